@@ -65,6 +65,19 @@
 #include "mavlink_manager.h"
 #include "psram_manager.h"
 #include "exif_gps_static.h"
+#include "capture_pipeline.h"
+#include "capture_trigger.h"
+#include "sensor_profile_manager.h"
+#include "sharpness_gate.h"
+#include "duplicate_filter.h"
+#include "thumbnail_manager.h"
+#include "capture_trace.h"
+#include "mission_log.h"
+#include "mission_manifest.h"
+#include "camera_hal.h"
+#include "camera_replay.h"
+#include "mission_tag_scanner.h"
+#include "preview_server.h"
 #include "esp_camera.h"
 
 // Task handles
@@ -72,6 +85,9 @@ TaskHandle_t cameraTaskHandle = NULL;
 TaskHandle_t uploadTaskHandle = NULL;
 TaskHandle_t ntripTaskHandle = NULL;
 
+// Frame source used instead of the sensor when Config::replay.enabled
+ReplayCameraSource replayCamera;
+
 // Button debouncing
 unsigned long lastDebounceTime = 0;
 bool lastCaptureState = HIGH;
@@ -85,6 +101,8 @@ bool landingModeActive = false;
 void cameraTask(void* parameter);
 void uploadTask(void* parameter);
 void handleButtons();
+void handleSerialCommands();
+void runCameraTest(bool (*test)(uint8_t), uint8_t frames);
 void initializeSystem();
 void performHealthCheck();
 
@@ -169,6 +187,9 @@ void loop() {
   // Handle button inputs and state machine
   handleButtons();
 
+  // Handle console commands
+  handleSerialCommands();
+
   // Check landing mode timeout
   if (landingModeActive &&
       (millis() - landingModeStartTime > LANDING_MODE_TIMEOUT_MS)) {
@@ -244,15 +265,44 @@ void initializeSystem() {
     }
   }
 
+  // Initialize capture pipeline (PSRAM frame ring + SD writer task)
+  if (!CapturePipeline::init()) {
+    Serial.println("WARNING: Capture pipeline unavailable - using synchronous SD writes");
+  }
+
+  // Per-stage capture latency ring (allocated once, recorded in flight)
+  if (Config::trace.enabled) {
+    CaptureTrace::init();
+  }
+
+  // Live MJPEG view of saved mission frames (field setup)
+  if (Config::preview.enabled) {
+    PreviewServer::init();
+  }
+
   // Initialize Camera Mode Manager
   if (!CameraModeManager::init()) {
     Serial.println("WARNING: Camera Mode Manager initialization failed!");
   }
 
+  // AprilTag scan of mission frames (needs the detector from CameraModeManager)
+  if (Config::missionTags.enabled) {
+    MissionTagScanner::init();
+  }
+
+  // Recorded frames instead of the sensor (bench tests, field issue reproduction)
+  if (Config::replay.enabled) {
+    CameraHAL::setSource(&replayCamera);
+    Serial.println("Camera source: replay of " + Config::replay.DIRECTORY);
+  }
+
   // Initialize camera (starts in IDLE mode)
   if (!CameraManager::init()) {
     Serial.println("WARNING: Camera initialization failed!");
     // Continue without camera - NTRIP can still work
+  } else if (Config::burst.enabled) {
+    // Reserve the burst staging arena while PSRAM is still unfragmented
+    CameraManager::initBurst();
   }
 
   // Enable GPS geotagging if available
@@ -349,13 +399,135 @@ void handleButtons() {
   }
 }
 
+// Frame tests run between missions; the camera is powered up for them if
+// idle mode had it switched off, and powered down again afterwards
+void runCameraTest(bool (*test)(uint8_t), uint8_t frames) {
+  bool poweredUp = false;
+  if (!CameraManager::isInitialized() && !SystemState::isCapturing()) {
+    CameraManager::powerUp();
+    poweredUp = CameraManager::isInitialized();
+  }
+  test(frames);
+  if (poweredUp) {
+    CameraManager::powerDown();
+  }
+}
+
+void handleSerialCommands() {
+  static char line[64];
+  static uint8_t length = 0;
+
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (length < sizeof(line) - 1) {
+        line[length++] = c;
+      }
+      continue;
+    }
+    if (length == 0) {
+      continue;
+    }
+    line[length] = '\0';
+    length = 0;
+
+    if (strcmp(line, "trace") == 0) {
+      CaptureTrace::printSummary();
+    } else if (strcmp(line, "trace dump") == 0) {
+      char path[40];
+      snprintf(path, sizeof(path), "/capture_trace_%lu.csv", millis());
+      if (!CaptureTrace::dumpCSV(path)) {
+        Serial.println("Capture trace dump failed");
+      }
+    } else if (strcmp(line, "trace reset") == 0) {
+      CaptureTrace::reset();
+      Serial.println("Capture trace cleared");
+    } else if (strcmp(line, "alloc test") == 0) {
+      CameraManager::runAllocationTest();
+    } else if (strcmp(line, "gps test") == 0) {
+      GPSManager::runFixHistoryTest();
+    } else if (strcmp(line, "tag bench") == 0) {
+      MissionTagScanner::runDecodeBenchmark(10);
+    } else if (strcmp(line, "preview bench") == 0) {
+      UploadManager::runPreviewBenchmark(5);
+    } else if (strcmp(line, "hash bench") == 0) {
+      StorageManager::runHashBenchmark(5);
+    } else if (strcmp(line, "exif test") == 0) {
+      StaticEXIFGPS::runRoundTripTest();
+    } else if (strcmp(line, "exif bench") == 0) {
+      StaticEXIFGPS::runCopyBenchmark();
+    } else if (strcmp(line, "sensor test") == 0) {
+      SensorProfileManager::runSelfTest();
+    } else if (strncmp(line, "pipeline test", 13) == 0) {
+      // pipeline test [frames] [interval_ms] [write_latency_ms]
+      unsigned frames = 50;
+      unsigned intervalMs = Config::cameraMode.MISSION_CAPTURE_INTERVAL;
+      unsigned latencyMs = intervalMs * 2;  // Slower than capture: exercises back-pressure
+      sscanf(line + 13, "%u %u %u", &frames, &intervalMs, &latencyMs);
+      CapturePipeline::runSelfTest(frames, intervalMs, latencyMs);
+    } else if (strcmp(line, "qc sim") == 0) {
+      QualityController::runSimulation();
+    } else if (strncmp(line, "qc sim ", 7) == 0) {
+      // qc sim <capture_dir>: replay the frame sizes recorded in its mission.bin
+      CameraModeManager::runQualityReplay(String(line + 7));
+    } else if (strncmp(line, "sharpness bench", 15) == 0) {
+      // sharpness bench [frames]
+      unsigned frames = 10;
+      sscanf(line + 15, "%u", &frames);
+      runCameraTest(SharpnessGate::runBenchmark, constrain(frames, 1u, 255u));
+    } else if (strcmp(line, "dup test") == 0) {
+      DuplicateFilter::runSelfTest();
+    } else if (strncmp(line, "thumb test", 10) == 0) {
+      // thumb test [frames]
+      unsigned frames = 5;
+      sscanf(line + 10, "%u", &frames);
+      runCameraTest(ThumbnailManager::runSelfTest, constrain(frames, 1u, 255u));
+    } else if (strcmp(line, "log test") == 0) {
+      MissionLog::runSelfTest();
+    } else if (strcmp(line, "burst") == 0) {
+      // Inspection pass: the camera task stages Config::burst.FRAMES in PSRAM, then flushes
+      if (!CameraManager::isBurstReady()) {
+        Serial.println("Burst unavailable: disabled in config or no PSRAM arena");
+      } else if (!CameraModeManager::isMissionMode() || !SystemState::isCapturing()) {
+        Serial.println("Burst needs mission capture running");
+      } else if (cameraTaskHandle) {
+        xTaskNotify(cameraTaskHandle, 3, eSetValueWithOverwrite);
+      }
+    } else if (strcmp(line, "trigger test") == 0) {
+      DistanceTrigger::runTrackTests();
+    } else if (strncmp(line, "trigger test ", 13) == 0) {
+      // trigger test <path>: replay a receiver NMEA log from the SD card
+      DistanceTrigger::runTrackTests(line + 13);
+    } else {
+      Serial.printf("Unknown command: %s\n", line);
+      Serial.println("Commands: trace, trace dump, trace reset, alloc test, gps test, tag bench, preview bench, hash bench, exif test, exif bench, sensor test,");
+      Serial.println("          pipeline test [frames interval_ms latency_ms], trigger test [nmea_path], qc sim [capture_dir],");
+      Serial.println("          sharpness bench [frames], dup test, thumb test [frames], log test, burst");
+    }
+  }
+}
+
 void cameraTask(void* parameter) {
   uint32_t notificationValue;
+  bool wasScheduled = false;
+
+  // Capture deadlines wake this task through a timer notification
+  CameraModeManager::initScheduler(xTaskGetCurrentTaskHandle());
 
   while (true) {
-    // Wait for notification with timeout
-    if (xTaskNotifyWait(0, 0xFFFFFFFF, &notificationValue, pdMS_TO_TICKS(100))) {
+    // Block until the next capture deadline or a command notification;
+    // a new capture run (start, resume after upload) begins with a fresh schedule
+    bool scheduled = CameraModeManager::isLandingMode() ||
+                     (CameraModeManager::isMissionMode() && SystemState::isCapturing());
+    if (scheduled && !wasScheduled) {
+      CameraModeManager::resetSchedule();
+    }
+    wasScheduled = scheduled;
+    TickType_t waitTicks = scheduled ? CameraModeManager::getScheduleWaitTicks() : pdMS_TO_TICKS(100);
+
+    if (xTaskNotifyWait(0, 0xFFFFFFFF, &notificationValue, waitTicks)) {
       CameraMode currentMode = CameraModeManager::getMode();
+      notificationValue &= CAMERA_NOTIFY_COMMAND_MASK;
 
       if (notificationValue == 1) {
         // Start mission capture (IDLE → MISSION transition)
@@ -368,8 +540,15 @@ void cameraTask(void* parameter) {
         if (currentMode == Config::CAMERA_MODE_LANDING) {
           Serial.println("Stopping mission capture, starting landing mode");
           CameraManager::stopCapture();
+          // The landing loop takes over the AprilTag detector
+          MissionTagScanner::waitIdle(1000);
           // Landing mode will be handled in the continuous processing below
         }
+      } else if (notificationValue == 3) {
+        // Burst capture (inspection pass): stage in PSRAM, then flush
+        if (currentMode == Config::CAMERA_MODE_MISSION && SystemState::isCapturing()) {
+          CameraManager::captureBurst();
+        }
       }
     }
 
@@ -378,6 +557,9 @@ void cameraTask(void* parameter) {
     // Handle mode-specific continuous processing
     switch (currentMode) {
       case Config::CAMERA_MODE_MISSION:
+        // A burst put off by a busy capture ring is written once it drains
+        CameraManager::serviceBurst();
+
         // Mission mode: Capture geotagged photos at configured interval
         if (SystemState::isCapturing() && CameraModeManager::shouldCapture()) {
           CameraModeManager::recordCaptureStart();
@@ -401,7 +583,7 @@ void cameraTask(void* parameter) {
           CameraModeManager::recordCaptureStart();
 
           // Get frame for AprilTag processing
-          camera_fb_t *fb = esp_camera_fb_get();
+          camera_fb_t *fb = CameraManager::grabFrame();
           if (fb) {
             // Process frame for AprilTag detection
             int tags_detected = 0;
@@ -428,7 +610,7 @@ void cameraTask(void* parameter) {
               }
             }
 
-            esp_camera_fb_return(fb);
+            CameraHAL::fbReturn(fb);
 
             // Record processing for statistics (success if frame processed)
             CameraModeManager::recordCaptureComplete(true);
@@ -442,9 +624,6 @@ void cameraTask(void* parameter) {
         // Idle mode: Do nothing
         break;
     }
-
-    // Small delay to prevent task hogging
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
 
@@ -525,6 +704,47 @@ void performHealthCheck() {
     NtripClient::printStatistics();
   }
 
+  if (CapturePipeline::isInitialized()) {
+    CapturePipeline::printStatistics();
+  }
+
+  if (SharpnessGate::getStatistics().scored > 0) {
+    SharpnessGate::printStatistics();
+  }
+
+  if (DuplicateFilter::getStatistics().framesChecked > 0) {
+    DuplicateFilter::printStatistics();
+  }
+
+  if (ThumbnailManager::getStatistics().written > 0 ||
+      ThumbnailManager::getStatistics().exifEmbedded > 0) {
+    ThumbnailManager::printStatistics();
+  }
+
+  if (MissionLog::getStatistics().recordsLogged > 0) {
+    MissionLog::printStatistics();
+  }
+
+  if (MissionManifest::getStatistics().featuresWritten > 0) {
+    MissionManifest::printStatistics();
+  }
+
+  if (MissionTagScanner::isInitialized()) {
+    MissionTagScanner::printStatistics();
+  }
+
+  if (PreviewServer::isInitialized()) {
+    PreviewServer::printStatistics();
+  }
+
+  if (CameraHAL::getSource() == &replayCamera) {
+    replayCamera.printStatistics();
+  }
+
+  if (CameraManager::getBurstStatistics().burstCount > 0) {
+    CameraManager::printBurstStatistics();
+  }
+
   // Check GPS status
   if (Config::gps.enabled) {
     Serial.printf("GPS: %s", GPSManager::hasValidFix() ? "Valid fix" : "No fix");
@@ -0,0 +1,168 @@
+#include "alloc_counter.h"
+
+#ifdef ALLOC_COUNTER
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#define ALLOC_COUNTER_MAX_TASKS 4
+
+// Nothing here may allocate: it runs inside malloc
+struct WatchedTask {
+    void* task;
+    int16_t exemptDepth;
+};
+
+static WatchedTask watched[ALLOC_COUNTER_MAX_TASKS];
+static uint8_t watchedCount = 0;
+static WatchedTask anyTask = {nullptr, 0}; // Used while no task is watched
+
+static std::atomic<uint32_t> allocCount(0);
+static std::atomic<uint32_t> allocBytes(0);
+static std::atomic<uint32_t> exemptCount(0);
+
+static WatchedTask* currentEntry() {
+    if (watchedCount == 0) {
+        return &anyTask;
+    }
+#ifdef ARDUINO
+    void* task = xTaskGetCurrentTaskHandle();
+#else
+    void* task = nullptr;
+#endif
+    for (uint8_t i = 0; i < watchedCount; i++) {
+        if (watched[i].task == task) {
+            return &watched[i];
+        }
+    }
+    return nullptr;
+}
+
+bool AllocCounter::watchTask(void* task) {
+    if (watchedCount >= ALLOC_COUNTER_MAX_TASKS) {
+        return false;
+    }
+    watched[watchedCount].task = task;
+    watched[watchedCount].exemptDepth = 0;
+    watchedCount++;
+    return true;
+}
+
+void AllocCounter::unwatchAll() {
+    watchedCount = 0;
+}
+
+void AllocCounter::reset() {
+    allocCount = 0;
+    allocBytes = 0;
+    exemptCount = 0;
+}
+
+void AllocCounter::record(size_t bytes) {
+    WatchedTask* entry = currentEntry();
+    if (!entry) {
+        return;
+    }
+    if (entry->exemptDepth > 0) {
+        exemptCount++;
+    } else {
+        allocCount++;
+        allocBytes += bytes;
+    }
+}
+
+uint32_t AllocCounter::getCount() {
+    return allocCount;
+}
+
+uint32_t AllocCounter::getBytes() {
+    return allocBytes;
+}
+
+uint32_t AllocCounter::getExemptCount() {
+    return exemptCount;
+}
+
+AllocCounter::Exempt::Exempt() {
+    WatchedTask* entry = currentEntry();
+    if (entry) {
+        entry->exemptDepth++;
+    }
+}
+
+AllocCounter::Exempt::~Exempt() {
+    WatchedTask* entry = currentEntry();
+    if (entry) {
+        entry->exemptDepth--;
+    }
+}
+
+// Linker wrappers (-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc)
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t num, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    AllocCounter::record(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t num, size_t size) {
+    AllocCounter::record(num * size);
+    return __real_calloc(num, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    AllocCounter::record(size);
+    return __real_realloc(ptr, size);
+}
+}
+
+// operator new counted here as well, for builds where the C++ runtime's
+// own malloc calls are not wrapped (shared libstdc++ on a host)
+void* operator new(size_t size) {
+    AllocCounter::record(size);
+    void* ptr = __real_malloc(size ? size : 1);
+    if (!ptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    AllocCounter::record(size);
+    return __real_malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+#endif // ALLOC_COUNTER
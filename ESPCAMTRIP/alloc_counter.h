@@ -0,0 +1,68 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Allocation Counter
+ *
+ * Counts heap allocations so a test can assert that the steady-state
+ * capture path allocates nothing (long missions must not fragment the
+ * heap). Off by default; a build enables it with
+ *
+ *   -DALLOC_COUNTER -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ *
+ * which routes malloc/calloc/realloc (and so Arduino String) through
+ * counting wrappers and replaces the global operator new. PSRAM buffers
+ * from heap_caps_malloc are counted by PSRAMManager. Without ALLOC_COUNTER
+ * every call below compiles to nothing and the counts stay 0.
+ *
+ * Allocations inside an AllocCounter::Exempt scope are counted separately:
+ * StorageManager uses it around the SD/VFS driver's file open and close,
+ * which allocate a handle per file and free it again on close.
+ */
+
+class AllocCounter {
+public:
+#ifdef ALLOC_COUNTER
+    static constexpr bool enabled = true;
+
+    /**
+     * Only count allocations made by these tasks (FreeRTOS handles);
+     * with none watched, every allocation counts
+     */
+    static bool watchTask(void* task);
+    static void unwatchAll();
+
+    static void reset();
+    static void record(size_t bytes);
+
+    static uint32_t getCount();          // Outside Exempt scopes
+    static uint32_t getBytes();
+    static uint32_t getExemptCount();    // Inside Exempt scopes (SD driver)
+
+    class Exempt {
+    public:
+        Exempt();
+        ~Exempt();
+    };
+#else
+    static constexpr bool enabled = false;
+
+    static bool watchTask(void*) { return false; }
+    static void unwatchAll() {}
+    static void reset() {}
+    static void record(size_t) {}
+    static uint32_t getCount() { return 0; }
+    static uint32_t getBytes() { return 0; }
+    static uint32_t getExemptCount() { return 0; }
+
+    class Exempt {
+    public:
+        Exempt() {}
+    };
+#endif
+};
+
+#endif // ALLOC_COUNTER_H
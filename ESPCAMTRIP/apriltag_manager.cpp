@@ -33,6 +33,7 @@ float AprilTagManager::camera_fx = 460.0f;  // Default focal length for VGA
 float AprilTagManager::camera_fy = 460.0f;
 float AprilTagManager::camera_cx = 320.0f;  // VGA center
 float AprilTagManager::camera_cy = 240.0f;
+int AprilTagManager::camera_width = 640;
 unsigned long AprilTagManager::last_detection_time = 0;
 AprilTagDetection AprilTagManager::last_detection = {};
 bool AprilTagManager::has_active_detection = false;
@@ -192,6 +193,9 @@ int AprilTagManager::processFrameData(uint8_t* frame_data, int width, int height
     zarray_t* detections = apriltag_detector_detect(detector, &image);
     int num_detections = zarray_size(detections);
 
+    // Detections are reported at the intrinsics resolution
+    float image_scale = (float)camera_width / width;
+
     // Process detections
     if (num_detections > 0) {
         // Get the first (best) detection for now
@@ -201,17 +205,17 @@ int AprilTagManager::processFrameData(uint8_t* frame_data, int width, int height
 
         // Convert to our internal format
         last_detection.id = detection->id;
-        last_detection.center_x = detection->c[0];
-        last_detection.center_y = detection->c[1];
+        last_detection.center_x = detection->c[0] * image_scale;
+        last_detection.center_y = detection->c[1] * image_scale;
         last_detection.decision_margin = detection->decision_margin;
 
         // Copy corner coordinates
         for (int i = 0; i < 8; i++) {
-            last_detection.corners[i] = detection->p[i/2][i%2];
+            last_detection.corners[i] = detection->p[i/2][i%2] * image_scale;
         }
 
         // Estimate pose if camera intrinsics are available
-        last_detection.pose_valid = estimatePose(detection, &last_detection);
+        last_detection.pose_valid = estimatePose(detection, &last_detection, image_scale);
 
         // Update detection state
         last_detection_time = millis();
@@ -220,7 +224,7 @@ int AprilTagManager::processFrameData(uint8_t* frame_data, int width, int height
         // Calculate tag size in pixels for quality assessment
         float corner_distance = sqrt(pow(detection->p[0][0] - detection->p[2][0], 2) +
                                    pow(detection->p[0][1] - detection->p[2][1], 2));
-        last_detection.tag_size_pixels = corner_distance;
+        last_detection.tag_size_pixels = corner_distance * image_scale;
 
         Serial.printf("AprilTag detected: ID=%d, center=(%.1f,%.1f), margin=%.2f\n",
                       last_detection.id, last_detection.center_x, last_detection.center_y,
@@ -254,20 +258,21 @@ int AprilTagManager::processFrameData(uint8_t* frame_data, int width, int height
 #endif
 }
 
-bool AprilTagManager::estimatePose(apriltag_detection* detection, AprilTagDetection* result) {
+bool AprilTagManager::estimatePose(apriltag_detection* detection, AprilTagDetection* result,
+                                   float image_scale) {
 #ifdef APRILTAG_ENABLED
     if (!isPoseEstimationReady() || !detection || !result) {
         return false;
     }
 
-    // Setup camera info for pose estimation
+    // Setup camera info for pose estimation, in the detector's pixel coordinates
     apriltag_detection_info_t info = {
         .det = detection,
         .tagsize = tag_size_m,
-        .fx = camera_fx,
-        .fy = camera_fy,
-        .cx = camera_cx,
-        .cy = camera_cy
+        .fx = camera_fx / image_scale,
+        .fy = camera_fy / image_scale,
+        .cx = camera_cx / image_scale,
+        .cy = camera_cy / image_scale
     };
 
     // Estimate pose
@@ -302,14 +307,15 @@ unsigned long AprilTagManager::getDetectionAge() {
     return millis() - last_detection_time;
 }
 
-void AprilTagManager::setCameraIntrinsics(float fx, float fy, float cx, float cy) {
+void AprilTagManager::setCameraIntrinsics(float fx, float fy, float cx, float cy, int width) {
     camera_fx = fx;
     camera_fy = fy;
     camera_cx = cx;
     camera_cy = cy;
+    camera_width = width;
 
-    Serial.printf("Camera intrinsics updated: fx=%.1f fy=%.1f cx=%.1f cy=%.1f\n",
-                  fx, fy, cx, cy);
+    Serial.printf("Camera intrinsics updated: fx=%.1f fy=%.1f cx=%.1f cy=%.1f (width %d)\n",
+                  fx, fy, cx, cy, width);
 }
 
 bool AprilTagManager::isPoseEstimationReady() {
@@ -79,6 +79,7 @@ private:
     static float tag_size_m;           // Physical tag size in meters
     static float camera_fx, camera_fy; // Camera focal lengths
     static float camera_cx, camera_cy; // Camera optical center
+    static int camera_width;           // Image width the intrinsics are for
 
     // Processing state
     static unsigned long last_detection_time;
@@ -92,7 +93,8 @@ private:
     static bool initializeDetector();
     static void deinitializeDetector();
     static bool processFrameBuffer(uint8_t* frame_data, int width, int height);
-    static bool estimatePose(apriltag_detection* detection, AprilTagDetection* result);
+    static bool estimatePose(apriltag_detection* detection, AprilTagDetection* result,
+                             float image_scale);
     static void updateStatistics(unsigned long process_time, int detection_count);
 
 public:
@@ -129,7 +131,10 @@ public:
 
     /**
      * Process raw frame data for AprilTag detection
-     * Alternative interface for custom frame processing
+     * Alternative interface for custom frame processing. Frames of another
+     * width than the intrinsics (e.g. downscaled mission frames) must have
+     * the same field of view; detection coordinates are reported at the
+     * intrinsics resolution.
      *
      * @param frame_data Grayscale image data
      * @param width Image width in pixels
@@ -159,7 +164,7 @@ public:
      * Configuration functions
      */
     static void setTagSize(float size_meters) { tag_size_m = size_meters; }
-    static void setCameraIntrinsics(float fx, float fy, float cx, float cy);
+    static void setCameraIntrinsics(float fx, float fy, float cx, float cy, int width = 640);
 
     /**
      * Get processing statistics
@@ -0,0 +1,31 @@
+#include "camera_hal.h"
+
+#ifdef ESP_PLATFORM
+
+// ESP32 camera driver backend
+class Esp32CameraSource : public CameraSource {
+public:
+    const char* getName() const override { return "esp32"; }
+    esp_err_t init(const camera_config_t& config) override { return esp_camera_init(&config); }
+    void deinit() override { esp_camera_deinit(); }
+    camera_fb_t* getFrame() override { return esp_camera_fb_get(); }
+    void returnFrame(camera_fb_t* fb) override { esp_camera_fb_return(fb); }
+    sensor_t* getSensor() override { return esp_camera_sensor_get(); }
+};
+
+static Esp32CameraSource esp32Source;
+#define DEFAULT_CAMERA_SOURCE (&esp32Source)
+
+#else
+
+// Host builds have no driver and must select a source (e.g. replay)
+#define DEFAULT_CAMERA_SOURCE nullptr
+
+#endif
+
+// Static member definitions
+CameraSource* CameraHAL::source = DEFAULT_CAMERA_SOURCE;
+
+void CameraHAL::setSource(CameraSource* newSource) {
+    source = newSource ? newSource : DEFAULT_CAMERA_SOURCE;
+}
@@ -0,0 +1,52 @@
+#ifndef CAMERA_HAL_H
+#define CAMERA_HAL_H
+
+#include "esp_camera.h"
+
+/**
+ * Camera HAL
+ *
+ * The capture path gets frames and the sensor through CameraHAL instead
+ * of calling esp_camera_* directly, so a different frame source can stand
+ * in for the driver: the ESP32 camera driver by default, or the replay
+ * source (camera_replay.h) serving recorded JPEG/PGM frames from a
+ * directory, on the device or in a host build.
+ *
+ * The interface mirrors esp_camera: camera_fb_t frames that are returned
+ * to the source, and a sensor_t whose setters and status the mode switch
+ * and sensor profile code use unchanged.
+ */
+
+class CameraSource {
+public:
+    virtual ~CameraSource() {}
+
+    virtual const char* getName() const = 0;
+    virtual esp_err_t init(const camera_config_t& config) = 0;
+    virtual void deinit() = 0;
+    virtual camera_fb_t* getFrame() = 0;           // nullptr on timeout or end of input
+    virtual void returnFrame(camera_fb_t* fb) = 0;
+    virtual sensor_t* getSensor() = 0;
+};
+
+class CameraHAL {
+private:
+    static CameraSource* source;
+
+public:
+    /**
+     * Select the frame source; call before CameraManager::init()
+     * nullptr selects the ESP32 camera driver
+     */
+    static void setSource(CameraSource* source);
+    static CameraSource* getSource() { return source; }
+    static const char* getSourceName() { return source->getName(); }
+
+    static esp_err_t init(const camera_config_t& config) { return source->init(config); }
+    static void deinit() { source->deinit(); }
+    static camera_fb_t* fbGet() { return source->getFrame(); }
+    static void fbReturn(camera_fb_t* fb) { source->returnFrame(fb); }
+    static sensor_t* sensorGet() { return source->getSensor(); }
+};
+
+#endif // CAMERA_HAL_H
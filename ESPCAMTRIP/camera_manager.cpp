@@ -4,45 +4,97 @@
 #include "storage_manager.h"
 #include "gps_manager.h"
 #include "exif_gps_static.h"
+#include "capture_pipeline.h"
+#include "camera_mode_manager.h"
 #include "psram_manager.h"
+#include "duplicate_filter.h"
+#include "thumbnail_manager.h"
+#include "capture_trace.h"
+#include "mission_log.h"
+#include "mission_manifest.h"
+#include "alloc_counter.h"
+#include "camera_hal.h"
+#include "mission_tag_scanner.h"
 #include <esp_camera.h>
-#include <ArduinoJson.h>
+#include <esp_timer.h>
 
 // Static member definitions
 bool CameraManager::initialized = false;
 bool CameraManager::capturing = false;
 int CameraManager::photoCount = 0;
+uint32_t CameraManager::captureSequence = 0;
 String CameraManager::currentDirectory = "";
 bool CameraManager::geotaggingEnabled = false;
+uint8_t* CameraManager::burstArena = nullptr;
+size_t CameraManager::burstArenaSize = 0;
+BurstStatistics CameraManager::burstStats = {};
+uint8_t CameraManager::burstPending = 0;
+
+// Burst frame descriptors; data points into burstArena
+static CaptureSlot burstFrames[BURST_MAX_FRAMES];
 
 bool CameraManager::init() {
   Serial.println("Initializing camera...");
   
   camera_config_t config = getCameraConfig();
   
+  SensorProfileId profile = Config::camera.LOW_LIGHT_PROFILE ? SENSOR_PROFILE_LOW_LIGHT
+                                                              : SENSOR_PROFILE_MISSION;
+  if (!initDriver(config, profile)) {
+    return false;
+  }
+  
+  Serial.println("Camera initialized successfully");
+  return true;
+}
+
+bool CameraManager::reinit(const camera_config_t& config, SensorProfileId profile) {
+  deinit();
+  return initDriver(config, profile);
+}
+
+bool CameraManager::initDriver(const camera_config_t& config, SensorProfileId profile) {
   // Initialize camera
-  esp_err_t err = esp_camera_init(&config);
+  esp_err_t err = CameraHAL::init(config);
   if (err != ESP_OK) {
     Serial.printf("Camera init failed with error 0x%x\n", err);
     return false;
   }
   
-  // Apply additional settings
-  applyCameraSettings();
+  // Driver reset the sensor: seed the shadow, then write only what the profile changes
+  SensorProfileManager::syncFromSensor(CameraHAL::sensorGet());
+  applyProfile(profile);
   
   initialized = true;
-  Serial.println("Camera initialized successfully");
+  CameraModeManager::onCameraInitialized();
   return true;
 }
 
 void CameraManager::deinit() {
   if (initialized) {
-    esp_camera_deinit();
+    CameraHAL::deinit();
     initialized = false;
+    SensorProfileManager::invalidate();
+    CameraModeManager::onCameraDeinitialized();
     Serial.println("Camera deinitialized");
   }
 }
 
+camera_fb_t* CameraManager::grabFrame() {
+  // Skip frames still queued from before an in-place mode switch
+  for (uint8_t attempt = 0; attempt <= Config::cameraMode.FAST_SWITCH_FB_COUNT; attempt++) {
+    camera_fb_t *fb = CameraHAL::fbGet();
+    if (!fb) {
+      return nullptr;
+    }
+    if (CameraModeManager::acceptFrame(fb)) {
+      return fb;
+    }
+    CameraHAL::fbReturn(fb);
+  }
+  return nullptr;
+}
+
 bool CameraManager::isInitialized() {
   return initialized;
 }
@@ -79,6 +131,10 @@ bool CameraManager::startCapture() {
   
   capturing = true;
   photoCount = 0;
+  captureSequence = 0;
+  DuplicateFilter::reset(currentDirectory);
+  MissionLog::open(currentDirectory);
+  MissionManifest::open(currentDirectory);
   SystemState::setCapturing(true);
   SystemState::setCameraInUse(true);
   
@@ -89,6 +145,15 @@ bool CameraManager::startCapture() {
 void CameraManager::stopCapture() {
   capturing = false;
   SystemState::setCapturing(false);
+
+  // Flush frames still buffered in the capture ring to this directory
+  CapturePipeline::waitUntilDrained(5000);
+  if (burstPending > 0) {
+    flushBurst(burstPending);
+  }
+  DuplicateFilter::flushLog();
+  MissionLog::close();
+  MissionManifest::close();
   SystemState::setCameraInUse(false);
   
   Serial.printf("Capture stopped. Total photos: %d\n", photoCount);
@@ -99,30 +164,86 @@ bool CameraManager::capturePhoto() {
     return false;
   }
   
-  camera_fb_t *fb = esp_camera_fb_get();
+  uint32_t trace = CaptureTrace::begin();
+  uint32_t stageStart = micros();
+  camera_fb_t *fb = grabFrame();
+  CaptureTrace::record(trace, TRACE_FB_GET, stageStart);
   if (!fb) {
     Serial.println("Camera capture failed");
     return false;
   }
+  CameraModeManager::recordFrameSize(fb->len);
+
+  // Blur check on the entropy data before anything is copied or written
+  stageStart = micros();
+  bool keep = fb->format != PIXFORMAT_JPEG || SharpnessGate::check(fb->buf, fb->len);
+  CaptureTrace::record(trace, TRACE_ANALYZE, stageStart);
+  if (!keep) {
+    CameraHAL::fbReturn(fb);
+    CameraModeManager::recordFrameSkipped();
+    return false;
+  }
+
+  // Hand the frame to the SD writer task when it fits a ring slot
+  if (CapturePipeline::isInitialized()) {
+    if (fb->len <= Config::pipeline.SLOT_SIZE) {
+      return queueFrame(fb, false, nullptr, trace);
+    }
+    CapturePipeline::recordOversizeFrame();
+
+    // Written here only once the writer task is idle, never alongside it
+    if (!CapturePipeline::waitUntilDrained(2000)) {
+      CameraHAL::fbReturn(fb);
+      CameraModeManager::recordBackPressure(true);
+      Serial.println("Capture ring busy - oversize frame dropped");
+      return false;
+    }
+  }
   
-  String filename = generateFilename();
+  char filename[sizeof(CaptureSlot::filename)];
+  generateFilename(filename, sizeof(filename));
+  uint32_t writeStart = micros();
   File file = StorageManager::openFile(filename, "w");
+  CaptureTrace::record(trace, TRACE_OPEN, writeStart);
   
   if (!file) {
-    Serial.println("Failed to create file: " + filename);
-    esp_camera_fb_return(fb);
+    Serial.printf("Failed to create file: %s\n", filename);
+    CameraHAL::fbReturn(fb);
     return false;
   }
   
-  size_t written = file.write(fb->buf, fb->len);
+  stageStart = micros();
+  PhotoHash hash;
+  size_t written = StorageManager::writeHashed(file, fb->buf, fb->len, hash);
+  CaptureTrace::record(trace, TRACE_WRITE, stageStart);
+  stageStart = micros();
   StorageManager::closeFile(file);
+  CaptureTrace::record(trace, TRACE_CLOSE, stageStart);
   
-  esp_camera_fb_return(fb);
+  size_t frameSize = fb->len;
+  CameraHAL::fbReturn(fb);
   
-  if (written == fb->len) {
+  if (written == frameSize) {
+    CameraModeManager::recordFrameWrite(written, micros() - writeStart);
+    CaptureTrace::setPhoto(trace, captureSequence);
+
+    CaptureSlot meta = {};
+    meta.length = frameSize;
+    meta.sequence = captureSequence;
+    meta.captureTime = millis();
+    meta.sharpness = -1;
+    hash.finish(meta.sha256);
+    strlcpy(meta.filename, filename, sizeof(meta.filename));
+    snapshotSensor(meta);
+    stageStart = micros();
+    logPhoto(meta);
+    CaptureTrace::record(trace, TRACE_METADATA, stageStart);
+    CaptureTrace::finish(trace);
+
     photoCount++;
+    captureSequence++;
     SystemState::incrementPhotoCount();
-    Serial.printf("Photo %04d saved: %u bytes\n", photoCount - 1, (unsigned)fb->len);
+    printPhotoSaved(meta);
     return true;
   }
   
@@ -132,7 +253,7 @@ bool CameraManager::capturePhoto() {
 bool CameraManager::setQuality(int quality) {
   if (!initialized) return false;
   
-  sensor_t * s = esp_camera_sensor_get();
+  sensor_t * s = CameraHAL::sensorGet();
   if (!s) return false;
   
   s->set_quality(s, quality);
@@ -142,7 +263,7 @@ bool CameraManager::setQuality(int quality) {
 bool CameraManager::setFrameSize(framesize_t size) {
   if (!initialized) return false;
   
-  sensor_t * s = esp_camera_sensor_get();
+  sensor_t * s = CameraHAL::sensorGet();
   if (!s) return false;
   
   s->set_framesize(s, size);
@@ -152,30 +273,33 @@ bool CameraManager::setFrameSize(framesize_t size) {
 bool CameraManager::setBrightness(int brightness) {
   if (!initialized) return false;
   
-  sensor_t * s = esp_camera_sensor_get();
+  sensor_t * s = CameraHAL::sensorGet();
   if (!s) return false;
   
   s->set_brightness(s, brightness);
+  SensorProfileManager::syncFromSensor(s);
   return true;
 }
 
 bool CameraManager::setContrast(int contrast) {
   if (!initialized) return false;
   
-  sensor_t * s = esp_camera_sensor_get();
+  sensor_t * s = CameraHAL::sensorGet();
   if (!s) return false;
   
   s->set_contrast(s, contrast);
+  SensorProfileManager::syncFromSensor(s);
   return true;
 }
 
 bool CameraManager::setSaturation(int saturation) {
   if (!initialized) return false;
   
-  sensor_t * s = esp_camera_sensor_get();
+  sensor_t * s = CameraHAL::sensorGet();
   if (!s) return false;
   
   s->set_saturation(s, saturation);
+  SensorProfileManager::syncFromSensor(s);
   return true;
 }
 
@@ -217,33 +341,22 @@ camera_config_t CameraManager::getCameraConfig() {
   return config;
 }
 
-void CameraManager::applyCameraSettings() {
-  sensor_t * s = esp_camera_sensor_get();
-  if (!s) return;
-  
-  // Apply optimal settings
-  s->set_brightness(s, 0);     // -2 to 2
-  s->set_contrast(s, 0);       // -2 to 2
-  s->set_saturation(s, 0);     // -2 to 2
-  s->set_special_effect(s, 0); // 0 - No Effect
-  s->set_whitebal(s, 1);       // 0 = disable, 1 = enable
-  s->set_awb_gain(s, 1);       // 0 = disable, 1 = enable
-  s->set_wb_mode(s, 0);        // 0 to 4 - if awb_gain enabled (0 - Auto)
-  s->set_exposure_ctrl(s, 1);  // 0 = disable, 1 = enable
-  s->set_aec2(s, 0);           // 0 = disable, 1 = enable
-  s->set_ae_level(s, 0);       // -2 to 2
-  s->set_aec_value(s, 300);    // 0 to 1200
-  s->set_gain_ctrl(s, 1);      // 0 = disable, 1 = enable
-  s->set_agc_gain(s, 0);       // 0 to 30
-  s->set_gainceiling(s, (gainceiling_t)0);  // 0 to 6
-  s->set_bpc(s, 0);            // 0 = disable, 1 = enable
-  s->set_wpc(s, 1);            // 0 = disable, 1 = enable
-  s->set_raw_gma(s, 1);        // 0 = disable, 1 = enable
-  s->set_lenc(s, 1);           // 0 = disable, 1 = enable
-  s->set_hmirror(s, 0);        // 0 = disable, 1 = enable
-  s->set_vflip(s, 0);          // 0 = disable, 1 = enable
-  s->set_dcw(s, 1);            // 0 = disable, 1 = enable
-  s->set_colorbar(s, 0);       // 0 = disable, 1 = enable
+bool CameraManager::applyProfile(SensorProfileId profile) {
+  sensor_t * s = CameraHAL::sensorGet();
+  if (!s) return false;
+  
+  unsigned long start = micros();
+  int writes = SensorProfileManager::apply(s, profile);
+  uint32_t elapsed = micros() - start;
+  SensorProfileManager::recordApplyTime(elapsed);
+  
+  if (writes < 0) {
+    return false;
+  }
+  
+  Serial.printf("Sensor profile %s applied: %d writes in %u us\n",
+                SensorProfileManager::getProfileName(profile), writes, elapsed);
+  return true;
 }
 
 bool CameraManager::createCaptureDirectory() {
@@ -269,10 +382,8 @@ bool CameraManager::createCaptureDirectory() {
   return true;
 }
 
-String CameraManager::generateFilename() {
-  char filename[100];
-  sprintf(filename, "%s/photo_%04d.jpg", currentDirectory.c_str(), photoCount);
-  return String(filename);
+void CameraManager::generateFilename(char* filename, size_t size) {
+  snprintf(filename, size, "%s/photo_%04u.jpg", currentDirectory.c_str(), captureSequence);
 }
 
 bool CameraManager::isCameraPin(int pin) {
@@ -304,6 +415,17 @@ bool CameraManager::isCameraPin(int pin) {
 
 // GPS Geotagging Functions
 
+// EXIF date/time: UTC of the exposure from the GPS clock, with milliseconds
+// in GPSTimeStamp; the system clock only until the receiver has sent a date
+static void updateEXIF(const CaptureSlot& slot) {
+  if (slot.exposureUnixUs > 0) {
+    StaticEXIFGPS::updateGPS(slot.gps, (uint32_t)(slot.exposureUnixUs / 1000000),
+                             (uint16_t)((slot.exposureUnixUs / 1000) % 1000));
+  } else {
+    StaticEXIFGPS::updateGPS(slot.gps);
+  }
+}
+
 bool CameraManager::enableGeotagging(bool enable) {
   geotaggingEnabled = enable && Config::gps.enable_geotagging;
   Serial.printf("GPS geotagging %s\n", geotaggingEnabled ? "enabled" : "disabled");
@@ -320,185 +442,672 @@ bool CameraManager::captureGeotaggedPhoto() {
   }
 
   // Get camera frame
-  camera_fb_t *fb = esp_camera_fb_get();
+  uint32_t trace = CaptureTrace::begin();
+  uint32_t stageStart = micros();
+  camera_fb_t *fb = grabFrame();
+  CaptureTrace::record(trace, TRACE_FB_GET, stageStart);
   if (!fb) {
     Serial.println("Camera capture failed");
     return false;
   }
+  CameraModeManager::recordFrameSize(fb->len);
+
+  // Blur check on the entropy data before the file is opened; blurred
+  // frames are dropped or kept and marked in the metadata
+  stageStart = micros();
+  SharpnessResult sharpness = {};
+  static DCGrid dcGrid;
+  bool dedup = DuplicateFilter::isEnabled() && fb->format == PIXFORMAT_JPEG;
+  bool keep = fb->format != PIXFORMAT_JPEG ||
+              SharpnessGate::check(fb->buf, fb->len, &sharpness, dedup ? &dcGrid : nullptr);
+
+  // Near-duplicate of the last written frame while stationary: not written
+  if (keep && dedup &&
+      DuplicateFilter::evaluate(&dcGrid, GPSManager::getPosition(), fb->len, captureSequence)) {
+    keep = false;
+  }
+  CaptureTrace::record(trace, TRACE_ANALYZE, stageStart);
+  if (!keep) {
+    CameraHAL::fbReturn(fb);
+    CameraModeManager::recordFrameSkipped();
+    return false;
+  }
+
+  bool geotag = isGeotaggingEnabled();
+
+  // Hand the frame to the SD writer task when it fits a ring slot
+  if (CapturePipeline::isInitialized()) {
+    size_t needed = fb->len + (geotag ? StaticEXIFGPS::getHeaderSize() : 0);
+    if (needed <= Config::pipeline.SLOT_SIZE) {
+      return queueFrame(fb, geotag, &sharpness, trace);
+    }
+    CapturePipeline::recordOversizeFrame();
+
+    // Written here only once the writer task is idle, never alongside it
+    if (!CapturePipeline::waitUntilDrained(2000)) {
+      CameraHAL::fbReturn(fb);
+      CameraModeManager::recordBackPressure(true);
+      Serial.println("Capture ring busy - oversize frame dropped");
+      return false;
+    }
+  }
+
+  // Synchronous fallback: pipeline disabled or frame too large for a slot
+  CaptureSlot meta = {};
+  meta.exposureUs = frameTimestamp(fb);
+  meta.captureTime = (unsigned long)(meta.exposureUs / 1000);
+  if (geotag) {
+    resolvePosition(meta);
+  }
 
   // Generate filename (with GPS coordinates if available)
-  String filename = isGeotaggingEnabled() ? generateGeotaggedFilename() : generateFilename();
+  char filename[sizeof(CaptureSlot::filename)];
+  if (geotag) {
+    generateGeotaggedFilename(filename, sizeof(filename), meta.gps);
+  } else {
+    generateFilename(filename, sizeof(filename));
+  }
+  uint32_t writeStart = micros();
   File file = StorageManager::openFile(filename, "w");
+  CaptureTrace::record(trace, TRACE_OPEN, writeStart);
 
   if (!file) {
-    Serial.println("Failed to create file: " + filename);
-    esp_camera_fb_return(fb);
+    Serial.printf("Failed to create file: %s\n", filename);
+    CameraHAL::fbReturn(fb);
     return false;
   }
 
-  // Embed EXIF GPS data if geotagging is enabled (static implementation)
-  size_t finalDataSize = fb->len;
-  uint8_t* finalData = fb->buf;
-  uint8_t* exifBuffer = nullptr;
+  // Write SOI + EXIF header + rest of frame straight from the camera buffer
+  size_t finalDataSize = 0;
+  size_t written = 0;
+  PhotoHash hash;
+  HashingPrint out(file, hash);
 
-  if (isGeotaggingEnabled()) {
+  if (geotag) {
     // Update static EXIF header with current GPS data
-    GPSPosition gpsPos = GPSManager::getPosition();
-    StaticEXIFGPS::updateGPS(gpsPos.latitude, gpsPos.longitude, gpsPos.altitude,
-                            gpsPos.valid ? time(nullptr) : 0, GPSManager::getFixQuality());
-
-    // Allocate buffer for JPEG + EXIF (using PSRAM for large allocations)
-    size_t bufferSize = fb->len + StaticEXIFGPS::getHeaderSize();
-    exifBuffer = (uint8_t*)PSRAMManager::allocate(bufferSize);
-
-    if (exifBuffer) {
-      // Copy original JPEG data
-      memcpy(exifBuffer, fb->buf, fb->len);
-
-      // Embed static EXIF data
-      size_t newSize = StaticEXIFGPS::embedIntoJPEG(exifBuffer, fb->len, bufferSize);
-      if (newSize > 0) {
-        finalData = exifBuffer;
-        finalDataSize = newSize;
-        Serial.printf("Static EXIF GPS embedded (%u bytes added)\n", newSize - fb->len);
-      } else {
-        Serial.println("Failed to embed static EXIF GPS, using original JPEG");
-        PSRAMManager::deallocate(exifBuffer);
-        exifBuffer = nullptr;
-      }
-    } else {
-      Serial.println("Failed to allocate EXIF buffer from PSRAM");
+    stageStart = micros();
+    updateEXIF(meta);
+    CaptureTrace::record(trace, TRACE_EXIF, stageStart);
+
+    stageStart = micros();
+    finalDataSize = fb->len + StaticEXIFGPS::getHeaderSize();
+    written = StaticEXIFGPS::writeWithEXIF(out, fb->buf, fb->len);
+    if (written == 0 && file.position() == 0) {
+      Serial.println("Failed to embed static EXIF GPS, using original JPEG");
+      finalDataSize = fb->len;
+      written = out.write(fb->buf, fb->len);
     }
+  } else {
+    stageStart = micros();
+    finalDataSize = fb->len;
+    written = out.write(fb->buf, fb->len);
   }
+  CaptureTrace::record(trace, TRACE_WRITE, stageStart);
 
-  // Write final image data
-  size_t written = file.write(finalData, finalDataSize);
+  stageStart = micros();
   StorageManager::closeFile(file);
-
-  // Clean up EXIF buffer if allocated
-  if (exifBuffer) {
-    PSRAMManager::deallocate(exifBuffer);
-  }
+  CaptureTrace::record(trace, TRACE_CLOSE, stageStart);
 
   // Return frame buffer
-  esp_camera_fb_return(fb);
+  size_t frameSize = fb->len;
+  CameraHAL::fbReturn(fb);
 
   // Check write success
   if (written == finalDataSize) {
+    CameraModeManager::recordFrameWrite(written, micros() - writeStart);
+    uint32_t photoNumber = captureSequence++;
     photoCount++;
     SystemState::incrementPhotoCount();
+    CaptureTrace::setPhoto(trace, photoNumber);
 
-    // Save GPS metadata if geotagging is enabled
-    if (isGeotaggingEnabled()) {
-      saveGPSMetadata(filename);
-      Serial.printf("Geotagged photo %04d saved: %u bytes (GPS: %.6f, %.6f)\n",
-                    photoCount - 1, (unsigned)fb->len,
-                    GPSManager::getPosition().latitude,
-                    GPSManager::getPosition().longitude);
-    } else {
-      Serial.printf("Photo %04d saved: %u bytes\n", photoCount - 1, (unsigned)fb->len);
-    }
+    meta.length = written;
+    meta.exifSize = written - frameSize;
+    meta.sequence = photoNumber;
+    meta.geotagged = geotag;
+    meta.sharpness = sharpness.valid ? (int16_t)sharpness.score : -1;
+    meta.blurred = sharpness.blurred;
+    hash.finish(meta.sha256);
+    strlcpy(meta.filename, filename, sizeof(meta.filename));
+    snapshotSensor(meta);
+    stageStart = micros();
+    logPhoto(meta);
+    CaptureTrace::record(trace, TRACE_METADATA, stageStart);
+    CaptureTrace::finish(trace);
+
+    printPhotoSaved(meta);
     return true;
   }
 
   return false;
 }
 
-String CameraManager::generateGeotaggedFilename() {
-  char filename[150];
+bool CameraManager::queueFrame(camera_fb_t* fb, bool geotag, const SharpnessResult* sharpness,
+                               uint32_t trace) {
+  // Back-pressure: ring full when the frame arrived
+  bool ringFull = CapturePipeline::getOccupancy() >= CapturePipeline::getCapacity();
+  uint32_t stageStart = micros();
+  CaptureSlot* slot = CapturePipeline::acquireSlot(Config::pipeline.ACQUIRE_TIMEOUT_MS);
+  CaptureTrace::record(trace, TRACE_SLOT_ACQUIRE, stageStart);
+  if (ringFull || !slot) {
+    CameraModeManager::recordBackPressure(slot == nullptr);
+  }
+
+  if (!slot) {
+    CameraHAL::fbReturn(fb);
+    Serial.println("Capture ring full - frame dropped");
+    return false;
+  }
 
-  if (isGeotaggingEnabled()) {
-    GPSPosition gpsPos = GPSManager::getPosition();
-    // Format: photo_0001_N3752.1234_E14510.5678_RTK.jpg
-    // Converts decimal degrees to DDMM.MMMM format for filename
-    double lat = abs(gpsPos.latitude);
-    double lon = abs(gpsPos.longitude);
-    int latDeg = (int)lat;
-    int lonDeg = (int)lon;
-    double latMin = (lat - latDeg) * 60.0;
-    double lonMin = (lon - lonDeg) * 60.0;
+  stageStart = micros();
+  stageFrame(fb, *slot, geotag);
+  CameraHAL::fbReturn(fb);
+  CaptureTrace::record(trace, TRACE_EXIF, stageStart);
+  if (sharpness && sharpness->valid) {
+    slot->sharpness = sharpness->score;
+    slot->blurred = sharpness->blurred;
+  }
+  slot->trace = trace;
+  CaptureTrace::setPhoto(trace, captureSequence);
 
-    char latHem = (gpsPos.latitude >= 0) ? 'N' : 'S';
-    char lonHem = (gpsPos.longitude >= 0) ? 'E' : 'W';
+  captureSequence++;
+  CaptureTrace::markQueued(trace);
+  CapturePipeline::commitSlot(slot);
+  CameraModeManager::recordRingOccupancy(CapturePipeline::getOccupancy());
+  return true;
+}
 
-    const char* fixType = GPSManager::hasRTKFix() ? "RTK" : "GPS";
+void CameraManager::stageFrame(camera_fb_t* fb, CaptureSlot& slot, bool geotag) {
+  slot.sequence = captureSequence;
+  slot.exposureUs = frameTimestamp(fb);
+  slot.captureTime = (unsigned long)(slot.exposureUs / 1000);
+  slot.geotagged = geotag;
+  slot.positionSource = GPS_POSITION_LATEST;
+  slot.fixOffsetUs = 0;
+  slot.exposureUnixUs = 0;
+  slot.sharpness = -1;
+  slot.blurred = false;
+  slot.trace = 0;
+  slot.exifSize = 0;
+  slot.thumbnailSize = 0;
+  snapshotSensor(slot);
 
-    sprintf(filename, "%s/photo_%04d_%c%02d%06.3f_%c%03d%06.3f_%s.jpg",
-            currentDirectory.c_str(), photoCount,
-            latHem, latDeg, latMin,
-            lonHem, lonDeg, lonMin,
-            fixType);
+  if (geotag) {
+    // Position at exposure; the writer may run much later. The file name,
+    // EXIF and mission log record all take it from here
+    resolvePosition(slot);
+    updateEXIF(slot);
+    generateGeotaggedFilename(slot.filename, sizeof(slot.filename), slot.gps);
   } else {
-    // Fallback to regular filename if GPS not available
-    sprintf(filename, "%s/photo_%04d.jpg", currentDirectory.c_str(), photoCount);
+    generateFilename(slot.filename, sizeof(slot.filename));
+  }
+
+  // Single copy into the slot (EXIF spliced in); caller returns the camera buffer
+  slot.length = 0;
+  if (geotag) {
+    slot.length = StaticEXIFGPS::copyWithEXIF(slot.data, slot.capacity, fb->buf, fb->len);
+    if (slot.length == 0) {
+      Serial.println("Failed to embed static EXIF GPS, using original JPEG");
+    } else {
+      slot.exifSize = slot.length - fb->len;
+    }
   }
+  if (slot.length == 0) {
+    memcpy(slot.data, fb->buf, fb->len);
+    slot.length = fb->len;
+  }
+}
+
+int64_t CameraManager::frameTimestamp(const camera_fb_t* fb) {
+  // The driver stamps each frame from esp_timer as its capture starts
+  int64_t timeUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+  return timeUs > 0 ? timeUs : esp_timer_get_time();
+}
 
-  return String(filename);
+void CameraManager::resolvePosition(CaptureSlot& slot) {
+  slot.fixOffsetUs = 0;
+  slot.positionSource = GPSManager::getPositionAt(slot.exposureUs, slot.gps, &slot.fixOffsetUs);
+  slot.exposureUnixUs = GPSManager::getUnixTimeAt(slot.exposureUs);
 }
 
-bool CameraManager::saveGPSMetadata(const String& photoFilename) {
-  if (!isGeotaggingEnabled()) {
+void CameraManager::refinePosition(CaptureSlot& slot) {
+  // At staging the fix after the exposure is usually still on its way, so
+  // the position was projected; interpolate once that fix has arrived
+  if (!slot.geotagged || slot.positionSource != GPS_POSITION_EXTRAPOLATED || slot.exifSize == 0) {
+    return;
+  }
+  GPSPosition pos;
+  int32_t fixOffset = 0;
+  if (GPSManager::getPositionAt(slot.exposureUs, pos, &fixOffset) != GPS_POSITION_INTERPOLATED) {
+    return;
+  }
+  if (StaticEXIFGPS::patchPosition(slot.data, slot.length, pos)) {
+    slot.gps = pos;
+    slot.positionSource = GPS_POSITION_INTERPOLATED;
+    slot.fixOffsetUs = fixOffset;
+
+    // Not opened yet: keep the coordinates in the name in step with the EXIF
+    char* name = strrchr(slot.filename, '/');
+    if (name) {
+      name++;
+      formatGeotaggedName(name, sizeof(slot.filename) - (name - slot.filename), slot.sequence, pos);
+    }
+  }
+}
+
+bool CameraManager::writeCapturedFrame(CaptureSlot& slot) {
+  CaptureTrace::markDequeued(slot.trace);
+  refinePosition(slot);
+
+  // Optional EXIF thumbnail: linked in the slot's header, inserted after it on SD
+  const uint8_t* thumbnail = nullptr;
+  slot.thumbnailSize = 0;
+  if (slot.exifSize > 0 && ThumbnailManager::isEXIFEnabled()) {
+    uint32_t stageStart = micros();
+    size_t size = ThumbnailManager::makeEXIFThumbnail(slot.data, slot.length, &thumbnail);
+    if (size > 0 && StaticEXIFGPS::attachThumbnail(slot.data, slot.length, size)) {
+      slot.thumbnailSize = size;
+    }
+    CaptureTrace::record(slot.trace, TRACE_EXIF_THUMBNAIL, stageStart);
+  }
+
+  uint32_t writeStart = micros();
+  File file = StorageManager::openFile(slot.filename, "w");
+  CaptureTrace::record(slot.trace, TRACE_OPEN, writeStart);
+  if (!file) {
+    Serial.printf("Failed to create file: %s\n", slot.filename);
+    if (slot.thumbnailSize > 0) {
+      StaticEXIFGPS::attachThumbnail(slot.data, slot.length, 0);
+    }
     return false;
   }
 
-  // Create metadata filename by replacing .jpg with .json
-  String metadataFilename = photoFilename;
-  metadataFilename.replace(".jpg", ".json");
-
-  // Get current GPS position
-  GPSPosition gpsPos = GPSManager::getPosition();
-  GPSStatistics gpsStats = GPSManager::getStatistics();
-
-  // Create JSON document
-  DynamicJsonDocument doc(1024);
-
-  // Basic photo info
-  doc["photo_filename"] = photoFilename.substring(photoFilename.lastIndexOf('/') + 1);
-  doc["photo_number"] = photoCount;
-  doc["capture_time"] = millis();
-  doc["unix_timestamp"] = gpsPos.timestamp;
-
-  // GPS position data
-  JsonObject gps = doc.createNestedObject("gps");
-  gps["latitude"] = gpsPos.latitude;
-  gps["longitude"] = gpsPos.longitude;
-  gps["altitude_msl"] = gpsPos.altitude;
-  gps["horizontal_accuracy"] = gpsPos.accuracy;
-  gps["speed_ms"] = gpsPos.speed;
-  gps["course_degrees"] = gpsPos.course;
-
-  // GPS quality indicators
-  gps["fix_quality"] = gpsPos.fixQuality;
-  gps["fix_quality_text"] = GPSManager::getFixQualityString(gpsPos.fixQuality);
-  gps["satellites_used"] = gpsPos.satellites;
-  gps["hdop"] = gpsPos.hdop;
-  gps["vdop"] = gpsPos.vdop;
-  gps["age_of_diff"] = gpsPos.ageOfDiff;
-  gps["valid"] = gpsPos.valid;
-
-  // GPS statistics
-  JsonObject stats = doc.createNestedObject("gps_stats");
-  stats["messages_received"] = gpsStats.messagesReceived;
-  stats["messages_processed"] = gpsStats.messagesProcessed;
-  stats["parse_errors"] = gpsStats.parseErrors;
-  stats["checksum_errors"] = gpsStats.checksumErrors;
-  stats["message_rate_hz"] = gpsStats.messageRate;
-
-  // Camera settings
-  JsonObject camera = doc.createNestedObject("camera");
-  camera["frame_size"] = Config::camera.FRAME_SIZE;
-  camera["jpeg_quality"] = Config::camera.JPEG_QUALITY;
-  camera["pixel_format"] = "JPEG";
-
-  // Write JSON to file
-  File metaFile = StorageManager::openFile(metadataFilename, "w");
-  if (!metaFile) {
-    Serial.println("Failed to create metadata file: " + metadataFilename);
+  // Hashed as written: the digest is for the upload, without reading the file back
+  uint32_t stageStart = micros();
+  PhotoHash hash;
+  size_t expected = slot.length + slot.thumbnailSize;
+  size_t written;
+  if (slot.thumbnailSize > 0) {
+    // Header, thumbnail, rest of the JPEG; then the slot is a plain JPEG again
+    size_t split = StaticEXIFGPS::getThumbnailOffset();
+    written = StorageManager::writeHashed(file, slot.data, split, hash);
+    written += StorageManager::writeHashed(file, thumbnail, slot.thumbnailSize, hash);
+    written += StorageManager::writeHashed(file, slot.data + split, slot.length - split, hash);
+    StaticEXIFGPS::attachThumbnail(slot.data, slot.length, 0);
+  } else {
+    written = StorageManager::writeHashed(file, slot.data, slot.length, hash);
+  }
+  hash.finish(slot.sha256);
+  CaptureTrace::record(slot.trace, TRACE_WRITE, stageStart);
+  stageStart = micros();
+  StorageManager::closeFile(file);
+  CaptureTrace::record(slot.trace, TRACE_CLOSE, stageStart);
+
+  if (written != expected) {
+    Serial.printf("Short write for %s: %u/%u bytes\n",
+                  slot.filename, (unsigned)written, (unsigned)expected);
     return false;
   }
+  CameraModeManager::recordFrameWrite(written, micros() - writeStart);
+
+  // Preview from the slot copy, after the photo itself is safe on SD
+  if (ThumbnailManager::isEnabled()) {
+    stageStart = micros();
+    ThumbnailManager::writeThumbnail(slot.filename, slot.data, slot.length);
+    CaptureTrace::record(slot.trace, TRACE_THUMBNAIL, stageStart);
+  }
+
+  // Every Nth mission frame to the AprilTag scan task (copy only)
+  MissionTagScanner::offer(slot.data, slot.length, slot.exposureUs);
+
+  photoCount++;
+  SystemState::incrementPhotoCount();
 
-  serializeJsonPretty(doc, metaFile);
-  StorageManager::closeFile(metaFile);
+  stageStart = micros();
+  logPhoto(slot);
+  CaptureTrace::record(slot.trace, TRACE_METADATA, stageStart);
+  CaptureTrace::finish(slot.trace);
 
+  printPhotoSaved(slot);
   return true;
-}
\ No newline at end of file
+}
+
+bool CameraManager::initBurst() {
+  if (!Config::burst.enabled) {
+    return false;
+  }
+  if (burstArena) {
+    return true;
+  }
+
+  // Size the arena from what PSRAM has left, keeping a reserve for mode switches
+  size_t freePsram = PSRAMManager::getFreeSize();
+  if (freePsram <= Config::burst.PSRAM_RESERVE) {
+    Serial.printf("Burst disabled: only %u KB PSRAM free\n", (unsigned)(freePsram / 1024));
+    return false;
+  }
+  size_t size = min(freePsram - Config::burst.PSRAM_RESERVE, Config::burst.MAX_ARENA_SIZE);
+
+  burstArena = (uint8_t*)PSRAM_MALLOC(size);
+  if (!burstArena) {
+    Serial.printf("Burst disabled: failed to allocate %u KB arena\n", (unsigned)(size / 1024));
+    return false;
+  }
+  burstArenaSize = size;
+  burstStats.reset();
+
+  Serial.printf("Burst arena: %u KB in PSRAM (%u KB was free)\n",
+                (unsigned)(size / 1024), (unsigned)(freePsram / 1024));
+  return true;
+}
+
+uint8_t CameraManager::captureBurst(uint8_t frames) {
+  if (!initialized || !capturing || !burstArena) {
+    return 0;
+  }
+
+  // The arena still holds a burst waiting for the ring to drain
+  if (burstPending > 0 && flushBurst(burstPending) == 0 && burstPending > 0) {
+    Serial.println("Burst skipped: previous burst not written yet");
+    return 0;
+  }
+
+  if (frames == 0) {
+    frames = Config::burst.FRAMES;
+  }
+  if (frames > BURST_MAX_FRAMES) {
+    frames = BURST_MAX_FRAMES;
+  }
+
+  bool geotag = isGeotaggingEnabled();
+  size_t exifSize = geotag ? StaticEXIFGPS::getHeaderSize() : 0;
+  size_t used = 0;
+  uint8_t count = 0;
+
+  // Stage phase: no SD access, each camera buffer is returned right after the copy
+  unsigned long start = millis();
+  while (count < frames) {
+    camera_fb_t* fb = grabFrame();
+    if (!fb) {
+      break;
+    }
+
+    if (used + fb->len + exifSize > burstArenaSize) {
+      CameraHAL::fbReturn(fb);
+      burstStats.arenaFullEvents++;
+      break;
+    }
+
+    CaptureSlot& frame = burstFrames[count];
+    frame.data = burstArena + used;
+    frame.capacity = burstArenaSize - used;
+    stageFrame(fb, frame, geotag);
+    CameraHAL::fbReturn(fb);
+
+    used += frame.length;
+    captureSequence++;
+    count++;
+  }
+  unsigned long captureTime = millis() - start;
+
+  burstStats.burstCount++;
+  burstStats.totalFrames += count;
+  burstStats.lastBurstFrames = count;
+  burstStats.lastBurstBytes = used;
+  burstStats.lastBurstFps = captureTime > 0 ? count * 1000.0f / captureTime : 0.0f;
+
+  Serial.printf("Burst staged %u/%u frames (%u KB) at %.1f fps\n", count, frames,
+                (unsigned)(used / 1024), burstStats.lastBurstFps);
+
+  if (count > 0) {
+    flushBurst(count);
+  }
+  return count;
+}
+
+void CameraManager::serviceBurst() {
+  // The camera task is the ring's only producer, so idle stays idle while flushing
+  if (burstPending > 0 && CapturePipeline::isIdle()) {
+    flushBurst(burstPending);
+  }
+}
+
+uint8_t CameraManager::flushBurst(uint8_t count) {
+  // The writer task must be done with queued mission frames: writeCapturedFrame()
+  // is never run from two tasks at once. Otherwise keep the frames for later
+  if (CapturePipeline::isInitialized() && !CapturePipeline::waitUntilDrained(2000)) {
+    burstPending = count;
+    burstStats.deferredFlushes++;
+    Serial.printf("Burst flush deferred: %u frames kept in PSRAM\n", count);
+    return 0;
+  }
+  burstPending = 0;
+
+  unsigned long start = millis();
+  size_t bytes = 0;
+  uint8_t written = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (writeCapturedFrame(burstFrames[i])) {
+      bytes += burstFrames[i].length;
+      written++;
+    } else {
+      burstStats.flushFailures++;
+    }
+  }
+
+  burstStats.lastFlushTime = millis() - start;
+  burstStats.lastFlushThroughput = burstStats.lastFlushTime > 0 ?
+      (bytes / 1024.0f) * 1000.0f / burstStats.lastFlushTime : 0.0f;
+
+  Serial.printf("Burst flushed %u/%u frames in %u ms (%.1f KB/s)\n", written, count,
+                burstStats.lastFlushTime, burstStats.lastFlushThroughput);
+  return written;
+}
+
+void CameraManager::printBurstStatistics() {
+  Serial.println("\n--- Burst Capture ---");
+  Serial.printf("Arena: %u KB\n", (unsigned)(burstArenaSize / 1024));
+  Serial.printf("Bursts: %u, frames: %u, arena full: %u, flush failures: %u\n",
+                burstStats.burstCount, burstStats.totalFrames,
+                burstStats.arenaFullEvents, burstStats.flushFailures);
+  Serial.printf("Last burst: %u frames, %u KB, %.1f fps\n",
+                burstStats.lastBurstFrames, (unsigned)(burstStats.lastBurstBytes / 1024),
+                burstStats.lastBurstFps);
+  Serial.printf("Last flush: %u ms, %.1f KB/s, deferred flushes: %u, pending: %u\n",
+                burstStats.lastFlushTime, burstStats.lastFlushThroughput,
+                burstStats.deferredFlushes, burstPending);
+  Serial.println("---------------------\n");
+}
+
+void CameraManager::generateGeotaggedFilename(char* filename, size_t size, const GPSPosition& gps) {
+  if (!gps.valid) {
+    // Fallback to regular filename if GPS not available
+    generateFilename(filename, size);
+    return;
+  }
+  int prefix = snprintf(filename, size, "%s/", currentDirectory.c_str());
+  if (prefix > 0 && (size_t)prefix < size) {
+    formatGeotaggedName(filename + prefix, size - prefix, captureSequence, gps);
+  }
+}
+
+void CameraManager::formatGeotaggedName(char* name, size_t size, uint32_t sequence,
+                                        const GPSPosition& gps) {
+  // Format: photo_0001_N3752.1234_E14510.5678_RTK.jpg
+  // Converts decimal degrees to DDMM.MMMM format for filename
+  double lat = abs(gps.latitude);
+  double lon = abs(gps.longitude);
+  int latDeg = (int)lat;
+  int lonDeg = (int)lon;
+  double latMin = (lat - latDeg) * 60.0;
+  double lonMin = (lon - lonDeg) * 60.0;
+
+  char latHem = (gps.latitude >= 0) ? 'N' : 'S';
+  char lonHem = (gps.longitude >= 0) ? 'E' : 'W';
+
+  bool rtk = gps.fixQuality == GPS_FIX_RTK_FIXED || gps.fixQuality == GPS_FIX_RTK_FLOAT;
+  const char* fixType = rtk ? "RTK" : "GPS";
+
+  snprintf(name, size, "photo_%04u_%c%02d%06.3f_%c%03d%06.3f_%s.jpg",
+          sequence,
+          latHem, latDeg, latMin,
+          lonHem, lonDeg, lonMin,
+          fixType);
+}
+
+// Waits for `frames` more photos to be written by the mission capture
+static bool waitForPhotos(uint16_t frames, uint32_t timeoutMs) {
+  int target = CameraManager::getPhotoCount() + frames;
+  unsigned long start = millis();
+  while (CameraManager::getPhotoCount() < target) {
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(50));
+  }
+  return true;
+}
+
+bool CameraManager::runAllocationTest(uint16_t frames) {
+  Serial.println("\n=== Capture Allocation Test ===");
+  if (!AllocCounter::enabled) {
+    Serial.println("FAIL: Built without ALLOC_COUNTER (see alloc_counter.h)");
+    return false;
+  }
+  if (!capturing || !CameraModeManager::getCaptureTask()) {
+    Serial.println("FAIL: Mission capture not running");
+    return false;
+  }
+
+  uint32_t timeoutMs = frames * CameraModeManager::getCaptureInterval() * 4 + 5000;
+  int passed = 0;
+  int total = 0;
+
+  // Only the capture path's tasks; GPS, WiFi and upload tasks allocate freely
+  AllocCounter::unwatchAll();
+  AllocCounter::watchTask(CameraModeManager::getCaptureTask());
+  if (CapturePipeline::getWriterTask()) {
+    AllocCounter::watchTask(CapturePipeline::getWriterTask());
+  }
+
+  // EXIF thumbnails on (geotagged photos only), so their encoder is measured too
+  bool exifThumbnails = Config::thumbnail.EXIF;
+  Config::thumbnail.EXIF = true;
+
+  // Warm-up covers first-use allocations (stdio buffers, mission log flush)
+  bool warm = waitForPhotos(frames, timeoutMs);
+  CapturePipeline::waitUntilDrained(2000);
+  AllocCounter::reset();
+  uint32_t exifBefore = ThumbnailManager::getStatistics().exifEmbedded;
+  bool measured = warm && waitForPhotos(frames, timeoutMs);
+  CapturePipeline::waitUntilDrained(2000);
+  uint32_t count = AllocCounter::getCount();
+  uint32_t bytes = AllocCounter::getBytes();
+  uint32_t exempt = AllocCounter::getExemptCount();
+  uint32_t exifEmbedded = ThumbnailManager::getStatistics().exifEmbedded - exifBefore;
+  AllocCounter::unwatchAll();
+  Config::thumbnail.EXIF = exifThumbnails;
+
+  total++;
+  if (measured) {
+    passed++;
+    Serial.printf("PASS: %u photos captured after %u warm-up photos\n", frames, frames);
+  } else {
+    Serial.printf("FAIL: Fewer than %u photos in %u ms (blur/duplicate skips?)\n",
+                  frames, timeoutMs);
+  }
+
+  total++;
+  if (measured && count == 0) {
+    passed++;
+    Serial.println("PASS: No heap allocations on the capture path");
+  } else {
+    Serial.printf("FAIL: %u allocations (%u bytes) over %u photos\n", count, bytes, frames);
+  }
+  Serial.printf("SD driver (file open/close): %u allocations, %.1f per photo\n",
+                exempt, (float)exempt / frames);
+  Serial.printf("EXIF thumbnails: %u of %u photos (none without a GPS fix)\n",
+                exifEmbedded, frames);
+
+  Serial.printf("Results: %d/%d tests passed\n", passed, total);
+  Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+  return passed == total;
+}
+
+void CameraManager::printPhotoSaved(const CaptureSlot& slot) {
+  // Formatted on the stack: Serial.printf mallocs for lines over 64 bytes
+  char line[96];
+  int n;
+  if (slot.geotagged) {
+    n = snprintf(line, sizeof(line), "Geotagged photo %04u saved: %u bytes (GPS: %.6f, %.6f)\n",
+                 slot.sequence, (unsigned)(slot.length + slot.thumbnailSize), slot.gps.latitude,
+                 slot.gps.longitude);
+  } else {
+    n = snprintf(line, sizeof(line), "Photo %04u saved: %u bytes\n",
+                 slot.sequence, (unsigned)(slot.length + slot.thumbnailSize));
+  }
+  Serial.write((const uint8_t*)line, min(n, (int)sizeof(line) - 1));
+}
+
+void CameraManager::snapshotSensor(CaptureSlot& slot) {
+  // Actual settings at capture; the rate controller and mode switches change them
+  sensor_t* s = CameraHAL::sensorGet();
+  slot.frameSize = s ? s->status.framesize : Config::camera.FRAME_SIZE;
+  slot.jpegQuality = s ? s->status.quality : Config::camera.JPEG_QUALITY;
+}
+
+bool CameraManager::logPhoto(const CaptureSlot& slot) {
+  MissionLogRecord record;
+  memset(&record, 0, sizeof(record));
+
+  record.photoNumber = slot.sequence;
+  record.captureTimeMs = slot.captureTime;
+  record.fileSize = slot.length + slot.thumbnailSize;
+  record.exifOffset = slot.exifSize > 0 ? 2 : 0; // APP1 follows SOI
+  record.exifSize = slot.exifSize + slot.thumbnailSize;
+  record.sharpness = slot.sharpness;
+  record.frameSize = slot.frameSize;
+  record.jpegQuality = slot.jpegQuality;
+  memcpy(record.sha256, slot.sha256, sizeof(record.sha256));
+  if (slot.blurred) {
+    record.flags |= MISSION_LOG_BLURRED;
+  }
+
+  const char* name = strrchr(slot.filename, '/');
+  strncpy(record.filename, name ? name + 1 : slot.filename, sizeof(record.filename));
+
+  if (slot.geotagged) {
+    const GPSPosition& gps = slot.gps;
+    record.flags |= MISSION_LOG_GEOTAGGED | (gps.valid ? MISSION_LOG_GPS_VALID : 0);
+    record.unixTime = gps.timestamp;
+    record.latitude = gps.latitude;
+    record.longitude = gps.longitude;
+    record.altitude = gps.altitude;
+    record.accuracy = gps.accuracy;
+    record.speed = gps.speed;
+    record.course = gps.course;
+    record.hdop = gps.hdop;
+    record.vdop = gps.vdop;
+    record.ageOfDiff = gps.ageOfDiff;
+    record.fixQuality = gps.fixQuality;
+    record.satellites = gps.satellites;
+    record.baseStationId = gps.baseStationId;
+    record.fixOffsetUs = slot.fixOffsetUs;
+    record.exposureUtcUs = slot.exposureUnixUs;
+    if (slot.positionSource == GPS_POSITION_INTERPOLATED) {
+      record.flags |= MISSION_LOG_INTERPOLATED;
+    } else if (slot.positionSource == GPS_POSITION_EXTRAPOLATED) {
+      record.flags |= MISSION_LOG_EXTRAPOLATED;
+    }
+
+    GPSStatistics gpsStats = GPSManager::getStatistics();
+    record.gpsParseErrors = min(gpsStats.parseErrors, (uint32_t)UINT16_MAX);
+    record.gpsChecksumErrors = min(gpsStats.checksumErrors, (uint32_t)UINT16_MAX);
+    record.gpsMessageRate = gpsStats.messageRate;
+  }
+
+  MissionManifest::append(slot);
+  // Dedup decisions handed over by the camera task go out with the photo metadata
+  DuplicateFilter::writePendingLog();
+  return MissionLog::append(record);
+}
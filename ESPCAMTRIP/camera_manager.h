@@ -3,11 +3,46 @@
 
 #include <Arduino.h>
 #include "esp_camera.h"
+#include "gps_manager.h"
+#include "sensor_profile_manager.h"
+#include "sharpness_gate.h"
+
+struct CaptureSlot;
+
+// Largest burst that can be staged (frame descriptors are static)
+#define BURST_MAX_FRAMES 32
+
+struct BurstStatistics {
+  uint32_t burstCount;
+  uint32_t totalFrames;         // Frames staged across all bursts
+  uint8_t lastBurstFrames;      // Frames staged in the last burst
+  float lastBurstFps;           // Achieved capture rate of the last burst
+  size_t lastBurstBytes;
+  uint32_t lastFlushTime;       // ms
+  float lastFlushThroughput;    // KB/s to SD
+  uint32_t arenaFullEvents;     // Bursts cut short by arena space
+  uint32_t flushFailures;       // Staged frames that failed to write
+  uint32_t deferredFlushes;     // Flushes put off until the capture ring drained
+
+  void reset() {
+    burstCount = 0;
+    totalFrames = 0;
+    lastBurstFrames = 0;
+    lastBurstFps = 0.0f;
+    lastBurstBytes = 0;
+    lastFlushTime = 0;
+    lastFlushThroughput = 0.0f;
+    arenaFullEvents = 0;
+    flushFailures = 0;
+    deferredFlushes = 0;
+  }
+};
 
 class CameraManager {
 public:
   // Initialization and control
   static bool init();
+  static bool reinit(const camera_config_t& config, SensorProfileId profile); // Mode switch with a new driver config
   static void deinit();
   static bool isInitialized();
   
@@ -26,6 +61,9 @@ public:
   static bool setBrightness(int brightness);
   static bool setContrast(int contrast);
   static bool setSaturation(int saturation);
+
+  // Apply a sensor profile (only changed settings are written), timed in us
+  static bool applyProfile(SensorProfileId profile);
   
   // Status
   static int getPhotoCount();
@@ -37,20 +75,60 @@ public:
   static bool isGeotaggingEnabled();
   static bool captureGeotaggedPhoto();
 
+  // Next frame for the current mode (skips stale frames after a mode switch)
+  static camera_fb_t* grabFrame();
+
+  // Capture pipeline writer (called from SD writer task)
+  static bool writeCapturedFrame(CaptureSlot& slot);
+
+  // Burst capture: frames are staged in a PSRAM arena, then flushed in one pass
+  static bool initBurst();
+  static uint8_t captureBurst(uint8_t frames = 0); // 0 = Config::burst.FRAMES
+  static void serviceBurst();    // Camera task: flush a deferred burst once the ring is idle
+  static bool isBurstReady() { return burstArena != nullptr; }
+  static BurstStatistics getBurstStatistics() { return burstStats; }
+  static void printBurstStatistics();
+
+  /**
+   * Steady-state allocation check of the mission capture path
+   * Needs a build with ALLOC_COUNTER (see alloc_counter.h) and a running
+   * capture; counts heap allocations by the camera and SD writer tasks
+   * over `frames` photos after `frames` warm-up photos. EXIF thumbnails
+   * are turned on for the test so their encoder is covered
+   */
+  static bool runAllocationTest(uint16_t frames = 20);
+
 private:
   static bool initialized;
   static bool capturing;
   static int photoCount;
+  static uint32_t captureSequence;
   static String currentDirectory;
   static bool geotaggingEnabled;
 
+  // Burst staging arena (allocated once by initBurst)
+  static uint8_t* burstArena;
+  static size_t burstArenaSize;
+  static BurstStatistics burstStats;
+  static uint8_t burstPending;   // Staged frames not yet written (flush deferred)
+
   // Camera configuration
   static camera_config_t getCameraConfig();
-  static void applyCameraSettings();
+  static bool initDriver(const camera_config_t& config, SensorProfileId profile);
   static bool createCaptureDirectory();
-  static String generateFilename();
-  static String generateGeotaggedFilename();
-  static bool saveGPSMetadata(const String& photoFilename);
+  static void generateFilename(char* filename, size_t size);
+  static void generateGeotaggedFilename(char* filename, size_t size, const GPSPosition& gps);
+  static void formatGeotaggedName(char* name, size_t size, uint32_t sequence, const GPSPosition& gps);
+  static bool queueFrame(camera_fb_t* fb, bool geotag, const SharpnessResult* sharpness = nullptr,
+                         uint32_t trace = 0);
+  static void stageFrame(camera_fb_t* fb, CaptureSlot& slot, bool geotag);
+  static int64_t frameTimestamp(const camera_fb_t* fb);
+  static void resolvePosition(CaptureSlot& slot);
+  static void refinePosition(CaptureSlot& slot);
+  static uint8_t flushBurst(uint8_t count);
+  static void snapshotSensor(CaptureSlot& slot);
+  static bool logPhoto(const CaptureSlot& slot);
+  static void printPhotoSaved(const CaptureSlot& slot);
   
   // Pin validation
   // static bool isCameraPin(int pin); // Removed from private
@@ -3,6 +3,9 @@
 #include "config.h"
 #include "system_state.h"
 #include "apriltag_manager.h"
+#include "gps_manager.h"
+#include "camera_hal.h"
+#include "mission_log.h"
 #include <esp_camera.h>
 
 // Static member definitions
@@ -12,6 +15,22 @@ bool CameraModeManager::modeChangeInProgress = false;
 unsigned long CameraModeManager::lastModeChange = 0;
 unsigned long CameraModeManager::lastCaptureTime = 0;
 bool CameraModeManager::autoSwitchEnabled = true;
+bool CameraModeManager::driverReady = false;
+pixformat_t CameraModeManager::driverPixelFormat = PIXFORMAT_JPEG;
+framesize_t CameraModeManager::driverFrameSize = FRAMESIZE_VGA;
+unsigned long CameraModeManager::switchStartTime = 0;
+bool CameraModeManager::awaitingFirstFrame = false;
+bool CameraModeManager::lastSwitchFast = false;
+int64_t CameraModeManager::nextDeadline = 0;
+int64_t CameraModeManager::lastSlotStart = 0;
+bool CameraModeManager::slotSkipped = false;
+esp_timer_handle_t CameraModeManager::captureTimer = NULL;
+TaskHandle_t CameraModeManager::captureTask = NULL;
+DistanceTrigger CameraModeManager::missionTrigger;
+QualityController CameraModeManager::qualityController;
+
+// Histogram bucket upper bounds (ms); values above the last go in the final bucket
+static const uint32_t SCHED_HIST_LIMITS_MS[SCHED_HIST_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100 };
 
 CameraModeManager::ModeStats CameraModeManager::missionStats;
 CameraModeManager::ModeStats CameraModeManager::landingStats;
@@ -43,6 +62,8 @@ bool CameraModeManager::init() {
         }
     }
 
+    configureQualityControl(qualityController);
+
     Serial.printf("Camera Mode Manager initialized, starting in %s mode\n",
                   getModeString(currentMode));
     return true;
@@ -93,6 +114,7 @@ bool CameraModeManager::setMode(CameraMode mode) {
 
     modeChangeInProgress = true;
     CameraMode oldMode = currentMode;
+    switchStartTime = millis();
 
     // Get camera configuration for new mode
     camera_config_t config;
@@ -122,8 +144,13 @@ bool CameraModeManager::setMode(CameraMode mode) {
             return false;
     }
 
-    // Reconfigure camera
-    if (!reconfigureCamera(config)) {
+    // Reconfigure camera: in place if the driver allows it, otherwise re-init
+    bool fast = canFastSwitch(mode);
+    if (fast && !fastSwitchCamera(mode)) {
+        Serial.println("In-place switch failed, re-initializing camera");
+        fast = false;
+    }
+    if (!fast && !reconfigureCamera(mode, config)) {
         Serial.println("Failed to reconfigure camera");
         modeChangeInProgress = false;
         return false;
@@ -133,8 +160,31 @@ bool CameraModeManager::setMode(CameraMode mode) {
     currentMode = mode;
     lastModeChange = millis();
     lastCaptureTime = 0; // Reset capture timing
+    resetSchedule();
     modeChangeInProgress = false;
 
+    // Mission mode is armed on the ground: take the AGL reference now, not
+    // from whichever fix arrives first (possibly in the air). Without a fix
+    // yet, the first one after arming is used.
+    if (mode == Config::CAMERA_MODE_MISSION) {
+        missionTrigger.clearHomeAltitude();
+        GPSPosition home = GPSManager::getPosition();
+        if (home.valid) {
+            missionTrigger.setHomeAltitude(home.altitude);
+        }
+    }
+
+    // First usable frame is timed in acceptFrame()
+    awaitingFirstFrame = true;
+    lastSwitchFast = fast;
+    ModeStats* stats = getCurrentStats();
+    if (stats) {
+        stats->switchCount++;
+        if (fast) {
+            stats->fastSwitchCount++;
+        }
+    }
+
     // Update configuration
     Config::cameraMode.current_mode = mode;
 
@@ -157,15 +207,145 @@ bool CameraModeManager::requestModeChange(CameraMode mode) {
     return true;
 }
 
+bool CameraModeManager::initScheduler(TaskHandle_t task) {
+    captureTask = task;
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = captureTimerCallback,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "capture_deadline",
+        .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create(&timerArgs, &captureTimer) != ESP_OK) {
+        Serial.println("Failed to create capture deadline timer - using timed waits");
+        captureTimer = NULL;
+        return false;
+    }
+
+    resetSchedule();
+    return true;
+}
+
+void CameraModeManager::captureTimerCallback(void* arg) {
+    if (captureTask) {
+        xTaskNotify(captureTask, CAMERA_NOTIFY_CAPTURE_DUE, eSetBits);
+    }
+}
+
+void CameraModeManager::armCaptureTimer() {
+    if (!captureTimer) {
+        return;
+    }
+
+    int64_t delay = nextDeadline - esp_timer_get_time();
+    esp_timer_stop(captureTimer);
+    esp_timer_start_once(captureTimer, delay > 0 ? delay : 0);
+}
+
+void CameraModeManager::resetSchedule() {
+    nextDeadline = 0;
+    lastSlotStart = 0;
+    if (captureTimer) {
+        esp_timer_stop(captureTimer);
+    }
+
+    // New capture run: fresh ENU origin and first photo immediately
+    configureTrigger();
+    missionTrigger.reset();
+}
+
+bool CameraModeManager::getTakeoffAltitude(float& altitude) {
+    if (!missionTrigger.hasHomeAltitude()) {
+        return false;
+    }
+    altitude = missionTrigger.getHomeAltitude();
+    return true;
+}
+
+bool CameraModeManager::isDistanceTriggerActive() {
+    return currentMode == Config::CAMERA_MODE_MISSION &&
+           Config::cameraMode.MISSION_TRIGGER != Config::TRIGGER_TIME;
+}
+
+void CameraModeManager::configureTrigger() {
+    if (Config::cameraMode.MISSION_TRIGGER == Config::TRIGGER_OVERLAP) {
+        missionTrigger.setOverlap(Config::cameraMode.TARGET_FORWARD_OVERLAP,
+                                  Config::cameraMode.LENS_ALONG_TRACK_FOV_DEG,
+                                  Config::cameraMode.MIN_TRIGGER_DISTANCE_M,
+                                  Config::cameraMode.MIN_TRIGGER_AGL_M);
+    } else {
+        missionTrigger.setDistance(Config::cameraMode.TRIGGER_DISTANCE_M);
+    }
+}
+
+bool CameraModeManager::distanceTriggerDue() {
+    GPSPosition pos = GPSManager::getPosition();
+    if (!pos.valid) {
+        return true; // No fix: fall back to time-based capture
+    }
+
+    TriggerFix fix = { pos.latitude, pos.longitude, pos.altitude,
+                       pos.speed, pos.course, pos.lastUpdate, pos.valid };
+    if (missionTrigger.shouldTrigger(fix, millis())) {
+        return true;
+    }
+
+    // Periodic photo even when hovering, if configured
+    uint32_t maxInterval = Config::cameraMode.TRIGGER_MAX_INTERVAL_MS;
+    return maxInterval > 0 && lastCaptureTime > 0 && (millis() - lastCaptureTime) >= maxInterval;
+}
+
+TickType_t CameraModeManager::getScheduleWaitTicks() {
+    if (nextDeadline == 0) {
+        return 0;
+    }
+
+    int64_t remaining = nextDeadline - esp_timer_get_time();
+    if (remaining <= 0) {
+        return 0;
+    }
+
+    // Timer notification normally wakes the task first; this is the fallback
+    uint32_t remainingMs = (uint32_t)((remaining + 999) / 1000);
+    if (remainingMs > 100) {
+        remainingMs = 100;
+    }
+    return pdMS_TO_TICKS(remainingMs) + 1;
+}
+
 bool CameraModeManager::shouldCapture() {
     if (currentMode == Config::CAMERA_MODE_IDLE) {
         return false;
     }
 
-    unsigned long now = millis();
-    uint32_t interval = getCaptureInterval();
+    int64_t now = esp_timer_get_time();
+    if (nextDeadline == 0) {
+        nextDeadline = now; // First slot of a new schedule is due immediately
+    }
 
-    return (now - lastCaptureTime) >= interval;
+    if (now < nextDeadline) {
+        return false;
+    }
+
+    // Slot is due, but with a distance trigger only capture once far enough
+    if (isDistanceTriggerActive() && !distanceTriggerDue()) {
+        int64_t intervalUs = (int64_t)getCaptureInterval() * 1000;
+        nextDeadline += intervalUs;
+        if (nextDeadline <= now) {
+            nextDeadline = now + intervalUs;
+        }
+        armCaptureTimer();
+
+        ModeStats* stats = getCurrentStats();
+        if (stats) {
+            stats->triggerSkips++;
+        }
+        return false;
+    }
+
+    return true;
 }
 
 uint32_t CameraModeManager::getCaptureInterval() {
@@ -180,7 +360,19 @@ uint32_t CameraModeManager::getCaptureInterval() {
 }
 
 framesize_t CameraModeManager::getFrameSize() {
-    switch (currentMode) {
+    return getFrameSize(currentMode);
+}
+
+pixformat_t CameraModeManager::getPixelFormat() {
+    return getPixelFormat(currentMode);
+}
+
+uint8_t CameraModeManager::getJPEGQuality() {
+    return getJPEGQuality(currentMode);
+}
+
+framesize_t CameraModeManager::getFrameSize(CameraMode mode) {
+    switch (mode) {
         case Config::CAMERA_MODE_MISSION:
             return Config::cameraMode.MISSION_FRAME_SIZE;
         case Config::CAMERA_MODE_LANDING:
@@ -190,8 +382,8 @@ framesize_t CameraModeManager::getFrameSize() {
     }
 }
 
-pixformat_t CameraModeManager::getPixelFormat() {
-    switch (currentMode) {
+pixformat_t CameraModeManager::getPixelFormat(CameraMode mode) {
+    switch (mode) {
         case Config::CAMERA_MODE_MISSION:
             return Config::cameraMode.MISSION_PIXEL_FORMAT;
         case Config::CAMERA_MODE_LANDING:
@@ -201,10 +393,12 @@ pixformat_t CameraModeManager::getPixelFormat() {
     }
 }
 
-uint8_t CameraModeManager::getJPEGQuality() {
-    switch (currentMode) {
+uint8_t CameraModeManager::getJPEGQuality(CameraMode mode) {
+    switch (mode) {
         case Config::CAMERA_MODE_MISSION:
-            return Config::cameraMode.MISSION_JPEG_QUALITY;
+            // Keep the controlled quality across mode switches
+            return Config::cameraMode.QUALITY_CONTROL_ENABLED ?
+                   qualityController.getQuality() : Config::cameraMode.MISSION_JPEG_QUALITY;
         case Config::CAMERA_MODE_LANDING:
             return Config::cameraMode.LANDING_JPEG_QUALITY;
         default:
@@ -212,8 +406,8 @@ uint8_t CameraModeManager::getJPEGQuality() {
     }
 }
 
-camera_config_t CameraModeManager::getMissionCameraConfig() {
-    camera_config_t config;
+camera_config_t CameraModeManager::getBaseCameraConfig() {
+    camera_config_t config = {};
 
     config.ledc_channel = LEDC_CHANNEL_0;
     config.ledc_timer = LEDC_TIMER_0;
@@ -234,91 +428,217 @@ camera_config_t CameraModeManager::getMissionCameraConfig() {
     config.pin_pwdn = Config::cameraPins.PWDN_GPIO_NUM;
     config.pin_reset = Config::cameraPins.RESET_GPIO_NUM;
     config.xclk_freq_hz = Config::camera.XCLK_FREQ;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.grab_mode = CAMERA_GRAB_LATEST;
+
+    return config;
+}
+
+camera_config_t CameraModeManager::getMissionCameraConfig() {
+    camera_config_t config = getBaseCameraConfig();
+
     config.pixel_format = Config::cameraMode.MISSION_PIXEL_FORMAT;
     config.frame_size = Config::cameraMode.MISSION_FRAME_SIZE;
-    config.jpeg_quality = Config::cameraMode.MISSION_JPEG_QUALITY;
+    config.jpeg_quality = getJPEGQuality(Config::CAMERA_MODE_MISSION);
     config.fb_count = 1; // Single buffer for mission mode
+    sizeBuffersForFastSwitch(config);
 
     return config;
 }
 
 camera_config_t CameraModeManager::getLandingCameraConfig() {
-    camera_config_t config;
+    camera_config_t config = getBaseCameraConfig();
 
-    config.ledc_channel = LEDC_CHANNEL_0;
-    config.ledc_timer = LEDC_TIMER_0;
-    config.pin_d0 = Config::cameraPins.Y2_GPIO_NUM;
-    config.pin_d1 = Config::cameraPins.Y3_GPIO_NUM;
-    config.pin_d2 = Config::cameraPins.Y4_GPIO_NUM;
-    config.pin_d3 = Config::cameraPins.Y5_GPIO_NUM;
-    config.pin_d4 = Config::cameraPins.Y6_GPIO_NUM;
-    config.pin_d5 = Config::cameraPins.Y7_GPIO_NUM;
-    config.pin_d6 = Config::cameraPins.Y8_GPIO_NUM;
-    config.pin_d7 = Config::cameraPins.Y9_GPIO_NUM;
-    config.pin_xclk = Config::cameraPins.XCLK_GPIO_NUM;
-    config.pin_pclk = Config::cameraPins.PCLK_GPIO_NUM;
-    config.pin_vsync = Config::cameraPins.VSYNC_GPIO_NUM;
-    config.pin_href = Config::cameraPins.HREF_GPIO_NUM;
-    config.pin_sccb_sda = Config::cameraPins.SIOD_GPIO_NUM;
-    config.pin_sccb_scl = Config::cameraPins.SIOC_GPIO_NUM;
-    config.pin_pwdn = Config::cameraPins.PWDN_GPIO_NUM;
-    config.pin_reset = Config::cameraPins.RESET_GPIO_NUM;
-    config.xclk_freq_hz = Config::camera.XCLK_FREQ;
     config.pixel_format = Config::cameraMode.LANDING_PIXEL_FORMAT;
     config.frame_size = Config::cameraMode.LANDING_FRAME_SIZE;
     config.jpeg_quality = Config::cameraMode.LANDING_JPEG_QUALITY;
     config.fb_count = 2; // Dual buffer for landing mode (higher rate)
+    sizeBuffersForFastSwitch(config);
 
     return config;
 }
 
-bool CameraModeManager::reconfigureCamera(const camera_config_t& config) {
-    // Deinitialize current camera if needed
-    if (CameraManager::isInitialized()) {
-        CameraManager::deinit();
-        delay(100); // Allow time for cleanup
+void CameraModeManager::sizeBuffersForFastSwitch(camera_config_t& config) {
+    // Buffers can only be shared when both modes use the same pixel format;
+    // otherwise every switch reinitializes and extra buffers only cost PSRAM
+    if (!Config::cameraMode.FAST_SWITCH_ENABLED ||
+        Config::cameraMode.MISSION_PIXEL_FORMAT != Config::cameraMode.LANDING_PIXEL_FORMAT) {
+        return;
     }
 
-    // Initialize with new configuration
-    esp_err_t err = esp_camera_init(&config);
-    if (err != ESP_OK) {
-        Serial.printf("Camera reconfiguration failed with error 0x%x\n", err);
+    if (config.fb_count < Config::cameraMode.FAST_SWITCH_FB_COUNT) {
+        config.fb_count = Config::cameraMode.FAST_SWITCH_FB_COUNT;
+    }
+
+    // Allocate for the larger mode; the sensor is then set to the actual size
+    framesize_t mission = Config::cameraMode.MISSION_FRAME_SIZE;
+    framesize_t landing = Config::cameraMode.LANDING_FRAME_SIZE;
+    uint32_t missionPixels = (uint32_t)resolution[mission].width * resolution[mission].height;
+    uint32_t landingPixels = (uint32_t)resolution[landing].width * resolution[landing].height;
+    config.frame_size = (missionPixels >= landingPixels) ? mission : landing;
+}
+
+bool CameraModeManager::canFastSwitch(CameraMode mode) {
+    if (!Config::cameraMode.FAST_SWITCH_ENABLED || !driverReady ||
+        !CameraManager::isInitialized()) {
         return false;
     }
 
-    // Apply mode-specific settings
-    sensor_t * s = esp_camera_sensor_get();
-    if (s) {
-        if (currentMode == Config::CAMERA_MODE_LANDING) {
-            // Landing mode optimizations
-            s->set_brightness(s, 0);
-            s->set_contrast(s, 0);
-            s->set_saturation(s, 0); // Not relevant for grayscale
-            s->set_exposure_ctrl(s, 1);
-            s->set_gain_ctrl(s, 1);
-            s->set_agc_gain(s, 0);
-        } else {
-            // Mission mode optimizations
-            s->set_brightness(s, 0);
-            s->set_contrast(s, 0);
-            s->set_saturation(s, 0);
-            s->set_whitebal(s, 1);
-            s->set_awb_gain(s, 1);
-            s->set_exposure_ctrl(s, 1);
-            s->set_gain_ctrl(s, 1);
+    // cam_hal fixes JPEG vs raw framing at init, so the format must match
+    if (getPixelFormat(mode) != driverPixelFormat) {
+        return false;
+    }
+
+    // Frame buffers must be large enough for the target frame size
+    framesize_t target = getFrameSize(mode);
+    return (uint32_t)resolution[target].width * resolution[target].height <=
+           (uint32_t)resolution[driverFrameSize].width * resolution[driverFrameSize].height;
+}
+
+bool CameraModeManager::fastSwitchCamera(CameraMode mode) {
+    sensor_t * s = CameraHAL::sensorGet();
+    if (!s) {
+        return false;
+    }
+
+    if (s->set_framesize(s, getFrameSize(mode)) != 0) {
+        return false;
+    }
+    if (getPixelFormat(mode) == PIXFORMAT_JPEG) {
+        s->set_quality(s, getJPEGQuality(mode));
+    }
+
+    CameraManager::applyProfile(getSensorProfile(mode));
+    return true;
+}
+
+bool CameraModeManager::reconfigureCamera(CameraMode mode, const camera_config_t& config) {
+    // Re-initialize driver (no settle delay needed between deinit and init)
+    if (!CameraManager::reinit(config, getSensorProfile(mode))) {
+        Serial.println("Camera reconfiguration failed");
+        return false;
+    }
+
+    // Buffers may be sized for the larger mode - set the sensor to this mode
+    sensor_t * s = CameraHAL::sensorGet();
+    if (s && config.frame_size != getFrameSize(mode)) {
+        s->set_framesize(s, getFrameSize(mode));
+    }
+
+    return true;
+}
+
+SensorProfileId CameraModeManager::getSensorProfile(CameraMode mode) {
+    if (mode == Config::CAMERA_MODE_LANDING) {
+        return SENSOR_PROFILE_LANDING;
+    }
+    return Config::camera.LOW_LIGHT_PROFILE ? SENSOR_PROFILE_LOW_LIGHT : SENSOR_PROFILE_MISSION;
+}
+
+void CameraModeManager::onCameraInitialized() {
+    // Record what the driver allocated for before any in-place changes
+    sensor_t * s = CameraHAL::sensorGet();
+    if (!s) {
+        driverReady = false;
+        return;
+    }
+
+    driverPixelFormat = s->pixformat;
+    driverFrameSize = s->status.framesize;
+    driverReady = true;
+}
+
+void CameraModeManager::onCameraDeinitialized() {
+    driverReady = false;
+}
+
+bool CameraModeManager::acceptFrame(const camera_fb_t* fb) {
+    if (!fb) {
+        return false;
+    }
+    if (!awaitingFirstFrame) {
+        return true;
+    }
+
+    ModeStats* stats = getCurrentStats();
+
+    // Frames captured before an in-place switch still have the old geometry
+    framesize_t size = getFrameSize();
+    if (fb->format != getPixelFormat() ||
+        fb->width != resolution[size].width || fb->height != resolution[size].height) {
+        if (stats) {
+            stats->staleFrames++;
         }
+        return false;
     }
 
+    awaitingFirstFrame = false;
+    unsigned long latency = millis() - switchStartTime;
+    if (stats) {
+        stats->lastSwitchLatency = latency;
+        if (latency > stats->maxSwitchLatency) {
+            stats->maxSwitchLatency = latency;
+        }
+    }
+
+    Serial.printf("First %s frame %lu ms after mode switch (%s)\n",
+                  getModeString(currentMode), latency, lastSwitchFast ? "in-place" : "re-init");
     return true;
 }
 
 void CameraModeManager::recordCaptureStart() {
     lastCaptureTime = millis();
+    slotSkipped = false;
+
+    int64_t now = esp_timer_get_time();
+    int64_t intervalUs = (int64_t)getCaptureInterval() * 1000;
+    if (nextDeadline == 0) {
+        nextDeadline = now;
+    }
+
+    // Deadlines that passed while the previous capture was running are skipped
+    int64_t lateness = now - nextDeadline;
+    if (lateness < 0) {
+        lateness = 0;
+    }
+    uint32_t missed = (uint32_t)(lateness / intervalUs);
+
+    ModeStats* stats = getCurrentStats();
+    if (stats) {
+        // Actual lateness, so a missed interval shows in the top buckets
+        stats->slotsMissed += missed;
+        stats->latenessHist[histogramBucket((uint32_t)min(lateness, (int64_t)UINT32_MAX))]++;
+        if (lateness > stats->maxLateness) {
+            stats->maxLateness = (uint32_t)min(lateness, (int64_t)UINT32_MAX);
+        }
+
+        // Start-to-start jitter only between consecutive slots
+        if (lastSlotStart != 0 && missed == 0) {
+            int64_t jitter = (now - lastSlotStart) - intervalUs;
+            if (jitter < 0) {
+                jitter = -jitter;
+            }
+            stats->jitterHist[histogramBucket((uint32_t)jitter)]++;
+            if (jitter > stats->maxJitter) {
+                stats->maxJitter = (uint32_t)jitter;
+            }
+        }
+    }
+
+    lastSlotStart = now;
+    nextDeadline += intervalUs * (missed + 1);
+    armCaptureTimer();
 }
 
 void CameraModeManager::recordCaptureComplete(bool success) {
     unsigned long captureTime = millis() - lastCaptureTime;
 
+    // Distance counts from the last frame actually queued or written: a
+    // failed grab or a dropped frame triggers again at the next slot
+    if (success && isDistanceTriggerActive()) {
+        missionTrigger.recordCapture();
+    }
+
     ModeStats* stats = getCurrentStats();
     if (stats) {
         if (success) {
@@ -328,12 +648,108 @@ void CameraModeManager::recordCaptureComplete(bool success) {
             if (captureTime > stats->maxCaptureTime) {
                 stats->maxCaptureTime = captureTime;
             }
-        } else {
+        } else if (!slotSkipped) {
             stats->frameDrops++;
         }
     }
 }
 
+void CameraModeManager::recordFrameSkipped() {
+    slotSkipped = true;
+    ModeStats* stats = getCurrentStats();
+    if (stats) {
+        stats->framesSkipped++;
+    }
+}
+
+void CameraModeManager::recordRingOccupancy(uint8_t occupancy) {
+    ModeStats* stats = getCurrentStats();
+    if (stats) {
+        stats->ringOccupancy = occupancy;
+        if (occupancy > stats->ringHighWater) {
+            stats->ringHighWater = occupancy;
+        }
+    }
+}
+
+void CameraModeManager::recordBackPressure(bool dropped) {
+    ModeStats* stats = getCurrentStats();
+    if (stats) {
+        stats->backPressureEvents++;
+        if (dropped) {
+            stats->ringDrops++;
+        }
+    }
+}
+
+void CameraModeManager::configureQualityControl(QualityController& controller) {
+    const Config::CameraModeConfig& cfg = Config::cameraMode;
+    uint32_t interval = cfg.MISSION_CAPTURE_INTERVAL;
+    uint32_t targetBytes = cfg.TARGET_BYTES_PER_FRAME;
+    if (cfg.TARGET_BYTES_PER_SECOND > 0) {
+        targetBytes = (uint32_t)((uint64_t)cfg.TARGET_BYTES_PER_SECOND * interval / 1000);
+    }
+
+    controller.configure(cfg.MISSION_JPEG_QUALITY, cfg.QUALITY_MIN, cfg.QUALITY_MAX,
+                         targetBytes, cfg.QUALITY_HYSTERESIS,
+                         (uint32_t)(interval * cfg.WRITE_BUDGET_FRACTION));
+    controller.reset();
+}
+
+bool CameraModeManager::runQualityReplay(const String& directory) {
+    std::vector<MissionLogFrame> logged;
+    if (!MissionLog::readFrames(directory, logged)) {
+        Serial.printf("FAIL: No readable %s/%s\n", directory.c_str(), MISSION_LOG_FILE);
+        return false;
+    }
+
+    std::vector<QualityReplayFrame> frames;
+    frames.reserve(logged.size());
+    for (const MissionLogFrame& f : logged) {
+        frames.push_back({ f.jpegBytes, f.jpegQuality });
+    }
+
+    // Fresh controller with the mission settings, starting from the initial quality
+    QualityController controller;
+    configureQualityControl(controller);
+    return QualityController::runReplay(controller, frames.data(), frames.size());
+}
+
+void CameraModeManager::recordFrameSize(size_t bytes) {
+    if (!Config::cameraMode.QUALITY_CONTROL_ENABLED || currentMode != Config::CAMERA_MODE_MISSION) {
+        return;
+    }
+
+    if (qualityController.update(bytes)) {
+        CameraManager::setQuality(qualityController.getQuality());
+    }
+}
+
+void CameraModeManager::recordFrameWrite(size_t bytes, uint32_t writeUs) {
+    if (Config::cameraMode.QUALITY_CONTROL_ENABLED) {
+        qualityController.recordWrite(bytes, writeUs);
+    }
+}
+
+uint8_t CameraModeManager::histogramBucket(uint32_t us) {
+    uint32_t ms = us / 1000;
+    for (uint8_t i = 0; i < SCHED_HIST_BUCKETS - 1; i++) {
+        if (ms < SCHED_HIST_LIMITS_MS[i]) {
+            return i;
+        }
+    }
+    return SCHED_HIST_BUCKETS - 1;
+}
+
+void CameraModeManager::printHistogram(const char* label, const uint32_t* hist) {
+    Serial.printf("  %s ms:", label);
+    for (uint8_t i = 0; i < SCHED_HIST_BUCKETS - 1; i++) {
+        Serial.printf(" <%lu:%lu", SCHED_HIST_LIMITS_MS[i], hist[i]);
+    }
+    Serial.printf(" >=%lu:%lu\n", SCHED_HIST_LIMITS_MS[SCHED_HIST_BUCKETS - 2],
+                  hist[SCHED_HIST_BUCKETS - 1]);
+}
+
 CameraModeManager::ModeStats* CameraModeManager::getCurrentStats() {
     switch (currentMode) {
         case Config::CAMERA_MODE_MISSION:
@@ -392,16 +808,49 @@ void CameraModeManager::printStats() {
     Serial.printf("Current Mode: %s\n", getModeString(currentMode));
 
     Serial.println("\nMission Mode:");
-    Serial.printf("  Captures: %lu, Drops: %lu\n",
-                  missionStats.captureCount, missionStats.frameDrops);
+    Serial.printf("  Captures: %lu, Drops: %lu, Skipped (blur/duplicate): %lu\n",
+                  missionStats.captureCount, missionStats.frameDrops, missionStats.framesSkipped);
     Serial.printf("  Avg/Max time: %lu/%lu ms\n",
                   missionStats.avgCaptureTime, missionStats.maxCaptureTime);
+    Serial.printf("  Ring occupancy: %u (peak %u), back-pressure: %lu, ring drops: %lu\n",
+                  missionStats.ringOccupancy, missionStats.ringHighWater,
+                  missionStats.backPressureEvents, missionStats.ringDrops);
+    Serial.printf("  Switches: %lu (%lu in-place), first frame last/max: %lu/%lu ms\n",
+                  missionStats.switchCount, missionStats.fastSwitchCount,
+                  missionStats.lastSwitchLatency, missionStats.maxSwitchLatency);
+    Serial.printf("  Missed slots: %lu, max lateness/jitter: %lu/%lu us\n",
+                  missionStats.slotsMissed, missionStats.maxLateness, missionStats.maxJitter);
+    printHistogram("Lateness", missionStats.latenessHist);
+    printHistogram("Jitter  ", missionStats.jitterHist);
+    if (Config::cameraMode.MISSION_TRIGGER != Config::TRIGGER_TIME) {
+        Serial.printf("  Distance trigger: %.1f m spacing, %lu slots skipped\n",
+                      missionTrigger.getTriggerDistance(), missionStats.triggerSkips);
+    }
+
+    if (Config::cameraMode.QUALITY_CONTROL_ENABLED) {
+        QualityControllerStats qc = qualityController.getStatistics();
+        Serial.printf("  JPEG quality: %u, avg %.0f KB vs target %lu KB, SD %.0f KB/s\n",
+                      qualityController.getQuality(), qualityController.getAverageSize() / 1024.0f,
+                      qualityController.getEffectiveTarget() / 1024,
+                      qualityController.getWriteRate() * 1000.0f / 1024.0f);
+        Serial.printf("  Quality adjustments: %lu (%lu up, %lu down), over target: %lu, budget-limited: %lu\n",
+                      qc.adjustments, qc.qualityRaised, qc.qualityLowered,
+                      qc.overTarget, qc.budgetLimited);
+    }
 
     Serial.println("\nLanding Mode:");
     Serial.printf("  Captures: %lu, Drops: %lu\n",
                   landingStats.captureCount, landingStats.frameDrops);
     Serial.printf("  Avg/Max time: %lu/%lu ms\n",
                   landingStats.avgCaptureTime, landingStats.maxCaptureTime);
+    Serial.printf("  Switches: %lu (%lu in-place), first frame last/max: %lu/%lu ms, stale frames: %lu\n",
+                  landingStats.switchCount, landingStats.fastSwitchCount,
+                  landingStats.lastSwitchLatency, landingStats.maxSwitchLatency,
+                  landingStats.staleFrames);
+    Serial.printf("  Missed slots: %lu, max lateness/jitter: %lu/%lu us\n",
+                  landingStats.slotsMissed, landingStats.maxLateness, landingStats.maxJitter);
+    printHistogram("Lateness", landingStats.latenessHist);
+    printHistogram("Jitter  ", landingStats.jitterHist);
 
     Serial.println("-----------------------------\n");
 }
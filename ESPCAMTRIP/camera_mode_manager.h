@@ -2,8 +2,14 @@
 #define CAMERA_MODE_MANAGER_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
 #include "esp_camera.h"
 #include "config.h"
+#include "sensor_profile_manager.h"
+#include "capture_trigger.h"
+#include "quality_controller.h"
 
 // Use CameraMode from Config namespace
 using CameraMode = Config::CameraMode;
@@ -11,6 +17,14 @@ using CameraMode = Config::CameraMode;
 // Forward declarations
 class CameraManager;
 
+// Camera task notification bit set by the capture deadline timer
+// (low byte carries commands: 1 = start mission, 2 = stop/landing, 3 = burst)
+#define CAMERA_NOTIFY_COMMAND_MASK 0xFF
+#define CAMERA_NOTIFY_CAPTURE_DUE  (1UL << 8)
+
+// Lateness/jitter histogram buckets (upper bounds in ms, last bucket open)
+#define SCHED_HIST_BUCKETS 8
+
 /**
  * Camera Mode Manager
  *
@@ -24,6 +38,24 @@ class CameraManager;
  * - Pixel format (JPEG vs Grayscale)
  * - Capture rate (2-5Hz vs 10-15Hz)
  * - Quality settings
+ *
+ * When both modes share a pixel format, switches are done in place through
+ * the sensor (framesize/quality) with frame buffers pre-sized for the larger
+ * mode. A pixel format change needs a driver re-init, which is done without
+ * settle delays. Switch-to-first-frame latency is tracked per mode.
+ *
+ * Captures run on absolute deadlines (next = previous + interval) so the
+ * cadence does not drift with processing time. An esp_timer wakes the
+ * camera task at each deadline; deadlines that pass while a capture is
+ * still running are counted as missed slots.
+ *
+ * In MISSION mode the deadline is the maximum capture rate; with a distance
+ * or overlap trigger configured, a due slot only captures once the aircraft
+ * has moved far enough since the previous photo.
+ *
+ * MISSION JPEG quality is steered by a rate controller fed with each frame's
+ * size and the measured SD write rate, holding a bytes-per-frame target
+ * (from a bytes-per-second budget when set) within quality bounds.
  */
 class CameraModeManager {
 private:
@@ -37,19 +69,57 @@ private:
     // Mode-specific capture statistics
     struct ModeStats {
         uint32_t captureCount;
-        uint32_t frameDrops;
+        uint32_t frameDrops;         // Captures that failed (camera, ring or SD)
+        uint32_t framesSkipped;      // Frames discarded by the blur gate or duplicate filter
         uint32_t avgCaptureTime;
         uint32_t maxCaptureTime;
         unsigned long totalCaptureTime;
         unsigned long lastStatsReset;
 
+        // Capture pipeline (PSRAM frame ring) state
+        uint8_t ringOccupancy;       // Slots in use after last capture
+        uint8_t ringHighWater;       // Peak slots in use
+        uint32_t backPressureEvents; // Captures that found the ring full
+        uint32_t ringDrops;          // Frames dropped because no slot freed in time
+
+        // Mode switching into this mode
+        uint32_t switchCount;
+        uint32_t fastSwitchCount;    // Switches done without driver re-init
+        uint32_t lastSwitchLatency;  // ms from switch request to first usable frame
+        uint32_t maxSwitchLatency;
+        uint32_t staleFrames;        // Old-mode frames discarded after a switch
+
+        // Capture scheduling (absolute deadlines)
+        uint32_t slotsMissed;        // Whole intervals missed because a capture overran
+        uint32_t maxLateness;        // us from deadline to capture start (missed intervals included)
+        uint32_t maxJitter;          // us deviation of start-to-start interval
+        uint32_t latenessHist[SCHED_HIST_BUCKETS];
+        uint32_t jitterHist[SCHED_HIST_BUCKETS];
+        uint32_t triggerSkips;       // Slots skipped by the distance trigger
+
         void reset() {
             captureCount = 0;
             frameDrops = 0;
+            framesSkipped = 0;
             avgCaptureTime = 0;
             maxCaptureTime = 0;
             totalCaptureTime = 0;
             lastStatsReset = millis();
+            ringOccupancy = 0;
+            ringHighWater = 0;
+            backPressureEvents = 0;
+            ringDrops = 0;
+            switchCount = 0;
+            fastSwitchCount = 0;
+            lastSwitchLatency = 0;
+            maxSwitchLatency = 0;
+            staleFrames = 0;
+            slotsMissed = 0;
+            maxLateness = 0;
+            maxJitter = 0;
+            memset(latenessHist, 0, sizeof(latenessHist));
+            memset(jitterHist, 0, sizeof(jitterHist));
+            triggerSkips = 0;
         }
     };
 
@@ -57,10 +127,45 @@ private:
     static ModeStats landingStats;
     static ModeStats* getCurrentStats();
 
+    // Driver state for fast mode switching
+    static bool driverReady;
+    static pixformat_t driverPixelFormat;
+    static framesize_t driverFrameSize;      // Frame size the buffers were allocated for
+    static unsigned long switchStartTime;
+    static bool awaitingFirstFrame;
+    static bool lastSwitchFast;
+
+    // Absolute-deadline capture scheduler
+    static int64_t nextDeadline;             // esp_timer time (us), 0 = not scheduled
+    static int64_t lastSlotStart;
+    static bool slotSkipped;                 // Current capture discarded by a frame gate
+    static esp_timer_handle_t captureTimer;
+    static TaskHandle_t captureTask;
+
+    static void captureTimerCallback(void* arg);
+    static void armCaptureTimer();
+    static uint8_t histogramBucket(uint32_t us);
+    static void printHistogram(const char* label, const uint32_t* hist);
+
+    // Distance/overlap trigger for MISSION mode
+    static DistanceTrigger missionTrigger;
+    static bool isDistanceTriggerActive();
+    static void configureTrigger();
+    static bool distanceTriggerDue();
+
+    // JPEG rate control for MISSION mode
+    static QualityController qualityController;
+    static void configureQualityControl(QualityController& controller);
+
     // Mode configuration helpers
+    static camera_config_t getBaseCameraConfig();
     static camera_config_t getMissionCameraConfig();
     static camera_config_t getLandingCameraConfig();
-    static bool reconfigureCamera(const camera_config_t& config);
+    static void sizeBuffersForFastSwitch(camera_config_t& config);
+    static bool canFastSwitch(CameraMode mode);
+    static bool fastSwitchCamera(CameraMode mode);
+    static bool reconfigureCamera(CameraMode mode, const camera_config_t& config);
+    static SensorProfileId getSensorProfile(CameraMode mode);
 
     // Performance monitoring
     static void updateCaptureStats(unsigned long captureTime);
@@ -78,16 +183,40 @@ public:
     static bool isModeChangeInProgress() { return modeChangeInProgress; }
     static bool requestModeChange(CameraMode mode);
 
+    // Capture scheduling
+    static bool initScheduler(TaskHandle_t task);  // Task woken at each deadline
+    static TaskHandle_t getCaptureTask() { return captureTask; }
+    static void resetSchedule();                   // Next capture is due immediately
+    static TickType_t getScheduleWaitTicks();       // Fallback wait until next deadline
+    static bool getTakeoffAltitude(float& altitude); // AGL reference of the distance trigger
+
     // Mode-specific operations
     static bool shouldCapture();
     static uint32_t getCaptureInterval();
     static framesize_t getFrameSize();
     static pixformat_t getPixelFormat();
     static uint8_t getJPEGQuality();
+    static framesize_t getFrameSize(CameraMode mode);
+    static pixformat_t getPixelFormat(CameraMode mode);
+    static uint8_t getJPEGQuality(CameraMode mode);
+
+    /**
+     * Check a frame against the current mode's geometry
+     * Frames queued before an in-place switch are rejected; the first
+     * accepted frame after a switch records the switch latency.
+     */
+    static bool acceptFrame(const camera_fb_t* fb);
 
     // Performance and statistics
     static void recordCaptureStart();
     static void recordCaptureComplete(bool success);
+    static void recordRingOccupancy(uint8_t occupancy);
+    static void recordBackPressure(bool dropped);
+    static void recordFrameSkipped();                            // Blur gate or duplicate filter
+    static void recordFrameSize(size_t bytes);                   // Camera task, each mission frame
+    static void recordFrameWrite(size_t bytes, uint32_t writeUs); // SD write of a captured frame
+    static QualityControllerStats getQualityStats() { return qualityController.getStatistics(); }
+    static bool runQualityReplay(const String& directory);      // <directory>/mission.bin sizes
     static ModeStats getMissionStats() { return missionStats; }
     static ModeStats getLandingStats() { return landingStats; }
     static void printStats();
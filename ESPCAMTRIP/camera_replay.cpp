@@ -0,0 +1,332 @@
+#include "camera_replay.h"
+#include "config.h"
+#include "sensor_profile_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#ifdef ESP_PLATFORM
+#include "psram_manager.h"
+#include <esp_timer.h>
+#define REPLAY_MALLOC(size) PSRAM_MALLOC(size)
+#define REPLAY_FREE(ptr) PSRAM_FREE(ptr)
+#else
+#define REPLAY_MALLOC(size) malloc(size)
+#define REPLAY_FREE(ptr) free(ptr)
+#endif
+
+// Clock of the driver's frame timestamps (GPS fix history uses it too)
+static int64_t nowUs() {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void sleepUs(int64_t us) {
+    if (us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+// Emulated sensor: setters only update status, frames are served as recorded
+#define REPLAY_SETTER(field, setter, type, statusField) \
+    static int replay_##setter(sensor_t* s, type value) { \
+        s->status.statusField = value; \
+        return 0; \
+    }
+SENSOR_SETTINGS_FIELDS(REPLAY_SETTER)
+#undef REPLAY_SETTER
+
+static int replay_set_framesize(sensor_t* s, framesize_t size) {
+    s->status.framesize = size;
+    return 0;
+}
+
+static int replay_set_quality(sensor_t* s, int quality) {
+    s->status.quality = quality;
+    return 0;
+}
+
+static int replay_set_pixformat(sensor_t* s, pixformat_t format) {
+    s->pixformat = format;
+    return 0;
+}
+
+static bool hasFrameExtension(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0 ||
+                   strcasecmp(dot, ".pgm") == 0);
+}
+
+ReplayCameraSource::ReplayCameraSource() : nextFile(0), bufferSize(0), nextFrameUs(0),
+                                           jitterState(1) {
+    memset(buffers, 0, sizeof(buffers));
+    memset(&sensor, 0, sizeof(sensor));
+    stats.reset();
+}
+
+esp_err_t ReplayCameraSource::init(const camera_config_t& config) {
+    deinit();
+
+    if (!scanDirectory(Config::replay.DIRECTORY.c_str())) {
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < REPLAY_BUFFERS; i++) {
+        buffers[i].data = (uint8_t*)REPLAY_MALLOC(bufferSize);
+        if (!buffers[i].data) {
+            Serial.printf("Replay: failed to allocate %u byte frame buffer\n", (unsigned)bufferSize);
+            deinit();
+            return ESP_FAIL;
+        }
+        buffers[i].inUse = false;
+    }
+
+    memset(&sensor, 0, sizeof(sensor));
+#define REPLAY_BIND(field, setter, type, statusField) sensor.setter = replay_##setter;
+    SENSOR_SETTINGS_FIELDS(REPLAY_BIND)
+#undef REPLAY_BIND
+    sensor.set_framesize = replay_set_framesize;
+    sensor.set_quality = replay_set_quality;
+    sensor.set_pixformat = replay_set_pixformat;
+    sensor.status.framesize = config.frame_size;
+    sensor.status.quality = config.jpeg_quality;
+    sensor.pixformat = config.pixel_format;
+
+    nextFile = 0;
+    nextFrameUs = 0;
+    jitterState = 1;
+    stats.reset();
+
+    Serial.printf("Replay camera: %u frames from %s (%u KB buffers)\n", (unsigned)files.size(),
+                  Config::replay.DIRECTORY.c_str(), (unsigned)(bufferSize / 1024));
+    return ESP_OK;
+}
+
+void ReplayCameraSource::deinit() {
+    for (int i = 0; i < REPLAY_BUFFERS; i++) {
+        REPLAY_FREE(buffers[i].data);
+        buffers[i].data = nullptr;
+        buffers[i].inUse = false;
+    }
+    files.clear();
+    bufferSize = 0;
+}
+
+bool ReplayCameraSource::scanDirectory(const char* directory) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        Serial.printf("Replay: cannot open %s\n", directory);
+        return false;
+    }
+
+    size_t largest = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (!hasFrameExtension(entry->d_name)) {
+            continue;
+        }
+        std::string path = std::string(directory) + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            continue;
+        }
+        largest = std::max(largest, (size_t)st.st_size);
+        files.push_back(path);
+    }
+    closedir(dir);
+
+    if (files.empty()) {
+        Serial.printf("Replay: no .jpg/.pgm frames in %s\n", directory);
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+    bufferSize = largest;
+    return true;
+}
+
+bool ReplayCameraSource::loadFrame(const std::string& path, Buffer& buffer) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    size_t length = fread(buffer.data, 1, bufferSize, f);
+    fclose(f);
+
+    camera_fb_t& fb = buffer.fb;
+    memset(&fb, 0, sizeof(fb));
+    size_t offset = 0;
+    if (length > 2 && buffer.data[0] == 0xFF && buffer.data[1] == 0xD8) {
+        if (!parseJPEGSize(buffer.data, length, fb.width, fb.height)) {
+            return false;
+        }
+        fb.format = PIXFORMAT_JPEG;
+        fb.len = length;
+    } else if (parsePGMHeader(buffer.data, length, fb.width, fb.height, offset)) {
+        fb.format = PIXFORMAT_GRAYSCALE;
+        fb.len = fb.width * fb.height;
+    } else {
+        return false;
+    }
+    fb.buf = buffer.data + offset;
+    int64_t stamp = nowUs();
+    fb.timestamp.tv_sec = stamp / 1000000;
+    fb.timestamp.tv_usec = stamp % 1000000;
+    return true;
+}
+
+uint32_t ReplayCameraSource::nextJitter(uint32_t range) {
+    if (range == 0) {
+        return 0;
+    }
+    // xorshift32: the same latency sequence on every run
+    jitterState ^= jitterState << 13;
+    jitterState ^= jitterState >> 17;
+    jitterState ^= jitterState << 5;
+    return jitterState % (range + 1);
+}
+
+camera_fb_t* ReplayCameraSource::getFrame() {
+    if (files.empty()) {
+        return nullptr;
+    }
+
+    Buffer* buffer = nullptr;
+    for (int i = 0; i < REPLAY_BUFFERS; i++) {
+        if (!buffers[i].inUse) {
+            buffer = &buffers[i];
+            break;
+        }
+    }
+    if (!buffer) {
+        stats.buffersBusy++;
+        return nullptr;
+    }
+
+    // Free-running sensor: the next frame is ready one interval after the last
+    if (Config::replay.INTERVAL_MS > 0) {
+        int64_t now = nowUs();
+        if (nextFrameUs > now) {
+            sleepUs(nextFrameUs - now);
+        }
+        nextFrameUs = std::max(nextFrameUs, now) + (int64_t)Config::replay.INTERVAL_MS * 1000;
+    }
+    sleepUs(Config::replay.LATENCY_US + nextJitter(Config::replay.JITTER_US));
+
+    if (nextFile >= files.size()) {
+        if (!Config::replay.LOOP) {
+            return nullptr;
+        }
+        nextFile = 0;
+        stats.loops++;
+    }
+
+    int64_t start = nowUs();
+    const std::string& path = files[nextFile++];
+    if (!loadFrame(path, *buffer)) {
+        stats.readFailures++;
+        Serial.printf("Replay: cannot read frame %s\n", path.c_str());
+        return nullptr;
+    }
+    uint32_t readTime = (uint32_t)(nowUs() - start);
+    stats.lastReadTime = readTime;
+    stats.maxReadTime = std::max(stats.maxReadTime, readTime);
+    stats.framesServed++;
+
+    buffer->inUse = true;
+    return &buffer->fb;
+}
+
+void ReplayCameraSource::returnFrame(camera_fb_t* fb) {
+    for (int i = 0; i < REPLAY_BUFFERS; i++) {
+        if (&buffers[i].fb == fb) {
+            buffers[i].inUse = false;
+            return;
+        }
+    }
+}
+
+void ReplayCameraSource::printStatistics() const {
+    Serial.println("\n--- Replay Camera ---");
+    Serial.printf("Frames: %u served from %u files, %u loops\n", stats.framesServed,
+                  (unsigned)files.size(), stats.loops);
+    Serial.printf("Read failures: %u, buffers busy: %u\n", stats.readFailures, stats.buffersBusy);
+    Serial.printf("Read time last/max: %u/%u us\n", stats.lastReadTime, stats.maxReadTime);
+    Serial.println("---------------------\n");
+}
+
+bool ReplayCameraSource::parseJPEGSize(const uint8_t* data, size_t length,
+                                       size_t& width, size_t& height) {
+    size_t pos = 2; // After SOI
+    while (pos + 4 <= length) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++; // Fill byte
+            continue;
+        }
+        size_t segmentLength = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+
+        // SOF0..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+            marker != 0xCC) {
+            if (pos + 9 > length) {
+                return false;
+            }
+            height = ((size_t)data[pos + 5] << 8) | data[pos + 6];
+            width = ((size_t)data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        if (marker == 0xDA) {
+            return false; // Scan before any frame header
+        }
+        pos += 2 + segmentLength;
+    }
+    return false;
+}
+
+bool ReplayCameraSource::parsePGMHeader(const uint8_t* data, size_t length, size_t& width,
+                                        size_t& height, size_t& dataOffset) {
+    if (length < 2 || data[0] != 'P' || data[1] != '5') {
+        return false;
+    }
+
+    // Three decimal fields (width, height, maxval), whitespace and # comments between
+    size_t pos = 2;
+    size_t values[3];
+    for (int v = 0; v < 3; v++) {
+        while (pos < length && (isspace(data[pos]) || data[pos] == '#')) {
+            if (data[pos] == '#') {
+                while (pos < length && data[pos] != '\n') {
+                    pos++;
+                }
+            } else {
+                pos++;
+            }
+        }
+        if (pos >= length || !isdigit(data[pos])) {
+            return false;
+        }
+        values[v] = 0;
+        while (pos < length && isdigit(data[pos])) {
+            values[v] = values[v] * 10 + (data[pos++] - '0');
+        }
+    }
+    pos++; // Single whitespace before the raster
+
+    width = values[0];
+    height = values[1];
+    dataOffset = pos;
+    return width > 0 && height > 0 && values[2] > 0 && values[2] <= 255 &&
+           pos + width * height <= length;
+}
@@ -0,0 +1,91 @@
+#ifndef CAMERA_REPLAY_H
+#define CAMERA_REPLAY_H
+
+#include "camera_hal.h"
+#include <string>
+#include <vector>
+
+/**
+ * Replay Camera Source
+ *
+ * CameraSource serving recorded frames from a directory (Config::replay),
+ * in file name order: .jpg/.jpeg as PIXFORMAT_JPEG, binary .pgm (P5,
+ * 8-bit) as PIXFORMAT_GRAYSCALE. Used to benchmark the capture, EXIF,
+ * storage and AprilTag stages without a sensor (host builds, or on the
+ * device from the SD card) and to reproduce field issues from the frames
+ * that caused them.
+ *
+ * Frames are paced like a free-running sensor (one every INTERVAL_MS,
+ * 0 = on demand) and each fb_get is delayed by LATENCY_US plus up to
+ * JITTER_US (fixed-seed, so runs repeat). Frames are read into
+ * REPLAY_BUFFERS buffers sized for the largest file at init and served
+ * at their recorded size: set_framesize/set_quality only update the
+ * emulated sensor status, so record at the mode's frame size.
+ */
+
+#define REPLAY_BUFFERS 2
+
+struct ReplayStatistics {
+    uint32_t framesServed;
+    uint32_t loops;              // Times the sequence wrapped around
+    uint32_t readFailures;
+    uint32_t buffersBusy;        // fb_get with every buffer still held
+    uint32_t lastReadTime;       // us, file read and parse
+    uint32_t maxReadTime;
+
+    void reset() {
+        framesServed = 0;
+        loops = 0;
+        readFailures = 0;
+        buffersBusy = 0;
+        lastReadTime = 0;
+        maxReadTime = 0;
+    }
+};
+
+class ReplayCameraSource : public CameraSource {
+private:
+    struct Buffer {
+        uint8_t* data;
+        bool inUse;
+        camera_fb_t fb;
+    };
+
+    std::vector<std::string> files;
+    size_t nextFile;
+    Buffer buffers[REPLAY_BUFFERS];
+    size_t bufferSize;
+    sensor_t sensor;
+    int64_t nextFrameUs;
+    uint32_t jitterState;
+    ReplayStatistics stats;
+
+    bool scanDirectory(const char* directory);
+    bool loadFrame(const std::string& path, Buffer& buffer);
+    uint32_t nextJitter(uint32_t range);
+
+public:
+    ReplayCameraSource();
+    ~ReplayCameraSource() override { deinit(); }
+
+    const char* getName() const override { return "replay"; }
+    esp_err_t init(const camera_config_t& config) override;
+    void deinit() override;
+    camera_fb_t* getFrame() override;
+    void returnFrame(camera_fb_t* fb) override;
+    sensor_t* getSensor() override { return &sensor; }
+
+    size_t getFrameCount() const { return files.size(); }
+    ReplayStatistics getStatistics() const { return stats; }
+    void printStatistics() const;
+
+    /**
+     * Width/height of a JPEG (first SOF marker) or binary PGM; pixel data
+     * offset for PGM. Exposed for tools reading recorded frames.
+     */
+    static bool parseJPEGSize(const uint8_t* data, size_t length, size_t& width, size_t& height);
+    static bool parsePGMHeader(const uint8_t* data, size_t length, size_t& width, size_t& height,
+                               size_t& dataOffset);
+};
+
+#endif // CAMERA_REPLAY_H
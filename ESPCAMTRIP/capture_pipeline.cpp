@@ -0,0 +1,435 @@
+#include "capture_pipeline.h"
+#include "camera_manager.h"
+#include "psram_manager.h"
+#include "config.h"
+#include "system_state.h"
+
+// Static member definitions
+bool CapturePipeline::initialized = false;
+CaptureSlot* CapturePipeline::slots = nullptr;
+uint8_t CapturePipeline::slotCount = 0;
+QueueHandle_t CapturePipeline::freeQueue = NULL;
+QueueHandle_t CapturePipeline::readyQueue = NULL;
+TaskHandle_t CapturePipeline::writerTaskHandle = NULL;
+volatile bool CapturePipeline::dryRun = false;
+uint32_t CapturePipeline::simulatedWriteLatency = 0;
+PipelineStatistics CapturePipeline::stats = {};
+volatile bool CapturePipeline::previewActive = false;
+CaptureSlot* CapturePipeline::previewSlot = nullptr;
+uint32_t CapturePipeline::previewSequence = 0;
+portMUX_TYPE CapturePipeline::previewMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool CapturePipeline::init() {
+    if (initialized) {
+        return true;
+    }
+
+    if (!Config::pipeline.enabled) {
+        Serial.println("Capture pipeline disabled - frames written synchronously");
+        return false;
+    }
+
+    Serial.println("Initializing capture pipeline...");
+
+    if (!PSRAMManager::isAvailable()) {
+        Serial.println("Capture pipeline requires PSRAM - frames written synchronously");
+        return false;
+    }
+
+    uint8_t count = Config::pipeline.SLOT_COUNT;
+    if (count < 2) {
+        count = 2; // Need at least one slot filling while another is written
+    }
+
+    slots = (CaptureSlot*)calloc(count, sizeof(CaptureSlot));
+    if (!slots) {
+        Serial.println("Failed to allocate capture slot table");
+        return false;
+    }
+
+    // Allocate slot buffers once; the capture path never allocates
+    for (uint8_t i = 0; i < count; i++) {
+        slots[i].data = (uint8_t*)PSRAM_MALLOC(Config::pipeline.SLOT_SIZE);
+        if (!slots[i].data) {
+            Serial.printf("Failed to allocate capture slot %u (%u bytes)\n",
+                          i, (unsigned)Config::pipeline.SLOT_SIZE);
+            // Run with fewer slots if at least two were allocated
+            break;
+        }
+        slots[i].capacity = Config::pipeline.SLOT_SIZE;
+        slotCount = i + 1;
+    }
+
+    if (slotCount < 2) {
+        Serial.println("Not enough PSRAM for capture ring");
+        releaseResources();
+        return false;
+    }
+
+    freeQueue = xQueueCreate(slotCount, sizeof(uint8_t));
+    readyQueue = xQueueCreate(slotCount, sizeof(uint8_t));
+    if (freeQueue == NULL || readyQueue == NULL) {
+        Serial.println("Failed to create capture pipeline queues");
+        releaseResources();
+        return false;
+    }
+
+    for (uint8_t i = 0; i < slotCount; i++) {
+        xQueueSend(freeQueue, &i, 0);
+    }
+
+    stats.reset();
+
+    xTaskCreatePinnedToCore(
+        writerTask,
+        "SDWriter",
+        Config::pipeline.WRITER_STACK_SIZE,
+        NULL,
+        Config::pipeline.WRITER_PRIORITY,
+        &writerTaskHandle,
+        Config::pipeline.WRITER_CORE
+    );
+    if (writerTaskHandle == NULL) {
+        Serial.println("Failed to create SD writer task");
+        releaseResources();
+        return false;
+    }
+
+    initialized = true;
+    Serial.printf("Capture pipeline initialized: %u slots x %u KB in PSRAM\n",
+                  slotCount, (unsigned)(Config::pipeline.SLOT_SIZE / 1024));
+    return true;
+}
+
+void CapturePipeline::releaseResources() {
+    // Failed init: undo every allocation so a retry starts clean
+    if (freeQueue != NULL) {
+        vQueueDelete(freeQueue);
+        freeQueue = NULL;
+    }
+    if (readyQueue != NULL) {
+        vQueueDelete(readyQueue);
+        readyQueue = NULL;
+    }
+    if (slots) {
+        for (uint8_t i = 0; i < slotCount; i++) {
+            PSRAM_FREE(slots[i].data);
+        }
+        free(slots);
+        slots = nullptr;
+    }
+    slotCount = 0;
+}
+
+CaptureSlot* CapturePipeline::acquireSlot(uint32_t timeoutMs) {
+    if (!initialized) {
+        return nullptr;
+    }
+
+    // Capture comes first: take the preview frame back rather than wait
+    if (uxQueueMessagesWaiting(freeQueue) == 0 && dropPreview()) {
+        stats.previewReclaims++;
+    }
+
+    uint8_t index;
+    if (xQueueReceive(freeQueue, &index, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+        return nullptr;
+    }
+
+    CaptureSlot* slot = &slots[index];
+    slot->length = 0;
+    slot->refCount = 0;
+    slot->geotagged = false;
+    slot->filename[0] = '\0';
+
+    updateHighWaterMark();
+    return slot;
+}
+
+void CapturePipeline::commitSlot(CaptureSlot* slot) {
+    if (!initialized || !slot) {
+        return;
+    }
+
+    uint8_t index = slot - slots;
+    stats.framesQueued++;
+    // Ready queue has one entry per slot, so this never blocks
+    xQueueSend(readyQueue, &index, portMAX_DELAY);
+}
+
+void CapturePipeline::releaseSlot(CaptureSlot* slot) {
+    if (!initialized || !slot) {
+        return;
+    }
+
+    uint8_t index = slot - slots;
+    xQueueSend(freeQueue, &index, portMAX_DELAY);
+}
+
+uint8_t CapturePipeline::getOccupancy() {
+    if (!initialized) {
+        return 0;
+    }
+    // The preview frame is reclaimable on demand: not occupied
+    uint8_t held = slotCount - uxQueueMessagesWaiting(freeQueue);
+    return (previewSlot && held > 0) ? held - 1 : held;
+}
+
+void CapturePipeline::updateHighWaterMark() {
+    uint8_t occupancy = getOccupancy();
+    if (occupancy > stats.highWaterMark) {
+        stats.highWaterMark = occupancy;
+    }
+}
+
+bool CapturePipeline::waitUntilDrained(uint32_t timeoutMs) {
+    if (!initialized) {
+        return true;
+    }
+
+    // Drained once every slot is back on the free list (the preview frame
+    // is let go; a reader still sending it returns it when done)
+    unsigned long start = millis();
+    dropPreview();
+    while (uxQueueMessagesWaiting(freeQueue) < slotCount) {
+        if (millis() - start > timeoutMs) {
+            Serial.printf("Capture pipeline drain timeout (%u frames pending)\n",
+                          (unsigned)uxQueueMessagesWaiting(readyQueue));
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+        dropPreview(); // Frames written meanwhile
+    }
+    return true;
+}
+
+void CapturePipeline::writerTask(void* parameter) {
+    uint8_t index;
+
+    while (true) {
+        if (xQueueReceive(readyQueue, &index, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        CaptureSlot& slot = slots[index];
+
+        unsigned long start = millis();
+        bool success = writeSlot(slot);
+        unsigned long writeTime = millis() - start;
+
+        if (success) {
+            stats.framesWritten++;
+            stats.bytesWritten += slot.length;
+            stats.totalWriteTime += writeTime;
+            stats.avgWriteTime = stats.totalWriteTime / stats.framesWritten;
+            if (writeTime > stats.maxWriteTime) {
+                stats.maxWriteTime = writeTime;
+            }
+        } else {
+            stats.writeFailures++;
+        }
+
+        retireSlot(index, success);
+    }
+}
+
+void CapturePipeline::retireSlot(uint8_t index, bool written) {
+    if (!written || !previewActive || dryRun) {
+        xQueueSend(freeQueue, &index, portMAX_DELAY);
+        return;
+    }
+
+    // Newest frame becomes the preview; the ring holds one reference
+    portENTER_CRITICAL(&previewMux);
+    CaptureSlot* previous = previewSlot;
+    slots[index].refCount = 1;
+    previewSlot = &slots[index];
+    previewSequence++;
+    portEXIT_CRITICAL(&previewMux);
+
+    stats.previewFrames++;
+    if (previous) {
+        unreference(previous);
+    }
+}
+
+void CapturePipeline::unreference(CaptureSlot* slot) {
+    portENTER_CRITICAL(&previewMux);
+    bool last = --slot->refCount == 0;
+    portEXIT_CRITICAL(&previewMux);
+
+    if (last) {
+        uint8_t index = slot - slots;
+        xQueueSend(freeQueue, &index, portMAX_DELAY);
+    }
+}
+
+bool CapturePipeline::dropPreview() {
+    portENTER_CRITICAL(&previewMux);
+    CaptureSlot* slot = previewSlot;
+    previewSlot = nullptr;
+    portEXIT_CRITICAL(&previewMux);
+
+    if (slot) {
+        unreference(slot);
+    }
+    return slot != nullptr;
+}
+
+void CapturePipeline::setPreviewActive(bool active) {
+    if (!initialized) {
+        return;
+    }
+    previewActive = active;
+    if (!active) {
+        dropPreview();
+    }
+}
+
+const CaptureSlot* CapturePipeline::acquirePreview(uint32_t& lastSequence) {
+    if (!initialized) {
+        return nullptr;
+    }
+
+    CaptureSlot* slot = nullptr;
+    portENTER_CRITICAL(&previewMux);
+    if (previewSlot && previewSequence != lastSequence) {
+        slot = previewSlot;
+        slot->refCount++;
+        lastSequence = previewSequence;
+    }
+    portEXIT_CRITICAL(&previewMux);
+    return slot;
+}
+
+void CapturePipeline::releasePreview(const CaptureSlot* slot) {
+    if (!initialized || !slot) {
+        return;
+    }
+    unreference(&slots[slot - slots]);
+}
+
+bool CapturePipeline::writeSlot(CaptureSlot& slot) {
+    if (simulatedWriteLatency > 0) {
+        vTaskDelay(pdMS_TO_TICKS(simulatedWriteLatency));
+    }
+
+    if (dryRun) {
+        return slot.length > 0;
+    }
+
+    return CameraManager::writeCapturedFrame(slot);
+}
+
+void CapturePipeline::printStatistics() {
+    Serial.println("\n--- Capture Pipeline ---");
+    if (!initialized) {
+        Serial.println("Status: Disabled (synchronous writes)");
+        Serial.println("------------------------\n");
+        return;
+    }
+
+    Serial.printf("Slots: %u x %u KB, occupancy %u, peak %u\n",
+                  slotCount, (unsigned)(Config::pipeline.SLOT_SIZE / 1024),
+                  getOccupancy(), stats.highWaterMark);
+    Serial.printf("Frames queued/written: %u/%u, write failures: %u, oversize: %u\n",
+                  stats.framesQueued, stats.framesWritten,
+                  stats.writeFailures, stats.oversizeFrames);
+    Serial.printf("Avg/Max write time: %u/%u ms\n", stats.avgWriteTime, stats.maxWriteTime);
+    if (stats.previewFrames > 0) {
+        Serial.printf("Preview frames: %u, reclaimed for capture: %u\n",
+                      stats.previewFrames, stats.previewReclaims);
+    }
+    Serial.printf("Bytes written: %.1f MB\n", stats.bytesWritten / 1024.0 / 1024.0);
+    Serial.println("------------------------\n");
+}
+
+bool CapturePipeline::runSelfTest(uint16_t frames, uint32_t intervalMs, uint32_t writeLatencyMs) {
+    Serial.println("\n=== Capture Pipeline Self-Test ===");
+
+    if (!initialized) {
+        Serial.println("FAIL: Pipeline not initialized");
+        return false;
+    }
+
+    if (SystemState::isCapturing() || !isIdle()) {
+        Serial.println("FAIL: Pipeline busy - stop capture first");
+        return false;
+    }
+
+    Serial.printf("Frames: %u, interval: %u ms, write latency: %u ms, slots: %u\n",
+                  frames, intervalMs, writeLatencyMs, slotCount);
+
+    PipelineStatistics savedStats = stats;
+    uint32_t savedLatency = simulatedWriteLatency;
+    stats.reset();
+    simulatedWriteLatency = writeLatencyMs;
+    dryRun = true;
+
+    uint32_t produced = 0;
+    uint32_t dropped = 0;
+    uint32_t backPressure = 0;
+
+    for (uint16_t i = 0; i < frames; i++) {
+        unsigned long frameStart = millis();
+
+        bool ringFull = (getOccupancy() >= slotCount);
+        CaptureSlot* slot = acquireSlot(Config::pipeline.ACQUIRE_TIMEOUT_MS);
+        if (ringFull) {
+            backPressure++;
+        }
+
+        if (!slot) {
+            dropped++;
+        } else {
+            // Synthetic JPEG: SOI, varying payload, EOI (UXGA-sized frames)
+            size_t length = 200 * 1024 + (esp_random() % (200 * 1024));
+            if (length > slot->capacity) {
+                length = slot->capacity;
+            }
+            slot->data[0] = 0xFF;
+            slot->data[1] = 0xD8;
+            slot->data[length - 2] = 0xFF;
+            slot->data[length - 1] = 0xD9;
+            slot->length = length;
+            slot->sequence = i;
+            slot->captureTime = frameStart;
+            commitSlot(slot);
+            produced++;
+        }
+
+        unsigned long elapsed = millis() - frameStart;
+        if (elapsed < intervalMs) {
+            vTaskDelay(pdMS_TO_TICKS(intervalMs - elapsed));
+        }
+    }
+
+    bool drained = waitUntilDrained(frames * (writeLatencyMs + 100) + 1000);
+    PipelineStatistics result = stats;
+
+    dryRun = false;
+    simulatedWriteLatency = savedLatency;
+    stats = savedStats;
+
+    bool accounted = (result.framesWritten + dropped == frames) && (produced == result.framesQueued);
+    bool noLeaks = (uxQueueMessagesWaiting(freeQueue) == slotCount);
+
+    Serial.printf("Produced: %u, written: %u, dropped: %u, back-pressure: %u\n",
+                  produced, result.framesWritten, dropped, backPressure);
+    Serial.printf("Peak occupancy: %u/%u, avg/max write: %u/%u ms\n",
+                  result.highWaterMark, slotCount, result.avgWriteTime, result.maxWriteTime);
+    Serial.printf("Drained: %s, frames accounted: %s, slots returned: %s\n",
+                  drained ? "PASS" : "FAIL",
+                  accounted ? "PASS" : "FAIL",
+                  noLeaks ? "PASS" : "FAIL");
+
+    // With write latency below the interval the ring should never drop
+    if (writeLatencyMs < intervalMs && dropped > 0) {
+        Serial.println("FAIL: Frames dropped although writer keeps up");
+        return false;
+    }
+
+    bool passed = drained && accounted && noLeaks;
+    Serial.printf("Overall Result: %s\n", passed ? "PASS" : "FAIL");
+    return passed;
+}
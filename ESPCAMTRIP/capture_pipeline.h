@@ -0,0 +1,182 @@
+#ifndef CAPTURE_PIPELINE_H
+#define CAPTURE_PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "gps_manager.h"
+#include "photo_hash.h"
+
+/**
+ * Capture Pipeline (PSRAM frame ring + SD writer task)
+ *
+ * Decouples camera capture from SD card latency:
+ * - CameraTask copies each JPEG into a preallocated PSRAM slot and
+ *   returns the camera frame buffer immediately
+ * - A dedicated writer task drains filled slots to the SD card
+ *
+ * All slots are allocated once at startup, so the capture path never
+ * allocates. When the ring is full the producer waits briefly, then
+ * drops the frame; both cases are counted as back-pressure in
+ * CameraModeManager statistics.
+ *
+ * While preview is active the writer keeps the newest written slot as
+ * the preview frame instead of freeing it. Readers take a reference
+ * (acquirePreview()) and send straight from the slot; it returns to the
+ * free list when the last reference goes. The producer reclaims the
+ * preview slot before it would wait for one, so preview never costs a
+ * frame unless a reader is still sending it.
+ */
+
+struct CaptureSlot {
+    uint8_t* data;               // PSRAM buffer
+    size_t capacity;             // Buffer size (Config::pipeline.SLOT_SIZE)
+    size_t length;               // JPEG bytes (including EXIF) in buffer
+    uint16_t exifSize;           // GPS EXIF APP1 bytes spliced in after SOI, 0 = none
+    uint16_t thumbnailSize;      // EXIF thumbnail bytes added to the APP1 on SD (writer)
+    uint8_t frameSize;           // Sensor framesize_t and JPEG quality at capture
+    uint8_t jpegQuality;
+    uint32_t sequence;           // Capture sequence number (photo number)
+    unsigned long captureTime;   // millis() at exposure (exposureUs / 1000)
+    int64_t exposureUs;          // Driver frame timestamp (esp_timer us)
+    bool geotagged;              // GPS snapshot below is valid for this frame
+    GPSPosition gps;             // Position at exposureUs
+    uint8_t positionSource;      // GPSPositionSource of gps
+    int32_t fixOffsetUs;         // exposureUs minus the fix gps was derived from
+    int64_t exposureUnixUs;      // UTC of exposureUs from the GPS clock (unix us), 0 = unknown
+    int16_t sharpness;           // Sharpness score (per mille), -1 = not scored
+    bool blurred;                // Below the sharpness threshold (kept, marked)
+    uint32_t trace;              // CaptureTrace handle, 0 = not traced
+    uint8_t refCount;            // Preview references (ring's latest + readers)
+    uint8_t sha256[PHOTO_HASH_SIZE]; // SHA-256 of the file as written (set by the writer)
+    char filename[128];          // Destination path on SD card
+};
+
+struct PipelineStatistics {
+    uint32_t framesQueued;
+    uint32_t framesWritten;
+    uint32_t writeFailures;
+    uint32_t oversizeFrames;     // Frames too large for a slot (written directly)
+    uint64_t bytesWritten;
+    uint32_t avgWriteTime;       // ms per frame in writer task
+    uint32_t maxWriteTime;
+    unsigned long totalWriteTime;
+    uint8_t highWaterMark;       // Peak ring occupancy
+    uint32_t previewFrames;      // Slots published as preview frame
+    uint32_t previewReclaims;    // Preview slot taken back for capture
+
+    void reset() {
+        framesQueued = 0;
+        framesWritten = 0;
+        writeFailures = 0;
+        oversizeFrames = 0;
+        bytesWritten = 0;
+        avgWriteTime = 0;
+        maxWriteTime = 0;
+        totalWriteTime = 0;
+        highWaterMark = 0;
+        previewFrames = 0;
+        previewReclaims = 0;
+    }
+};
+
+class CapturePipeline {
+private:
+    static bool initialized;
+    static CaptureSlot* slots;
+    static uint8_t slotCount;
+    static QueueHandle_t freeQueue;      // Indices of empty slots
+    static QueueHandle_t readyQueue;     // Indices of filled slots, in capture order
+    static TaskHandle_t writerTaskHandle;
+    static volatile bool dryRun;         // Self-test: discard instead of writing to SD
+    static uint32_t simulatedWriteLatency;
+    static PipelineStatistics stats;
+
+    // Preview frame (newest written slot while preview is active)
+    static volatile bool previewActive;
+    static CaptureSlot* previewSlot;
+    static uint32_t previewSequence;     // Incremented per published frame
+    static portMUX_TYPE previewMux;
+
+    static void writerTask(void* parameter);
+    static void releaseResources();
+    static bool writeSlot(CaptureSlot& slot);
+    static void retireSlot(uint8_t index, bool written);
+    static void unreference(CaptureSlot* slot);
+    static bool dropPreview();
+    static void updateHighWaterMark();
+
+public:
+    /**
+     * Allocate the PSRAM ring and start the writer task
+     * Call after PSRAM, storage and configuration are initialized
+     */
+    static bool init();
+
+    static bool isInitialized() { return initialized; }
+    static TaskHandle_t getWriterTask() { return writerTaskHandle; }
+
+    /**
+     * Producer side (CameraTask)
+     *
+     * acquireSlot() waits up to timeoutMs for an empty slot and returns
+     * nullptr if the ring stays full. A filled slot is handed to the
+     * writer with commitSlot(); an unused slot goes back with releaseSlot().
+     */
+    static CaptureSlot* acquireSlot(uint32_t timeoutMs);
+    static void commitSlot(CaptureSlot* slot);
+    static void releaseSlot(CaptureSlot* slot);
+
+    /**
+     * Preview readers (live view)
+     *
+     * setPreviewActive(true) makes the writer keep the newest written
+     * frame. acquirePreview() returns it with a reference if it is newer
+     * than lastSequence (updated), else nullptr; every acquired slot must
+     * go back with releasePreview(). Slot data is read-only to readers.
+     */
+    static void setPreviewActive(bool active);
+    static const CaptureSlot* acquirePreview(uint32_t& lastSequence);
+    static void releasePreview(const CaptureSlot* slot);
+
+    /**
+     * Ring state
+     */
+    static uint8_t getCapacity() { return slotCount; }
+    static uint8_t getOccupancy();      // Slots queued, being written or being sent to preview
+    static bool isIdle() { return getOccupancy() == 0; }
+
+    /**
+     * Block until all queued frames are on the SD card
+     * Call before changing capture directory or pausing for upload
+     */
+    static bool waitUntilDrained(uint32_t timeoutMs);
+
+    /**
+     * Add artificial latency to every write (field issue reproduction)
+     */
+    static void setSimulatedWriteLatency(uint32_t ms) { simulatedWriteLatency = ms; }
+
+    /**
+     * Statistics
+     */
+    static PipelineStatistics getStatistics() { return stats; }
+    static void resetStatistics() { stats.reset(); }
+    static void recordOversizeFrame() { stats.oversizeFrames++; }
+    static void printStatistics();
+
+    /**
+     * Drive the ring with synthetic frames and artificial write latency
+     * Nothing is written to SD. Must not run while a mission is capturing.
+     *
+     * @param frames Number of synthetic frames to produce
+     * @param intervalMs Producer interval (e.g. MISSION_CAPTURE_INTERVAL)
+     * @param writeLatencyMs Simulated time per SD write
+     * @return True if every frame was either written or counted as dropped
+     *         and all slots returned to the free list
+     */
+    static bool runSelfTest(uint16_t frames, uint32_t intervalMs, uint32_t writeLatencyMs);
+};
+
+#endif // CAPTURE_PIPELINE_H
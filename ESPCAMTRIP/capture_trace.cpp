@@ -0,0 +1,210 @@
+#include "capture_trace.h"
+#include "config.h"
+#include "storage_manager.h"
+#include "psram_manager.h"
+#include <algorithm>
+
+// Static member definitions
+TraceRecord* CaptureTrace::ring = nullptr;
+uint32_t* CaptureTrace::scratch = nullptr;
+uint16_t CaptureTrace::ringSize = 0;
+uint32_t CaptureTrace::nextFrame = 1;
+
+static const char* const STAGE_NAMES[TRACE_STAGE_COUNT] = {
+    "fb_get", "analyze", "slot_acquire", "exif", "queue", "exif_thumb", "open",
+    "write", "close", "thumbnail", "metadata", "total"
+};
+
+bool CaptureTrace::init() {
+    if (!Config::trace.enabled || Config::trace.RING_SIZE == 0) {
+        return false;
+    }
+    if (ring) {
+        return true;
+    }
+
+    ring = (TraceRecord*)PSRAM_CALLOC(Config::trace.RING_SIZE, sizeof(TraceRecord));
+    scratch = (uint32_t*)PSRAM_MALLOC(Config::trace.RING_SIZE * sizeof(uint32_t));
+    if (!ring || !scratch) {
+        PSRAM_FREE(ring);
+        PSRAM_FREE(scratch);
+        ring = nullptr;
+        scratch = nullptr;
+        Serial.println("Capture trace disabled: ring allocation failed");
+        return false;
+    }
+    ringSize = Config::trace.RING_SIZE;
+    nextFrame = 1;
+
+    Serial.printf("Capture trace: %u frames (%u KB PSRAM)\n", ringSize,
+                  (unsigned)(ringSize * (sizeof(TraceRecord) + sizeof(uint32_t)) / 1024));
+    return true;
+}
+
+TraceRecord* CaptureTrace::lookup(uint32_t handle) {
+    if (handle == 0 || !ring) {
+        return nullptr;
+    }
+    TraceRecord* r = &ring[handle % ringSize];
+    return r->frame == handle ? r : nullptr; // Overwritten by a newer frame
+}
+
+uint32_t CaptureTrace::begin() {
+    if (!ring) {
+        return 0;
+    }
+    uint32_t handle = nextFrame++;
+    if (nextFrame == 0) {
+        nextFrame = 1;
+    }
+
+    TraceRecord* r = &ring[handle % ringSize];
+    r->photo = TRACE_NO_PHOTO;
+    r->start = micros();
+    r->queued = 0;
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        r->stage[s] = TRACE_NOT_RUN;
+    }
+    r->frame = handle;
+    return handle;
+}
+
+void CaptureTrace::record(uint32_t handle, TraceStage stage, uint32_t startUs) {
+    TraceRecord* r = lookup(handle);
+    if (r) {
+        r->stage[stage] = micros() - startUs;
+    }
+}
+
+void CaptureTrace::setPhoto(uint32_t handle, uint32_t photo) {
+    TraceRecord* r = lookup(handle);
+    if (r) {
+        r->photo = photo;
+    }
+}
+
+void CaptureTrace::markQueued(uint32_t handle) {
+    TraceRecord* r = lookup(handle);
+    if (r) {
+        r->queued = micros();
+    }
+}
+
+void CaptureTrace::markDequeued(uint32_t handle) {
+    TraceRecord* r = lookup(handle);
+    if (r && r->queued) {
+        r->stage[TRACE_QUEUE] = micros() - r->queued;
+    }
+}
+
+void CaptureTrace::finish(uint32_t handle) {
+    TraceRecord* r = lookup(handle);
+    if (r) {
+        r->stage[TRACE_TOTAL] = micros() - r->start;
+    }
+}
+
+bool CaptureTrace::getSummary(TraceStage stage, TraceSummary& summary) {
+    memset(&summary, 0, sizeof(summary));
+    if (!ring) {
+        return false;
+    }
+
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < ringSize; i++) {
+        if (ring[i].frame != 0 && ring[i].stage[stage] != TRACE_NOT_RUN) {
+            scratch[count++] = ring[i].stage[stage];
+        }
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    // Nearest-rank percentiles
+    std::sort(scratch, scratch + count);
+    summary.count = count;
+    summary.p50 = scratch[(count - 1) * 50 / 100];
+    summary.p95 = scratch[(count - 1) * 95 / 100];
+    summary.p99 = scratch[(count - 1) * 99 / 100];
+    summary.max = scratch[count - 1];
+    return true;
+}
+
+const char* CaptureTrace::getStageName(TraceStage stage) {
+    return stage < TRACE_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+void CaptureTrace::printSummary() {
+    Serial.println("\n--- Capture Trace (us) ---");
+    if (!ring) {
+        Serial.println("Tracing disabled");
+        Serial.println("--------------------------\n");
+        return;
+    }
+
+    Serial.printf("%-13s %6s %8s %8s %8s %8s\n", "stage", "frames", "p50", "p95", "p99", "max");
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        TraceSummary summary;
+        if (getSummary((TraceStage)s, summary)) {
+            Serial.printf("%-13s %6u %8u %8u %8u %8u\n", STAGE_NAMES[s], summary.count,
+                          summary.p50, summary.p95, summary.p99, summary.max);
+        }
+    }
+    Serial.println("--------------------------\n");
+}
+
+bool CaptureTrace::dumpCSV(const String& path) {
+    if (!ring) {
+        return false;
+    }
+
+    File file = StorageManager::openFile(path, "w");
+    if (!file) {
+        Serial.println("Failed to create trace file: " + path);
+        return false;
+    }
+
+    file.print("frame,photo,start_us");
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        file.print(",");
+        file.print(STAGE_NAMES[s]);
+    }
+    file.print("\n");
+
+    // Oldest first: the slot after the newest frame
+    uint32_t newest = nextFrame - 1;
+    uint16_t rows = 0;
+    for (uint16_t i = 1; i <= ringSize; i++) {
+        const TraceRecord& r = ring[(newest + i) % ringSize];
+        if (r.frame == 0) {
+            continue;
+        }
+
+        char line[160];
+        int n = snprintf(line, sizeof(line), "%lu,", (unsigned long)r.frame);
+        if (r.photo != TRACE_NO_PHOTO) {
+            n += snprintf(line + n, sizeof(line) - n, "%lu", (unsigned long)r.photo);
+        }
+        n += snprintf(line + n, sizeof(line) - n, ",%lu", (unsigned long)r.start);
+        for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+            if (r.stage[s] == TRACE_NOT_RUN) {
+                n += snprintf(line + n, sizeof(line) - n, ",");
+            } else {
+                n += snprintf(line + n, sizeof(line) - n, ",%lu", (unsigned long)r.stage[s]);
+            }
+        }
+        n += snprintf(line + n, sizeof(line) - n, "\n");
+        file.write((const uint8_t*)line, n);
+        rows++;
+    }
+    StorageManager::closeFile(file);
+
+    Serial.printf("Capture trace: %u frames written to %s\n", rows, path.c_str());
+    return true;
+}
+
+void CaptureTrace::reset() {
+    if (ring) {
+        memset(ring, 0, ringSize * sizeof(TraceRecord));
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef CAPTURE_TRACE_H
+#define CAPTURE_TRACE_H
+
+#include <Arduino.h>
+
+/**
+ * Capture Trace
+ *
+ * Per-frame, per-stage latency of the mission capture path, in
+ * microseconds, kept in a fixed ring of the last RING_SIZE frames.
+ * A frame is followed from the camera task (frame grab, analysis, slot,
+ * EXIF copy) through the SD writer task (queue wait, open, write, close,
+ * thumbnail, metadata) by a handle carried in its CaptureSlot.
+ *
+ * Recording is a micros() call and a few stores into the PSRAM ring: no
+ * Serial, no locking, no heap after init(), so it stays on in flight.
+ * Summaries (p50/p95/p99/max per stage) and the CSV dump run on demand.
+ */
+
+enum TraceStage : uint8_t {
+    TRACE_FB_GET,                // CameraHAL::fbGet (incl. stale frame discard)
+    TRACE_ANALYZE,               // Sharpness score and duplicate check
+    TRACE_SLOT_ACQUIRE,          // Waiting for a free PSRAM ring slot
+    TRACE_EXIF,                  // EXIF update and copy into the slot
+    TRACE_QUEUE,                 // Committed until the writer picks it up
+    TRACE_EXIF_THUMBNAIL,        // EXIF thumbnail extract and encode (optional)
+    TRACE_OPEN,                  // StorageManager::openFile
+    TRACE_WRITE,                 // file.write
+    TRACE_CLOSE,                 // StorageManager::closeFile
+    TRACE_THUMBNAIL,             // DC thumbnail extract and write
+    TRACE_METADATA,              // Mission log append
+    TRACE_TOTAL,                 // Frame request to last stage of a written frame
+    TRACE_STAGE_COUNT
+};
+
+#define TRACE_NOT_RUN 0xFFFFFFFF
+#define TRACE_NO_PHOTO 0xFFFFFFFF
+
+struct TraceRecord {
+    uint32_t frame;              // Handle, 0 = unused
+    uint32_t photo;              // Photo number, TRACE_NO_PHOTO if not written
+    uint32_t start;              // micros() at frame request
+    uint32_t queued;             // micros() at slot commit
+    uint32_t stage[TRACE_STAGE_COUNT]; // us, TRACE_NOT_RUN if skipped
+};
+
+struct TraceSummary {
+    uint16_t count;              // Frames in the ring that ran the stage
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+    uint32_t max;
+};
+
+class CaptureTrace {
+private:
+    static TraceRecord* ring;    // PSRAM
+    static uint32_t* scratch;    // PSRAM, for percentile sorting
+    static uint16_t ringSize;
+    static uint32_t nextFrame;
+
+    static TraceRecord* lookup(uint32_t handle);
+
+public:
+    static bool init();
+    static bool isInitialized() { return ring != nullptr; }
+
+    /**
+     * Start tracing a frame
+     *
+     * @return Handle for the other calls; 0 when tracing is off (all calls
+     *         accept 0 and do nothing)
+     */
+    static uint32_t begin();
+
+    /**
+     * Record a stage as micros() - startUs
+     */
+    static void record(uint32_t handle, TraceStage stage, uint32_t startUs);
+
+    static void setPhoto(uint32_t handle, uint32_t photo);
+    static void markQueued(uint32_t handle);
+    static void markDequeued(uint32_t handle);
+
+    /**
+     * Frame written: records TRACE_TOTAL
+     */
+    static void finish(uint32_t handle);
+
+    /**
+     * Percentiles of one stage over the frames in the ring
+     */
+    static bool getSummary(TraceStage stage, TraceSummary& summary);
+    static const char* getStageName(TraceStage stage);
+    static void printSummary();
+
+    /**
+     * Write the ring, oldest frame first, as CSV (one row per frame,
+     * one column per stage in us, empty when not run)
+     */
+    static bool dumpCSV(const String& path);
+    static void reset();
+};
+
+#endif // CAPTURE_TRACE_H
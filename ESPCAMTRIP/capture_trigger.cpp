@@ -0,0 +1,637 @@
+#include "capture_trigger.h"
+#include "config.h"
+#include "gps_manager.h"
+#include "storage_manager.h"
+#include "system_state.h"
+#include <math.h>
+
+// WGS84 radii of curvature are close enough to a sphere over a survey area
+#define TRIGGER_EARTH_RADIUS_M 6371000.0
+#define TRIGGER_DEG_TO_RAD (M_PI / 180.0)
+
+// Dead reckoning is not trusted beyond this age of the last fix
+#define TRIGGER_MAX_EXTRAPOLATION_MS 1000
+
+DistanceTrigger::DistanceTrigger() :
+    originSet(false), originLat(0.0), originLon(0.0),
+    metersPerDegLat(0.0), metersPerDegLon(0.0),
+    homeSet(false), homeAltitude(0.0),
+    overlapMode(false), distance(5.0), overlap(0.0), tanHalfFov(0.0),
+    minDistance(1.0), minAgl(2.0),
+    estEast(0.0), estNorth(0.0), estValid(false),
+    photoEast(0.0), photoNorth(0.0), photoSet(false) {}
+
+void DistanceTrigger::reset() {
+    originSet = false;
+    estValid = false;
+    photoSet = false;
+}
+
+void DistanceTrigger::setDistance(float meters) {
+    overlapMode = false;
+    distance = meters;
+}
+
+void DistanceTrigger::setOverlap(float forwardOverlap, float alongTrackFovDeg,
+                                 float minDistanceM, float minAglM) {
+    overlapMode = true;
+    overlap = constrain(forwardOverlap, 0.0f, 0.95f);
+    tanHalfFov = tanf(alongTrackFovDeg * 0.5f * (float)TRIGGER_DEG_TO_RAD);
+    minDistance = minDistanceM;
+    minAgl = minAglM;
+}
+
+void DistanceTrigger::setOrigin(double latitude, double longitude) {
+    originLat = latitude;
+    originLon = longitude;
+    metersPerDegLat = TRIGGER_EARTH_RADIUS_M * TRIGGER_DEG_TO_RAD;
+    metersPerDegLon = metersPerDegLat * cos(latitude * TRIGGER_DEG_TO_RAD);
+    originSet = true;
+}
+
+void DistanceTrigger::project(double latitude, double longitude, float* east, float* north) const {
+    *east = (float)((longitude - originLon) * metersPerDegLon);
+    *north = (float)((latitude - originLat) * metersPerDegLat);
+}
+
+bool DistanceTrigger::shouldTrigger(const TriggerFix& fix, uint32_t nowMs) {
+    if (!fix.valid) {
+        estValid = false;
+        return false;
+    }
+
+    if (!originSet) {
+        setOrigin(fix.latitude, fix.longitude);
+    }
+    if (!homeSet) {
+        setHomeAltitude(fix.altitude);
+    }
+
+    // Project the fix, then dead-reckon to now along course over ground
+    project(fix.latitude, fix.longitude, &estEast, &estNorth);
+    uint32_t age = nowMs - fix.fixTime;
+    if (age > TRIGGER_MAX_EXTRAPOLATION_MS) {
+        age = TRIGGER_MAX_EXTRAPOLATION_MS;
+    }
+    float travelled = fix.speed * age / 1000.0f;
+    float course = fix.course * (float)TRIGGER_DEG_TO_RAD;
+    estEast += travelled * sinf(course);
+    estNorth += travelled * cosf(course);
+    estValid = true;
+
+    if (overlapMode) {
+        float agl = fix.altitude - homeAltitude;
+        if (agl < minAgl) {
+            agl = minAgl;
+        }
+        float footprint = 2.0f * agl * tanHalfFov;
+        distance = footprint * (1.0f - overlap);
+        if (distance < minDistance) {
+            distance = minDistance;
+        }
+    }
+
+    if (!photoSet) {
+        return true; // First photo of the run
+    }
+
+    return getDistanceSinceCapture() >= distance;
+}
+
+void DistanceTrigger::recordCapture() {
+    if (!estValid) {
+        return;
+    }
+    photoEast = estEast;
+    photoNorth = estNorth;
+    photoSet = true;
+}
+
+float DistanceTrigger::getDistanceSinceCapture() const {
+    if (!photoSet || !estValid) {
+        return 0.0f;
+    }
+    float dE = estEast - photoEast;
+    float dN = estNorth - photoNorth;
+    return sqrtf(dE * dE + dN * dN);
+}
+
+// Track replay for runTrackTests(): each sentence goes through the GPSManager
+// NMEA parser with a receipt time derived from its fix time, and the trigger
+// is evaluated on capture slots between fixes, the way distanceTriggerDue()
+// sees the live position in flight
+class TrackReplay {
+private:
+    DistanceTrigger& trigger;
+    uint32_t slotMs;
+    bool started;
+    uint32_t firstFixMs;      // UTC time of day of the first epoch
+    uint32_t epochFixMs;      // ... of the current epoch
+    uint32_t nextSlotMs;      // Replay clock (ms since the first epoch)
+    TriggerFix fix;
+    bool haveFix;
+    uint32_t lastFlownMs;
+
+    // hhmmss.ss field of RMC/GGA as ms of the UTC day, or -1 (other sentences)
+    static int32_t sentenceTimeMs(const char* sentence) {
+        if (strlen(sentence) < 7 ||
+            (strncmp(sentence + 3, "RMC", 3) != 0 && strncmp(sentence + 3, "GGA", 3) != 0)) {
+            return -1;
+        }
+        const char* field = strchr(sentence, ',');
+        if (!field || strlen(field + 1) < 6 || field[1] < '0' || field[1] > '9') {
+            return -1;
+        }
+        field++;
+        int hours = (field[0] - '0') * 10 + (field[1] - '0');
+        int minutes = (field[2] - '0') * 10 + (field[3] - '0');
+        float seconds = atof(field + 4);
+        return (hours * 3600 + minutes * 60) * 1000 + (int32_t)lroundf(seconds * 1000.0f);
+    }
+
+    // Replay clock for a fix time; logs may run across midnight UTC
+    uint32_t replayMs(uint32_t fixMs) const {
+        return (fixMs + 86400000u - firstFixMs) % 86400000u;
+    }
+
+    void evaluateUntil(uint32_t endMs) {
+        for (; nextSlotMs < endMs; nextSlotMs += slotMs) {
+            if (haveFix) {
+                float before = trigger.getTriggerDistance();
+                if (trigger.shouldTrigger(fix, nextSlotMs)) {
+                    trigger.recordCapture();
+                    photos++;
+                }
+                spacingSum += (before + trigger.getTriggerDistance()) * 0.5f;
+                spacingSamples++;
+            }
+        }
+    }
+
+public:
+    uint32_t photos;
+    uint32_t fixes;
+    float flownM;             // Integrated from reported ground speed
+    float maxSpeed;           // m/s
+    float spacingSum;         // Trigger distance per evaluated slot, for the mean
+    uint32_t spacingSamples;
+
+    TrackReplay(DistanceTrigger& t, uint32_t slotPeriodMs) :
+        trigger(t), slotMs(slotPeriodMs), started(false), firstFixMs(0), epochFixMs(0),
+        nextSlotMs(0), haveFix(false), lastFlownMs(0), photos(0), fixes(0), flownM(0.0f),
+        maxSpeed(0.0f), spacingSum(0.0f), spacingSamples(0) {
+        memset(&fix, 0, sizeof(fix));
+    }
+
+    void feed(const char* sentence) {
+        int32_t fixMs = sentenceTimeMs(sentence);
+        if (fixMs >= 0) {
+            if (!started) {
+                started = true;
+                firstFixMs = fixMs;
+                epochFixMs = fixMs;
+            } else if ((uint32_t)fixMs != epochFixMs) {
+                // New epoch: slots up to it only see the previous fix
+                evaluateUntil(replayMs(fixMs));
+                epochFixMs = fixMs;
+            }
+        }
+        if (!started) {
+            return;
+        }
+
+        // Receipt after a typical receiver output latency
+        int64_t receivedUs = (int64_t)replayMs(epochFixMs) * 1000 + 40000;
+        GPSManager::replaySentence(sentence, receivedUs);
+
+        // GGA completes the epoch's position (RMC came first with speed and course)
+        if (strncmp(sentence + 3, "GGA", 3) == 0) {
+            GPSPosition pos = GPSManager::getPosition();
+            if (pos.valid) {
+                uint32_t nowMs = replayMs(epochFixMs);
+                if (haveFix) {
+                    flownM += fix.speed * (nowMs - lastFlownMs) / 1000.0f;
+                }
+                lastFlownMs = nowMs;
+                fix = { pos.latitude, pos.longitude, pos.altitude,
+                        pos.speed, pos.course, nowMs, true };
+                haveFix = true;
+                fixes++;
+                if (pos.speed > maxSpeed) {
+                    maxSpeed = pos.speed;
+                }
+            }
+        }
+    }
+
+    // Evaluate the slot at the last epoch
+    void finish() {
+        if (started) {
+            evaluateUntil(replayMs(epochFixMs) + 1);
+        }
+    }
+};
+
+// Straight line at 10 m/s on course 045, 2 Hz fixes, 100 m
+static const char* const TRACK_LINE_NMEA[] = {
+    "$GNRMC,031200.00,A,3347.916600,S,15110.934400,E,19.438,45.00,171026,,,D*68",
+    "$GNGGA,031200.00,3347.916600,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031200.50,A,3347.914692,S,15110.936696,E,19.438,45.00,171026,,,D*6B",
+    "$GNGGA,031200.50,3347.914692,S,15110.936696,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*49",
+    "$GNRMC,031201.00,A,3347.912785,S,15110.938991,E,19.438,45.00,171026,,,D*68",
+    "$GNGGA,031201.00,3347.912785,S,15110.938991,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031201.50,A,3347.910877,S,15110.941287,E,19.438,45.00,171026,,,D*6F",
+    "$GNGGA,031201.50,3347.910877,S,15110.941287,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,031202.00,A,3347.908969,S,15110.943583,E,19.438,45.00,171026,,,D*6F",
+    "$GNGGA,031202.00,3347.908969,S,15110.943583,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,031202.50,A,3347.907061,S,15110.945879,E,19.438,45.00,171026,,,D*6A",
+    "$GNGGA,031202.50,3347.907061,S,15110.945879,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*48",
+    "$GNRMC,031203.00,A,3347.905154,S,15110.948174,E,19.438,45.00,171026,,,D*62",
+    "$GNGGA,031203.00,3347.905154,S,15110.948174,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031203.50,A,3347.903246,S,15110.950470,E,19.438,45.00,171026,,,D*69",
+    "$GNGGA,031203.50,3347.903246,S,15110.950470,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031204.00,A,3347.901338,S,15110.952766,E,19.438,45.00,171026,,,D*67",
+    "$GNGGA,031204.00,3347.901338,S,15110.952766,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*45",
+    "$GNRMC,031204.50,A,3347.899430,S,15110.955062,E,19.438,45.00,171026,,,D*69",
+    "$GNGGA,031204.50,3347.899430,S,15110.955062,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031205.00,A,3347.897523,S,15110.957357,E,19.438,45.00,171026,,,D*67",
+    "$GNGGA,031205.00,3347.897523,S,15110.957357,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*45",
+    "$GNRMC,031205.50,A,3347.895615,S,15110.959653,E,19.438,45.00,171026,,,D*69",
+    "$GNGGA,031205.50,3347.895615,S,15110.959653,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031206.00,A,3347.893707,S,15110.961949,E,19.438,45.00,171026,,,D*64",
+    "$GNGGA,031206.00,3347.893707,S,15110.961949,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*46",
+    "$GNRMC,031206.50,A,3347.891799,S,15110.964245,E,19.438,45.00,171026,,,D*66",
+    "$GNGGA,031206.50,3347.891799,S,15110.964245,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,031207.00,A,3347.889892,S,15110.966540,E,19.438,45.00,171026,,,D*6F",
+    "$GNGGA,031207.00,3347.889892,S,15110.966540,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,031207.50,A,3347.887984,S,15110.968836,E,19.438,45.00,171026,,,D*60",
+    "$GNGGA,031207.50,3347.887984,S,15110.968836,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031208.00,A,3347.886076,S,15110.971132,E,19.438,45.00,171026,,,D*6A",
+    "$GNGGA,031208.00,3347.886076,S,15110.971132,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*48",
+    "$GNRMC,031208.50,A,3347.884168,S,15110.973427,E,19.438,45.00,171026,,,D*60",
+    "$GNGGA,031208.50,3347.884168,S,15110.973427,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031209.00,A,3347.882261,S,15110.975723,E,19.438,45.00,171026,,,D*69",
+    "$GNGGA,031209.00,3347.882261,S,15110.975723,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031209.50,A,3347.880353,S,15110.978019,E,19.438,45.00,171026,,,D*6D",
+    "$GNGGA,031209.50,3347.880353,S,15110.978019,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,031210.00,A,3347.878445,S,15110.980315,E,19.438,45.00,171026,,,D*6F",
+    "$GNGGA,031210.00,3347.878445,S,15110.980315,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+};
+
+// Hover for 30 s with 0.3 m of receiver position noise, 1 Hz fixes
+static const char* const TRACK_HOVER_NMEA[] = {
+    "$GNRMC,031400.00,A,3347.916492,S,15110.934357,E,0.080,45.19,171026,,,D*55",
+    "$GNGGA,031400.00,3347.916492,S,15110.934357,E,4,18,0.61,50.011,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031401.00,A,3347.916584,S,15110.934478,E,0.157,142.87,171026,,,D*62",
+    "$GNGGA,031401.00,3347.916584,S,15110.934478,E,4,18,0.61,50.033,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,031402.00,A,3347.916562,S,15110.934211,E,0.049,39.44,171026,,,D*5C",
+    "$GNGGA,031402.00,3347.916562,S,15110.934211,E,4,18,0.61,50.006,M,22.1,M,1.0,0000*49",
+    "$GNRMC,031403.00,A,3347.916642,S,15110.934264,E,0.118,25.98,171026,,,D*57",
+    "$GNGGA,031403.00,3347.916642,S,15110.934264,E,4,18,0.61,49.959,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031404.00,A,3347.916698,S,15110.934555,E,0.019,176.00,171026,,,D*64",
+    "$GNGGA,031404.00,3347.916698,S,15110.934555,E,4,18,0.61,49.988,M,22.1,M,1.0,0000*49",
+    "$GNRMC,031405.00,A,3347.916730,S,15110.934382,E,0.074,135.75,171026,,,D*64",
+    "$GNGGA,031405.00,3347.916730,S,15110.934382,E,4,18,0.61,49.962,M,22.1,M,1.0,0000*43",
+    "$GNRMC,031406.00,A,3347.916456,S,15110.934514,E,0.026,203.55,171026,,,D*6E",
+    "$GNGGA,031406.00,3347.916456,S,15110.934514,E,4,18,0.61,49.952,M,22.1,M,1.0,0000*49",
+    "$GNRMC,031407.00,A,3347.916451,S,15110.934267,E,0.059,269.52,171026,,,D*68",
+    "$GNGGA,031407.00,3347.916451,S,15110.934267,E,4,18,0.61,50.022,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031408.00,A,3347.916492,S,15110.934277,E,0.077,18.80,171026,,,D*5E",
+    "$GNGGA,031408.00,3347.916492,S,15110.934277,E,4,18,0.61,50.049,M,22.1,M,1.0,0000*46",
+    "$GNRMC,031409.00,A,3347.916752,S,15110.934268,E,0.192,243.60,171026,,,D*66",
+    "$GNGGA,031409.00,3347.916752,S,15110.934268,E,4,18,0.61,49.954,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031410.00,A,3347.916684,S,15110.934454,E,0.133,327.27,171026,,,D*66",
+    "$GNGGA,031410.00,3347.916684,S,15110.934454,E,4,18,0.61,49.994,M,22.1,M,1.0,0000*4C",
+    "$GNRMC,031411.00,A,3347.916483,S,15110.934399,E,0.131,281.12,171026,,,D*6D",
+    "$GNGGA,031411.00,3347.916483,S,15110.934399,E,4,18,0.61,49.950,M,22.1,M,1.0,0000*46",
+    "$GNRMC,031412.00,A,3347.916504,S,15110.934319,E,0.144,78.52,171026,,,D*5A",
+    "$GNGGA,031412.00,3347.916504,S,15110.934319,E,4,18,0.61,49.995,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031413.00,A,3347.916683,S,15110.934494,E,0.083,101.46,171026,,,D*65",
+    "$GNGGA,031413.00,3347.916683,S,15110.934494,E,4,18,0.61,49.971,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,031414.00,A,3347.916544,S,15110.934439,E,0.148,77.25,171026,,,D*5E",
+    "$GNGGA,031414.00,3347.916544,S,15110.934439,E,4,18,0.61,49.963,M,22.1,M,1.0,0000*44",
+    "$GNRMC,031415.00,A,3347.916581,S,15110.934590,E,0.027,136.15,171026,,,D*6B",
+    "$GNGGA,031415.00,3347.916581,S,15110.934590,E,4,18,0.61,49.956,M,22.1,M,1.0,0000*48",
+    "$GNRMC,031416.00,A,3347.916669,S,15110.934488,E,0.108,126.65,171026,,,D*6F",
+    "$GNGGA,031416.00,3347.916669,S,15110.934488,E,4,18,0.61,49.992,M,22.1,M,1.0,0000*4E",
+    "$GNRMC,031417.00,A,3347.916639,S,15110.934512,E,0.160,226.97,171026,,,D*69",
+    "$GNGGA,031417.00,3347.916639,S,15110.934512,E,4,18,0.61,49.998,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031418.00,A,3347.916577,S,15110.934448,E,0.097,324.59,171026,,,D*69",
+    "$GNGGA,031418.00,3347.916577,S,15110.934448,E,4,18,0.61,49.990,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031419.00,A,3347.916648,S,15110.934225,E,0.024,163.52,171026,,,D*68",
+    "$GNGGA,031419.00,3347.916648,S,15110.934225,E,4,18,0.61,49.967,M,22.1,M,1.0,0000*49",
+    "$GNRMC,031420.00,A,3347.916550,S,15110.934564,E,0.113,341.80,171026,,,D*62",
+    "$GNGGA,031420.00,3347.916550,S,15110.934564,E,4,18,0.61,50.042,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,031421.00,A,3347.916460,S,15110.934462,E,0.001,226.98,171026,,,D*6D",
+    "$GNGGA,031421.00,3347.916460,S,15110.934462,E,4,18,0.61,50.047,M,22.1,M,1.0,0000*4C",
+    "$GNRMC,031422.00,A,3347.916744,S,15110.934216,E,0.071,219.68,171026,,,D*6A",
+    "$GNGGA,031422.00,3347.916744,S,15110.934216,E,4,18,0.61,50.015,M,22.1,M,1.0,0000*48",
+    "$GNRMC,031423.00,A,3347.916724,S,15110.934438,E,0.033,257.27,171026,,,D*60",
+    "$GNGGA,031423.00,3347.916724,S,15110.934438,E,4,18,0.61,50.040,M,22.1,M,1.0,0000*45",
+    "$GNRMC,031424.00,A,3347.916495,S,15110.934314,E,0.154,267.11,171026,,,D*61",
+    "$GNGGA,031424.00,3347.916495,S,15110.934314,E,4,18,0.61,50.042,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031425.00,A,3347.916571,S,15110.934559,E,0.190,268.81,171026,,,D*6A",
+    "$GNGGA,031425.00,3347.916571,S,15110.934559,E,4,18,0.61,50.013,M,22.1,M,1.0,0000*41",
+    "$GNRMC,031426.00,A,3347.916489,S,15110.934336,E,0.118,88.15,171026,,,D*51",
+    "$GNGGA,031426.00,3347.916489,S,15110.934336,E,4,18,0.61,49.951,M,22.1,M,1.0,0000*4C",
+    "$GNRMC,031427.00,A,3347.916473,S,15110.934470,E,0.121,39.62,171026,,,D*50",
+    "$GNGGA,031427.00,3347.916473,S,15110.934470,E,4,18,0.61,49.956,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031428.00,A,3347.916752,S,15110.934312,E,0.051,28.17,171026,,,D*58",
+    "$GNGGA,031428.00,3347.916752,S,15110.934312,E,4,18,0.61,49.996,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031429.00,A,3347.916467,S,15110.934304,E,0.175,44.84,171026,,,D*5C",
+    "$GNGGA,031429.00,3347.916467,S,15110.934304,E,4,18,0.61,50.027,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031430.00,A,3347.916462,S,15110.934526,E,0.010,101.72,171026,,,D*6C",
+    "$GNGGA,031430.00,3347.916462,S,15110.934526,E,4,18,0.61,50.026,M,22.1,M,1.0,0000*48",
+};
+
+// 15 m/s on course 270 with 1 Hz fixes, 150 m
+static const char* const TRACK_SPARSE_NMEA[] = {
+    "$GNRMC,031600.00,A,3347.916600,S,15110.934400,E,29.158,270.00,171026,,,D*58",
+    "$GNGGA,031600.00,3347.916600,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4E",
+    "$GNRMC,031601.00,A,3347.916600,S,15110.924660,E,29.158,270.00,171026,,,D*5C",
+    "$GNGGA,031601.00,3347.916600,S,15110.924660,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,031602.00,A,3347.916600,S,15110.914920,E,29.158,270.00,171026,,,D*57",
+    "$GNGGA,031602.00,3347.916600,S,15110.914920,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*41",
+    "$GNRMC,031603.00,A,3347.916600,S,15110.905180,E,29.158,270.00,171026,,,D*54",
+    "$GNGGA,031603.00,3347.916600,S,15110.905180,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,031604.00,A,3347.916600,S,15110.895440,E,29.158,270.00,171026,,,D*52",
+    "$GNGGA,031604.00,3347.916600,S,15110.895440,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,031605.00,A,3347.916600,S,15110.885700,E,29.158,270.00,171026,,,D*55",
+    "$GNGGA,031605.00,3347.916600,S,15110.885700,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*43",
+    "$GNRMC,031606.00,A,3347.916600,S,15110.875960,E,29.158,270.00,171026,,,D*51",
+    "$GNGGA,031606.00,3347.916600,S,15110.875960,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*47",
+    "$GNRMC,031607.00,A,3347.916600,S,15110.866220,E,29.158,270.00,171026,,,D*5D",
+    "$GNGGA,031607.00,3347.916600,S,15110.866220,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031608.00,A,3347.916600,S,15110.856480,E,29.158,270.00,171026,,,D*5D",
+    "$GNGGA,031608.00,3347.916600,S,15110.856480,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,031609.00,A,3347.916600,S,15110.846740,E,29.158,270.00,171026,,,D*52",
+    "$GNGGA,031609.00,3347.916600,S,15110.846740,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,031610.00,A,3347.916600,S,15110.837000,E,29.158,270.00,171026,,,D*5F",
+    "$GNGGA,031610.00,3347.916600,S,15110.837000,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*49",
+};
+
+// 10 m/s due north at 50 m MSL, 1 Hz fixes, 70 m
+static const char* const TRACK_OVERLAP_NMEA[] = {
+    "$GNRMC,031800.00,A,3347.916600,S,15110.934400,E,19.438,0.00,171026,,,D*53",
+    "$GNGGA,031800.00,3347.916600,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031801.00,A,3347.911204,S,15110.934400,E,19.438,0.00,171026,,,D*55",
+    "$GNGGA,031801.00,3347.911204,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*46",
+    "$GNRMC,031802.00,A,3347.905808,S,15110.934400,E,19.438,0.00,171026,,,D*55",
+    "$GNGGA,031802.00,3347.905808,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*46",
+    "$GNRMC,031803.00,A,3347.900412,S,15110.934400,E,19.438,0.00,171026,,,D*56",
+    "$GNGGA,031803.00,3347.900412,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*45",
+    "$GNRMC,031804.00,A,3347.895016,S,15110.934400,E,19.438,0.00,171026,,,D*5C",
+    "$GNGGA,031804.00,3347.895016,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,031805.00,A,3347.889620,S,15110.934400,E,19.438,0.00,171026,,,D*53",
+    "$GNGGA,031805.00,3347.889620,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*40",
+    "$GNRMC,031806.00,A,3347.884224,S,15110.934400,E,19.438,0.00,171026,,,D*5D",
+    "$GNGGA,031806.00,3347.884224,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4E",
+    "$GNRMC,031807.00,A,3347.878828,S,15110.934400,E,19.438,0.00,171026,,,D*59",
+    "$GNGGA,031807.00,3347.878828,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+};
+
+// Fly 100 m east, hover 10 s, fly another 100 m, 1 Hz fixes
+static const char* const TRACK_STOPGO_NMEA[] = {
+    "$GNRMC,032000.00,A,3347.916600,S,15110.934400,E,19.438,90.00,171026,,,D*61",
+    "$GNGGA,032000.00,3347.916600,S,15110.934400,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,032001.00,A,3347.916600,S,15110.940893,E,19.438,90.00,171026,,,D*65",
+    "$GNGGA,032001.00,3347.916600,S,15110.940893,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,032002.00,A,3347.916600,S,15110.947387,E,19.438,90.00,171026,,,D*6F",
+    "$GNGGA,032002.00,3347.916600,S,15110.947387,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*45",
+    "$GNRMC,032003.00,A,3347.916600,S,15110.953880,E,19.438,90.00,171026,,,D*67",
+    "$GNGGA,032003.00,3347.916600,S,15110.953880,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,032004.00,A,3347.916600,S,15110.960373,E,19.438,90.00,171026,,,D*67",
+    "$GNGGA,032004.00,3347.916600,S,15110.960373,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,032005.00,A,3347.916600,S,15110.966867,E,19.438,90.00,171026,,,D*6E",
+    "$GNGGA,032005.00,3347.916600,S,15110.966867,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,032006.00,A,3347.916600,S,15110.973360,E,19.438,90.00,171026,,,D*65",
+    "$GNGGA,032006.00,3347.916600,S,15110.973360,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,032007.00,A,3347.916600,S,15110.979853,E,19.438,90.00,171026,,,D*65",
+    "$GNGGA,032007.00,3347.916600,S,15110.979853,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,032008.00,A,3347.916600,S,15110.986347,E,19.438,90.00,171026,,,D*64",
+    "$GNGGA,032008.00,3347.916600,S,15110.986347,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4E",
+    "$GNRMC,032009.00,A,3347.916600,S,15110.992840,E,19.438,90.00,171026,,,D*6C",
+    "$GNGGA,032009.00,3347.916600,S,15110.992840,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*46",
+    "$GNRMC,032010.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*57",
+    "$GNGGA,032010.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,032011.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*56",
+    "$GNGGA,032011.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4B",
+    "$GNRMC,032012.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*55",
+    "$GNGGA,032012.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*48",
+    "$GNRMC,032013.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*54",
+    "$GNGGA,032013.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*49",
+    "$GNRMC,032014.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*53",
+    "$GNGGA,032014.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4E",
+    "$GNRMC,032015.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*52",
+    "$GNGGA,032015.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4F",
+    "$GNRMC,032016.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*51",
+    "$GNGGA,032016.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4C",
+    "$GNRMC,032017.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*50",
+    "$GNGGA,032017.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,032018.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*5F",
+    "$GNGGA,032018.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,032019.00,A,3347.916600,S,15110.999333,E,0.000,90.00,171026,,,D*5E",
+    "$GNGGA,032019.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*43",
+    "$GNRMC,032020.00,A,3347.916600,S,15110.999333,E,19.438,90.00,171026,,,D*63",
+    "$GNGGA,032020.00,3347.916600,S,15110.999333,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*49",
+    "$GNRMC,032021.00,A,3347.916600,S,15111.005826,E,19.438,90.00,171026,,,D*60",
+    "$GNGGA,032021.00,3347.916600,S,15111.005826,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,032022.00,A,3347.916600,S,15111.012320,E,19.438,90.00,171026,,,D*68",
+    "$GNGGA,032022.00,3347.916600,S,15111.012320,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,032023.00,A,3347.916600,S,15111.018813,E,19.438,90.00,171026,,,D*68",
+    "$GNGGA,032023.00,3347.916600,S,15111.018813,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*42",
+    "$GNRMC,032024.00,A,3347.916600,S,15111.025306,E,19.438,90.00,171026,,,D*6E",
+    "$GNGGA,032024.00,3347.916600,S,15111.025306,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,032025.00,A,3347.916600,S,15111.031800,E,19.438,90.00,171026,,,D*67",
+    "$GNGGA,032025.00,3347.916600,S,15111.031800,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4D",
+    "$GNRMC,032026.00,A,3347.916600,S,15111.038293,E,19.438,90.00,171026,,,D*6D",
+    "$GNGGA,032026.00,3347.916600,S,15111.038293,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*47",
+    "$GNRMC,032027.00,A,3347.916600,S,15111.044786,E,19.438,90.00,171026,,,D*66",
+    "$GNGGA,032027.00,3347.916600,S,15111.044786,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4C",
+    "$GNRMC,032028.00,A,3347.916600,S,15111.051280,E,19.438,90.00,171026,,,D*6E",
+    "$GNGGA,032028.00,3347.916600,S,15111.051280,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*44",
+    "$GNRMC,032029.00,A,3347.916600,S,15111.057773,E,19.438,90.00,171026,,,D*60",
+    "$GNGGA,032029.00,3347.916600,S,15111.057773,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*4A",
+    "$GNRMC,032030.00,A,3347.916600,S,15111.064266,E,19.438,90.00,171026,,,D*69",
+    "$GNGGA,032030.00,3347.916600,S,15111.064266,E,4,18,0.61,50.000,M,22.1,M,1.0,0000*43",
+};
+
+static uint32_t replayTrack(DistanceTrigger& trigger, const char* const* sentences, int count,
+                            uint32_t slotMs) {
+    GPSManager::reset();
+    TrackReplay replay(trigger, slotMs);
+    for (int i = 0; i < count; i++) {
+        replay.feed(sentences[i]);
+    }
+    replay.finish();
+    return replay.photos;
+}
+
+#define TRACK_LENGTH(track) ((int)(sizeof(track) / sizeof(track[0])))
+
+static bool replayTrackFile(const char* path) {
+    DistanceTrigger trigger;
+    if (Config::cameraMode.MISSION_TRIGGER == Config::TRIGGER_OVERLAP) {
+        trigger.setOverlap(Config::cameraMode.TARGET_FORWARD_OVERLAP,
+                           Config::cameraMode.LENS_ALONG_TRACK_FOV_DEG,
+                           Config::cameraMode.MIN_TRIGGER_DISTANCE_M,
+                           Config::cameraMode.MIN_TRIGGER_AGL_M);
+    } else {
+        trigger.setDistance(Config::cameraMode.TRIGGER_DISTANCE_M);
+    }
+
+    File file = StorageManager::openFile(path, "r");
+    if (!file) {
+        Serial.printf("FAIL: Cannot open %s\n", path);
+        return false;
+    }
+
+    // The log is taken to start on the ground: its first fix is the takeoff
+    // altitude, as when the mission is armed before takeoff
+    GPSManager::reset();
+    TrackReplay replay(trigger, Config::cameraMode.MISSION_CAPTURE_INTERVAL);
+    char line[128];
+    uint32_t lines = 0;
+    while (file.available()) {
+        size_t length = file.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[length] = '\0';
+        if (length > 0 && line[length - 1] == '\r') {
+            line[length - 1] = '\0';
+        }
+        if (line[0] == '$') {
+            replay.feed(line);
+            lines++;
+        }
+    }
+    replay.finish();
+    StorageManager::closeFile(file);
+
+    GPSStatistics gpsStats = GPSManager::getStatistics();
+    float meanSpacing = replay.spacingSamples > 0 ? replay.spacingSum / replay.spacingSamples : 0.0f;
+    float taken = replay.photos > 0 ? (float)(replay.photos - 1) : 0.0f;
+
+    // Photos fall on capture slots, so each one is up to a slot's travel late
+    float slotStep = replay.maxSpeed * Config::cameraMode.MISSION_CAPTURE_INTERVAL / 1000.0f;
+    float most = meanSpacing > 0.0f ? replay.flownM / meanSpacing + 1.0f : 0.0f;
+    float fewest = replay.flownM / (meanSpacing + slotStep) - 1.0f;
+
+    Serial.printf("%s: %u sentences, %u fixes, %lu checksum errors\n", path, lines, replay.fixes,
+                  gpsStats.checksumErrors);
+    Serial.printf("Flown %.1f m at a mean spacing of %.2f m: %u photos\n",
+                  replay.flownM, meanSpacing, replay.photos);
+
+    if (replay.fixes == 0 || gpsStats.checksumErrors > 0) {
+        Serial.println("FAIL: Log - no valid fixes or corrupted sentences");
+        return false;
+    }
+    if (taken < fewest || taken > most) {
+        Serial.printf("FAIL: Log - %u photos after the first, expected %.0f-%.0f\n",
+                      (unsigned)taken, fewest, most);
+        return false;
+    }
+    Serial.printf("PASS: Log - %u photos after the first (%.0f-%.0f expected)\n",
+                  (unsigned)taken, fewest, most);
+    return true;
+}
+
+bool DistanceTrigger::runTrackTests(const char* nmeaPath) {
+    Serial.println("\n=== Capture Trigger Track Tests ===");
+    if (SystemState::isCapturing()) {
+        Serial.println("FAIL: Stop capture first (replay replaces the current GPS position)");
+        return false;
+    }
+
+    int passed = 0;
+    int total = 0;
+
+    if (nmeaPath) {
+        total++;
+        if (replayTrackFile(nmeaPath)) {
+            passed++;
+        }
+    } else {
+        // Photos can only be taken on capture slots, so spacing is rounded up to
+        // whole slot steps; the tracks below use spacings that fit the step size
+
+        // 1. Straight line at 10 m/s for 10 s, 100 ms slots: 100 m -> 11 photos
+        {
+            DistanceTrigger trigger;
+            trigger.setDistance(9.9f);
+            uint32_t photos = replayTrack(trigger, TRACK_LINE_NMEA, TRACK_LENGTH(TRACK_LINE_NMEA), 100);
+            total++;
+            if (photos >= 10 && photos <= 12) {
+                passed++;
+                Serial.printf("PASS: Straight line - %u photos for 100 m at 10 m spacing\n", photos);
+            } else {
+                Serial.printf("FAIL: Straight line - %u photos, expected ~11\n", photos);
+            }
+        }
+
+        // 2. Hover with 0.3 m position noise for 30 s: only the first photo
+        {
+            DistanceTrigger trigger;
+            trigger.setDistance(5.0f);
+            uint32_t photos = replayTrack(trigger, TRACK_HOVER_NMEA, TRACK_LENGTH(TRACK_HOVER_NMEA), 100);
+            total++;
+            if (photos == 1) {
+                passed++;
+                Serial.println("PASS: Hover - no redundant photos");
+            } else {
+                Serial.printf("FAIL: Hover - %u photos, expected 1\n", photos);
+            }
+        }
+
+        // 3. Sparse 1 Hz fixes, 10 Hz slots at 15 m/s: dead reckoning keeps 4.5 m
+        //    spacing (~34 photos in 150 m); without it photos would be 15 m apart
+        {
+            DistanceTrigger trigger;
+            trigger.setDistance(4.4f);
+            uint32_t photos = replayTrack(trigger, TRACK_SPARSE_NMEA, TRACK_LENGTH(TRACK_SPARSE_NMEA), 100);
+            total++;
+            if (photos >= 32 && photos <= 35) {
+                passed++;
+                Serial.printf("PASS: Dead reckoning - %u photos with 1 Hz fixes\n", photos);
+            } else {
+                Serial.printf("FAIL: Dead reckoning - %u photos, expected ~34\n", photos);
+            }
+        }
+
+        // 4. Overlap, armed on the ground at 20 m MSL and flying at 50 m: 30 m AGL,
+        //    50 deg FOV, 75% overlap -> 27.98 m footprint, 7.0 m spacing
+        {
+            DistanceTrigger trigger;
+            trigger.setOverlap(0.75f, 50.0f, 1.0f, 2.0f);
+            trigger.setHomeAltitude(20.0f);
+            uint32_t photos = replayTrack(trigger, TRACK_OVERLAP_NMEA, TRACK_LENGTH(TRACK_OVERLAP_NMEA), 100);
+            float spacing = trigger.getTriggerDistance();
+            total++;
+            if (fabsf(spacing - 7.0f) < 0.1f && photos >= 9 && photos <= 11) {
+                passed++;
+                Serial.printf("PASS: Overlap - %.2f m spacing, %u photos over 70 m\n", spacing, photos);
+            } else {
+                Serial.printf("FAIL: Overlap - %.2f m spacing (expected 7.0), %u photos\n", spacing, photos);
+            }
+        }
+
+        // 5. Stop-and-go: fly 100 m, hover 10 s, fly 100 m -> ~21 photos, none while hovering
+        {
+            DistanceTrigger trigger;
+            trigger.setDistance(9.9f);
+            uint32_t photos = replayTrack(trigger, TRACK_STOPGO_NMEA, TRACK_LENGTH(TRACK_STOPGO_NMEA), 100);
+            total++;
+            if (photos >= 19 && photos <= 22) {
+                passed++;
+                Serial.printf("PASS: Stop-and-go - %u photos for 200 m flown\n", photos);
+            } else {
+                Serial.printf("FAIL: Stop-and-go - %u photos, expected ~21\n", photos);
+            }
+        }
+    }
+
+    // Live receiver data repopulates the position
+    GPSManager::reset();
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
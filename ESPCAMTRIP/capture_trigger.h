@@ -0,0 +1,117 @@
+#ifndef CAPTURE_TRIGGER_H
+#define CAPTURE_TRIGGER_H
+
+#include <Arduino.h>
+
+/**
+ * Distance-based Capture Trigger
+ *
+ * Fires a mission capture once the aircraft has moved a set ground distance
+ * since the previous photo, instead of on a fixed timer.
+ *
+ * - Positions are projected into a local ENU plane (metres) anchored at the
+ *   first fix, so each evaluation is a few multiplies instead of a haversine
+ * - Between GPS fixes the position is dead-reckoned from ground speed and
+ *   course, so a 1-5 Hz receiver can still drive a faster trigger
+ * - Overlap mode derives the spacing from target forward overlap, height
+ *   above the takeoff point and the lens along-track field of view
+ *
+ * The class holds no global state and only uses GPS values passed in, so
+ * NMEA tracks can be replayed through it (see runTrackTests()).
+ */
+
+// Minimal fix passed to the trigger (filled from GPSPosition)
+struct TriggerFix {
+    double latitude;        // Degrees
+    double longitude;       // Degrees
+    float altitude;         // Meters MSL
+    float speed;            // Ground speed (m/s)
+    float course;           // Course over ground (degrees)
+    uint32_t fixTime;       // millis() when the fix was received
+    bool valid;
+};
+
+class DistanceTrigger {
+private:
+    // Local ENU origin
+    bool originSet;
+    double originLat;
+    double originLon;
+    double metersPerDegLat;
+    double metersPerDegLon;
+
+    // Takeoff reference for AGL (set when the mission is armed, kept across reset())
+    bool homeSet;
+    float homeAltitude;
+
+    // Spacing
+    bool overlapMode;
+    float distance;          // Fixed spacing or overlap-derived spacing (m)
+    float overlap;
+    float tanHalfFov;
+    float minDistance;
+    float minAgl;
+
+    // Last evaluated estimate and last photo position (ENU metres)
+    float estEast;
+    float estNorth;
+    bool estValid;
+    float photoEast;
+    float photoNorth;
+    bool photoSet;
+
+    void setOrigin(double latitude, double longitude);
+    void project(double latitude, double longitude, float* east, float* north) const;
+
+public:
+    DistanceTrigger();
+
+    /**
+     * Forget the ENU origin and last photo (start of a new capture run)
+     * The takeoff altitude is kept.
+     */
+    void reset();
+
+    /**
+     * Fixed spacing between photos
+     */
+    void setDistance(float meters);
+
+    /**
+     * Spacing = footprint * (1 - overlap), footprint = 2 * AGL * tan(fov / 2)
+     */
+    void setOverlap(float forwardOverlap, float alongTrackFovDeg, float minDistanceM, float minAglM);
+
+    /**
+     * Takeoff altitude for AGL, taken when the mission is armed. Until one is
+     * set, the first valid fix evaluated after clearHomeAltitude() is used.
+     */
+    void setHomeAltitude(float altitude) { homeAltitude = altitude; homeSet = true; }
+    void clearHomeAltitude() { homeSet = false; }
+    bool hasHomeAltitude() const { return homeSet; }
+    float getHomeAltitude() const { return homeAltitude; }
+
+    /**
+     * Evaluate at time nowMs; true when the estimated position is at least
+     * the trigger distance from the last photo (or no photo taken yet)
+     */
+    bool shouldTrigger(const TriggerFix& fix, uint32_t nowMs);
+
+    /**
+     * Record that a photo was taken at the last evaluated position
+     */
+    void recordCapture();
+
+    float getTriggerDistance() const { return distance; }
+    float getDistanceSinceCapture() const;
+
+    /**
+     * Replay NMEA tracks through the GPSManager parser and the trigger and
+     * check photo spacing. Without a path, the built-in tracks (straight
+     * line, hover, sparse fixes, overlap, stop-and-go) are used; with one,
+     * a receiver log on the SD card is replayed with the configured trigger.
+     */
+    static bool runTrackTests(const char* nmeaPath = nullptr);
+};
+
+#endif // CAPTURE_TRIGGER_H
@@ -41,6 +41,16 @@ namespace Config {
   UploadConfig upload;
   CameraConfig camera;
   CameraModeConfig cameraMode;
+  PipelineConfig pipeline;
+  BurstConfig burst;
+  SharpnessConfig sharpness;
+  DuplicateFilterConfig dedup;
+  ThumbnailConfig thumbnail;
+  TraceConfig trace;
+  MissionLogConfig missionLog;
+  ReplayConfig replay;
+  MissionTagConfig missionTags;
+  PreviewConfig preview;
   AprilTagConfig apriltag;
 
   bool loadFromFile() {
@@ -178,6 +188,12 @@ namespace Config {
         if (!uploadObj["DELETE_AFTER_UPLOAD"].isNull()) {
             upload.DELETE_AFTER_UPLOAD = uploadObj["DELETE_AFTER_UPLOAD"].as<bool>();
         }
+        if (!uploadObj["PREVIEW_FIRST"].isNull()) {
+            upload.PREVIEW_FIRST = uploadObj["PREVIEW_FIRST"].as<bool>();
+        }
+        if (!uploadObj["PREVIEW_QUALITY"].isNull()) {
+            upload.PREVIEW_QUALITY = uploadObj["PREVIEW_QUALITY"].as<uint8_t>();
+        }
     }
 
     // Load CameraConfig settings
@@ -189,6 +205,246 @@ namespace Config {
         if (!cameraObj["FRAME_SIZE"].isNull()) {
             camera.FRAME_SIZE = (framesize_t)cameraObj["FRAME_SIZE"].as<int>();
         }
+        if (!cameraObj["LOW_LIGHT_PROFILE"].isNull()) {
+            camera.LOW_LIGHT_PROFILE = cameraObj["LOW_LIGHT_PROFILE"].as<bool>();
+        }
+    }
+
+    // Load CameraModeConfig trigger settings
+    if (!doc["camera_mode"].isNull()) {
+        JsonObject modeObj = doc["camera_mode"].as<JsonObject>();
+        if (!modeObj["MISSION_TRIGGER"].isNull()) {
+            cameraMode.MISSION_TRIGGER = (CaptureTrigger)modeObj["MISSION_TRIGGER"].as<int>();
+        }
+        if (!modeObj["TRIGGER_DISTANCE_M"].isNull()) {
+            cameraMode.TRIGGER_DISTANCE_M = modeObj["TRIGGER_DISTANCE_M"].as<float>();
+        }
+        if (!modeObj["TARGET_FORWARD_OVERLAP"].isNull()) {
+            cameraMode.TARGET_FORWARD_OVERLAP = modeObj["TARGET_FORWARD_OVERLAP"].as<float>();
+        }
+        if (!modeObj["LENS_ALONG_TRACK_FOV_DEG"].isNull()) {
+            cameraMode.LENS_ALONG_TRACK_FOV_DEG = modeObj["LENS_ALONG_TRACK_FOV_DEG"].as<float>();
+        }
+        if (!modeObj["TRIGGER_MAX_INTERVAL_MS"].isNull()) {
+            cameraMode.TRIGGER_MAX_INTERVAL_MS = modeObj["TRIGGER_MAX_INTERVAL_MS"].as<uint32_t>();
+        }
+        if (!modeObj["QUALITY_CONTROL_ENABLED"].isNull()) {
+            cameraMode.QUALITY_CONTROL_ENABLED = modeObj["QUALITY_CONTROL_ENABLED"].as<bool>();
+        }
+        if (!modeObj["TARGET_BYTES_PER_SECOND"].isNull()) {
+            cameraMode.TARGET_BYTES_PER_SECOND = modeObj["TARGET_BYTES_PER_SECOND"].as<uint32_t>();
+        }
+        if (!modeObj["TARGET_BYTES_PER_FRAME"].isNull()) {
+            cameraMode.TARGET_BYTES_PER_FRAME = modeObj["TARGET_BYTES_PER_FRAME"].as<uint32_t>();
+        }
+        if (!modeObj["QUALITY_MIN"].isNull()) {
+            cameraMode.QUALITY_MIN = modeObj["QUALITY_MIN"].as<uint8_t>();
+        }
+        if (!modeObj["QUALITY_MAX"].isNull()) {
+            cameraMode.QUALITY_MAX = modeObj["QUALITY_MAX"].as<uint8_t>();
+        }
+        if (!modeObj["QUALITY_HYSTERESIS"].isNull()) {
+            cameraMode.QUALITY_HYSTERESIS = modeObj["QUALITY_HYSTERESIS"].as<float>();
+        }
+        if (!modeObj["WRITE_BUDGET_FRACTION"].isNull()) {
+            cameraMode.WRITE_BUDGET_FRACTION = modeObj["WRITE_BUDGET_FRACTION"].as<float>();
+        }
+    }
+
+    // Load PipelineConfig settings
+    if (!doc["pipeline"].isNull()) {
+        JsonObject pipelineObj = doc["pipeline"].as<JsonObject>();
+        if (!pipelineObj["enabled"].isNull()) {
+            pipeline.enabled = pipelineObj["enabled"].as<bool>();
+        }
+        if (!pipelineObj["SLOT_COUNT"].isNull()) {
+            pipeline.SLOT_COUNT = pipelineObj["SLOT_COUNT"].as<uint8_t>();
+        }
+        if (!pipelineObj["ACQUIRE_TIMEOUT_MS"].isNull()) {
+            pipeline.ACQUIRE_TIMEOUT_MS = pipelineObj["ACQUIRE_TIMEOUT_MS"].as<uint32_t>();
+        }
+    }
+
+    // Load BurstConfig settings
+    if (!doc["burst"].isNull()) {
+        JsonObject burstObj = doc["burst"].as<JsonObject>();
+        if (!burstObj["enabled"].isNull()) {
+            burst.enabled = burstObj["enabled"].as<bool>();
+        }
+        if (!burstObj["FRAMES"].isNull()) {
+            burst.FRAMES = burstObj["FRAMES"].as<uint8_t>();
+        }
+        if (!burstObj["MAX_ARENA_SIZE"].isNull()) {
+            burst.MAX_ARENA_SIZE = burstObj["MAX_ARENA_SIZE"].as<size_t>();
+        }
+    }
+
+    // Load SharpnessConfig settings
+    if (!doc["sharpness"].isNull()) {
+        JsonObject sharpObj = doc["sharpness"].as<JsonObject>();
+        if (!sharpObj["enabled"].isNull()) {
+            sharpness.enabled = sharpObj["enabled"].as<bool>();
+        }
+        if (!sharpObj["DROP_BLURRED"].isNull()) {
+            sharpness.DROP_BLURRED = sharpObj["DROP_BLURRED"].as<bool>();
+        }
+        if (!sharpObj["THRESHOLD"].isNull()) {
+            sharpness.THRESHOLD = sharpObj["THRESHOLD"].as<uint16_t>();
+        }
+        if (!sharpObj["MCU_STRIDE"].isNull()) {
+            sharpness.MCU_STRIDE = sharpObj["MCU_STRIDE"].as<uint8_t>();
+        }
+        if (!sharpObj["DECODE_BUDGET_US"].isNull()) {
+            sharpness.DECODE_BUDGET_US = sharpObj["DECODE_BUDGET_US"].as<uint32_t>();
+        }
+    }
+
+    // Load DuplicateFilterConfig settings
+    if (!doc["dedup"].isNull()) {
+        JsonObject dedupObj = doc["dedup"].as<JsonObject>();
+        if (!dedupObj["enabled"].isNull()) {
+            dedup.enabled = dedupObj["enabled"].as<bool>();
+        }
+        if (!dedupObj["HAMMING_THRESHOLD"].isNull()) {
+            dedup.HAMMING_THRESHOLD = dedupObj["HAMMING_THRESHOLD"].as<uint8_t>();
+        }
+        if (!dedupObj["STATIONARY_SPEED_MS"].isNull()) {
+            dedup.STATIONARY_SPEED_MS = dedupObj["STATIONARY_SPEED_MS"].as<float>();
+        }
+        if (!dedupObj["MAX_SKIP_MS"].isNull()) {
+            dedup.MAX_SKIP_MS = dedupObj["MAX_SKIP_MS"].as<uint32_t>();
+        }
+        if (!dedupObj["LOG_DECISIONS"].isNull()) {
+            dedup.LOG_DECISIONS = dedupObj["LOG_DECISIONS"].as<bool>();
+        }
+    }
+
+    // Load ThumbnailConfig settings
+    if (!doc["thumbnail"].isNull()) {
+        JsonObject thumbObj = doc["thumbnail"].as<JsonObject>();
+        if (!thumbObj["enabled"].isNull()) {
+            thumbnail.enabled = thumbObj["enabled"].as<bool>();
+        }
+        if (!thumbObj["RGB"].isNull()) {
+            thumbnail.RGB = thumbObj["RGB"].as<bool>();
+        }
+        if (!thumbObj["EXIF"].isNull()) {
+            thumbnail.EXIF = thumbObj["EXIF"].as<bool>();
+        }
+        if (!thumbObj["EXIF_QUALITY"].isNull()) {
+            thumbnail.EXIF_QUALITY = thumbObj["EXIF_QUALITY"].as<uint8_t>();
+        }
+        if (!thumbObj["EXIF_BUDGET_MS"].isNull()) {
+            thumbnail.EXIF_BUDGET_MS = thumbObj["EXIF_BUDGET_MS"].as<uint16_t>();
+        }
+    }
+
+    // Load TraceConfig settings
+    if (!doc["trace"].isNull()) {
+        JsonObject traceObj = doc["trace"].as<JsonObject>();
+        if (!traceObj["enabled"].isNull()) {
+            trace.enabled = traceObj["enabled"].as<bool>();
+        }
+        if (!traceObj["RING_SIZE"].isNull()) {
+            trace.RING_SIZE = traceObj["RING_SIZE"].as<uint16_t>();
+        }
+    }
+
+    // Load GPSConfig frame position settings
+    if (!doc["gps"].isNull()) {
+        JsonObject gpsObj = doc["gps"].as<JsonObject>();
+        if (!gpsObj["FIX_OUTPUT_LATENCY_US"].isNull()) {
+            gps.FIX_OUTPUT_LATENCY_US = gpsObj["FIX_OUTPUT_LATENCY_US"].as<uint32_t>();
+        }
+        if (!gpsObj["MAX_FIX_GAP_MS"].isNull()) {
+            gps.MAX_FIX_GAP_MS = gpsObj["MAX_FIX_GAP_MS"].as<uint32_t>();
+        }
+        if (!gpsObj["MAX_EXTRAPOLATION_MS"].isNull()) {
+            gps.MAX_EXTRAPOLATION_MS = gpsObj["MAX_EXTRAPOLATION_MS"].as<uint32_t>();
+        }
+    }
+
+    // Load MissionLogConfig settings
+    if (!doc["mission_log"].isNull()) {
+        JsonObject logObj = doc["mission_log"].as<JsonObject>();
+        if (!logObj["FLUSH_RECORDS"].isNull()) {
+            missionLog.FLUSH_RECORDS = logObj["FLUSH_RECORDS"].as<uint8_t>();
+        }
+        if (!logObj["FLUSH_INTERVAL_MS"].isNull()) {
+            missionLog.FLUSH_INTERVAL_MS = logObj["FLUSH_INTERVAL_MS"].as<uint32_t>();
+        }
+        if (!logObj["MANIFEST"].isNull()) {
+            missionLog.MANIFEST = logObj["MANIFEST"].as<bool>();
+        }
+    }
+
+    // Load ReplayConfig settings
+    if (!doc["replay"].isNull()) {
+        JsonObject replayObj = doc["replay"].as<JsonObject>();
+        if (!replayObj["enabled"].isNull()) {
+            replay.enabled = replayObj["enabled"].as<bool>();
+        }
+        if (!replayObj["DIRECTORY"].isNull()) {
+            replay.DIRECTORY = replayObj["DIRECTORY"].as<String>();
+        }
+        if (!replayObj["INTERVAL_MS"].isNull()) {
+            replay.INTERVAL_MS = replayObj["INTERVAL_MS"].as<uint32_t>();
+        }
+        if (!replayObj["LATENCY_US"].isNull()) {
+            replay.LATENCY_US = replayObj["LATENCY_US"].as<uint32_t>();
+        }
+        if (!replayObj["JITTER_US"].isNull()) {
+            replay.JITTER_US = replayObj["JITTER_US"].as<uint32_t>();
+        }
+        if (!replayObj["LOOP"].isNull()) {
+            replay.LOOP = replayObj["LOOP"].as<bool>();
+        }
+    }
+
+    // Load MissionTagConfig settings
+    if (!doc["mission_tags"].isNull()) {
+        JsonObject tagsObj = doc["mission_tags"].as<JsonObject>();
+        if (!tagsObj["enabled"].isNull()) {
+            missionTags.enabled = tagsObj["enabled"].as<bool>();
+        }
+        if (!tagsObj["EVERY_N_FRAMES"].isNull()) {
+            missionTags.EVERY_N_FRAMES = tagsObj["EVERY_N_FRAMES"].as<uint8_t>();
+        }
+        if (!tagsObj["SCALE"].isNull()) {
+            missionTags.SCALE = tagsObj["SCALE"].as<uint8_t>();
+        }
+        if (!tagsObj["CPU_BUDGET_PCT"].isNull()) {
+            missionTags.CPU_BUDGET_PCT = tagsObj["CPU_BUDGET_PCT"].as<uint8_t>();
+        }
+        if (!tagsObj["BUDGET_WINDOW_MS"].isNull()) {
+            missionTags.BUDGET_WINDOW_MS = tagsObj["BUDGET_WINDOW_MS"].as<uint32_t>();
+        }
+        if (!tagsObj["MAX_LATENCY_MS"].isNull()) {
+            missionTags.MAX_LATENCY_MS = tagsObj["MAX_LATENCY_MS"].as<uint32_t>();
+        }
+    }
+
+    // Load PreviewConfig settings
+    if (!doc["preview"].isNull()) {
+        JsonObject previewObj = doc["preview"].as<JsonObject>();
+        if (!previewObj["enabled"].isNull()) {
+            preview.enabled = previewObj["enabled"].as<bool>();
+        }
+        if (!previewObj["PORT"].isNull()) {
+            preview.PORT = previewObj["PORT"].as<uint16_t>();
+        }
+        if (!previewObj["MAX_CLIENTS"].isNull()) {
+            preview.MAX_CLIENTS = previewObj["MAX_CLIENTS"].as<uint8_t>();
+        }
+        if (!previewObj["MAX_FPS"].isNull()) {
+            preview.MAX_FPS = previewObj["MAX_FPS"].as<float>();
+        }
+        if (!previewObj["CHUNK_SIZE"].isNull()) {
+            preview.CHUNK_SIZE = previewObj["CHUNK_SIZE"].as<uint16_t>();
+        }
+        if (!previewObj["SEND_TIMEOUT_MS"].isNull()) {
+            preview.SEND_TIMEOUT_MS = previewObj["SEND_TIMEOUT_MS"].as<uint32_t>();
+        }
     }
 
     Serial.println("Configuration loaded from file");
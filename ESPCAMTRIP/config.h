@@ -49,6 +49,9 @@ namespace Config {
     const uint8_t MIN_SATELLITES = 4;      // Minimum satellites for valid fix
     bool enable_geotagging = true;         // Add GPS data to photos
     bool debug_output = false;             // Enable GPS debug messages
+    uint32_t FIX_OUTPUT_LATENCY_US = 0;    // Receiver fix epoch to first NMEA byte (measure against PPS)
+    uint32_t MAX_FIX_GAP_MS = 1000;        // Fixes further apart are not interpolated across
+    uint32_t MAX_EXTRAPOLATION_MS = 500;   // Max projection past a fix for frame positions
   };
 
   // MAVLink Configuration
@@ -143,6 +146,8 @@ namespace Config {
   struct UploadConfig {
     bool AUTO_UPLOAD = false;  // Auto upload every hour
     bool DELETE_AFTER_UPLOAD = false; // Delete immediately after upload
+    bool PREVIEW_FIRST = true;  // Upload requantized previews of all pending photos before full size
+    uint8_t PREVIEW_QUALITY = 30; // Preview JPEG quality, IJG scale (1-100, higher = larger)
   };
   
   // Camera Configuration
@@ -150,6 +155,7 @@ namespace Config {
     uint8_t JPEG_QUALITY = 10;  // 0-63, lower is better quality
     framesize_t FRAME_SIZE = FRAMESIZE_UXGA; // 1600x1200
     const uint32_t XCLK_FREQ = 20000000; // 20MHz
+    bool LOW_LIGHT_PROFILE = false; // Mission photos use the low-light sensor profile
   };
 
   // Camera Mode Configuration
@@ -159,6 +165,13 @@ namespace Config {
     CAMERA_MODE_IDLE
   };
 
+  // Mission capture trigger
+  enum CaptureTrigger {
+    TRIGGER_TIME,           // Fixed MISSION_CAPTURE_INTERVAL
+    TRIGGER_DISTANCE,       // Every TRIGGER_DISTANCE_M of ground track
+    TRIGGER_OVERLAP         // Distance derived from forward overlap, AGL and lens FOV
+  };
+
   struct CameraModeConfig {
     // Mission Mode (Gutter Scanning)
     framesize_t MISSION_FRAME_SIZE = FRAMESIZE_UXGA;      // 1600x1200
@@ -175,6 +188,124 @@ namespace Config {
     // Mode switching
     CameraMode current_mode = CAMERA_MODE_MISSION;
     bool auto_switch_enabled = true;
+
+    // Fast mode switching: keep the driver alive and reconfigure the sensor
+    // in place when pixel formats match (frame buffers sized for both modes)
+    bool FAST_SWITCH_ENABLED = true;
+    uint8_t FAST_SWITCH_FB_COUNT = 2;                    // Frame buffers kept across switches (same-format modes only)
+
+    // Mission trigger (MISSION_CAPTURE_INTERVAL becomes the maximum rate)
+    CaptureTrigger MISSION_TRIGGER = TRIGGER_TIME;
+    float TRIGGER_DISTANCE_M = 5.0;                      // TRIGGER_DISTANCE spacing
+    float TARGET_FORWARD_OVERLAP = 0.75;                 // TRIGGER_OVERLAP: 0.0-0.95
+    float LENS_ALONG_TRACK_FOV_DEG = 50.0;               // Vertical FOV with camera top facing forward
+    float MIN_TRIGGER_DISTANCE_M = 1.0;                  // Floor for overlap-derived spacing
+    float MIN_TRIGGER_AGL_M = 2.0;                       // AGL floor for footprint calculation
+    uint32_t TRIGGER_MAX_INTERVAL_MS = 10000;            // Capture anyway after this long (0 = never)
+
+    // Mission JPEG rate control: quality steered to hold a byte budget
+    bool QUALITY_CONTROL_ENABLED = true;
+    uint32_t TARGET_BYTES_PER_SECOND = 1000 * 1024;      // 0 = use TARGET_BYTES_PER_FRAME
+    uint32_t TARGET_BYTES_PER_FRAME = 200 * 1024;
+    uint8_t QUALITY_MIN = 10;                            // Best quality the controller may use
+    uint8_t QUALITY_MAX = 30;                            // Worst quality the controller may use
+    float QUALITY_HYSTERESIS = 0.10;                     // Band around the target (fraction)
+    float WRITE_BUDGET_FRACTION = 0.6;                   // Share of the interval SD writes may take
+  };
+
+  // Capture Pipeline Configuration (PSRAM frame ring + SD writer task)
+  struct PipelineConfig {
+    bool enabled = true;                     // Decouple camera capture from SD writes
+    uint8_t SLOT_COUNT = 4;                  // Frames buffered in PSRAM
+    const size_t SLOT_SIZE = 512 * 1024;     // Max JPEG + EXIF per slot (UXGA q10 is 200-400KB)
+    uint32_t ACQUIRE_TIMEOUT_MS = 20;        // Producer wait for a free slot before dropping
+    const uint32_t WRITER_STACK_SIZE = 8192;
+    const uint8_t WRITER_PRIORITY = 2;
+    const uint8_t WRITER_CORE = 1;           // Keep SD writes off the camera core
+  };
+
+  // Burst Capture Configuration (PSRAM staging, flushed after the burst)
+  struct BurstConfig {
+    bool enabled = true;
+    uint8_t FRAMES = 10;                     // Frames per burst (max BURST_MAX_FRAMES)
+    size_t MAX_ARENA_SIZE = 3 * 1024 * 1024; // Upper bound for the staging arena
+    size_t PSRAM_RESERVE = 1536 * 1024;      // Left free for camera re-init and AprilTag
+  };
+
+  // Sharpness Gate Configuration (blur check on JPEG coefficients before write)
+  struct SharpnessConfig {
+    bool enabled = true;
+    bool DROP_BLURRED = false;               // false = keep blurred frames, marked in metadata
+    uint16_t THRESHOLD = 150;                // Weaker axis detail (u or v >= 2) share of luma AC energy (per mille)
+    uint8_t MCU_STRIDE = 4;                  // Score every Nth MCU of every Nth MCU row
+    uint32_t DECODE_BUDGET_US = 40000;       // Stop decoding and score what was seen
+  };
+
+  // Stationary Duplicate Filter Configuration
+  struct DuplicateFilterConfig {
+    bool enabled = true;
+    uint8_t HAMMING_THRESHOLD = 6;           // dHash bits (of 64) below which frames are duplicates
+    float STATIONARY_SPEED_MS = 0.5;         // GPS ground speed treated as stationary (m/s)
+    uint32_t MAX_SKIP_MS = 10000;            // Keep a frame at least this often while skipping
+    bool LOG_DECISIONS = true;               // Write dedup.csv in the capture directory
+  };
+
+  // DC Thumbnail Configuration
+  struct ThumbnailConfig {
+    bool enabled = true;                     // Write <photo>_thumb.pgm/.ppm next to each photo
+    bool RGB = false;                        // false = grayscale PGM, true = RGB PPM (3x size); also EXIF thumbnail colour
+    bool EXIF = false;                       // Embed a JPEG thumbnail in each geotagged photo's EXIF (IFD1)
+    uint8_t EXIF_QUALITY = 70;               // JPEG quality of the EXIF thumbnail
+    uint16_t EXIF_BUDGET_MS = 40;            // Skip the EXIF thumbnail when its extract takes longer
+  };
+
+  // Capture Latency Trace Configuration
+  struct TraceConfig {
+    bool enabled = true;                     // Per-stage timing ring (cheap enough for flight)
+    uint16_t RING_SIZE = 256;                // Frames kept (~60 bytes each, PSRAM)
+  };
+
+  // Camera Replay Configuration (recorded frames instead of the sensor)
+  struct ReplayConfig {
+    bool enabled = false;                    // Serve frames from DIRECTORY instead of the camera
+    String DIRECTORY = "/sdcard/replay";     // .jpg/.pgm frames; the SD card is mounted at /sdcard
+    uint32_t INTERVAL_MS = 0;                // Frame period, 0 = a frame on every request
+    uint32_t LATENCY_US = 0;                 // Added to every frame request
+    uint32_t JITTER_US = 0;                  // Random extra latency, 0..JITTER_US
+    bool LOOP = true;                        // Start over after the last frame
+  };
+
+  // Mission Log Configuration
+  struct MissionLogConfig {
+    uint8_t FLUSH_RECORDS = 8;               // Records buffered before a write (max 16)
+    uint32_t FLUSH_INTERVAL_MS = 5000;       // Max age of buffered records at an append
+    bool MANIFEST = true;                    // Also write manifest.geojson per directory
+  };
+
+  // Mission AprilTag Scan Configuration (tags in mapping frames, off the capture path)
+  struct MissionTagConfig {
+    bool enabled = false;                    // Also needs apriltag.enabled (detector)
+    uint8_t EVERY_N_FRAMES = 5;              // Scan one mission frame in N
+    uint8_t SCALE = 4;                       // Luma decode scale: 4 (400x300 UXGA) or 8
+    uint8_t CPU_BUDGET_PCT = 25;             // Max scanner share of one core
+    uint32_t BUDGET_WINDOW_MS = 5000;        // Averaging window for the CPU budget
+    uint32_t MAX_LATENCY_MS = 1000;          // Older detections are not sent as LANDING_TARGET
+    const uint32_t STACK_SIZE = 16384;       // Detector recursion (union-find, quads)
+    const uint8_t PRIORITY = 1;              // Below the SD writer
+    const uint8_t CORE = 1;
+  };
+
+  // Live Preview Configuration (MJPEG over HTTP, frames shared with the capture ring)
+  struct PreviewConfig {
+    bool enabled = false;
+    uint16_t PORT = 81;
+    uint8_t MAX_CLIENTS = 2;                 // Further connections get 503 (max PREVIEW_MAX_CLIENTS)
+    float MAX_FPS = 2.0;                     // Per client; mission frames are 200-400KB
+    uint16_t CHUNK_SIZE = 4096;              // Bytes per client turn (clients are served round-robin)
+    uint32_t SEND_TIMEOUT_MS = 2000;         // Drop a client that stops accepting data
+    const uint32_t STACK_SIZE = 4096;
+    const uint8_t PRIORITY = 1;              // Below CameraTask on the same core
+    const uint8_t CORE = 0;
   };
 
   // AprilTag Configuration
@@ -214,6 +345,16 @@ namespace Config {
   extern UploadConfig upload;
   extern CameraConfig camera;
   extern CameraModeConfig cameraMode;
+  extern PipelineConfig pipeline;
+  extern BurstConfig burst;
+  extern SharpnessConfig sharpness;
+  extern DuplicateFilterConfig dedup;
+  extern ThumbnailConfig thumbnail;
+  extern TraceConfig trace;
+  extern MissionLogConfig missionLog;
+  extern ReplayConfig replay;
+  extern MissionTagConfig missionTags;
+  extern PreviewConfig preview;
   extern AprilTagConfig apriltag;
   
   // Configuration file functions
@@ -0,0 +1,97 @@
+#include "dc_thumbnail.h"
+#include <string.h>
+
+// Baseline JPEG allows sampling factors 1-4
+#define DC_THUMB_MAX_SAMPLING 4
+
+static inline uint8_t clampLevel(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+// Block mean from its quantized DC: DC * q / 8, level shifted (libjpeg DESCALE)
+static inline uint8_t dcLevel(int16_t dc, uint16_t q) {
+    return clampLevel((((int32_t)dc * q + 4) >> 3) + 128);
+}
+
+bool DCThumbnail::extract(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                          bool rgb, uint8_t* out, size_t outSize, DCThumbnailInfo& info) {
+    memset(&info, 0, sizeof(info));
+    if (!decoder.begin(jpeg, length)) {
+        return false;
+    }
+
+    const JpegInfo& ji = decoder.getInfo();
+    bool interleaved = decoder.getBlockCount() > 1;
+    if (!interleaved && decoder.getBlockComponent(0) != 0) {
+        return false; // First scan is not luma
+    }
+
+    info.width = (ji.width + 7) / 8;
+    info.height = (ji.height + 7) / 8;
+    info.channels = (rgb && interleaved && ji.components == 3) ? 3 : 1;
+    if (!out || outSize < info.size()) {
+        return false;
+    }
+
+    // Blocks per MCU in each direction and per component
+    uint8_t hMax = interleaved ? ji.hMax : 1;
+    uint8_t vMax = interleaved ? ji.vMax : 1;
+    uint8_t compH[JPEG_MAX_COMPONENTS];
+    uint8_t compV[JPEG_MAX_COMPONENTS];
+    uint16_t dcQuant[JPEG_MAX_COMPONENTS];
+    for (uint8_t c = 0; c < ji.components; c++) {
+        const JpegComponent& comp = decoder.getComponent(c);
+        compH[c] = interleaved ? comp.h : 1;
+        compV[c] = interleaved ? comp.v : 1;
+        dcQuant[c] = decoder.getQuantTable(c)[0];
+    }
+    if (hMax > DC_THUMB_MAX_SAMPLING || vMax > DC_THUMB_MAX_SAMPLING) {
+        return false;
+    }
+
+    uint8_t level[JPEG_MAX_COMPONENTS][DC_THUMB_MAX_SAMPLING][DC_THUMB_MAX_SAMPLING];
+    memset(level, 128, sizeof(level));
+
+    for (uint16_t my = 0; my < ji.mcusY; my++) {
+        for (uint16_t mx = 0; mx < ji.mcusX; mx++) {
+            if (!decoder.decodeMCU(false)) {
+                return false;
+            }
+
+            // Blocks of a component are stored row-major within the MCU
+            uint8_t index[JPEG_MAX_COMPONENTS] = { 0, 0, 0 };
+            for (uint8_t b = 0; b < decoder.getBlockCount(); b++) {
+                uint8_t c = decoder.getBlockComponent(b);
+                uint8_t k = index[c]++;
+                level[c][k / compH[c]][k % compH[c]] = dcLevel(decoder.getDC(b), dcQuant[c]);
+            }
+
+            for (uint8_t by = 0; by < vMax; by++) {
+                uint32_t ty = (uint32_t)my * vMax + by;
+                if (ty >= info.height) {
+                    break; // Padding blocks below the image
+                }
+                uint8_t* row = out + ty * info.width * info.channels;
+                for (uint8_t bx = 0; bx < hMax; bx++) {
+                    uint32_t tx = (uint32_t)mx * hMax + bx;
+                    if (tx >= info.width) {
+                        break;
+                    }
+                    int y = level[0][by * compV[0] / vMax][bx * compH[0] / hMax];
+                    if (info.channels == 1) {
+                        row[tx] = y;
+                        continue;
+                    }
+
+                    int cb = level[1][by * compV[1] / vMax][bx * compH[1] / hMax] - 128;
+                    int cr = level[2][by * compV[2] / vMax][bx * compH[2] / hMax] - 128;
+                    uint8_t* px = row + tx * 3;
+                    px[0] = clampLevel(y + ((91881 * cr + 32768) >> 16));
+                    px[1] = clampLevel(y + ((-22554 * cb - 46802 * cr + 32768) >> 16));
+                    px[2] = clampLevel(y + ((116130 * cb + 32768) >> 16));
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef DC_THUMBNAIL_H
+#define DC_THUMBNAIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "jpeg_coeff_decoder.h"
+
+/**
+ * DC Thumbnail
+ *
+ * Builds a 1/8-scale image (200x150 for UXGA) from a JPEG by entropy
+ * decoding only: the DC coefficient of each 8x8 block is the block's mean,
+ * so no IDCT or upsampling filter is run.
+ *
+ * - Grayscale output is the luma DC per block
+ * - RGB output replicates chroma DC over the luma blocks it covers and
+ *   converts with the JFIF equations, in the same fixed point as libjpeg.
+ *   Matches libjpeg at scale 1/8 with fancy upsampling off for grayscale,
+ *   h1v1 (4:4:4) and h2v1 (4:2:2) sampling. For h2v2 (4:2:0) libjpeg runs
+ *   a 2x2 chroma IDCT instead of replicating DC, so colours differ (up
+ *   to about 14 levels at UXGA, more on small frames)
+ * - Frames whose first scan is not interleaved (rare) give grayscale only
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); the caller provides
+ * the decoder and output buffer.
+ */
+
+struct DCThumbnailInfo {
+    uint16_t width;              // ceil(JPEG width / 8)
+    uint16_t height;             // ceil(JPEG height / 8)
+    uint8_t channels;            // 1 = gray, 3 = RGB (interleaved, row-major)
+
+    size_t size() const { return (size_t)width * height * channels; }
+};
+
+class DCThumbnail {
+public:
+    /**
+     * Extract a thumbnail
+     *
+     * @param rgb Request RGB; grayscale JPEGs always give one channel
+     * @param info Filled once the headers are parsed, also when the
+     *             buffer is too small (info.size() is the bytes needed)
+     * @return false for unsupported or corrupt JPEGs or a short buffer
+     */
+    static bool extract(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                        bool rgb, uint8_t* out, size_t outSize, DCThumbnailInfo& info);
+};
+
+#endif // DC_THUMBNAIL_H
@@ -0,0 +1,364 @@
+#include "duplicate_filter.h"
+#include "config.h"
+#include "storage_manager.h"
+#include "system_state.h"
+
+// Static member definitions
+uint64_t DuplicateFilter::lastKeptHash = 0;
+bool DuplicateFilter::hasKept = false;
+unsigned long DuplicateFilter::lastKeptTime = 0;
+DuplicateFilterStats DuplicateFilter::stats = {};
+String DuplicateFilter::logPath = "";
+char DuplicateFilter::logBuffers[2][DEDUP_LOG_BUFFER_SIZE];
+uint8_t DuplicateFilter::active = 0;
+size_t DuplicateFilter::logLength = 0;
+volatile size_t DuplicateFilter::pendingLength = 0;
+bool DuplicateFilter::logHeaderWritten = false;
+portMUX_TYPE DuplicateFilter::logMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Longest log line, flush before the buffer cannot take another
+#define DEDUP_LOG_LINE_MAX 96
+
+bool DuplicateFilter::isEnabled() {
+    return Config::dedup.enabled;
+}
+
+void DuplicateFilter::reset(const String& directory) {
+    flushLog();
+
+    hasKept = false;
+    lastKeptHash = 0;
+    lastKeptTime = 0;
+    logHeaderWritten = false;
+    logPath = (Config::dedup.LOG_DECISIONS && directory.length() > 0) ?
+              directory + "/" + DEDUP_LOG_FILE : String("");
+}
+
+uint64_t DuplicateFilter::computeHash(const DCGrid& grid) {
+    uint64_t hash = 0;
+    int bit = 0;
+    for (int y = 0; y < DHASH_GRID_H; y++) {
+        for (int x = 0; x < DHASH_GRID_W - 1; x++, bit++) {
+            int64_t leftCount = grid.count[y][x];
+            int64_t rightCount = grid.count[y][x + 1];
+            if (leftCount == 0 || rightCount == 0) {
+                continue;
+            }
+            // left mean < right mean, without dividing
+            if ((int64_t)grid.sum[y][x] * rightCount < (int64_t)grid.sum[y][x + 1] * leftCount) {
+                hash |= 1ULL << bit;
+            }
+        }
+    }
+    return hash;
+}
+
+bool DuplicateFilter::evaluate(const DCGrid* grid, const GPSPosition& pos, size_t frameBytes,
+                               uint32_t photoNumber, DuplicateDecision* decision) {
+    DuplicateDecision d;
+    d.hash = 0;
+    d.distance = 64;
+    d.speed = pos.speed;
+
+    bool hashed = grid && grid->complete;
+    if (hashed) {
+        d.hash = computeHash(*grid);
+        if (hasKept) {
+            d.distance = hammingDistance(d.hash, lastKeptHash);
+        }
+    }
+
+    unsigned long now = millis();
+    if (!hashed) {
+        d.reason = DEDUP_KEEP_NO_HASH;
+    } else if (!hasKept) {
+        d.reason = DEDUP_KEEP_FIRST;
+    } else if (!pos.valid) {
+        d.reason = DEDUP_KEEP_NO_FIX;
+    } else if (pos.speed > Config::dedup.STATIONARY_SPEED_MS) {
+        d.reason = DEDUP_KEEP_MOVING;
+    } else if (d.distance >= Config::dedup.HAMMING_THRESHOLD) {
+        d.reason = DEDUP_KEEP_DIFFERENT;
+    } else if (Config::dedup.MAX_SKIP_MS > 0 && now - lastKeptTime >= Config::dedup.MAX_SKIP_MS) {
+        d.reason = DEDUP_KEEP_REFRESH;
+    } else {
+        d.reason = DEDUP_SKIP;
+    }
+    d.skip = d.reason == DEDUP_SKIP;
+
+    stats.framesChecked++;
+    stats.lastDistance = d.distance;
+    switch (d.reason) {
+        case DEDUP_SKIP:
+            stats.framesSkipped++;
+            stats.bytesSkipped += frameBytes;
+            break;
+        case DEDUP_KEEP_DIFFERENT: stats.keptDifferent++; break;
+        case DEDUP_KEEP_MOVING:    stats.keptMoving++;    break;
+        case DEDUP_KEEP_NO_FIX:    stats.keptNoFix++;     break;
+        case DEDUP_KEEP_NO_HASH:   stats.keptNoHash++;    break;
+        case DEDUP_KEEP_REFRESH:   stats.refreshes++;     break;
+        default: break;
+    }
+
+    if (!d.skip) {
+        if (hashed) {
+            lastKeptHash = d.hash;
+            hasKept = true;
+        }
+        lastKeptTime = now;
+    }
+
+    appendLog(d, d.skip ? -1 : (int32_t)photoNumber);
+    if (decision) {
+        *decision = d;
+    }
+    return d.skip;
+}
+
+void DuplicateFilter::appendLog(const DuplicateDecision& decision, int32_t photoNumber) {
+    if (logPath.length() == 0) {
+        return;
+    }
+    if (logLength + DEDUP_LOG_LINE_MAX > DEDUP_LOG_BUFFER_SIZE) {
+        // Hand the full buffer to the photo writer; no SD access here
+        bool handedOver = false;
+        portENTER_CRITICAL(&logMux);
+        if (pendingLength == 0) {
+            pendingLength = logLength;
+            active ^= 1;
+            logLength = 0;
+            handedOver = true;
+        }
+        portEXIT_CRITICAL(&logMux);
+        if (!handedOver) {
+            stats.logLinesDropped++;
+            return;
+        }
+    }
+
+    char photo[12] = "";
+    if (photoNumber >= 0) {
+        snprintf(photo, sizeof(photo), "%04ld", (long)photoNumber);
+    }
+    char hash[17] = "";
+    if (decision.reason != DEDUP_KEEP_NO_HASH) {
+        snprintf(hash, sizeof(hash), "%08lx%08lx",
+                 (unsigned long)(decision.hash >> 32), (unsigned long)(decision.hash & 0xFFFFFFFF));
+    }
+
+    char* buffer = logBuffers[active];
+    int n = snprintf(buffer + logLength, DEDUP_LOG_BUFFER_SIZE - logLength,
+                     "%lu,%s,%s,%u,%.2f,%s\n", millis(), photo, hash, decision.distance,
+                     decision.speed, getReasonString(decision.reason));
+    if (n > 0 && logLength + n < DEDUP_LOG_BUFFER_SIZE) {
+        logLength += n;
+    }
+}
+
+bool DuplicateFilter::writeLog(const char* data, size_t length) {
+    File file = StorageManager::openFile(logPath, "a");
+    if (!file) {
+        Serial.println("Failed to open dedup log: " + logPath);
+        return false;
+    }
+    if (!logHeaderWritten) {
+        file.print("time_ms,photo,hash,distance,speed_ms,decision\n");
+        logHeaderWritten = true;
+    }
+    file.write((const uint8_t*)data, length);
+    StorageManager::closeFile(file);
+    return true;
+}
+
+void DuplicateFilter::writePendingLog() {
+    // Only the camera task hands over (and then never touches) the pending buffer
+    size_t length = pendingLength;
+    if (length == 0) {
+        return;
+    }
+    if (logPath.length() > 0) {
+        writeLog(logBuffers[active ^ 1], length);
+    }
+    portENTER_CRITICAL(&logMux);
+    pendingLength = 0;
+    portEXIT_CRITICAL(&logMux);
+}
+
+void DuplicateFilter::flushLog() {
+    // Older lines first: the handed-over buffer, then the one being filled
+    writePendingLog();
+    if (logLength > 0 && logPath.length() > 0) {
+        writeLog(logBuffers[active], logLength);
+    }
+    logLength = 0;
+}
+
+const char* DuplicateFilter::getReasonString(DuplicateReason reason) {
+    switch (reason) {
+        case DEDUP_KEEP_DIFFERENT: return "keep-different";
+        case DEDUP_KEEP_MOVING:    return "keep-moving";
+        case DEDUP_KEEP_NO_FIX:    return "keep-nofix";
+        case DEDUP_KEEP_NO_HASH:   return "keep-nohash";
+        case DEDUP_KEEP_FIRST:     return "keep-first";
+        case DEDUP_KEEP_REFRESH:   return "keep-refresh";
+        case DEDUP_SKIP:           return "skip";
+        default:                   return "unknown";
+    }
+}
+
+void DuplicateFilter::printStatistics() {
+    Serial.println("\n--- Duplicate Filter ---");
+    Serial.printf("Frames: %u checked, %u skipped (%.1f%%), %u KB not written\n",
+                  stats.framesChecked, stats.framesSkipped,
+                  stats.framesChecked ? stats.framesSkipped * 100.0f / stats.framesChecked : 0.0f,
+                  (unsigned)(stats.bytesSkipped / 1024));
+    Serial.printf("Kept: %u different, %u moving, %u no fix, %u no hash, %u refresh\n",
+                  stats.keptDifferent, stats.keptMoving, stats.keptNoFix,
+                  stats.keptNoHash, stats.refreshes);
+    Serial.printf("Last distance: %u (threshold %u)\n", stats.lastDistance,
+                  Config::dedup.HAMMING_THRESHOLD);
+    if (stats.logLinesDropped > 0) {
+        Serial.printf("Log lines dropped: %u (log buffers full)\n", stats.logLinesDropped);
+    }
+    Serial.println("------------------------\n");
+}
+
+// Synthetic scene for runSelfTest(): smooth structure plus per-MCU sensor noise
+static uint32_t dedupNoiseState = 1;
+
+static int16_t sceneDC(int mx, int my, float phase, int noise) {
+    dedupNoiseState = dedupNoiseState * 1103515245 + 12345;
+    int n = noise ? (int)((dedupNoiseState >> 16) % (2 * noise + 1)) - noise : 0;
+    float v = 40.0f * sinf(mx * 0.07f + phase) + 30.0f * cosf(my * 0.05f) +
+              20.0f * sinf((mx + my) * 0.11f + phase);
+    return (int16_t)v + n;
+}
+
+static void fillGrid(DCGrid& grid, float phase, int noise) {
+    grid.begin(100, 150); // UXGA 4:2:2 MCU layout
+    for (int my = 0; my < 150; my++) {
+        for (int mx = 0; mx < 100; mx++) {
+            grid.add(mx, my, sceneDC(mx, my, phase, noise));
+        }
+    }
+    grid.complete = true;
+}
+
+bool DuplicateFilter::runSelfTest() {
+    Serial.println("\n=== Duplicate Filter Self-Test ===");
+
+    if (SystemState::isCapturing()) {
+        Serial.println("FAIL: Stop capture first (the test replaces the last kept frame)");
+        return false;
+    }
+
+    // Preserve run state; the test does not log
+    uint64_t savedHash = lastKeptHash;
+    bool savedHasKept = hasKept;
+    unsigned long savedKeptTime = lastKeptTime;
+    DuplicateFilterStats savedStats = stats;
+    String savedPath = logPath;
+    logPath = "";
+
+    int passed = 0;
+    int total = 0;
+    static DCGrid grid;
+    dedupNoiseState = 1;
+
+    GPSPosition hover;
+    hover.valid = true;
+    hover.speed = 0.1f;
+    GPSPosition moving = hover;
+    moving.speed = 6.0f;
+    GPSPosition noFix;
+
+    // Same scene with sensor noise hashes within the threshold
+    fillGrid(grid, 0.0f, 0);
+    uint64_t base = computeHash(grid);
+    fillGrid(grid, 0.0f, 6);
+    uint8_t noisy = hammingDistance(base, computeHash(grid));
+    total++;
+    if (noisy < Config::dedup.HAMMING_THRESHOLD) {
+        passed++;
+        Serial.printf("PASS: Sensor noise moved the hash %u bits\n", noisy);
+    } else {
+        Serial.printf("FAIL: Sensor noise moved the hash %u bits\n", noisy);
+    }
+
+    // Panned scene is far from the original
+    fillGrid(grid, 1.5f, 6);
+    uint8_t panned = hammingDistance(base, computeHash(grid));
+    total++;
+    if (panned >= Config::dedup.HAMMING_THRESHOLD * 2) {
+        passed++;
+        Serial.printf("PASS: Changed scene is %u bits away\n", panned);
+    } else {
+        Serial.printf("FAIL: Changed scene only %u bits away\n", panned);
+    }
+
+    // Decisions: first kept, hover duplicate skipped, moving/no fix kept
+    struct Step {
+        const char* label;
+        float phase;
+        const GPSPosition* pos;
+        DuplicateReason expected;
+    };
+    const Step steps[] = {
+        { "First frame",         0.0f, &hover,  DEDUP_KEEP_FIRST },
+        { "Hover duplicate",     0.0f, &hover,  DEDUP_SKIP },
+        { "Duplicate, moving",   0.0f, &moving, DEDUP_KEEP_MOVING },
+        { "Duplicate, no fix",   0.0f, &noFix,  DEDUP_KEEP_NO_FIX },
+        { "Hover, scene change", 1.5f, &hover,  DEDUP_KEEP_DIFFERENT },
+    };
+
+    hasKept = false;
+    lastKeptTime = millis();
+    for (const Step& step : steps) {
+        fillGrid(grid, step.phase, 6);
+        DuplicateDecision d;
+        evaluate(&grid, *step.pos, 200 * 1024, 0, &d);
+        total++;
+        if (d.reason == step.expected) {
+            passed++;
+            Serial.printf("PASS: %s -> %s (distance %u)\n", step.label,
+                          getReasonString(d.reason), d.distance);
+        } else {
+            Serial.printf("FAIL: %s -> %s, expected %s\n", step.label,
+                          getReasonString(d.reason), getReasonString(step.expected));
+        }
+    }
+
+    // Long hover forces a refresh frame
+    lastKeptTime = millis() - Config::dedup.MAX_SKIP_MS;
+    DuplicateDecision d;
+    evaluate(&grid, hover, 200 * 1024, 0, &d);
+    total++;
+    if (Config::dedup.MAX_SKIP_MS == 0 || d.reason == DEDUP_KEEP_REFRESH) {
+        passed++;
+        Serial.println("PASS: Refresh frame kept after MAX_SKIP_MS");
+    } else {
+        Serial.printf("FAIL: Long hover -> %s\n", getReasonString(d.reason));
+    }
+
+    // Incomplete decode is never skipped
+    grid.complete = false;
+    evaluate(&grid, hover, 200 * 1024, 0, &d);
+    total++;
+    if (d.reason == DEDUP_KEEP_NO_HASH) {
+        passed++;
+        Serial.println("PASS: Incomplete decode kept");
+    } else {
+        Serial.printf("FAIL: Incomplete decode -> %s\n", getReasonString(d.reason));
+    }
+
+    lastKeptHash = savedHash;
+    hasKept = savedHasKept;
+    lastKeptTime = savedKeptTime;
+    stats = savedStats;
+    logPath = savedPath;
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
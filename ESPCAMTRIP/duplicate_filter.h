@@ -0,0 +1,173 @@
+#ifndef DUPLICATE_FILTER_H
+#define DUPLICATE_FILTER_H
+
+#include <Arduino.h>
+#include "gps_manager.h"
+
+/**
+ * Duplicate Filter (stationary near-duplicate suppression)
+ *
+ * Skips writing mission frames that look the same as the last written
+ * frame while the vehicle is not moving (pre-flight, loiter, hover).
+ *
+ * - The frame hash is a 64-bit difference hash (dHash) over a 9x8 grid of
+ *   luma DC averages, collected during the sharpness decode pass, so no
+ *   pixel decode is needed
+ * - A frame is skipped only when its Hamming distance to the last kept
+ *   frame is under the threshold AND GPS ground speed says stationary;
+ *   without a fix every frame is kept
+ * - A frame is kept at least every MAX_SKIP_MS as a refresh
+ *
+ * Every decision and hash is appended to dedup.csv in the capture
+ * directory for auditing, and uploaded with the photos. Lines are
+ * buffered on the camera task; a full buffer is handed over and written
+ * by whoever writes photos (SD writer task with the capture pipeline), so
+ * the camera task never opens the file during a run.
+ */
+
+#define DEDUP_LOG_FILE "dedup.csv"
+#define DEDUP_LOG_BUFFER_SIZE 2048
+
+#define DHASH_GRID_W 9
+#define DHASH_GRID_H 8
+
+// Luma DC averages per grid cell, filled MCU by MCU
+struct DCGrid {
+    int32_t sum[DHASH_GRID_H][DHASH_GRID_W];
+    uint16_t count[DHASH_GRID_H][DHASH_GRID_W];
+    uint16_t mcusX;
+    uint16_t mcusY;
+    bool complete;               // Every MCU was added
+
+    void begin(uint16_t mcuCols, uint16_t mcuRows) {
+        memset(sum, 0, sizeof(sum));
+        memset(count, 0, sizeof(count));
+        mcusX = mcuCols;
+        mcusY = mcuRows;
+        complete = false;
+    }
+
+    void add(uint16_t mx, uint16_t my, int16_t dc) {
+        uint16_t cx = (uint32_t)mx * DHASH_GRID_W / mcusX;
+        uint16_t cy = (uint32_t)my * DHASH_GRID_H / mcusY;
+        sum[cy][cx] += dc;
+        count[cy][cx]++;
+    }
+};
+
+enum DuplicateReason {
+    DEDUP_KEEP_DIFFERENT,        // Scene changed
+    DEDUP_KEEP_MOVING,           // Ground speed above the stationary limit
+    DEDUP_KEEP_NO_FIX,           // Cannot tell whether the vehicle moves
+    DEDUP_KEEP_NO_HASH,          // Decode incomplete (budget or corrupt)
+    DEDUP_KEEP_FIRST,            // Nothing kept yet in this run
+    DEDUP_KEEP_REFRESH,          // MAX_SKIP_MS since the last kept frame
+    DEDUP_SKIP                   // Near-duplicate while stationary
+};
+
+struct DuplicateDecision {
+    uint64_t hash;
+    uint8_t distance;            // Hamming distance to the last kept frame (64 = none)
+    float speed;                 // m/s
+    DuplicateReason reason;
+    bool skip;
+};
+
+struct DuplicateFilterStats {
+    uint32_t framesChecked;
+    uint32_t framesSkipped;
+    uint32_t keptDifferent;
+    uint32_t keptMoving;
+    uint32_t keptNoFix;
+    uint32_t keptNoHash;
+    uint32_t refreshes;
+    uint64_t bytesSkipped;       // JPEG bytes not written
+    uint32_t logLinesDropped;    // Both log buffers full (no photo written meanwhile)
+    uint8_t lastDistance;
+
+    void reset() {
+        framesChecked = 0;
+        framesSkipped = 0;
+        keptDifferent = 0;
+        keptMoving = 0;
+        keptNoFix = 0;
+        keptNoHash = 0;
+        refreshes = 0;
+        bytesSkipped = 0;
+        logLinesDropped = 0;
+        lastDistance = 0;
+    }
+};
+
+class DuplicateFilter {
+private:
+    static uint64_t lastKeptHash;
+    static bool hasKept;
+    static unsigned long lastKeptTime;
+    static DuplicateFilterStats stats;
+
+    // Buffered audit log: the camera task fills logBuffers[active]; a full
+    // buffer waits in the other one (pendingLength bytes) for writePendingLog()
+    static String logPath;
+    static char logBuffers[2][DEDUP_LOG_BUFFER_SIZE];
+    static uint8_t active;
+    static size_t logLength;
+    static volatile size_t pendingLength;
+    static bool logHeaderWritten;
+    static portMUX_TYPE logMux;
+
+    static void appendLog(const DuplicateDecision& decision, int32_t photoNumber);
+    static bool writeLog(const char* data, size_t length);
+
+public:
+    static bool isEnabled();
+
+    /**
+     * Start a capture run; decisions are logged to <directory>/dedup.csv
+     * (empty directory = no log)
+     */
+    static void reset(const String& directory);
+
+    /**
+     * 64-bit dHash: bit set where a cell is darker than its right neighbour
+     */
+    static uint64_t computeHash(const DCGrid& grid);
+    static uint8_t hammingDistance(uint64_t a, uint64_t b) { return __builtin_popcountll(a ^ b); }
+
+    /**
+     * Decide whether to skip writing a frame
+     *
+     * @param grid DC grid from the decode pass (nullptr or incomplete = keep)
+     * @param photoNumber Photo number the frame gets if kept (for the log)
+     * @return true to skip the write
+     */
+    static bool evaluate(const DCGrid* grid, const GPSPosition& pos, size_t frameBytes,
+                         uint32_t photoNumber, DuplicateDecision* decision = nullptr);
+
+    /**
+     * Write a log buffer handed over by the camera task, if any; called
+     * where photos are written (SD writer task, or the synchronous path)
+     */
+    static void writePendingLog();
+
+    /**
+     * Write all buffered log lines (end of a run, pipeline drained)
+     */
+    static void flushLog();
+
+    /**
+     * Statistics
+     */
+    static DuplicateFilterStats getStatistics() { return stats; }
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+    static const char* getReasonString(DuplicateReason reason);
+
+    /**
+     * Hash and decide on synthetic DC grids (static scene, sensor noise,
+     * changed scene, moving/no-fix positions, refresh); not while capturing
+     */
+    static bool runSelfTest();
+};
+
+#endif // DUPLICATE_FILTER_H
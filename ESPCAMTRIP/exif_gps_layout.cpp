@@ -0,0 +1,343 @@
+#include "exif_gps_layout.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Offset of a header field from the TIFF header, as stored in IFD entries
+#define TIFF_OFFSET(field) \
+    (offsetof(StaticEXIFHeader, field) - offsetof(StaticEXIFHeader, fixed.tiff_byte_order))
+
+#define EXIF_TIFF_SIZE (sizeof(StaticEXIFHeader) - offsetof(StaticEXIFHeader, fixed.tiff_byte_order))
+#define EXIF_APP1_LENGTH (sizeof(StaticEXIFHeader) - 2)  // Length field counts itself, not the marker
+
+static constexpr const char EXIF_CAMERA_MAKE[] = "XIAO ESP32S3";
+static constexpr const char EXIF_CAMERA_MODEL[] = "OV2640";
+static constexpr const char EXIF_DATETIME_UNSET[] = "0000:00:00 00:00:00";
+static constexpr const char EXIF_DATESTAMP_UNSET[] = "0000:00:00";
+static constexpr const char EXIF_PROCESSING_GPS[] = "ASCII\0\0\0GPS";  // 8-byte charset code + text
+#define EXIF_PROCESSING_TEXT 8
+
+static constexpr EXIFEntry exifEntry(uint16_t tag, uint16_t type, uint32_t count, uint32_t value) {
+    return EXIFEntry{tag, type, count, value};
+}
+
+template <size_t N>
+static constexpr void copyString(char* dest, const char (&src)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static constexpr StaticEXIFHeader buildTemplate() {
+    StaticEXIFHeader h{};
+    StaticEXIFFixed& f = h.fixed;
+    StaticEXIFPatch& p = h.patch;
+
+    f.app1_marker[0] = 0xFF;
+    f.app1_marker[1] = 0xE1;
+    f.app1_length[0] = (uint8_t)(EXIF_APP1_LENGTH >> 8);
+    f.app1_length[1] = (uint8_t)(EXIF_APP1_LENGTH & 0xFF);
+    copyString(f.exif_id, "Exif\0");
+
+    f.tiff_byte_order = TIFF_LITTLE_ENDIAN;
+    f.tiff_magic = TIFF_MAGIC;
+    f.ifd0_offset = TIFF_OFFSET(fixed.ifd0_count);
+
+    f.ifd0_count = EXIF_IFD0_ENTRIES;
+    f.ifd0[0] = exifEntry(0x010F, TIFF_ASCII, sizeof(EXIF_CAMERA_MAKE), TIFF_OFFSET(fixed.camera_make));
+    f.ifd0[1] = exifEntry(0x0110, TIFF_ASCII, sizeof(EXIF_CAMERA_MODEL), TIFF_OFFSET(fixed.camera_model));
+    f.ifd0[2] = exifEntry(0x0132, TIFF_ASCII, sizeof(p.datetime), TIFF_OFFSET(patch.datetime));
+    f.ifd0[3] = exifEntry(0x8825, TIFF_LONG, 1, TIFF_OFFSET(fixed.gps_count));
+    f.next_ifd = 0;                              // IFD1 unlinked until a thumbnail is attached
+    copyString(f.camera_make, EXIF_CAMERA_MAKE);
+    copyString(f.camera_model, EXIF_CAMERA_MODEL);
+
+    // Thumbnail IFD: 72 dpi JPEG stored right after the header
+    f.ifd1_count = EXIF_IFD1_ENTRIES;
+    f.ifd1[EXIF_THUMB_COMPRESSION] = exifEntry(0x0103, TIFF_SHORT, 1, 6);
+    f.ifd1[EXIF_THUMB_X_RESOLUTION] = exifEntry(0x011A, TIFF_RATIONAL, 1, TIFF_OFFSET(fixed.x_resolution));
+    f.ifd1[EXIF_THUMB_Y_RESOLUTION] = exifEntry(0x011B, TIFF_RATIONAL, 1, TIFF_OFFSET(fixed.y_resolution));
+    f.ifd1[EXIF_THUMB_RESOLUTION_UNIT] = exifEntry(0x0128, TIFF_SHORT, 1, 2);
+    f.ifd1[EXIF_THUMB_OFFSET] = exifEntry(0x0201, TIFF_LONG, 1, EXIF_TIFF_SIZE);
+    f.ifd1[EXIF_THUMB_LENGTH] = exifEntry(0x0202, TIFF_LONG, 1, 0);
+    f.ifd1_next = 0;
+    f.x_resolution[0] = f.y_resolution[0] = 72;
+    f.x_resolution[1] = f.y_resolution[1] = 1;
+
+    // Inline values are little-endian bytes: version 2.2.0.0, "N\0", "E\0"
+    f.gps_count = EXIF_GPS_ENTRIES;
+    f.gps_version = exifEntry(0x0000, TIFF_BYTE, 4, 0x00000202);
+    p.gps[EXIF_GPS_LAT_REF] = exifEntry(0x0001, TIFF_ASCII, 2, 'N');
+    p.gps[EXIF_GPS_LAT] = exifEntry(0x0002, TIFF_RATIONAL, 3, TIFF_OFFSET(patch.lat_degrees));
+    p.gps[EXIF_GPS_LON_REF] = exifEntry(0x0003, TIFF_ASCII, 2, 'E');
+    p.gps[EXIF_GPS_LON] = exifEntry(0x0004, TIFF_RATIONAL, 3, TIFF_OFFSET(patch.lon_degrees));
+    p.gps[EXIF_GPS_ALT_REF] = exifEntry(0x0005, TIFF_BYTE, 1, 0);
+    p.gps[EXIF_GPS_ALT] = exifEntry(0x0006, TIFF_RATIONAL, 1, TIFF_OFFSET(patch.altitude));
+    p.gps[EXIF_GPS_TIME] = exifEntry(0x0007, TIFF_RATIONAL, 3, TIFF_OFFSET(patch.time_hour));
+    p.gps[EXIF_GPS_MEASURE_MODE] = exifEntry(0x000A, TIFF_ASCII, 2, '2');
+    p.gps[EXIF_GPS_DOP] = exifEntry(0x000B, TIFF_RATIONAL, 1, TIFF_OFFSET(patch.dop));
+    p.gps[EXIF_GPS_SPEED_REF] = exifEntry(0x000C, TIFF_ASCII, 2, 'K');
+    p.gps[EXIF_GPS_SPEED] = exifEntry(0x000D, TIFF_RATIONAL, 1, TIFF_OFFSET(patch.speed));
+    p.gps[EXIF_GPS_TRACK_REF] = exifEntry(0x000E, TIFF_ASCII, 2, 'T');
+    p.gps[EXIF_GPS_TRACK] = exifEntry(0x000F, TIFF_RATIONAL, 1, TIFF_OFFSET(patch.track));
+    p.gps[EXIF_GPS_PROCESSING_METHOD] = exifEntry(0x001B, TIFF_UNDEFINED,
+                                                  sizeof(EXIF_PROCESSING_GPS) - 1,
+                                                  TIFF_OFFSET(patch.processing_method));
+    p.gps[EXIF_GPS_DATE_STAMP] = exifEntry(0x001D, TIFF_ASCII, sizeof(EXIF_DATESTAMP_UNSET),
+                                           TIFF_OFFSET(patch.date_stamp));
+    p.gps[EXIF_GPS_H_ERROR] = exifEntry(0x001F, TIFF_RATIONAL, 1, TIFF_OFFSET(patch.h_error));
+    p.gps_next_ifd = 0;
+
+    copyString(p.datetime, EXIF_DATETIME_UNSET);
+    copyString(p.date_stamp, EXIF_DATESTAMP_UNSET);
+    copyString(p.processing_method, EXIF_PROCESSING_GPS);
+
+    // Zero rationals with valid denominators
+    p.lat_degrees[1] = p.lat_minutes[1] = p.lat_seconds[1] = 1;
+    p.lon_degrees[1] = p.lon_minutes[1] = p.lon_seconds[1] = 1;
+    p.altitude[1] = 1;
+    p.time_hour[1] = p.time_minute[1] = p.time_second[1] = 1;
+    p.dop[1] = p.speed[1] = p.track[1] = p.h_error[1] = 1;
+    return h;
+}
+
+// Flash-resident template; the patch part is copied to RAM at init
+static constexpr StaticEXIFHeader EXIF_TEMPLATE = buildTemplate();
+
+// --- Compile-time layout checks (TIFF 6.0 / EXIF 2.2) ---
+
+static constexpr uint32_t tiffTypeSize(uint16_t type) {
+    return type == TIFF_BYTE || type == TIFF_ASCII || type == TIFF_UNDEFINED ? 1 :
+           type == TIFF_SHORT ? 2 :
+           type == TIFF_LONG ? 4 :
+           type == TIFF_RATIONAL ? 8 : 0;
+}
+
+// Known type; inline if it fits in 4 bytes, else a word-aligned offset
+// with the whole value inside the TIFF data
+static constexpr bool entryValid(const EXIFEntry& e) {
+    return tiffTypeSize(e.type) != 0 && e.count > 0 &&
+           (tiffTypeSize(e.type) * e.count <= 4 ||
+            (e.value % 2 == 0 && e.value >= 8 &&
+             e.value + tiffTypeSize(e.type) * e.count <= EXIF_TIFF_SIZE));
+}
+
+static constexpr const EXIFEntry& gpsEntry(const StaticEXIFHeader& h, size_t i) {
+    return i == 0 ? h.fixed.gps_version : h.patch.gps[i - 1];
+}
+
+template <size_t N>
+static constexpr bool ifdValid(const EXIFEntry (&entries)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        if (!entryValid(entries[i]) || (i > 0 && entries[i].tag <= entries[i - 1].tag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static constexpr bool gpsIfdValid(const StaticEXIFHeader& h) {
+    for (size_t i = 0; i < EXIF_GPS_ENTRIES; i++) {
+        if (!entryValid(gpsEntry(h, i)) || (i > 0 && gpsEntry(h, i).tag <= gpsEntry(h, i - 1).tag)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ASCII values: count includes the NUL and fits the field
+template <size_t N>
+static constexpr bool asciiFits(const EXIFEntry& e, const char (&field)[N]) {
+    return e.type == TIFF_ASCII && e.count <= N && field[e.count - 1] == '\0' &&
+           (e.count < 2 || field[e.count - 2] != '\0');
+}
+
+static_assert(EXIF_APP1_LENGTH <= 0xFFFF, "APP1 segment too long");
+static_assert(((EXIF_TEMPLATE.fixed.app1_length[0] << 8) | EXIF_TEMPLATE.fixed.app1_length[1]) ==
+              EXIF_APP1_LENGTH, "APP1 length must be big-endian segment size minus the marker");
+static_assert(EXIF_TEMPLATE.fixed.ifd0_offset % 2 == 0 && TIFF_OFFSET(fixed.gps_count) % 2 == 0,
+              "IFDs must start on a word boundary");
+static_assert(offsetof(StaticEXIFHeader, fixed.next_ifd) - offsetof(StaticEXIFHeader, fixed.ifd0) ==
+              EXIF_IFD0_ENTRIES * sizeof(EXIFEntry) &&
+              EXIF_TEMPLATE.fixed.ifd0_count == EXIF_IFD0_ENTRIES, "IFD0 entry count");
+static_assert(offsetof(StaticEXIFHeader, patch.gps_next_ifd) -
+              offsetof(StaticEXIFHeader, fixed.gps_version) == EXIF_GPS_ENTRIES * sizeof(EXIFEntry) &&
+              EXIF_TEMPLATE.fixed.gps_count == EXIF_GPS_ENTRIES, "GPS IFD entry count");
+static_assert(ifdValid(EXIF_TEMPLATE.fixed.ifd0), "IFD0 entries unsorted, misaligned or out of bounds");
+static_assert(ifdValid(EXIF_TEMPLATE.fixed.ifd1), "IFD1 entries unsorted, misaligned or out of bounds");
+static_assert(TIFF_OFFSET(fixed.ifd1_count) % 2 == 0 && EXIF_TEMPLATE.fixed.ifd1_count == EXIF_IFD1_ENTRIES &&
+              offsetof(StaticEXIFHeader, fixed.ifd1_next) - offsetof(StaticEXIFHeader, fixed.ifd1) ==
+              EXIF_IFD1_ENTRIES * sizeof(EXIFEntry), "IFD1 entry count or alignment");
+static_assert(EXIF_TEMPLATE.fixed.ifd1[EXIF_THUMB_OFFSET].value == EXIF_TIFF_SIZE &&
+              EXIF_TEMPLATE.fixed.next_ifd == 0, "Thumbnail must follow the header, IFD1 unlinked");
+static_assert(gpsIfdValid(EXIF_TEMPLATE), "GPS IFD entries unsorted, misaligned or out of bounds");
+static_assert(asciiFits(EXIF_TEMPLATE.fixed.ifd0[0], EXIF_TEMPLATE.fixed.camera_make) &&
+              asciiFits(EXIF_TEMPLATE.fixed.ifd0[1], EXIF_TEMPLATE.fixed.camera_model) &&
+              asciiFits(EXIF_TEMPLATE.fixed.ifd0[2], EXIF_TEMPLATE.patch.datetime),
+              "IFD0 string counts do not match their fields");
+static_assert(asciiFits(EXIF_TEMPLATE.patch.gps[EXIF_GPS_DATE_STAMP], EXIF_TEMPLATE.patch.date_stamp) &&
+              EXIF_TEMPLATE.patch.gps[EXIF_GPS_PROCESSING_METHOD].count ==
+              EXIF_PROCESSING_TEXT + 3, "GPS string counts do not match their fields");
+static_assert(TIFF_OFFSET(patch.lat_degrees) % 4 == 0 && TIFF_OFFSET(fixed.x_resolution) % 4 == 0,
+              "Rationals should be 32-bit aligned");
+
+
+const StaticEXIFHeader& EXIFGPSLayout::getTemplate() {
+    return EXIF_TEMPLATE;
+}
+
+bool EXIFGPSLayout::isOwnHeader(const uint8_t* jpeg, size_t jpeg_size) {
+    if (!jpeg || jpeg_size < 2 + sizeof(StaticEXIFHeader) || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return false;
+    }
+
+    // Our own APP1: the fixed part matches the template byte for byte,
+    // apart from the fields a thumbnail changes
+    StaticEXIFFixed fixed;
+    memcpy(&fixed, jpeg + 2, sizeof(fixed));
+    memcpy(fixed.app1_length, EXIF_TEMPLATE.fixed.app1_length, sizeof(fixed.app1_length));
+    fixed.next_ifd = EXIF_TEMPLATE.fixed.next_ifd;
+    fixed.ifd1[EXIF_THUMB_LENGTH].value = EXIF_TEMPLATE.fixed.ifd1[EXIF_THUMB_LENGTH].value;
+    return memcmp(&fixed, &EXIF_TEMPLATE.fixed, sizeof(fixed)) == 0;
+}
+
+StaticEXIFHeader* EXIFGPSLayout::findHeader(uint8_t* jpeg, size_t jpeg_size) {
+    return isOwnHeader(jpeg, jpeg_size) ? (StaticEXIFHeader*)(jpeg + 2) : nullptr;
+}
+
+bool EXIFGPSLayout::setThumbnail(StaticEXIFFixed& fixed, size_t thumbnail_size) {
+    if (thumbnail_size > getMaxThumbnailSize()) {
+        return false;
+    }
+
+    size_t length = EXIF_APP1_LENGTH + thumbnail_size;
+    fixed.app1_length[0] = (uint8_t)(length >> 8);
+    fixed.app1_length[1] = (uint8_t)(length & 0xFF);
+    fixed.next_ifd = thumbnail_size > 0 ? TIFF_OFFSET(fixed.ifd1_count) : 0;
+    fixed.ifd1[EXIF_THUMB_LENGTH].value = thumbnail_size;
+    return true;
+}
+
+// Numerator of a non-negative value over a fixed denominator
+static inline uint32_t scaleRational(float value, uint32_t scale) {
+    return (value > 0) ? (uint32_t)(value * scale + 0.5f) : 0;
+}
+
+static inline double rationalValue(uint32_t numerator, uint32_t denominator) {
+    return denominator != 0 ? (double)numerator / denominator : 0.0;
+}
+
+#define RATIONAL_VALUE(field) rationalValue((field)[0], (field)[1])
+
+// Degrees, minutes and GPS_COORD_SCALE seconds numerators
+static void splitDMS(double value, uint32_t dms[3]) {
+    double abs_value = fabs(value);
+    dms[0] = (uint32_t)abs_value;
+    double min_float = (abs_value - dms[0]) * 60.0;
+    dms[1] = (uint32_t)min_float;
+    dms[2] = (uint32_t)((min_float - dms[1]) * 60.0 * GPS_COORD_SCALE);
+}
+
+void EXIFGPSLayout::setFix(StaticEXIFPatch& header, const EXIFGPSFix& fix) {
+    uint32_t dms[3];
+    splitDMS(fix.latitude, dms);
+    header.lat_degrees[0] = dms[0];
+    header.lat_degrees[1] = 1;
+    header.lat_minutes[0] = dms[1];
+    header.lat_minutes[1] = 1;
+    header.lat_seconds[0] = dms[2];
+    header.lat_seconds[1] = GPS_COORD_SCALE;
+    header.gps[EXIF_GPS_LAT_REF].value = (fix.latitude >= 0) ? 'N' : 'S';
+
+    splitDMS(fix.longitude, dms);
+    header.lon_degrees[0] = dms[0];
+    header.lon_degrees[1] = 1;
+    header.lon_minutes[0] = dms[1];
+    header.lon_minutes[1] = 1;
+    header.lon_seconds[0] = dms[2];
+    header.lon_seconds[1] = GPS_COORD_SCALE;
+    header.gps[EXIF_GPS_LON_REF].value = (fix.longitude >= 0) ? 'E' : 'W';
+
+    // Altitude (reference 1 = below sea level)
+    header.gps[EXIF_GPS_ALT_REF].value = (fix.altitude < 0) ? 1 : 0;
+    header.altitude[0] = (uint32_t)(fabs(fix.altitude) * GPS_ALT_SCALE);
+    header.altitude[1] = GPS_ALT_SCALE;
+
+    // Fix quality: GGA fixes carry altitude, so any fix is 3D
+    header.gps[EXIF_GPS_MEASURE_MODE].value = fix.valid ? '3' : '2';
+    header.dop[0] = scaleRational(fix.hdop, GPS_DOP_SCALE);
+    header.dop[1] = GPS_DOP_SCALE;
+    header.speed[0] = scaleRational(fix.speed * 3.6f, GPS_SPEED_SCALE);
+    header.speed[1] = GPS_SPEED_SCALE;
+    uint32_t track = scaleRational(fix.course, GPS_TRACK_SCALE);
+    header.track[0] = (track < 360 * GPS_TRACK_SCALE) ? track : 0;
+    header.track[1] = GPS_TRACK_SCALE;
+    header.h_error[0] = scaleRational(fix.accuracy, GPS_ERROR_SCALE);
+    header.h_error[1] = GPS_ERROR_SCALE;
+    memcpy(header.processing_method + EXIF_PROCESSING_TEXT, fix.rtk ? "RTK" : "GPS", 3);
+}
+
+void EXIFGPSLayout::getFix(const StaticEXIFPatch& header, EXIFGPSFix& fix) {
+    fix.latitude = RATIONAL_VALUE(header.lat_degrees) + RATIONAL_VALUE(header.lat_minutes) / 60.0 +
+                   RATIONAL_VALUE(header.lat_seconds) / 3600.0;
+    if (header.gps[EXIF_GPS_LAT_REF].value == 'S') fix.latitude = -fix.latitude;
+    fix.longitude = RATIONAL_VALUE(header.lon_degrees) + RATIONAL_VALUE(header.lon_minutes) / 60.0 +
+                    RATIONAL_VALUE(header.lon_seconds) / 3600.0;
+    if (header.gps[EXIF_GPS_LON_REF].value == 'W') fix.longitude = -fix.longitude;
+    fix.altitude = (float)RATIONAL_VALUE(header.altitude);
+    if (header.gps[EXIF_GPS_ALT_REF].value == 1) fix.altitude = -fix.altitude;
+
+    fix.valid = header.gps[EXIF_GPS_MEASURE_MODE].value == '3';
+    fix.hdop = (float)RATIONAL_VALUE(header.dop);
+    fix.speed = (float)(RATIONAL_VALUE(header.speed) / 3.6);
+    fix.course = (float)RATIONAL_VALUE(header.track);
+    fix.accuracy = (float)RATIONAL_VALUE(header.h_error);
+    fix.rtk = memcmp(header.processing_method + EXIF_PROCESSING_TEXT, "RTK", 3) == 0;
+}
+
+void EXIFGPSLayout::setTime(StaticEXIFPatch& header, time_t time, uint16_t millis) {
+    struct tm gmt;
+    if (!gmtime_r(&time, &gmt)) {
+        return;
+    }
+    // Fields reduced to their digit width so the 20-byte field provably fits
+    snprintf(header.datetime, sizeof(header.datetime), "%04u:%02u:%02u %02u:%02u:%02u",
+             (unsigned)(gmt.tm_year + 1900) % 10000u, (unsigned)(gmt.tm_mon + 1) % 100u,
+             (unsigned)gmt.tm_mday % 100u, (unsigned)gmt.tm_hour % 100u,
+             (unsigned)gmt.tm_min % 100u, (unsigned)gmt.tm_sec % 100u);
+    memcpy(header.date_stamp, header.datetime, 10);  // "YYYY:MM:DD"
+
+    // GPS time rationals (denominators are 1 from the template)
+    header.time_hour[0] = gmt.tm_hour;
+    header.time_minute[0] = gmt.tm_min;
+    setTimeMillis(header, time, millis);
+}
+
+void EXIFGPSLayout::setTimeMillis(StaticEXIFPatch& header, time_t time, uint16_t millis) {
+    // Unix time has no leap seconds: the second of the minute is time % 60
+    header.time_second[0] = (uint32_t)(time % 60) * 1000 + (millis % 1000);
+    header.time_second[1] = 1000;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (no timegm() on newlib)
+static int64_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+bool EXIFGPSLayout::getTime(const StaticEXIFPatch& header, double& unix_time) {
+    int year, month, day;
+    if (sscanf(header.date_stamp, "%4d:%2d:%2d", &year, &month, &day) != 3 ||
+        year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        header.time_hour[1] == 0 || header.time_minute[1] == 0 || header.time_second[1] == 0) {
+        return false;
+    }
+
+    unix_time = daysFromCivil(year, month, day) * 86400.0 + RATIONAL_VALUE(header.time_hour) * 3600.0 +
+                RATIONAL_VALUE(header.time_minute) * 60.0 + RATIONAL_VALUE(header.time_second);
+    return true;
+}
@@ -0,0 +1,225 @@
+#ifndef EXIF_GPS_LAYOUT_H
+#define EXIF_GPS_LAYOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * EXIF GPS Layout
+ *
+ * The fixed-size APP1 segment StaticEXIFGPS inserts right after SOI, and
+ * the encoding of a fix into it. The segment is a constexpr template
+ * (exif_gps_layout.cpp) whose offsets are computed and static_asserted at
+ * compile time: sorted tags, entry counts, inline values for 4 bytes or
+ * less, word-aligned offsets inside the segment and the APP1 length.
+ *
+ * Every field has a fixed size and a fixed file offset, so a header can
+ * be found by comparing the bytes after SOI with the template and
+ * rewritten in place: the camera patches its RAM copy per photo, the
+ * writer patches queued frames, tools/regeotag.cpp patches photos on disk.
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); little-endian hosts
+ * only, like the TIFF data it overlays.
+ */
+
+// TIFF/EXIF constants
+#define TIFF_LITTLE_ENDIAN 0x4949
+#define TIFF_MAGIC 0x002A
+#define TIFF_RATIONAL 5
+#define TIFF_ASCII 2
+#define TIFF_BYTE 1
+#define TIFF_SHORT 3
+#define TIFF_LONG 4
+#define TIFF_UNDEFINED 7
+
+// GPS coordinate precision
+#define GPS_COORD_SCALE 1000000  // 6 decimal places
+#define GPS_ALT_SCALE 1000       // 3 decimal places
+#define GPS_DOP_SCALE 100
+#define GPS_SPEED_SCALE 100      // km/h
+#define GPS_TRACK_SCALE 100      // Degrees
+#define GPS_ERROR_SCALE 1000     // Meters
+
+// One TIFF IFD entry; values of 4 bytes or less are stored inline in value
+struct __attribute__((packed)) EXIFEntry {
+    uint16_t tag;
+    uint16_t type;               // TIFF_*
+    uint32_t count;
+    uint32_t value;              // Inline value or offset from the TIFF header
+};
+
+#define EXIF_IFD0_ENTRIES 4      // Make, Model, DateTime, GPS IFD pointer
+#define EXIF_IFD1_ENTRIES 6      // Thumbnail: Compression .. JPEGInterchangeFormatLength
+#define EXIF_GPS_ENTRIES 17      // GPSVersionID .. GPSHPositioningError
+
+// Entries in StaticEXIFFixed::ifd1
+enum EXIFThumbnailEntry {
+    EXIF_THUMB_COMPRESSION = 0,  // 6 = JPEG
+    EXIF_THUMB_X_RESOLUTION,
+    EXIF_THUMB_Y_RESOLUTION,
+    EXIF_THUMB_RESOLUTION_UNIT,
+    EXIF_THUMB_OFFSET,           // Right after StaticEXIFHeader
+    EXIF_THUMB_LENGTH            // Patched by attachThumbnail()
+};
+
+// GPS entries in StaticEXIFPatch::gps (GPSVersionID is in the fixed part)
+enum EXIFGPSEntry {
+    EXIF_GPS_LAT_REF = 0,        // Inline "N"/"S"
+    EXIF_GPS_LAT,
+    EXIF_GPS_LON_REF,            // Inline "E"/"W"
+    EXIF_GPS_LON,
+    EXIF_GPS_ALT_REF,            // Inline 0 = above, 1 = below sea level
+    EXIF_GPS_ALT,
+    EXIF_GPS_TIME,
+    EXIF_GPS_MEASURE_MODE,       // Inline "2"/"3"
+    EXIF_GPS_DOP,
+    EXIF_GPS_SPEED_REF,          // Inline "K"
+    EXIF_GPS_SPEED,
+    EXIF_GPS_TRACK_REF,          // Inline "T"
+    EXIF_GPS_TRACK,
+    EXIF_GPS_PROCESSING_METHOD,
+    EXIF_GPS_DATE_STAMP,
+    EXIF_GPS_H_ERROR
+};
+
+// Constant part of the APP1 segment: written from the flash template
+struct __attribute__((packed)) StaticEXIFFixed {
+    // JPEG APP1 marker and segment length (big-endian, excludes the marker)
+    uint8_t app1_marker[2];      // FF E1
+    uint8_t app1_length[2];
+
+    // EXIF identifier
+    char exif_id[6];             // "Exif\0\0"
+
+    // TIFF header (offsets below are from tiff_byte_order)
+    uint16_t tiff_byte_order;    // 0x4949 (little endian)
+    uint16_t tiff_magic;         // 0x002A
+    uint32_t ifd0_offset;        // Offset to IFD0 (8)
+
+    // IFD0
+    uint16_t ifd0_count;
+    EXIFEntry ifd0[EXIF_IFD0_ENTRIES];
+    uint32_t next_ifd;           // 0
+
+    // IFD0 string data
+    char camera_make[16];        // "XIAO ESP32S3\0"
+    char camera_model[16];       // "OV2640\0"
+
+    // IFD1 (thumbnail), linked from next_ifd only when one is attached
+    uint16_t ifd1_count;
+    EXIFEntry ifd1[EXIF_IFD1_ENTRIES];
+    uint32_t ifd1_next;          // 0
+    uint32_t x_resolution[2];    // 72/1
+    uint32_t y_resolution[2];
+    uint16_t ifd1_padding;       // Keeps the rationals 32-bit aligned
+
+    // GPS IFD, first entry (GPSVersionID 2.2.0.0, inline)
+    uint16_t gps_count;
+    EXIFEntry gps_version;
+};
+
+// Per-photo part: the RAM patch region, rewritten by EXIFGPSLayout::setFix()/setTime()
+struct __attribute__((packed)) StaticEXIFPatch {
+    EXIFEntry gps[EXIF_GPS_ENTRIES - 1];  // EXIFGPSEntry order (tag order)
+    uint32_t gps_next_ifd;       // 0
+
+    char datetime[20];           // "YYYY:MM:DD HH:MM:SS\0"
+
+    // GPS rationals (numerator, denominator)
+    uint32_t lat_degrees[2];
+    uint32_t lat_minutes[2];
+    uint32_t lat_seconds[2];
+
+    uint32_t lon_degrees[2];
+    uint32_t lon_minutes[2];
+    uint32_t lon_seconds[2];
+
+    uint32_t altitude[2];
+
+    uint32_t time_hour[2];
+    uint32_t time_minute[2];
+    uint32_t time_second[2];
+
+    uint32_t dop[2];
+    uint32_t speed[2];
+    uint32_t track[2];
+    uint32_t h_error[2];
+
+    char processing_method[12];  // "ASCII\0\0\0" + "RTK"/"GPS" (11 bytes used)
+    char date_stamp[12];         // "YYYY:MM:DD\0" (11 bytes used)
+};
+
+// Complete APP1 segment as inserted after SOI
+struct __attribute__((packed)) StaticEXIFHeader {
+    StaticEXIFFixed fixed;
+    StaticEXIFPatch patch;
+};
+
+static_assert(sizeof(EXIFEntry) == 12, "TIFF IFD entries are 12 bytes");
+
+// One GPS fix as stored in the GPS IFD
+struct EXIFGPSFix {
+    double latitude;             // Degrees, negative = S
+    double longitude;            // Degrees, negative = W
+    float altitude;              // m MSL
+    float accuracy;              // m horizontal (GPSHPositioningError)
+    float hdop;
+    float speed;                 // m/s (stored as km/h)
+    float course;                // Degrees true
+    bool valid;                  // GPSMeasureMode 3 rather than 2
+    bool rtk;                    // GPSProcessingMethod "RTK" rather than "GPS"
+};
+
+class EXIFGPSLayout {
+public:
+    /**
+     * Flash-resident template: header of a photo without a fix or thumbnail
+     */
+    static const StaticEXIFHeader& getTemplate();
+
+    /**
+     * Header of a JPEG starting with SOI and this APP1 segment: the fixed
+     * part matches the template apart from the fields a thumbnail changes
+     *
+     * @return Header inside jpeg, or nullptr
+     */
+    static StaticEXIFHeader* findHeader(uint8_t* jpeg, size_t jpeg_size);
+    static bool isOwnHeader(const uint8_t* jpeg, size_t jpeg_size);
+
+    /**
+     * Write or read position and fix quality (everything in the patch but
+     * date and time). getFix() decodes any denominators, not just ours.
+     */
+    static void setFix(StaticEXIFPatch& patch, const EXIFGPSFix& fix);
+    static void getFix(const StaticEXIFPatch& patch, EXIFGPSFix& fix);
+
+    /**
+     * Write DateTime, GPSDateStamp and GPSTimeStamp (UTC) / read the GPS
+     * date and time back as Unix time with fractional seconds.
+     * setTimeMillis() only rewrites GPSTimeStamp's seconds (ms precision,
+     * denominator 1000) within the second setTime() wrote.
+     *
+     * @return getTime(): false if the date stamp is unset or invalid
+     */
+    static void setTime(StaticEXIFPatch& patch, time_t time, uint16_t millis = 0);
+    static void setTimeMillis(StaticEXIFPatch& patch, time_t time, uint16_t millis);
+    static bool getTime(const StaticEXIFPatch& patch, double& unix_time);
+
+    /**
+     * Link (size > 0) or unlink the IFD1 thumbnail stored right after the
+     * header: APP1 length, IFD0 next-IFD pointer and thumbnail length
+     *
+     * @return false if the thumbnail is larger than getMaxThumbnailSize()
+     */
+    static bool setThumbnail(StaticEXIFFixed& fixed, size_t thumbnail_size);
+
+    /**
+     * File offset of the thumbnail (end of the header) and the largest
+     * thumbnail the APP1 segment can hold
+     */
+    static size_t getThumbnailOffset() { return 2 + sizeof(StaticEXIFHeader); }
+    static size_t getMaxThumbnailSize() { return 0xFFFF - sizeof(StaticEXIFHeader); }  // Segment incl. marker <= 64 KB
+};
+
+#endif // EXIF_GPS_LAYOUT_H
@@ -1,207 +1,67 @@
 #include "exif_gps_static.h"
+#include "psram_manager.h"
+#include "gps_manager.h"
+#include <stddef.h>
 #include <time.h>
 
 // Static member definitions
-StaticEXIFHeader StaticEXIFGPS::exif_header;
+StaticEXIFPatch StaticEXIFGPS::exif_patch;
 bool StaticEXIFGPS::initialized = false;
+EXIFCopyStats StaticEXIFGPS::copy_stats = {};
+time_t StaticEXIFGPS::datetime_time = 0;
 
 bool StaticEXIFGPS::init() {
     Serial.println("Initializing Static EXIF GPS...");
-    initializeHeader();
+    memcpy(&exif_patch, &EXIFGPSLayout::getTemplate().patch, sizeof(exif_patch));
+    datetime_time = 0;
     initialized = true;
-    Serial.printf("Static EXIF GPS initialized, header size: %u bytes\n", sizeof(StaticEXIFHeader));
+    Serial.printf("Static EXIF GPS initialized, header size: %u bytes (%u in RAM)\n",
+                  (unsigned)sizeof(StaticEXIFHeader), (unsigned)sizeof(StaticEXIFPatch));
     return true;
 }
 
-void StaticEXIFGPS::initializeHeader() {
-    memset(&exif_header, 0, sizeof(StaticEXIFHeader));
-
-    // JPEG APP1 marker
-    exif_header.app1_marker = 0xE1FF;  // Little endian: 0xFFE1
-    exif_header.app1_length = sizeof(StaticEXIFHeader) - 2; // Don't count marker itself
-
-    // EXIF identifier
-    strcpy(exif_header.exif_id, "Exif");
-
-    // TIFF header
-    exif_header.tiff_byte_order = TIFF_LITTLE_ENDIAN;
-    exif_header.tiff_magic = TIFF_MAGIC;
-    exif_header.ifd0_offset = 8;
-
-    // IFD0 setup
-    exif_header.ifd0_count = 4; // make, model, datetime, gps_ifd
-
-    // IFD0 Entry 1: Camera make
-    exif_header.make_tag = 0x010F;
-    exif_header.make_type = TIFF_ASCII;
-    exif_header.make_count = 13; // "XIAO ESP32S3\0"
-    exif_header.make_offset = calculateOffset(exif_header.camera_make);
-
-    // IFD0 Entry 2: Camera model
-    exif_header.model_tag = 0x0110;
-    exif_header.model_type = TIFF_ASCII;
-    exif_header.model_count = 7; // "OV2640\0"
-    exif_header.model_offset = calculateOffset(exif_header.camera_model);
-
-    // IFD0 Entry 3: DateTime
-    exif_header.datetime_tag = 0x0132;
-    exif_header.datetime_type = TIFF_ASCII;
-    exif_header.datetime_count = 20; // "YYYY:MM:DD HH:MM:SS\0"
-    exif_header.datetime_offset = calculateOffset(exif_header.datetime);
-
-    // IFD0 Entry 4: GPS IFD pointer
-    exif_header.gps_ifd_tag = 0x8825;
-    exif_header.gps_ifd_type = TIFF_LONG;
-    exif_header.gps_ifd_count = 1;
-    exif_header.gps_ifd_offset = calculateOffset(&exif_header.gps_entry_count);
-
-    // Next IFD pointer (none)
-    exif_header.next_ifd = 0;
-
-    // GPS IFD setup
-    exif_header.gps_entry_count = 8;
-
-    // GPS Entry 1: Version
-    exif_header.gps_version_tag = 0x0000;
-    exif_header.gps_version_type = TIFF_BYTE;
-    exif_header.gps_version_count = 4;
-    exif_header.gps_version_data = 0x00020200; // Version 2.2.0.0
-
-    // GPS Entry 2: Latitude reference
-    exif_header.gps_lat_ref_tag = 0x0001;
-    exif_header.gps_lat_ref_type = TIFF_ASCII;
-    exif_header.gps_lat_ref_count = 2;
-    exif_header.gps_lat_ref_offset = calculateOffset(exif_header.lat_ref);
-
-    // GPS Entry 3: Latitude
-    exif_header.gps_lat_tag = 0x0002;
-    exif_header.gps_lat_type = TIFF_RATIONAL;
-    exif_header.gps_lat_count = 3;
-    exif_header.gps_lat_offset = calculateOffset(exif_header.lat_degrees);
-
-    // GPS Entry 4: Longitude reference
-    exif_header.gps_lon_ref_tag = 0x0003;
-    exif_header.gps_lon_ref_type = TIFF_ASCII;
-    exif_header.gps_lon_ref_count = 2;
-    exif_header.gps_lon_ref_offset = calculateOffset(exif_header.lon_ref);
-
-    // GPS Entry 5: Longitude
-    exif_header.gps_lon_tag = 0x0004;
-    exif_header.gps_lon_type = TIFF_RATIONAL;
-    exif_header.gps_lon_count = 3;
-    exif_header.gps_lon_offset = calculateOffset(exif_header.lon_degrees);
-
-    // GPS Entry 6: Altitude reference
-    exif_header.gps_alt_ref_tag = 0x0005;
-    exif_header.gps_alt_ref_type = TIFF_BYTE;
-    exif_header.gps_alt_ref_count = 1;
-    exif_header.gps_alt_ref_data = 0; // Above sea level
-
-    // GPS Entry 7: Altitude
-    exif_header.gps_alt_tag = 0x0006;
-    exif_header.gps_alt_type = TIFF_RATIONAL;
-    exif_header.gps_alt_count = 1;
-    exif_header.gps_alt_offset = calculateOffset(exif_header.altitude);
-
-    // GPS Entry 8: Timestamp
-    exif_header.gps_time_tag = 0x0007;
-    exif_header.gps_time_type = TIFF_RATIONAL;
-    exif_header.gps_time_count = 3;
-    exif_header.gps_time_offset = calculateOffset(exif_header.time_hour);
-
-    // GPS IFD next pointer (none)
-    exif_header.gps_next_ifd = 0;
-
-    // Initialize string data
-    strcpy(exif_header.camera_make, "XIAO ESP32S3");
-    strcpy(exif_header.camera_model, "OV2640");
-    strcpy(exif_header.datetime, "0000:00:00 00:00:00"); // Will be updated
-    strcpy(exif_header.lat_ref, "N");
-    strcpy(exif_header.lon_ref, "E");
-
-    // Initialize GPS coordinates to zero
-    memset(exif_header.lat_degrees, 0, sizeof(exif_header.lat_degrees));
-    memset(exif_header.lat_minutes, 0, sizeof(exif_header.lat_minutes));
-    memset(exif_header.lat_seconds, 0, sizeof(exif_header.lat_seconds));
-    memset(exif_header.lon_degrees, 0, sizeof(exif_header.lon_degrees));
-    memset(exif_header.lon_minutes, 0, sizeof(exif_header.lon_minutes));
-    memset(exif_header.lon_seconds, 0, sizeof(exif_header.lon_seconds));
-    memset(exif_header.altitude, 0, sizeof(exif_header.altitude));
-    memset(exif_header.time_hour, 0, sizeof(exif_header.time_hour));
-    memset(exif_header.time_minute, 0, sizeof(exif_header.time_minute));
-    memset(exif_header.time_second, 0, sizeof(exif_header.time_second));
+EXIFGPSFix StaticEXIFGPS::toFix(const GPSPosition& position) {
+    EXIFGPSFix fix;
+    fix.latitude = position.latitude;
+    fix.longitude = position.longitude;
+    fix.altitude = position.altitude;
+    fix.accuracy = position.accuracy;
+    fix.hdop = position.hdop;
+    fix.speed = position.speed;
+    fix.course = position.course;
+    fix.valid = position.fixQuality != GPS_FIX_INVALID;
+    fix.rtk = position.fixQuality == GPS_FIX_RTK_FIXED || position.fixQuality == GPS_FIX_RTK_FLOAT;
+    return fix;
 }
 
-uint32_t StaticEXIFGPS::calculateOffset(void* field) {
-    // Calculate offset from start of TIFF header (after EXIF identifier)
-    uint8_t* base = (uint8_t*)&exif_header.tiff_byte_order;
-    uint8_t* target = (uint8_t*)field;
-    return (uint32_t)(target - base);
-}
-
-void StaticEXIFGPS::updateGPS(double latitude, double longitude, float altitude,
-                             uint32_t timestamp, uint8_t fix_quality) {
+void StaticEXIFGPS::updateGPS(const GPSPosition& position, uint32_t timestamp, uint16_t millis) {
     if (!initialized) return;
 
-    // Update latitude
-    double abs_lat = fabs(latitude);
-    uint32_t lat_deg = (uint32_t)abs_lat;
-    double lat_min_float = (abs_lat - lat_deg) * 60.0;
-    uint32_t lat_min = (uint32_t)lat_min_float;
-    uint32_t lat_sec = (uint32_t)((lat_min_float - lat_min) * 60.0 * GPS_COORD_SCALE);
-
-    exif_header.lat_degrees[0] = lat_deg;
-    exif_header.lat_degrees[1] = 1;
-    exif_header.lat_minutes[0] = lat_min;
-    exif_header.lat_minutes[1] = 1;
-    exif_header.lat_seconds[0] = lat_sec;
-    exif_header.lat_seconds[1] = GPS_COORD_SCALE;
-
-    exif_header.lat_ref[0] = (latitude >= 0) ? 'N' : 'S';
-    exif_header.lat_ref[1] = '\0';
-
-    // Update longitude
-    double abs_lon = fabs(longitude);
-    uint32_t lon_deg = (uint32_t)abs_lon;
-    double lon_min_float = (abs_lon - lon_deg) * 60.0;
-    uint32_t lon_min = (uint32_t)lon_min_float;
-    uint32_t lon_sec = (uint32_t)((lon_min_float - lon_min) * 60.0 * GPS_COORD_SCALE);
-
-    exif_header.lon_degrees[0] = lon_deg;
-    exif_header.lon_degrees[1] = 1;
-    exif_header.lon_minutes[0] = lon_min;
-    exif_header.lon_minutes[1] = 1;
-    exif_header.lon_seconds[0] = lon_sec;
-    exif_header.lon_seconds[1] = GPS_COORD_SCALE;
-
-    exif_header.lon_ref[0] = (longitude >= 0) ? 'E' : 'W';
-    exif_header.lon_ref[1] = '\0';
-
-    // Update altitude
-    uint32_t alt_scaled = (uint32_t)(fabs(altitude) * GPS_ALT_SCALE);
-    exif_header.altitude[0] = alt_scaled;
-    exif_header.altitude[1] = GPS_ALT_SCALE;
-
-    // Update timestamp
-    time_t time_val = (timestamp > 0) ? timestamp : time(nullptr);
-    struct tm* gmt = gmtime(&time_val);
+    EXIFGPSLayout::setFix(exif_patch, toFix(position));
 
-    if (gmt) {
-        // Update datetime string
-        sprintf(exif_header.datetime, "%04d:%02d:%02d %02d:%02d:%02d",
-                gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday,
-                gmt->tm_hour, gmt->tm_min, gmt->tm_sec);
+    // Date and time only change once a second: skip gmtime/sprintf otherwise
+    time_t time_val = (timestamp > 0) ? timestamp : time(nullptr);
+    if (time_val != datetime_time) {
+        EXIFGPSLayout::setTime(exif_patch, time_val, millis);
+        datetime_time = time_val;
+    } else {
+        EXIFGPSLayout::setTimeMillis(exif_patch, time_val, millis);
+    }
+}
 
-        // Update GPS time rationals
-        exif_header.time_hour[0] = gmt->tm_hour;
-        exif_header.time_hour[1] = 1;
-        exif_header.time_minute[0] = gmt->tm_min;
-        exif_header.time_minute[1] = 1;
-        exif_header.time_second[0] = gmt->tm_sec;
-        exif_header.time_second[1] = 1;
+bool StaticEXIFGPS::patchPosition(uint8_t* jpeg, size_t jpeg_size, const GPSPosition& position) {
+    StaticEXIFHeader* header = initialized ? EXIFGPSLayout::findHeader(jpeg, jpeg_size) : nullptr;
+    if (!header) {
+        return false;
     }
 
-    Serial.printf("EXIF GPS updated: %.6f, %.6f @ %.1fm\n", latitude, longitude, altitude);
+    EXIFGPSLayout::setFix(header->patch, toFix(position));
+    return true;
+}
+
+bool StaticEXIFGPS::attachThumbnail(uint8_t* jpeg, size_t jpeg_size, size_t thumbnail_size) {
+    StaticEXIFHeader* header = initialized ? EXIFGPSLayout::findHeader(jpeg, jpeg_size) : nullptr;
+    return header && EXIFGPSLayout::setThumbnail(header->fixed, thumbnail_size);
 }
 
 size_t StaticEXIFGPS::embedIntoJPEG(uint8_t* jpeg_buffer, size_t jpeg_size, size_t max_buffer_size) {
@@ -225,33 +85,580 @@ size_t StaticEXIFGPS::embedIntoJPEG(uint8_t* jpeg_buffer, size_t jpeg_size, size
     // Make space for EXIF header (insert after SOI)
     memmove(jpeg_buffer + 2 + header_size, jpeg_buffer + 2, jpeg_size - 2);
 
-    // Copy EXIF header
-    memcpy(jpeg_buffer + 2, &exif_header, header_size);
+    // Copy EXIF header: template fixed part, then the patch
+    memcpy(jpeg_buffer + 2, &EXIFGPSLayout::getTemplate().fixed, sizeof(StaticEXIFFixed));
+    memcpy(jpeg_buffer + 2 + sizeof(StaticEXIFFixed), &exif_patch, sizeof(StaticEXIFPatch));
+
+    copy_stats.embedFallbacks++;
+    copy_stats.bytesCopied += (jpeg_size - 2) + header_size;
 
-    Serial.printf("Static EXIF embedded: %u bytes added\n", header_size);
     return jpeg_size + header_size;
 }
 
+size_t StaticEXIFGPS::getWritePieces(const uint8_t* jpeg, size_t jpeg_size,
+                                     EXIFWritePiece pieces[EXIF_WRITE_PIECES]) {
+    if (!initialized || !jpeg || jpeg_size < 4) {
+        return 0;
+    }
+
+    // Check JPEG SOI marker
+    if (jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        Serial.println("Invalid JPEG format for EXIF embedding");
+        return 0;
+    }
+
+    pieces[0].data = jpeg;                       // SOI
+    pieces[0].length = 2;
+    pieces[1].data = (const uint8_t*)&EXIFGPSLayout::getTemplate().fixed; // Flash
+    pieces[1].length = sizeof(StaticEXIFFixed);
+    pieces[2].data = (const uint8_t*)&exif_patch;
+    pieces[2].length = sizeof(StaticEXIFPatch);
+    pieces[3].data = jpeg + 2;                   // Remaining segments + EOI
+    pieces[3].length = jpeg_size - 2;
+
+    return jpeg_size + sizeof(StaticEXIFHeader);
+}
+
+size_t StaticEXIFGPS::writeWithEXIF(Print& out, const uint8_t* jpeg, size_t jpeg_size) {
+    EXIFWritePiece pieces[EXIF_WRITE_PIECES];
+    size_t total = getWritePieces(jpeg, jpeg_size, pieces);
+    if (total == 0) {
+        return 0;
+    }
+
+    size_t written = 0;
+    for (int i = 0; i < EXIF_WRITE_PIECES; i++) {
+        written += out.write(pieces[i].data, pieces[i].length);
+    }
+
+    if (written != total) {
+        return 0;
+    }
+
+    copy_stats.scatterWrites++;
+    return written;
+}
+
+size_t StaticEXIFGPS::copyWithEXIF(uint8_t* dest, size_t dest_size,
+                                   const uint8_t* jpeg, size_t jpeg_size) {
+    EXIFWritePiece pieces[EXIF_WRITE_PIECES];
+    size_t total = getWritePieces(jpeg, jpeg_size, pieces);
+    if (total == 0 || !dest || total > dest_size) {
+        return 0;
+    }
+
+    uint8_t* p = dest;
+    for (int i = 0; i < EXIF_WRITE_PIECES; i++) {
+        memcpy(p, pieces[i].data, pieces[i].length);
+        p += pieces[i].length;
+    }
+
+    copy_stats.scatterWrites++;
+    copy_stats.bytesCopied += total;
+    return total;
+}
+
 bool StaticEXIFGPS::hasValidGPS() {
     // Check if latitude or longitude is non-zero
-    return (exif_header.lat_degrees[0] != 0 || exif_header.lon_degrees[0] != 0);
+    return (exif_patch.lat_degrees[0] != 0 || exif_patch.lon_degrees[0] != 0);
 }
 
 void StaticEXIFGPS::getCurrentGPS(double* lat, double* lon, float* alt) {
     if (!lat || !lon || !alt) return;
 
-    // Reconstruct latitude
-    *lat = exif_header.lat_degrees[0] +
-           (double)exif_header.lat_minutes[0] / 60.0 +
-           (double)exif_header.lat_seconds[0] / GPS_COORD_SCALE / 3600.0;
-    if (exif_header.lat_ref[0] == 'S') *lat = -*lat;
-
-    // Reconstruct longitude
-    *lon = exif_header.lon_degrees[0] +
-           (double)exif_header.lon_minutes[0] / 60.0 +
-           (double)exif_header.lon_seconds[0] / GPS_COORD_SCALE / 3600.0;
-    if (exif_header.lon_ref[0] == 'W') *lon = -*lon;
-
-    // Reconstruct altitude
-    *alt = (float)exif_header.altitude[0] / GPS_ALT_SCALE;
-}
\ No newline at end of file
+    EXIFGPSFix fix;
+    EXIFGPSLayout::getFix(exif_patch, fix);
+    *lat = fix.latitude;
+    *lon = fix.longitude;
+    *alt = fix.altitude;
+}
+
+bool StaticEXIFGPS::runCopyBenchmark(size_t frame_size, uint16_t iterations) {
+    Serial.println("\n=== EXIF Copy Benchmark ===");
+
+    if (!initialized || frame_size < 4 || iterations == 0) {
+        Serial.println("FAIL: EXIF not initialized or bad parameters");
+        return false;
+    }
+
+    size_t out_size = frame_size + sizeof(StaticEXIFHeader);
+    uint8_t* frame = (uint8_t*)PSRAM_MALLOC(frame_size);
+    uint8_t* out = (uint8_t*)PSRAM_MALLOC(out_size);
+    if (!frame || !out) {
+        Serial.println("FAIL: Could not allocate benchmark buffers");
+        PSRAM_FREE(frame);
+        PSRAM_FREE(out);
+        return false;
+    }
+
+    // Synthetic JPEG: SOI, payload, EOI
+    for (size_t i = 0; i < frame_size; i++) {
+        frame[i] = (uint8_t)(i * 31);
+    }
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    frame[frame_size - 2] = 0xFF;
+    frame[frame_size - 1] = 0xD9;
+
+    EXIFCopyStats saved = copy_stats;
+
+    // Old path: copy frame into a new buffer, then shift it to insert APP1
+    resetCopyStats();
+    unsigned long start = micros();
+    for (uint16_t i = 0; i < iterations; i++) {
+        memcpy(out, frame, frame_size);
+        copy_stats.bytesCopied += frame_size;
+        embedIntoJPEG(out, frame_size, out_size);
+    }
+    unsigned long embed_us = (micros() - start) / iterations;
+    uint64_t embed_bytes = copy_stats.bytesCopied / iterations;
+    bool embed_ok = (out[2] == 0xFF && out[3] == 0xE1 && out[out_size - 1] == 0xD9);
+
+    // New path: single pass SOI + header + remainder
+    resetCopyStats();
+    start = micros();
+    for (uint16_t i = 0; i < iterations; i++) {
+        copyWithEXIF(out, out_size, frame, frame_size);
+    }
+    unsigned long scatter_us = (micros() - start) / iterations;
+    uint64_t scatter_bytes = copy_stats.bytesCopied / iterations;
+    bool scatter_ok = (out[2] == 0xFF && out[3] == 0xE1 && out[out_size - 1] == 0xD9);
+
+    copy_stats = saved;
+    PSRAM_FREE(frame);
+    PSRAM_FREE(out);
+
+    Serial.printf("Frame: %u bytes, %u iterations\n", (unsigned)frame_size, iterations);
+    Serial.printf("memcpy+embed: %lu us/frame, %lu bytes copied/frame, output %s\n",
+                  embed_us, (unsigned long)embed_bytes, embed_ok ? "PASS" : "FAIL");
+    Serial.printf("scatter copy: %lu us/frame, %lu bytes copied/frame, output %s\n",
+                  scatter_us, (unsigned long)scatter_bytes, scatter_ok ? "PASS" : "FAIL");
+    Serial.println("scatter write to file: 0 bytes copied/frame");
+
+    bool passed = embed_ok && scatter_ok && scatter_bytes < embed_bytes;
+    Serial.printf("Overall Result: %s\n", passed ? "PASS" : "FAIL");
+    return passed;
+}
+
+// --- Round-trip test: independent reader working on bytes only ---
+
+struct ParsedEXIF {
+    double latitude;
+    double longitude;
+    double altitude;
+    char datetime[20];
+    uint8_t version[4];
+    uint32_t time[3];
+    char measure_mode;
+    char speed_ref;
+    char track_ref;
+    double dop;
+    double speed;
+    double track;
+    double h_error;
+    char method[12];
+    char date_stamp[11];
+    const uint8_t* thumbnail;    // JPEG from IFD1, nullptr if none
+    uint32_t thumbnail_size;
+};
+
+static uint16_t readLE16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLE32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Value bytes of an IFD entry: inline if 4 bytes or less, else at its offset
+static const uint8_t* entryValue(const uint8_t* tiff, size_t tiff_size, const uint8_t* entry,
+                                 uint16_t type, uint32_t min_count) {
+    static const uint8_t SIZES[] = {0, 1, 1, 2, 4, 8, 0, 1};
+    if (readLE16(entry + 2) != type || type >= sizeof(SIZES) || SIZES[type] == 0 ||
+        readLE32(entry + 4) < min_count) {
+        return nullptr;
+    }
+    uint32_t size = SIZES[type] * readLE32(entry + 4);
+    if (size <= 4) {
+        return entry + 8;
+    }
+    uint32_t offset = readLE32(entry + 8);
+    return (offset + size <= tiff_size) ? tiff + offset : nullptr;
+}
+
+static double readRational(const uint8_t* p) {
+    uint32_t den = readLE32(p + 4);
+    return den ? (double)readLE32(p) / den : NAN;
+}
+
+static double readDMS(const uint8_t* p) {
+    double v = 0;
+    static const double UNITS[] = {1.0, 60.0, 3600.0};
+    for (int i = 0; i < 3; i++) {
+        uint32_t den = readLE32(p + i * 8 + 4);
+        if (den == 0) return NAN;
+        v += (double)readLE32(p + i * 8) / den / UNITS[i];
+    }
+    return v;
+}
+
+static bool parseEXIF(const uint8_t* jpeg, size_t size, ParsedEXIF& out) {
+    // SOI, APP1 (big-endian length), next marker right after the segment
+    if (size < 20 || jpeg[0] != 0xFF || jpeg[1] != 0xD8 || jpeg[2] != 0xFF || jpeg[3] != 0xE1) {
+        return false;
+    }
+    size_t length = (jpeg[4] << 8) | jpeg[5];
+    if (4 + length >= size || jpeg[4 + length] != 0xFF || memcmp(jpeg + 6, "Exif\0\0", 6) != 0) {
+        return false;
+    }
+    const uint8_t* tiff = jpeg + 12;
+    size_t tiff_size = length - 8;
+    if (tiff[0] != 'I' || tiff[1] != 'I' || readLE16(tiff + 2) != 42) {
+        return false;
+    }
+
+    // IFD0: DateTime and the GPS IFD pointer; tags must ascend
+    uint32_t ifd = readLE32(tiff + 4);
+    if (ifd % 2 != 0 || ifd + 2 > tiff_size) return false;
+    uint16_t count = readLE16(tiff + ifd);
+    if (ifd + 2 + count * 12 + 4 > tiff_size) return false;
+    uint32_t gps_ifd = 0;
+    bool have_datetime = false;
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t* e = tiff + ifd + 2 + i * 12;
+        uint16_t tag = readLE16(e);
+        if (i > 0 && tag <= readLE16(e - 12)) return false;
+        if (tag == 0x0132) {
+            const uint8_t* v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 20);
+            if (!v || v[19] != '\0') return false;
+            memcpy(out.datetime, v, 20);
+            have_datetime = true;
+        } else if (tag == 0x8825) {
+            const uint8_t* v = entryValue(tiff, tiff_size, e, TIFF_LONG, 1);
+            if (!v) return false;
+            gps_ifd = readLE32(v);
+        }
+    }
+    if (!have_datetime || gps_ifd == 0 || gps_ifd % 2 != 0 || gps_ifd + 2 > tiff_size) {
+        return false;
+    }
+
+    // IFD1: JPEG thumbnail inside the segment
+    out.thumbnail = nullptr;
+    out.thumbnail_size = 0;
+    uint32_t ifd1 = readLE32(tiff + ifd + 2 + count * 12);
+    if (ifd1 != 0) {
+        if (ifd1 % 2 != 0 || ifd1 + 2 > tiff_size) return false;
+        count = readLE16(tiff + ifd1);
+        if (ifd1 + 2 + count * 12 + 4 > tiff_size) return false;
+        uint32_t compression = 0, offset = 0, size = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            const uint8_t* e = tiff + ifd1 + 2 + i * 12;
+            uint16_t tag = readLE16(e);
+            if (i > 0 && tag <= readLE16(e - 12)) return false;
+            const uint8_t* v = e;
+            if (tag == 0x0103 && (v = entryValue(tiff, tiff_size, e, TIFF_SHORT, 1))) {
+                compression = readLE16(v);
+            } else if (tag == 0x0201 && (v = entryValue(tiff, tiff_size, e, TIFF_LONG, 1))) {
+                offset = readLE32(v);
+            } else if (tag == 0x0202 && (v = entryValue(tiff, tiff_size, e, TIFF_LONG, 1))) {
+                size = readLE32(v);
+            }
+            if (!v) return false;
+        }
+        if (compression != 6 || size == 0 || offset + size > tiff_size) return false;
+        out.thumbnail = tiff + offset;
+        out.thumbnail_size = size;
+    }
+
+    // GPS IFD
+    count = readLE16(tiff + gps_ifd);
+    if (gps_ifd + 2 + count * 12 + 4 > tiff_size) return false;
+    char lat_ref = 0, lon_ref = 0;
+    int alt_ref = -1;
+    out.latitude = out.longitude = out.altitude = NAN;
+    out.dop = out.speed = out.track = out.h_error = NAN;
+    out.measure_mode = out.speed_ref = out.track_ref = 0;
+    memset(out.method, 0, sizeof(out.method));
+    memset(out.date_stamp, 0, sizeof(out.date_stamp));
+    memset(out.version, 0, sizeof(out.version));
+    memset(out.time, 0xFF, sizeof(out.time));
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t* e = tiff + gps_ifd + 2 + i * 12;
+        uint16_t tag = readLE16(e);
+        if (i > 0 && tag <= readLE16(e - 12)) return false;
+        const uint8_t* v = nullptr;
+        switch (tag) {
+            case 0x0000:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_BYTE, 4))) memcpy(out.version, v, 4);
+                break;
+            case 0x0001:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 2))) lat_ref = v[0];
+                break;
+            case 0x0002:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 3))) out.latitude = readDMS(v);
+                break;
+            case 0x0003:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 2))) lon_ref = v[0];
+                break;
+            case 0x0004:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 3))) out.longitude = readDMS(v);
+                break;
+            case 0x0005:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_BYTE, 1))) alt_ref = v[0];
+                break;
+            case 0x0006:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 1))) out.altitude = readRational(v);
+                break;
+            case 0x0007:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 3))) {
+                    for (int t = 0; t < 3; t++) {
+                        uint32_t den = readLE32(v + t * 8 + 4);
+                        out.time[t] = den ? readLE32(v + t * 8) / den : 0xFFFFFFFF;
+                    }
+                }
+                break;
+            case 0x000A:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 2))) out.measure_mode = v[0];
+                break;
+            case 0x000B:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 1))) out.dop = readRational(v);
+                break;
+            case 0x000C:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 2))) out.speed_ref = v[0];
+                break;
+            case 0x000D:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 1))) out.speed = readRational(v);
+                break;
+            case 0x000E:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 2))) out.track_ref = v[0];
+                break;
+            case 0x000F:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 1))) out.track = readRational(v);
+                break;
+            case 0x001B: {
+                // Character code, then text without a terminator
+                uint32_t n = readLE32(e + 4);
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_UNDEFINED, 8)) &&
+                    memcmp(v, "ASCII\0\0\0", 8) == 0 && n - 8 < sizeof(out.method)) {
+                    memcpy(out.method, v + 8, n - 8);
+                } else {
+                    v = nullptr;
+                }
+                break;
+            }
+            case 0x001D:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_ASCII, 11)) && v[10] == '\0') {
+                    memcpy(out.date_stamp, v, 11);
+                } else {
+                    v = nullptr;
+                }
+                break;
+            case 0x001F:
+                if ((v = entryValue(tiff, tiff_size, e, TIFF_RATIONAL, 1))) out.h_error = readRational(v);
+                break;
+            default:
+                v = e; // Other tags are not checked
+                break;
+        }
+        if (!v) return false;
+    }
+    if ((lat_ref != 'N' && lat_ref != 'S') || (lon_ref != 'E' && lon_ref != 'W') ||
+        (alt_ref != 0 && alt_ref != 1)) {
+        return false;
+    }
+    if (lat_ref == 'S') out.latitude = -out.latitude;
+    if (lon_ref == 'W') out.longitude = -out.longitude;
+    if (alt_ref == 1) out.altitude = -out.altitude;
+    return true;
+}
+
+struct RoundTripCase {
+    double latitude;
+    double longitude;
+    float altitude;
+    float accuracy;
+    float hdop;
+    float speed;
+    float course;
+    uint8_t fixQuality;
+};
+
+static GPSPosition toPosition(const RoundTripCase& c) {
+    GPSPosition pos;
+    pos.latitude = c.latitude;
+    pos.longitude = c.longitude;
+    pos.altitude = c.altitude;
+    pos.accuracy = c.accuracy;
+    pos.hdop = c.hdop;
+    pos.speed = c.speed;
+    pos.course = c.course;
+    pos.fixQuality = c.fixQuality;
+    pos.valid = c.fixQuality != GPS_FIX_INVALID;
+    return pos;
+}
+
+static bool matchesCase(const ParsedEXIF& p, const RoundTripCase& c) {
+    // Seconds are truncated to 1e-6 arcsec, altitude to 1 mm; others rounded
+    bool rtk = c.fixQuality == GPS_FIX_RTK_FIXED || c.fixQuality == GPS_FIX_RTK_FLOAT;
+    return fabs(p.latitude - c.latitude) < 1e-6 && fabs(p.longitude - c.longitude) < 1e-6 &&
+           fabs(p.altitude - c.altitude) < 0.002 &&
+           fabs(p.dop - c.hdop) < 0.006 && fabs(p.speed - c.speed * 3.6) < 0.006 &&
+           fabs(p.track - c.course) < 0.006 && fabs(p.h_error - c.accuracy) < 0.0006 &&
+           p.measure_mode == (c.fixQuality != GPS_FIX_INVALID ? '3' : '2') &&
+           p.speed_ref == 'K' && p.track_ref == 'T' && strcmp(p.method, rtk ? "RTK" : "GPS") == 0;
+}
+
+bool StaticEXIFGPS::runRoundTripTest() {
+    Serial.println("\n=== EXIF Round-Trip Test ===");
+    if (!initialized) {
+        Serial.println("FAIL: EXIF not initialized");
+        return false;
+    }
+
+    static const RoundTripCase CASES[] = {
+        {-33.8567844, 151.2152967, 58.25f, 0.014f, 0.62f, 12.5f, 271.3f, GPS_FIX_RTK_FIXED},  // S/E
+        {37.8199286, -122.4782551, 227.0f, 1.8f, 0.9f, 0.0f, 0.0f, GPS_FIX_GPS},             // N/W
+        {-54.8019121, -68.3029511, 12.5f, 0.35f, 1.1f, 8.0f, 359.99f, GPS_FIX_RTK_FLOAT},    // S/W
+        {31.5590000, 35.4732000, -430.5f, 2.5f, 1.4f, 3.0f, 90.0f, GPS_FIX_DGPS},            // Below sea level
+        {0.0, 0.0, 0.0f, 999.0f, 99.99f, 0.0f, 0.0f, GPS_FIX_INVALID}                        // No fix
+    };
+    const uint32_t timestamp = 1700000000;     // 2023:11:14 22:13:20 UTC
+
+    // Synthetic JPEG: SOI, DQT marker, payload, EOI
+    uint8_t frame[64];
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        frame[i] = (uint8_t)(i * 31);
+    }
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    frame[2] = 0xFF;
+    frame[3] = 0xDB;
+    frame[sizeof(frame) - 2] = 0xFF;
+    frame[sizeof(frame) - 1] = 0xD9;
+    uint8_t out[sizeof(frame) + sizeof(StaticEXIFHeader)];
+
+    // The live header is restored afterwards
+    StaticEXIFPatch saved_patch = exif_patch;
+    time_t saved_time = datetime_time;
+    EXIFCopyStats saved_stats = copy_stats;
+    int passed = 0;
+    int total = 0;
+    ParsedEXIF parsed = {};
+
+    // Positions in every hemisphere, through copyWithEXIF
+    int good = 0;
+    const int cases = sizeof(CASES) / sizeof(CASES[0]);
+    for (int i = 0; i < cases; i++) {
+        updateGPS(toPosition(CASES[i]), timestamp);
+        size_t size = copyWithEXIF(out, sizeof(out), frame, sizeof(frame));
+        if (size == sizeof(out) && parseEXIF(out, size, parsed) && matchesCase(parsed, CASES[i])) {
+            good++;
+        } else {
+            Serial.printf("  Case %d: %.7f, %.7f @ %.3fm read back as %.7f, %.7f @ %.3fm, "
+                          "DOP %.2f, %.2f km/h, track %.2f, error %.3fm, mode %c, %s\n", i,
+                          CASES[i].latitude, CASES[i].longitude, CASES[i].altitude,
+                          parsed.latitude, parsed.longitude, parsed.altitude, parsed.dop,
+                          parsed.speed, parsed.track, parsed.h_error,
+                          parsed.measure_mode ? parsed.measure_mode : '?', parsed.method);
+        }
+    }
+    total++;
+    if (good == cases) {
+        passed++;
+        Serial.printf("PASS: %d positions and fix qualities read back by an independent parser\n",
+                      cases);
+    } else {
+        Serial.printf("FAIL: %d/%d positions read back\n", good, cases);
+    }
+
+    // Fields other than the position
+    total++;
+    bool segment_ok = (((out[4] << 8) | out[5]) + 4 == 2 + sizeof(StaticEXIFHeader)) &&
+                      memcmp(out + 2 + sizeof(StaticEXIFHeader), frame + 2, sizeof(frame) - 2) == 0;
+    bool fields_ok = parsed.version[0] == 2 && parsed.version[1] == 2 && parsed.version[2] == 0 &&
+                     parsed.version[3] == 0 && strcmp(parsed.datetime, "2023:11:14 22:13:20") == 0 &&
+                     parsed.time[0] == 22 && parsed.time[1] == 13 && parsed.time[2] == 20 &&
+                     strcmp(parsed.date_stamp, "2023:11:14") == 0;
+    if (segment_ok && fields_ok) {
+        passed++;
+        Serial.println("PASS: APP1 length, GPS version 2.2.0.0, DateTime, GPS date and time");
+    } else {
+        Serial.printf("FAIL: Segment %s, version %u.%u.%u.%u, DateTime \"%.19s\", "
+                      "GPS %.10s %u:%u:%u\n", segment_ok ? "ok" : "bad", parsed.version[0],
+                      parsed.version[1], parsed.version[2], parsed.version[3], parsed.datetime,
+                      parsed.date_stamp, parsed.time[0], parsed.time[1], parsed.time[2]);
+    }
+
+    // patchPosition on a copied frame, leaving the time alone
+    total++;
+    bool patched = patchPosition(out, sizeof(out), toPosition(CASES[0])) &&
+                   parseEXIF(out, sizeof(out), parsed) && matchesCase(parsed, CASES[0]) &&
+                   strcmp(parsed.datetime, "2023:11:14 22:13:20") == 0;
+    bool foreign_rejected = !patchPosition(frame, sizeof(frame), toPosition(CASES[4]));
+    if (patched && foreign_rejected) {
+        passed++;
+        Serial.println("PASS: patchPosition rewrites our header and rejects other JPEGs");
+    } else {
+        Serial.printf("FAIL: patchPosition %s, foreign JPEG %s\n", patched ? "ok" : "bad",
+                      foreign_rejected ? "rejected" : "accepted");
+    }
+
+    // Thumbnail: header patched in the buffer, bytes inserted after it
+    total++;
+    static const uint8_t THUMBNAIL[] = {0xFF, 0xD8, 0xFF, 0xDB, 0x00, 0x04, 0x01, 0x02,
+                                        0x5A, 0xA5, 0x3C, 0xC3, 0x00, 0xFF, 0xD9};
+    uint8_t with_thumbnail[sizeof(out) + sizeof(THUMBNAIL)];
+    size_t split = getThumbnailOffset();
+    updateGPS(toPosition(CASES[2]), timestamp);
+    size_t size = copyWithEXIF(out, sizeof(out), frame, sizeof(frame));
+    bool attached = size == sizeof(out) && attachThumbnail(out, size, sizeof(THUMBNAIL));
+    memcpy(with_thumbnail, out, split);
+    memcpy(with_thumbnail + split, THUMBNAIL, sizeof(THUMBNAIL));
+    memcpy(with_thumbnail + split + sizeof(THUMBNAIL), out + split, sizeof(out) - split);
+    bool thumbnail_ok = attached && parseEXIF(with_thumbnail, sizeof(with_thumbnail), parsed) &&
+                        matchesCase(parsed, CASES[2]) && parsed.thumbnail_size == sizeof(THUMBNAIL) &&
+                        memcmp(parsed.thumbnail, THUMBNAIL, sizeof(THUMBNAIL)) == 0 &&
+                        memcmp(with_thumbnail + split + sizeof(THUMBNAIL), frame + 2,
+                               sizeof(frame) - 2) == 0;
+    // Position still patchable with a thumbnail; detaching restores the plain header
+    thumbnail_ok = thumbnail_ok &&
+                   patchPosition(with_thumbnail, sizeof(with_thumbnail), toPosition(CASES[3])) &&
+                   parseEXIF(with_thumbnail, sizeof(with_thumbnail), parsed) &&
+                   matchesCase(parsed, CASES[3]) && parsed.thumbnail_size == sizeof(THUMBNAIL);
+    bool detached = attachThumbnail(out, size, 0) && parseEXIF(out, size, parsed) &&
+                    parsed.thumbnail == nullptr &&
+                    memcmp(out + 2, &EXIFGPSLayout::getTemplate().fixed, sizeof(StaticEXIFFixed)) == 0;
+    if (thumbnail_ok && detached) {
+        passed++;
+        Serial.println("PASS: IFD1 thumbnail read back; patchable and detachable in place");
+    } else {
+        Serial.printf("FAIL: Thumbnail %s, detach %s\n", thumbnail_ok ? "ok" : "bad",
+                      detached ? "ok" : "bad");
+    }
+
+    // updateGPS cost: same second (position only) and a new second each call
+    const uint32_t iterations = 1000;
+    GPSPosition pos = toPosition(CASES[0]);
+    unsigned long start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pos.latitude += 1e-6;
+        updateGPS(pos, timestamp);
+    }
+    unsigned long same_ns = (micros() - start) * 1000 / iterations;
+    start = micros();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pos.latitude += 1e-6;
+        updateGPS(pos, timestamp + 1 + i);
+    }
+    unsigned long new_ns = (micros() - start) * 1000 / iterations;
+    Serial.printf("updateGPS: %lu ns/call same second, %lu ns/call new second\n", same_ns, new_ns);
+
+    exif_patch = saved_patch;
+    datetime_time = saved_time;
+    copy_stats = saved_stats;
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
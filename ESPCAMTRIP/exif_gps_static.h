@@ -2,6 +2,9 @@
 #define EXIF_GPS_STATIC_H
 
 #include <Arduino.h>
+#include "exif_gps_layout.h"
+
+struct GPSPosition;
 
 /**
  * Static EXIF GPS Writer for ESP32 (Memory Optimized)
@@ -9,154 +12,54 @@
  * Based on ESP32-CAM_Interval approach with static allocation
  * Pre-builds complete TIFF/EXIF structure for in-place GPS updates
  *
+ * The APP1 segment and its encoding are in exif_gps_layout.h (portable,
+ * shared with tools/regeotag.cpp). The template stays in flash; only the
+ * per-photo StaticEXIFPatch tail is copied to RAM at init and written
+ * separately (an extra scatter piece).
+ *
+ * Besides position and time the GPS IFD carries the fix quality for
+ * photogrammetry tools that weight camera positions: GPSMeasureMode,
+ * GPSDOP (HDOP), GPSSpeed (km/h), GPSTrack (true), GPSProcessingMethod
+ * ("RTK" for RTK fixed/float, else "GPS"), GPSDateStamp and
+ * GPSHPositioningError (GPSPosition::accuracy). All fields are fixed-size,
+ * so every update is an in-place patch.
+ *
+ * IFD1 (JPEG thumbnail) is laid out in the template but not linked. To
+ * embed a thumbnail the SD writer patches its copy of the header
+ * (attachThumbnail(): APP1 length, IFD0 next-IFD pointer, thumbnail
+ * length) and writes the thumbnail bytes right after the header; the
+ * thumbnail offset itself is a compile-time constant.
+ *
  * Advantages:
  * - Zero heap allocation during capture
  * - Predictable memory footprint
- * - Fast GPS coordinate updates (~10ms vs 200ms)
+ * - Fast GPS coordinate updates (no layout work at runtime)
  * - No memory fragmentation
  */
 
-// TIFF/EXIF constants
-#define TIFF_LITTLE_ENDIAN 0x4949
-#define TIFF_MAGIC 0x002A
-#define TIFF_RATIONAL 5
-#define TIFF_ASCII 2
-#define TIFF_BYTE 1
-#define TIFF_SHORT 3
-#define TIFF_LONG 4
-
-// GPS coordinate precision
-#define GPS_COORD_SCALE 1000000  // 6 decimal places
-#define GPS_ALT_SCALE 1000       // 3 decimal places
-
-// JPEG/EXIF header structure (pre-allocated)
-struct __attribute__((packed)) StaticEXIFHeader {
-    // JPEG APP1 marker
-    uint16_t app1_marker;        // 0xFFE1
-    uint16_t app1_length;        // Length of APP1 segment
-
-    // EXIF identifier
-    char exif_id[6];             // "Exif\0\0"
-
-    // TIFF header
-    uint16_t tiff_byte_order;    // 0x4949 (little endian)
-    uint16_t tiff_magic;         // 0x002A
-    uint32_t ifd0_offset;        // Offset to IFD0 (8)
-
-    // IFD0 (Image File Directory)
-    uint16_t ifd0_count;         // Number of entries
-
-    // IFD0 Entry 1: Camera make
-    uint16_t make_tag;           // 0x010F
-    uint16_t make_type;          // TIFF_ASCII
-    uint32_t make_count;         // Length of make string
-    uint32_t make_offset;        // Offset to make string
-
-    // IFD0 Entry 2: Camera model
-    uint16_t model_tag;          // 0x0110
-    uint16_t model_type;         // TIFF_ASCII
-    uint32_t model_count;        // Length of model string
-    uint32_t model_offset;       // Offset to model string
-
-    // IFD0 Entry 3: DateTime
-    uint16_t datetime_tag;       // 0x0132
-    uint16_t datetime_type;      // TIFF_ASCII
-    uint32_t datetime_count;     // 20 ("YYYY:MM:DD HH:MM:SS\0")
-    uint32_t datetime_offset;    // Offset to datetime string
-
-    // IFD0 Entry 4: GPS IFD pointer
-    uint16_t gps_ifd_tag;        // 0x8825
-    uint16_t gps_ifd_type;       // TIFF_LONG
-    uint32_t gps_ifd_count;      // 1
-    uint32_t gps_ifd_offset;     // Offset to GPS IFD
-
-    // Next IFD pointer (none)
-    uint32_t next_ifd;           // 0
-
-    // GPS IFD
-    uint16_t gps_entry_count;    // Number of GPS entries (8)
-
-    // GPS Entry 1: Version
-    uint16_t gps_version_tag;    // 0x0000
-    uint16_t gps_version_type;   // TIFF_BYTE
-    uint32_t gps_version_count;  // 4
-    uint32_t gps_version_data;   // Version bytes (2,2,0,0)
-
-    // GPS Entry 2: Latitude reference
-    uint16_t gps_lat_ref_tag;    // 0x0001
-    uint16_t gps_lat_ref_type;   // TIFF_ASCII
-    uint32_t gps_lat_ref_count;  // 2
-    uint32_t gps_lat_ref_offset; // Offset to lat ref ("N" or "S")
-
-    // GPS Entry 3: Latitude
-    uint16_t gps_lat_tag;        // 0x0002
-    uint16_t gps_lat_type;       // TIFF_RATIONAL
-    uint32_t gps_lat_count;      // 3 (deg, min, sec)
-    uint32_t gps_lat_offset;     // Offset to latitude rationals
-
-    // GPS Entry 4: Longitude reference
-    uint16_t gps_lon_ref_tag;    // 0x0003
-    uint16_t gps_lon_ref_type;   // TIFF_ASCII
-    uint32_t gps_lon_ref_count;  // 2
-    uint32_t gps_lon_ref_offset; // Offset to lon ref ("E" or "W")
-
-    // GPS Entry 5: Longitude
-    uint16_t gps_lon_tag;        // 0x0004
-    uint16_t gps_lon_type;       // TIFF_RATIONAL
-    uint32_t gps_lon_count;      // 3 (deg, min, sec)
-    uint32_t gps_lon_offset;     // Offset to longitude rationals
-
-    // GPS Entry 6: Altitude reference
-    uint16_t gps_alt_ref_tag;    // 0x0005
-    uint16_t gps_alt_ref_type;   // TIFF_BYTE
-    uint32_t gps_alt_ref_count;  // 1
-    uint32_t gps_alt_ref_data;   // 0 (above sea level)
-
-    // GPS Entry 7: Altitude
-    uint16_t gps_alt_tag;        // 0x0006
-    uint16_t gps_alt_type;       // TIFF_RATIONAL
-    uint32_t gps_alt_count;      // 1
-    uint32_t gps_alt_offset;     // Offset to altitude rational
-
-    // GPS Entry 8: Timestamp
-    uint16_t gps_time_tag;       // 0x0007
-    uint16_t gps_time_type;      // TIFF_RATIONAL
-    uint32_t gps_time_count;     // 3 (hour, min, sec)
-    uint32_t gps_time_offset;    // Offset to time rationals
-
-    // GPS IFD next pointer (none)
-    uint32_t gps_next_ifd;       // 0
-
-    // String data area
-    char camera_make[16];        // "XIAO ESP32S3\0"
-    char camera_model[16];       // "OV2640\0"
-    char datetime[20];           // "YYYY:MM:DD HH:MM:SS\0"
-    char lat_ref[2];            // "N\0" or "S\0"
-    char lon_ref[2];            // "E\0" or "W\0"
-
-    // GPS rational data (3 rationals each = 24 bytes)
-    uint32_t lat_degrees[2];     // degrees rational
-    uint32_t lat_minutes[2];     // minutes rational
-    uint32_t lat_seconds[2];     // seconds rational
-
-    uint32_t lon_degrees[2];     // degrees rational
-    uint32_t lon_minutes[2];     // minutes rational
-    uint32_t lon_seconds[2];     // seconds rational
-
-    uint32_t altitude[2];        // altitude rational
-
-    uint32_t time_hour[2];       // hour rational
-    uint32_t time_minute[2];     // minute rational
-    uint32_t time_second[2];     // second rational
+// One contiguous piece of a JPEG+EXIF output stream
+struct EXIFWritePiece {
+    const uint8_t* data;
+    size_t length;
+};
+
+#define EXIF_WRITE_PIECES 4      // SOI, EXIF fixed part, EXIF patch, JPEG remainder
+
+// Copy accounting for the JPEG+EXIF output paths
+struct EXIFCopyStats {
+    uint32_t scatterWrites;      // Frames written/copied as pieces
+    uint32_t embedFallbacks;     // Frames that went through embedIntoJPEG
+    uint64_t bytesCopied;        // Bytes moved in RAM (not counting SD writes)
 };
 
 class StaticEXIFGPS {
 private:
-    static StaticEXIFHeader exif_header;
+    static StaticEXIFPatch exif_patch;
     static bool initialized;
+    static EXIFCopyStats copy_stats;
+    static time_t datetime_time;     // Time currently in exif_patch.datetime
 
-    static void initializeHeader();
-    static uint32_t calculateOffset(void* field);
+    static EXIFGPSFix toFix(const GPSPosition& position);
 
 public:
     /**
@@ -166,21 +69,76 @@ public:
     static bool init();
 
     /**
-     * Update GPS coordinates in pre-allocated header
+     * Update GPS position and fix quality in pre-allocated header
      * Fast in-place update for capture performance
      *
-     * @param latitude Latitude in decimal degrees
-     * @param longitude Longitude in decimal degrees
-     * @param altitude Altitude in meters
+     * @param position Position, accuracy, HDOP, speed, course and fix quality
      * @param timestamp Unix timestamp (0 = use current time)
-     * @param fix_quality GPS fix quality indicator
+     * @param millis Milliseconds into timestamp, for GPSTimeStamp
+     */
+    static void updateGPS(const GPSPosition& position, uint32_t timestamp = 0, uint16_t millis = 0);
+
+    /**
+     * Rewrite the position and fix quality in the EXIF header of a JPEG
+     * built by copyWithEXIF() (APP1 right after SOI); date and time are kept.
+     * Touches only that buffer, so the writer task can refine a queued
+     * frame while the camera task updates the static header.
+     *
+     * @return false if the JPEG does not carry this header
+     */
+    static bool patchPosition(uint8_t* jpeg, size_t jpeg_size, const GPSPosition& position);
+
+    /**
+     * Link or unlink an EXIF thumbnail in the header of a JPEG built by
+     * copyWithEXIF(), in place. The JPEG then describes a file with the
+     * thumbnail bytes inserted at getThumbnailOffset(); the caller writes
+     * them there and calls again with size 0 before the buffer is parsed
+     * as a JPEG again.
+     *
+     * @param thumbnail_size JPEG thumbnail bytes, 0 = no thumbnail
+     * @return false if the JPEG does not carry this header or the
+     *         thumbnail is larger than getMaxThumbnailSize()
+     */
+    static bool attachThumbnail(uint8_t* jpeg, size_t jpeg_size, size_t thumbnail_size);
+
+    /**
+     * File offset of the thumbnail (end of the EXIF header) and the largest
+     * thumbnail the APP1 segment can hold
+     */
+    static size_t getThumbnailOffset() { return EXIFGPSLayout::getThumbnailOffset(); }
+    static size_t getMaxThumbnailSize() { return EXIFGPSLayout::getMaxThumbnailSize(); }
+
+    /**
+     * Describe JPEG+EXIF output as pieces: SOI, EXIF fixed part, EXIF patch,
+     * JPEG from offset 2. Pieces point into the JPEG buffer, the flash template
+     * and the static patch; nothing is copied.
+     * Patch piece reflects the last updateGPS() - consume before the next update.
+     *
+     * @return Total output size, or 0 if the JPEG is invalid
+     */
+    static size_t getWritePieces(const uint8_t* jpeg, size_t jpeg_size,
+                                 EXIFWritePiece pieces[EXIF_WRITE_PIECES]);
+
+    /**
+     * Write JPEG with EXIF straight to a file or stream (no intermediate buffer)
+     *
+     * @return Bytes written, or 0 if the JPEG is invalid or the write was short
+     */
+    static size_t writeWithEXIF(Print& out, const uint8_t* jpeg, size_t jpeg_size);
+
+    /**
+     * Copy JPEG with EXIF into a separate buffer in a single pass
+     * Used to fill capture ring slots without a second copy/memmove
+     *
+     * @return Output size, or 0 if the JPEG is invalid or dest is too small
      */
-    static void updateGPS(double latitude, double longitude, float altitude,
-                         uint32_t timestamp = 0, uint8_t fix_quality = 1);
+    static size_t copyWithEXIF(uint8_t* dest, size_t dest_size,
+                               const uint8_t* jpeg, size_t jpeg_size);
 
     /**
-     * Embed GPS EXIF data into JPEG
-     * Zero allocation - direct memory copy
+     * Embed GPS EXIF data into JPEG in place (fallback path)
+     * Needs header-size headroom and shifts the whole frame; prefer
+     * writeWithEXIF() or copyWithEXIF()
      *
      * @param jpeg_buffer JPEG data buffer
      * @param jpeg_size Current JPEG size
@@ -203,6 +161,28 @@ public:
      * Get current GPS coordinates from header
      */
     static void getCurrentGPS(double* lat, double* lon, float* alt);
+
+    /**
+     * Copy statistics
+     */
+    static EXIFCopyStats getCopyStats() { return copy_stats; }
+    static void resetCopyStats() { memset(&copy_stats, 0, sizeof(copy_stats)); }
+
+    /**
+     * Compare bytes copied and time per frame for the memcpy+embed path
+     * against the single-pass scatter copy, using a synthetic JPEG in PSRAM
+     *
+     * @param frame_size Synthetic JPEG size (e.g. 300 KB for UXGA)
+     * @param iterations Frames per method
+     */
+    static bool runCopyBenchmark(size_t frame_size = 300 * 1024, uint16_t iterations = 20);
+
+    /**
+     * Write headers for known positions, read them back with a separate
+     * byte-level EXIF parser (no StaticEXIFHeader access) and compare;
+     * also times updateGPS()
+     */
+    static bool runRoundTripTest();
 };
 
 #endif // EXIF_GPS_STATIC_H
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "gps_fix_history.h"
+#include "gps_manager.h"
+#include <math.h>
+#include <string.h>
+
+static const double EARTH_RADIUS_M = 6371000.0;
+static const int64_t DAY_US = 86400LL * 1000000LL;
+
+GPSFixHistory::GPSFixHistory()
+    : outputLatencyUs(0), maxGapUs(1000000), maxExtrapolationUs(500000) {
+    reset();
+}
+
+void GPSFixHistory::configure(int64_t outputLatency, int64_t maxGap, int64_t maxExtrapolation) {
+    outputLatencyUs = outputLatency;
+    maxGapUs = maxGap;
+    maxExtrapolationUs = maxExtrapolation;
+    updateClockOffset();
+}
+
+void GPSFixHistory::reset() {
+    memset(fixes, 0, sizeof(fixes));
+    head = 0;
+    count = 0;
+    clockOffsetUs = 0;
+    dayBaseUs = 0;
+}
+
+const GPSFixSample& GPSFixHistory::at(uint8_t age) const {
+    return fixes[(head + GPS_FIX_HISTORY - 1 - age) % GPS_FIX_HISTORY];
+}
+
+void GPSFixHistory::add(const GPSPosition& pos, uint32_t epochMs, int64_t receivedUs) {
+    int64_t utcUs = dayBaseUs + (int64_t)epochMs * 1000;
+
+    if (count > 0) {
+        int64_t newestUtc = at(0).utcUs;
+        if (utcUs < newestUtc - DAY_US / 2) {
+            // Past midnight UTC
+            dayBaseUs += DAY_US;
+            utcUs += DAY_US;
+        } else if (utcUs == newestUtc) {
+            // Another fix sentence for the newest epoch: refresh it in place
+            GPSFixSample& fix = fixes[(head + GPS_FIX_HISTORY - 1) % GPS_FIX_HISTORY];
+            fix.latitude = pos.latitude;
+            fix.longitude = pos.longitude;
+            fix.altitude = pos.altitude;
+            fix.speed = pos.speed;
+            fix.course = pos.course;
+            fix.unixTime = pos.timestamp;
+            return;
+        } else if (utcUs < newestUtc) {
+            // Receiver time went backwards (restart): start over
+            reset();
+            utcUs = (int64_t)epochMs * 1000;
+        }
+    }
+
+    GPSFixSample& fix = fixes[head];
+    fix.utcUs = utcUs;
+    fix.receivedUs = receivedUs;
+    fix.unixTime = pos.timestamp;
+    fix.latitude = pos.latitude;
+    fix.longitude = pos.longitude;
+    fix.altitude = pos.altitude;
+    fix.speed = pos.speed;
+    fix.course = pos.course;
+
+    head = (head + 1) % GPS_FIX_HISTORY;
+    if (count < GPS_FIX_HISTORY) {
+        count++;
+    }
+    updateClockOffset();
+}
+
+void GPSFixHistory::updateClockOffset() {
+    if (count == 0) {
+        return;
+    }
+    // Receipt jitter only ever delays a sentence: the least delayed epoch
+    // in the window is closest to the true offset
+    int64_t minDelay = at(0).receivedUs - at(0).utcUs;
+    for (uint8_t age = 1; age < count; age++) {
+        int64_t delay = at(age).receivedUs - at(age).utcUs;
+        if (delay < minDelay) {
+            minDelay = delay;
+        }
+    }
+    clockOffsetUs = minDelay - outputLatencyUs;
+}
+
+void GPSFixHistory::project(const GPSFixSample& fix, float climbRate, int64_t dtUs,
+                            GPSPosition& pos) {
+    double dt = dtUs / 1000000.0;
+    double distance = fix.speed * dt;
+    double course = fix.course * M_PI / 180.0;
+    double north = distance * cos(course);
+    double east = distance * sin(course);
+
+    pos.latitude = fix.latitude + north / EARTH_RADIUS_M * 180.0 / M_PI;
+    pos.longitude = fix.longitude +
+                    east / (EARTH_RADIUS_M * cos(fix.latitude * M_PI / 180.0)) * 180.0 / M_PI;
+    pos.altitude = fix.altitude + climbRate * dt;
+    pos.speed = fix.speed;
+    pos.course = fix.course;
+    pos.timestamp = fix.unixTime;
+}
+
+GPSPositionSource GPSFixHistory::positionAt(int64_t timeUs, GPSPosition& pos,
+                                            int32_t* fixOffsetUs) const {
+    if (count == 0) {
+        return GPS_POSITION_LATEST;
+    }
+
+    // Past the newest fix: project it forward, climbing at the last rate
+    const GPSFixSample& newest = at(0);
+    if (timeUs >= localTime(newest)) {
+        int64_t dt = timeUs - localTime(newest);
+        if (dt > maxExtrapolationUs) {
+            return GPS_POSITION_LATEST;
+        }
+        float climbRate = 0.0f;
+        if (count > 1) {
+            int64_t gap = newest.utcUs - at(1).utcUs;
+            if (gap > 0 && gap <= maxGapUs) {
+                climbRate = (newest.altitude - at(1).altitude) / (gap / 1000000.0f);
+            }
+        }
+        project(newest, climbRate, dt, pos);
+        if (fixOffsetUs) {
+            *fixOffsetUs = (int32_t)dt;
+        }
+        return GPS_POSITION_EXTRAPOLATED;
+    }
+
+    // Newest to oldest: first fix at or before the time, and the one after it
+    for (uint8_t age = 1; age < count; age++) {
+        const GPSFixSample& a = at(age);
+        int64_t ta = localTime(a);
+        if (ta > timeUs) {
+            continue;
+        }
+        const GPSFixSample& b = at(age - 1);
+        int64_t dt = timeUs - ta;
+        if (fixOffsetUs) {
+            *fixOffsetUs = (int32_t)dt;
+        }
+
+        int64_t gap = b.utcUs - a.utcUs;
+        if (gap > maxGapUs) {
+            // Fixes missing in between: only trust a short projection
+            if (dt > maxExtrapolationUs) {
+                return GPS_POSITION_LATEST;
+            }
+            project(a, 0.0f, dt, pos);
+            return GPS_POSITION_EXTRAPOLATED;
+        }
+
+        double f = (double)dt / gap;
+        double dLon = b.longitude - a.longitude;
+        if (dLon > 180.0) {
+            dLon -= 360.0;
+        } else if (dLon < -180.0) {
+            dLon += 360.0;
+        }
+        float dCourse = b.course - a.course;
+        if (dCourse > 180.0f) {
+            dCourse -= 360.0f;
+        } else if (dCourse < -180.0f) {
+            dCourse += 360.0f;
+        }
+
+        pos.latitude = a.latitude + (b.latitude - a.latitude) * f;
+        pos.longitude = a.longitude + dLon * f;
+        if (pos.longitude > 180.0) {
+            pos.longitude -= 360.0;
+        } else if (pos.longitude < -180.0) {
+            pos.longitude += 360.0;
+        }
+        pos.altitude = a.altitude + (b.altitude - a.altitude) * (float)f;
+        pos.speed = a.speed + (b.speed - a.speed) * (float)f;
+        pos.course = fmodf(a.course + dCourse * (float)f + 360.0f, 360.0f);
+        pos.timestamp = a.unixTime;        // The fix fixOffsetUs is measured from
+        return GPS_POSITION_INTERPOLATED;
+    }
+
+    // Older than the whole ring
+    return GPS_POSITION_LATEST;
+}
+
+int64_t GPSFixHistory::unixTimeAt(int64_t timeUs) const {
+    if (count == 0 || at(0).unixTime < 86400) {
+        return 0;
+    }
+    // unixTime is the fix's whole second; utcUs carries its fraction
+    const GPSFixSample& newest = at(0);
+    int64_t fixUnixUs = (int64_t)newest.unixTime * 1000000 + newest.utcUs % 1000000;
+    return fixUnixUs + (timeUs - localTime(newest));
+}
+
+const char* GPSFixHistory::getSourceString(GPSPositionSource source) {
+    switch (source) {
+        case GPS_POSITION_INTERPOLATED: return "interpolated";
+        case GPS_POSITION_EXTRAPOLATED: return "extrapolated";
+        default: return "latest";
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef GPS_FIX_HISTORY_H
+#define GPS_FIX_HISTORY_H
+
+#include <stdint.h>
+
+struct GPSPosition;
+
+/**
+ * GPS Fix History
+ *
+ * Time-indexed ring of recent GNSS fixes, so a frame can be geotagged with
+ * the position at its exposure instead of the last fix received (up to one
+ * fix interval plus output latency old: metres at survey speeds).
+ *
+ * Fixes are indexed by their UTC epoch (NMEA time field), mapped onto the
+ * local microsecond clock (esp_timer, the camera driver's frame timestamp
+ * clock) with an offset estimated from when each epoch's first sentence
+ * arrived. Receipt times carry serial and polling jitter but never arrive
+ * early, so the offset is the minimum of (received - epoch) over the ring,
+ * less the receiver's fixed output latency (configure()).
+ *
+ * positionAt() interpolates between the two fixes bracketing a time, or
+ * projects the newest fix along its speed and course when the time is past
+ * it (the usual case at capture: the next fix is still being computed).
+ *
+ * The class holds no global state and only uses fixes passed in, so
+ * recorded NMEA can be replayed through it (see GPSManager::runFixHistoryTest()).
+ */
+
+#define GPS_FIX_HISTORY 32           // ~6 s at 5 Hz
+
+// How positionAt() derived a position
+enum GPSPositionSource : uint8_t {
+    GPS_POSITION_LATEST = 0,         // No usable fix near the time: position unchanged
+    GPS_POSITION_INTERPOLATED,       // Between the two fixes bracketing the time
+    GPS_POSITION_EXTRAPOLATED        // Projected from a fix along speed/course
+};
+
+struct GPSFixSample {
+    int64_t utcUs;                   // Fix epoch, UTC (day rollovers unwrapped)
+    int64_t receivedUs;              // Local clock when the epoch's first sentence arrived
+    uint32_t unixTime;               // GPSPosition.timestamp of the fix (whole seconds)
+    double latitude;                 // Degrees
+    double longitude;
+    float altitude;                  // Meters MSL
+    float speed;                     // m/s
+    float course;                    // Degrees
+};
+
+class GPSFixHistory {
+private:
+    GPSFixSample fixes[GPS_FIX_HISTORY];
+    uint8_t head;                    // Next write position
+    uint8_t count;
+    int64_t clockOffsetUs;           // Local clock = UTC epoch + offset
+    int64_t dayBaseUs;               // Unwrapped start of the current UTC day
+    int64_t outputLatencyUs;
+    int64_t maxGapUs;
+    int64_t maxExtrapolationUs;
+
+    const GPSFixSample& at(uint8_t age) const;   // 0 = newest
+    int64_t localTime(const GPSFixSample& fix) const { return fix.utcUs + clockOffsetUs; }
+    void updateClockOffset();
+    static void project(const GPSFixSample& fix, float climbRate, int64_t dtUs, GPSPosition& pos);
+
+public:
+    GPSFixHistory();
+
+    /**
+     * @param outputLatencyUs   Receiver delay from fix epoch to its first NMEA byte
+     * @param maxGapUs          Fixes further apart are not interpolated across
+     * @param maxExtrapolationUs  Max projection past a fix
+     */
+    void configure(int64_t outputLatencyUs, int64_t maxGapUs, int64_t maxExtrapolationUs);
+    void reset();
+
+    /**
+     * Add a fix: position, speed and course from pos, its UTC time of day
+     * (ms) and the local time its first sentence was received
+     */
+    void add(const GPSPosition& pos, uint32_t epochMs, int64_t receivedUs);
+
+    /**
+     * Position at a local clock time (esp_timer us). Updates latitude,
+     * longitude, altitude, speed and course in pos and leaves the rest
+     * (fix quality, accuracy) as passed in; pos is unchanged for
+     * GPS_POSITION_LATEST.
+     *
+     * @param fixOffsetUs Optional: time minus the fix at or before it
+     */
+    GPSPositionSource positionAt(int64_t timeUs, GPSPosition& pos, int32_t* fixOffsetUs = nullptr) const;
+
+    /**
+     * UTC (unix us) of a local clock time, from the clock offset and the
+     * newest fix's date; 0 without fixes or before the receiver sent a date
+     */
+    int64_t unixTimeAt(int64_t timeUs) const;
+
+    uint8_t getCount() const { return count; }
+    int64_t getClockOffset() const { return clockOffsetUs; }
+    int64_t getNewestFixTime() const { return count ? localTime(at(0)) : 0; }
+
+    static const char* getSourceString(GPSPositionSource source);
+};
+
+#endif // GPS_FIX_HISTORY_H
@@ -1,6 +1,7 @@
 #include "gps_manager.h"
 #include "config.h"
 #include <time.h>
+#include <esp_timer.h>
 
 // Only include MAVLink if using MAVLink GPS input mode
 #ifdef GPS_INPUT_MAVLINK
@@ -15,6 +16,11 @@ char GPSManager::nmeaBuffer[256];
 int GPSManager::bufferIndex = 0;
 unsigned long GPSManager::lastStatsTime = 0;
 uint32_t GPSManager::messageCount = 0;
+GPSFixHistory GPSManager::fixHistory;
+SemaphoreHandle_t GPSManager::historyMutex = NULL;
+int64_t GPSManager::sentenceReceivedUs = 0;
+int64_t GPSManager::epochReceivedUs = 0;
+uint32_t GPSManager::epochMs = UINT32_MAX;
 
 bool GPSManager::init() {
     Serial.println("Initializing GPS Manager...");
@@ -30,6 +36,13 @@ bool GPSManager::init() {
     gpsSerial.begin(115200, SERIAL_8N1, Config::pins.GPS_UART_RX, -1);
 #endif
 
+    if (!historyMutex) {
+        historyMutex = xSemaphoreCreateMutex();
+    }
+    fixHistory.configure(Config::gps.FIX_OUTPUT_LATENCY_US,
+                         (int64_t)Config::gps.MAX_FIX_GAP_MS * 1000,
+                         (int64_t)Config::gps.MAX_EXTRAPOLATION_MS * 1000);
+
     // Reset statistics and position
     stats.reset();
     resetPosition();
@@ -51,6 +64,7 @@ void GPSManager::update() {
         if (c == '$') {
             // Start of new NMEA sentence
             bufferIndex = 0;
+            sentenceReceivedUs = esp_timer_get_time();
         }
 
         if (bufferIndex < sizeof(nmeaBuffer) - 1) {
@@ -60,16 +74,9 @@ void GPSManager::update() {
         if (c == '\n' && bufferIndex > 1) {
             // End of NMEA sentence
             nmeaBuffer[bufferIndex] = '\0';
-            stats.messagesReceived++;
-
-            if (parseNMEA(nmeaBuffer)) {
-                stats.messagesProcessed++;
-            } else {
-                stats.parseErrors++;
-            }
+            processSentence(nmeaBuffer, sentenceReceivedUs);
 
             bufferIndex = 0;
-            messageCount++;
         }
 #else
         // Process MAVLink messages (placeholder for future implementation)
@@ -88,6 +95,23 @@ void GPSManager::update() {
     }
 }
 
+bool GPSManager::processSentence(const char* sentence, int64_t receivedUs) {
+    sentenceReceivedUs = receivedUs;
+    stats.messagesReceived++;
+    messageCount++;
+
+    if (parseNMEA(sentence)) {
+        stats.messagesProcessed++;
+        return true;
+    }
+    stats.parseErrors++;
+    return false;
+}
+
+bool GPSManager::replaySentence(const char* sentence, int64_t receivedUs) {
+    return processSentence(sentence, receivedUs);
+}
+
 bool GPSManager::parseNMEA(const char* sentence) {
     if (!sentence || strlen(sentence) < 6) return false;
 
@@ -130,9 +154,15 @@ bool GPSManager::parseGGA(const char* sentence) {
 
     if (tokenCount < 10) return false;
 
-    // Parse time (tokens[1])
+    // Parse time (tokens[1]): GGA has no date, keep the one RMC set
     if (strlen(tokens[1]) >= 6) {
-        currentPosition.timestamp = parseTime(tokens[1]);
+        uint32_t timeOfDay = parseTime(tokens[1]);
+        uint32_t day = currentPosition.timestamp - currentPosition.timestamp % 86400;
+        if (day > 0 && timeOfDay + 43200 < currentPosition.timestamp % 86400) {
+            day += 86400; // Past midnight before this epoch's RMC
+        }
+        currentPosition.timestamp = day + timeOfDay;
+        noteEpoch(parseTimeMs(tokens[1]));
     }
 
     // Parse latitude (tokens[2] and tokens[3])
@@ -183,6 +213,13 @@ bool GPSManager::parseGGA(const char* sentence) {
         currentPosition.accuracy = 999.0f; // Invalid
     }
 
+    // RMC of the same epoch has already set speed and course
+    if (currentPosition.valid && strlen(tokens[1]) >= 6 && historyMutex) {
+        xSemaphoreTake(historyMutex, portMAX_DELAY);
+        fixHistory.add(currentPosition, epochMs, epochReceivedUs);
+        xSemaphoreGive(historyMutex);
+    }
+
     return true;
 }
 
@@ -205,6 +242,10 @@ bool GPSManager::parseRMC(const char* sentence) {
 
     if (tokenCount < 10) return false;
 
+    if (strlen(tokens[1]) >= 6) {
+        noteEpoch(parseTimeMs(tokens[1]));
+    }
+
     // Check validity (tokens[2])
     if (strlen(tokens[2]) == 0 || tokens[2][0] != 'A') {
         return false; // Invalid fix
@@ -333,6 +374,26 @@ uint32_t GPSManager::parseTime(const char* timeStr) {
     return hours * 3600 + minutes * 60 + seconds;
 }
 
+uint32_t GPSManager::parseTimeMs(const char* timeStr) {
+    // HHMMSS.SS with up to 3 fractional digits
+    uint32_t ms = parseTime(timeStr) * 1000;
+    if (timeStr[6] == '.') {
+        uint32_t scale = 100;
+        for (const char* p = timeStr + 7; *p >= '0' && *p <= '9' && scale > 0; p++, scale /= 10) {
+            ms += (*p - '0') * scale;
+        }
+    }
+    return ms;
+}
+
+void GPSManager::noteEpoch(uint32_t timeMs) {
+    // First sentence carrying a new fix time starts the epoch
+    if (timeMs != epochMs) {
+        epochMs = timeMs;
+        epochReceivedUs = sentenceReceivedUs;
+    }
+}
+
 uint32_t GPSManager::parseDate(const char* dateStr, uint32_t timeSeconds) {
     if (!dateStr || strlen(dateStr) < 6) return timeSeconds;
 
@@ -375,6 +436,28 @@ GPSPosition GPSManager::getPosition() {
     return currentPosition;
 }
 
+GPSPositionSource GPSManager::getPositionAt(int64_t timeUs, GPSPosition& pos, int32_t* fixOffsetUs) {
+    pos = currentPosition;
+    if (!pos.valid || !historyMutex) {
+        return GPS_POSITION_LATEST;
+    }
+
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    GPSPositionSource source = fixHistory.positionAt(timeUs, pos, fixOffsetUs);
+    xSemaphoreGive(historyMutex);
+    return source;
+}
+
+int64_t GPSManager::getUnixTimeAt(int64_t timeUs) {
+    if (!historyMutex) {
+        return 0;
+    }
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    int64_t unixUs = fixHistory.unixTimeAt(timeUs);
+    xSemaphoreGive(historyMutex);
+    return unixUs;
+}
+
 bool GPSManager::hasValidFix() {
     return currentPosition.valid && isPositionFresh();
 }
@@ -413,6 +496,8 @@ void GPSManager::printStatus() {
     Serial.printf("Errors: %lu parse, %lu checksum\n",
                   stats.parseErrors, stats.checksumErrors);
     Serial.printf("Rate: %d msg/sec\n", stats.messageRate);
+    Serial.printf("Fix history: %u fixes, clock offset %lld us\n",
+                  fixHistory.getCount(), fixHistory.getClockOffset());
     Serial.println("----------------\n");
 }
 
@@ -494,6 +579,15 @@ void GPSManager::reset() {
     stats.reset();
     resetPosition();
     bufferIndex = 0;
+
+    if (historyMutex) {
+        xSemaphoreTake(historyMutex, portMAX_DELAY);
+    }
+    fixHistory.reset();
+    epochMs = UINT32_MAX;
+    if (historyMutex) {
+        xSemaphoreGive(historyMutex);
+    }
 }
 
 void GPSManager::setUpdateRate(uint8_t rateHz) {
@@ -504,4 +598,190 @@ void GPSManager::setUpdateRate(uint8_t rateHz) {
 void GPSManager::enableDebugOutput(bool enable) {
     // Enable/disable debug output for troubleshooting
     // Could be implemented with a static debug flag
-}
\ No newline at end of file
+}
+// 5 Hz RTK track across midnight UTC: 15 m/s on course 060, climbing 1 m/s,
+// RMC then GGA per epoch (u-blox output order)
+static const char* const FIX_HISTORY_TEST_NMEA[] = {
+    "$GNRMC,235958.00,A,3516.8540000,S,14907.8000000,E,29.158,60.00,171026,,,D*61",
+    "$GNGGA,235958.00,3516.8540000,S,14907.8000000,E,4,20,0.52,580.000,M,19.4,M,1.0,0000*7A",
+    "$GNRMC,235958.20,A,3516.8531906,S,14907.8017173,E,29.158,60.00,171026,,,D*69",
+    "$GNGGA,235958.20,3516.8531906,S,14907.8017173,E,4,20,0.52,580.200,M,19.4,M,1.0,0000*70",
+    "$GNRMC,235958.40,A,3516.8523812,S,14907.8034346,E,29.158,60.00,171026,,,D*6D",
+    "$GNGGA,235958.40,3516.8523812,S,14907.8034346,E,4,20,0.52,580.400,M,19.4,M,1.0,0000*72",
+    "$GNRMC,235958.60,A,3516.8515718,S,14907.8051520,E,29.158,60.00,171026,,,D*6A",
+    "$GNGGA,235958.60,3516.8515718,S,14907.8051520,E,4,20,0.52,580.600,M,19.4,M,1.0,0000*77",
+    "$GNRMC,235958.80,A,3516.8507624,S,14907.8068693,E,29.158,60.00,171026,,,D*68",
+    "$GNGGA,235958.80,3516.8507624,S,14907.8068693,E,4,20,0.52,580.800,M,19.4,M,1.0,0000*7B",
+    "$GNRMC,235959.00,A,3516.8499531,S,14907.8085866,E,29.158,60.00,171026,,,D*67",
+    "$GNGGA,235959.00,3516.8499531,S,14907.8085866,E,4,20,0.52,581.000,M,19.4,M,1.0,0000*7D",
+    "$GNRMC,235959.20,A,3516.8491437,S,14907.8103039,E,29.158,60.00,171026,,,D*67",
+    "$GNGGA,235959.20,3516.8491437,S,14907.8103039,E,4,20,0.52,581.200,M,19.4,M,1.0,0000*7F",
+    "$GNRMC,235959.40,A,3516.8483343,S,14907.8120213,E,29.158,60.00,171026,,,D*6D",
+    "$GNGGA,235959.40,3516.8483343,S,14907.8120213,E,4,20,0.52,581.400,M,19.4,M,1.0,0000*73",
+    "$GNRMC,235959.60,A,3516.8475249,S,14907.8137386,E,29.158,60.00,171026,,,D*66",
+    "$GNGGA,235959.60,3516.8475249,S,14907.8137386,E,4,20,0.52,581.600,M,19.4,M,1.0,0000*7A",
+    "$GNRMC,235959.80,A,3516.8467155,S,14907.8154559,E,29.158,60.00,171026,,,D*64",
+    "$GNGGA,235959.80,3516.8467155,S,14907.8154559,E,4,20,0.52,581.800,M,19.4,M,1.0,0000*76",
+    "$GNRMC,000000.00,A,3516.8459061,S,14907.8171732,E,29.158,60.00,181026,,,D*61",
+    "$GNGGA,000000.00,3516.8459061,S,14907.8171732,E,4,20,0.52,582.000,M,19.4,M,1.0,0000*77",
+    "$GNRMC,000000.20,A,3516.8450967,S,14907.8188906,E,29.158,60.00,181026,,,D*6A",
+    "$GNGGA,000000.20,3516.8450967,S,14907.8188906,E,4,20,0.52,582.200,M,19.4,M,1.0,0000*7E",
+    "$GNRMC,000000.40,A,3516.8442873,S,14907.8206079,E,29.158,60.00,181026,,,D*6F",
+    "$GNGGA,000000.40,3516.8442873,S,14907.8206079,E,4,20,0.52,582.400,M,19.4,M,1.0,0000*7D",
+    "$GNRMC,000000.60,A,3516.8434779,S,14907.8223252,E,29.158,60.00,181026,,,D*65",
+    "$GNGGA,000000.60,3516.8434779,S,14907.8223252,E,4,20,0.52,582.600,M,19.4,M,1.0,0000*75",
+    "$GNRMC,000000.80,A,3516.8426685,S,14907.8240425,E,29.158,60.00,181026,,,D*69",
+    "$GNGGA,000000.80,3516.8426685,S,14907.8240425,E,4,20,0.52,582.800,M,19.4,M,1.0,0000*77",
+};
+
+bool GPSManager::runFixHistoryTest() {
+    Serial.println("\n=== GPS Fix History Test ===");
+
+    const int epochs = sizeof(FIX_HISTORY_TEST_NMEA) / sizeof(FIX_HISTORY_TEST_NMEA[0]) / 2;
+    const int64_t epochUs = 200000;
+    const int64_t outputLatencyUs = 40000;
+    const int64_t startUs = 1000000000;       // Local clock at the first epoch
+    const uint16_t jitterMs[] = { 7, 0, 12, 3, 25, 9, 1, 18, 4, 30, 6, 2, 15, 8, 11 };
+    const double lat0 = -35.2809, lon0 = 149.1300;
+    const float alt0 = 580.0f, speed = 15.0f, course = 60.0f, climb = 1.0f;
+
+    // Known trajectory at a local time
+    auto truth = [&](int64_t timeUs, double& lat, double& lon, float& alt) {
+        double t = (timeUs - startUs) / 1000000.0;
+        double north = speed * t * cos(course * M_PI / 180.0);
+        double east = speed * t * sin(course * M_PI / 180.0);
+        lat = lat0 + north / 6371000.0 * 180.0 / M_PI;
+        lon = lon0 + east / (6371000.0 * cos(lat0 * M_PI / 180.0)) * 180.0 / M_PI;
+        alt = alt0 + climb * t;
+    };
+    auto errorM = [&](const GPSPosition& pos, int64_t timeUs) {
+        double lat, lon;
+        float alt;
+        truth(timeUs, lat, lon, alt);
+        double north = (pos.latitude - lat) * M_PI / 180.0 * 6371000.0;
+        double east = (pos.longitude - lon) * M_PI / 180.0 * 6371000.0 * cos(lat * M_PI / 180.0);
+        return (float)sqrt(north * north + east * east);
+    };
+
+    if (!historyMutex) {
+        historyMutex = xSemaphoreCreateMutex();
+    }
+    reset();
+    fixHistory.configure(outputLatencyUs, 1000000, 500000);
+
+    // Feed the track with receipt delayed by output latency plus serial/poll jitter
+    for (int i = 0; i < epochs; i++) {
+        int64_t receivedUs = startUs + i * epochUs + outputLatencyUs + jitterMs[i % 15] * 1000;
+        processSentence(FIX_HISTORY_TEST_NMEA[i * 2], receivedUs);
+        processSentence(FIX_HISTORY_TEST_NMEA[i * 2 + 1], receivedUs + 5000);
+    }
+
+    int passed = 0;
+    int total = 0;
+
+    // Test 1: every epoch stored across midnight
+    total++;
+    if (fixHistory.getCount() == epochs && stats.parseErrors == 0) {
+        Serial.printf("PASS: %d epochs parsed into the history\n", epochs);
+        passed++;
+    } else {
+        Serial.printf("FAIL: %u fixes stored, %lu parse errors\n", fixHistory.getCount(),
+                      stats.parseErrors);
+    }
+
+    // Test 2: jitter filtered out of the epoch-to-local clock mapping
+    total++;
+    int64_t newestExpected = startUs + (epochs - 1) * epochUs;
+    int64_t clockError = fixHistory.getNewestFixTime() - newestExpected;
+    if (llabs(clockError) <= 1000) {
+        Serial.printf("PASS: Fix epochs mapped to local clock within %lld us\n", clockError);
+        passed++;
+    } else {
+        Serial.printf("FAIL: Fix epoch mapping off by %lld us\n", clockError);
+    }
+
+    // Test 3: interpolation between fixes, including the pair across midnight
+    const int64_t interpolateAt[] = { startUs + 3 * epochUs + 50000,
+                                      startUs + 9 * epochUs + 130000,
+                                      startUs + 12 * epochUs + 100000 };
+    for (int64_t timeUs : interpolateAt) {
+        total++;
+        GPSPosition pos;
+        int32_t fixOffset = -1;
+        GPSPositionSource source = getPositionAt(timeUs, pos, &fixOffset);
+        float error = errorM(pos, timeUs);
+        int32_t expectedOffset = (int32_t)((timeUs - startUs) % epochUs);
+        if (source == GPS_POSITION_INTERPOLATED && error < 0.01f &&
+            llabs(fixOffset - expectedOffset) <= 1000) {
+            Serial.printf("PASS: Interpolated %ld ms after a fix, error %.1f mm\n",
+                          (long)fixOffset / 1000, error * 1000.0f);
+            passed++;
+        } else {
+            Serial.printf("FAIL: %s position at +%ld ms, error %.3f m\n",
+                          GPSFixHistory::getSourceString(source), (long)fixOffset / 1000, error);
+        }
+    }
+
+    // Test 4: projection past the newest fix (next fix not received yet)
+    total++;
+    {
+        int64_t timeUs = newestExpected + 120000;
+        GPSPosition pos;
+        GPSPositionSource source = getPositionAt(timeUs, pos);
+        float error = errorM(pos, timeUs);
+        double lat, lon;
+        float alt;
+        truth(timeUs, lat, lon, alt);
+        if (source == GPS_POSITION_EXTRAPOLATED && error < 0.02f && fabsf(pos.altitude - alt) < 0.02f) {
+            Serial.printf("PASS: Extrapolated 120 ms, error %.1f mm, altitude %.3f m\n",
+                          error * 1000.0f, pos.altitude);
+            passed++;
+        } else {
+            Serial.printf("FAIL: %s position 120 ms ahead, error %.3f m, altitude %.3f/%.3f m\n",
+                          GPSFixHistory::getSourceString(source), error, pos.altitude, alt);
+        }
+    }
+
+    // Test 5: no estimate too far past the newest fix or before the oldest
+    total++;
+    {
+        GPSPosition late;
+        GPSPosition early;
+        GPSPositionSource lateSource = getPositionAt(newestExpected + 600000, late);
+        GPSPositionSource earlySource = getPositionAt(startUs - 100000, early);
+        if (lateSource == GPS_POSITION_LATEST && earlySource == GPS_POSITION_LATEST &&
+            late.latitude == currentPosition.latitude) {
+            Serial.println("PASS: Latest fix used outside the history window");
+            passed++;
+        } else {
+            Serial.printf("FAIL: %s after the window, %s before it\n",
+                          GPSFixHistory::getSourceString(lateSource),
+                          GPSFixHistory::getSourceString(earlySource));
+        }
+    }
+
+    // Test 6: exposure UTC keeps the fix's fraction of a second, either side of midnight
+    total++;
+    {
+        const int64_t midnightUs = 1792281600LL * 1000000;   // 2026-10-18 00:00:00 UTC
+        int64_t beforeError = getUnixTimeAt(interpolateAt[1]) - (midnightUs - 70000);
+        int64_t afterError = getUnixTimeAt(interpolateAt[2]) - (midnightUs + 500000);
+        if (llabs(beforeError) <= 1000 && llabs(afterError) <= 1000) {
+            Serial.printf("PASS: Exposure UTC within %lld/%lld us, 23:59:59.930 and 00:00:00.500\n",
+                          beforeError, afterError);
+            passed++;
+        } else {
+            Serial.printf("FAIL: Exposure UTC off by %lld us before midnight, %lld us after\n",
+                          beforeError, afterError);
+        }
+    }
+
+    reset();
+    fixHistory.configure(Config::gps.FIX_OUTPUT_LATENCY_US,
+                         (int64_t)Config::gps.MAX_FIX_GAP_MS * 1000,
+                         (int64_t)Config::gps.MAX_EXTRAPOLATION_MS * 1000);
+
+    Serial.printf("\nResults: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "gps_fix_history.h"
 
 // GPS Input Mode Configuration
 // Choose ONE of the following input modes:
@@ -90,7 +93,15 @@ private:
     static unsigned long lastStatsTime;
     static uint32_t messageCount;
 
+    // Fix history for exposure-time positions (guarded by historyMutex)
+    static GPSFixHistory fixHistory;
+    static SemaphoreHandle_t historyMutex;
+    static int64_t sentenceReceivedUs;   // esp_timer when the current sentence's '$' arrived
+    static int64_t epochReceivedUs;      // ... when the current epoch's first sentence arrived
+    static uint32_t epochMs;             // UTC time of day of the current epoch
+
     // NMEA parsing functions
+    static bool processSentence(const char* sentence, int64_t receivedUs);
     static bool parseNMEA(const char* sentence);
     static bool parseGGA(const char* sentence);
     static bool parseRMC(const char* sentence);
@@ -99,6 +110,8 @@ private:
     static bool validateChecksum(const char* sentence);
     static double parseCoordinate(const char* coord, const char* hemisphere);
     static uint32_t parseTime(const char* timeStr);
+    static uint32_t parseTimeMs(const char* timeStr);
+    static void noteEpoch(uint32_t timeMs);
     static uint32_t parseDate(const char* dateStr, uint32_t timeSeconds);
 
     // MAVLink parsing functions (for GPS_INPUT_MAVLINK mode)
@@ -125,12 +138,45 @@ public:
     static uint8_t getSatelliteCount();
     static float getHorizontalAccuracy();
 
+    /**
+     * Position at a local time (esp_timer us, e.g. a frame's driver
+     * timestamp), interpolated between the fixes around it or projected
+     * from the newest one; the current position if the history has none
+     * near that time. pos gets the current fix quality and accuracy, and
+     * the GPS time (timestamp) of the fix the position was derived from.
+     *
+     * @param fixOffsetUs Optional: time minus the fix at or before it
+     */
+    static GPSPositionSource getPositionAt(int64_t timeUs, GPSPosition& pos,
+                                           int32_t* fixOffsetUs = nullptr);
+
+    /**
+     * UTC (unix us) of a local time (esp_timer us) from the receiver's
+     * clock, e.g. a frame's exposure; 0 before the receiver sent a date
+     */
+    static int64_t getUnixTimeAt(int64_t timeUs);
+
     // Status and diagnostics
     static GPSStatistics getStatistics();
     static void printStatus();
     static void printPosition();
     static bool isReceivingData();
 
+    /**
+     * Feed one recorded NMEA sentence (without line ending) through the
+     * parser as if it had been received at receivedUs (esp_timer us).
+     * Used by track replay tests; the live receiver stream is not paused.
+     */
+    static bool replaySentence(const char* sentence, int64_t receivedUs);
+
+    /**
+     * Replay an embedded 5 Hz NMEA track (RTK, across midnight UTC) with
+     * jittered receipt times and check clock mapping, interpolation and
+     * extrapolation against the known trajectory. Clears the current
+     * position and fix history; not while capturing.
+     */
+    static bool runFixHistoryTest();
+
     // Utility functions
     static String getFixQualityString(uint8_t quality);
     static String formatCoordinate(double coord, bool isLatitude);
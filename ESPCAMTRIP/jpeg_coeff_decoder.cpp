@@ -0,0 +1,489 @@
+#include "jpeg_coeff_decoder.h"
+#include <string.h>
+
+// JPEG markers
+#define JPEG_SOI  0xD8
+#define JPEG_EOI  0xD9
+#define JPEG_SOF0 0xC0
+#define JPEG_SOF1 0xC1
+#define JPEG_DHT  0xC4
+#define JPEG_DQT  0xDB
+#define JPEG_DRI  0xDD
+#define JPEG_SOS  0xDA
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+
+// Annex K.3 standard Huffman tables (luminance/chrominance DC and AC)
+const uint8_t JPEG_STD_DC_LUMA_COUNTS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+const uint8_t JPEG_STD_DC_CHROMA_COUNTS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+const uint8_t JPEG_STD_DC_SYMBOLS[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+const uint8_t JPEG_STD_AC_LUMA_COUNTS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+const uint8_t JPEG_STD_AC_LUMA_SYMBOLS[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+const uint8_t JPEG_STD_AC_CHROMA_COUNTS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+const uint8_t JPEG_STD_AC_CHROMA_SYMBOLS[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+static inline uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+JpegCoeffDecoder::JpegCoeffDecoder() {
+    memset(this, 0, sizeof(*this));
+}
+
+bool JpegCoeffDecoder::begin(const uint8_t* jpeg, size_t length) {
+    data = jpeg;
+    end = jpeg + length;
+    pos = nullptr;
+    bitBuffer = 0;
+    bitCount = 0;
+    markerHit = false;
+    error = false;
+    blockCount = 0;
+    mcuIndex = 0;
+    memset(&info, 0, sizeof(info));
+    for (int i = 0; i < 4; i++) {
+        dcTables[i].present = false;
+        acTables[i].present = false;
+    }
+
+    if (length < 4 || jpeg[0] != 0xFF || jpeg[1] != JPEG_SOI) {
+        return false;
+    }
+
+    const uint8_t* p = jpeg + 2;
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0xFF) {
+            p++; // Fill byte
+            continue;
+        }
+        p += 2;
+        if (marker == JPEG_EOI) {
+            return false; // No scan
+        }
+        if (marker == JPEG_SOI || marker == 0x01 || (marker >= JPEG_RST0 && marker <= JPEG_RST7)) {
+            continue; // Standalone markers
+        }
+
+        uint16_t segmentLength = readU16(p);
+        if (segmentLength < 2 || p + segmentLength > end) {
+            return false;
+        }
+        const uint8_t* segment = p + 2;
+        size_t payload = segmentLength - 2;
+
+        switch (marker) {
+            case JPEG_DQT:
+                if (!parseDQT(segment, payload)) return false;
+                break;
+            case JPEG_DHT:
+                if (!parseDHT(segment, payload)) return false;
+                break;
+            case JPEG_SOF0:
+            case JPEG_SOF1:
+                if (!parseSOF(segment, payload)) return false;
+                break;
+            case JPEG_DRI:
+                if (payload < 2) return false;
+                info.restartInterval = readU16(segment);
+                break;
+            case JPEG_SOS:
+                if (!parseSOS(segment, payload)) return false;
+                pos = segment + payload;
+                restartsLeft = info.restartInterval;
+                return true;
+            default:
+                // Other SOFn: progressive, lossless or arithmetic coding
+                if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                    return false;
+                }
+                break; // APPn, COM and others are skipped
+        }
+        p += segmentLength;
+    }
+    return false;
+}
+
+bool JpegCoeffDecoder::parseDQT(const uint8_t* p, size_t length) {
+    while (length > 0) {
+        uint8_t precision = p[0] >> 4;
+        uint8_t id = p[0] & 0x0F;
+        size_t tableSize = precision ? 128 : 64;
+        if (id > 3 || length < 1 + tableSize) {
+            return false;
+        }
+        for (int i = 0; i < 64; i++) {
+            quant[id][i] = precision ? readU16(p + 1 + i * 2) : p[1 + i];
+        }
+        p += 1 + tableSize;
+        length -= 1 + tableSize;
+    }
+    return true;
+}
+
+bool JpegCoeffDecoder::parseDHT(const uint8_t* p, size_t length) {
+    while (length > 17) {
+        uint8_t tableClass = p[0] >> 4;
+        uint8_t id = p[0] & 0x0F;
+        const uint8_t* counts = p + 1;
+        size_t total = 0;
+        for (int i = 0; i < 16; i++) {
+            total += counts[i];
+        }
+        if (tableClass > 1 || id > 3 || total > 256 || length < 17 + total) {
+            return false;
+        }
+        JpegHuffmanTable& table = tableClass ? acTables[id] : dcTables[id];
+        if (!buildHuffman(table, counts, p + 17)) {
+            return false;
+        }
+        p += 17 + total;
+        length -= 17 + total;
+    }
+    return length == 0;
+}
+
+bool JpegCoeffDecoder::parseSOF(const uint8_t* p, size_t length) {
+    if (length < 6 || p[0] != 8) {
+        return false; // 8-bit samples only
+    }
+    info.height = readU16(p + 1);
+    info.width = readU16(p + 3);
+    info.components = p[5];
+    if (info.width == 0 || info.height == 0 ||
+        (info.components != 1 && info.components != 3) ||
+        length < 6 + 3u * info.components) {
+        return false;
+    }
+
+    info.hMax = 1;
+    info.vMax = 1;
+    for (int i = 0; i < info.components; i++) {
+        JpegComponent& c = components[i];
+        c.id = p[6 + i * 3];
+        c.h = p[7 + i * 3] >> 4;
+        c.v = p[7 + i * 3] & 0x0F;
+        c.quantTable = p[8 + i * 3] & 0x03;
+        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4) {
+            return false;
+        }
+        if (c.h > info.hMax) info.hMax = c.h;
+        if (c.v > info.vMax) info.vMax = c.v;
+    }
+    return true;
+}
+
+bool JpegCoeffDecoder::parseSOS(const uint8_t* p, size_t length) {
+    if (info.components == 0 || length < 1) {
+        return false; // Scan before frame header
+    }
+    uint8_t count = p[0];
+    if (count < 1 || count > info.components || length < 1 + 2u * count + 3) {
+        return false;
+    }
+
+    bool anyDHT = false;
+    for (int i = 0; i < 4; i++) {
+        anyDHT = anyDHT || dcTables[i].present || acTables[i].present;
+    }
+    if (!anyDHT) {
+        installDefaultHuffman();
+    }
+
+    blockCount = 0;
+    uint8_t scanComponents[JPEG_MAX_COMPONENTS];
+    for (int i = 0; i < count; i++) {
+        uint8_t id = p[1 + i * 2];
+        uint8_t tables = p[2 + i * 2];
+        int index = -1;
+        for (int c = 0; c < info.components; c++) {
+            if (components[c].id == id) {
+                index = c;
+            }
+        }
+        if (index < 0) {
+            return false;
+        }
+        JpegComponent& c = components[index];
+        c.dcTable = tables >> 4;
+        c.acTable = tables & 0x0F;
+        c.dcPredictor = 0;
+        if (c.dcTable > 3 || c.acTable > 3 ||
+            !dcTables[c.dcTable].present || !acTables[c.acTable].present) {
+            return false;
+        }
+        scanComponents[i] = index;
+    }
+
+    if (count == 1) {
+        // Non-interleaved: one block per MCU over the component's own grid
+        const JpegComponent& c = components[scanComponents[0]];
+        uint32_t compWidth = ((uint32_t)info.width * c.h + info.hMax - 1) / info.hMax;
+        uint32_t compHeight = ((uint32_t)info.height * c.v + info.vMax - 1) / info.vMax;
+        info.mcusX = (compWidth + 7) / 8;
+        info.mcusY = (compHeight + 7) / 8;
+        blockComponent[blockCount++] = scanComponents[0];
+    } else {
+        info.mcusX = (info.width + 8 * info.hMax - 1) / (8 * info.hMax);
+        info.mcusY = (info.height + 8 * info.vMax - 1) / (8 * info.vMax);
+        for (int i = 0; i < count; i++) {
+            const JpegComponent& c = components[scanComponents[i]];
+            for (int b = 0; b < c.h * c.v; b++) {
+                if (blockCount >= JPEG_MAX_MCU_BLOCKS) {
+                    return false;
+                }
+                blockComponent[blockCount++] = scanComponents[i];
+            }
+        }
+    }
+    return true;
+}
+
+bool JpegCoeffDecoder::buildHuffman(JpegHuffmanTable& table, const uint8_t* counts,
+                                    const uint8_t* symbols) {
+    // Canonical code assignment (JPEG Annex C)
+    int k = 0;
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            table.size[k++] = (uint8_t)(i + 1);
+        }
+    }
+    table.size[k] = 0;
+    memcpy(table.symbols, symbols, k);
+
+    uint32_t code = 0;
+    int n = 0;
+    for (int len = 1; len <= 16; len++) {
+        table.delta[len] = n - (int32_t)code;
+        if (table.size[n] == len) {
+            while (table.size[n] == len) {
+                table.code[n++] = (uint16_t)code++;
+            }
+            if (code - 1 >= (1u << len)) {
+                return false; // Over-subscribed
+            }
+        }
+        table.maxcode[len] = code << (16 - len); // First code too long for this length
+        code <<= 1;
+    }
+    table.maxcode[17] = 0xFFFFFFFF;
+
+    memset(table.fast, 255, sizeof(table.fast));
+    for (int i = 0; i < n; i++) {
+        int s = table.size[i];
+        if (s <= JPEG_HUFF_FAST_BITS) {
+            int first = table.code[i] << (JPEG_HUFF_FAST_BITS - s);
+            int span = 1 << (JPEG_HUFF_FAST_BITS - s);
+            for (int j = 0; j < span; j++) {
+                table.fast[first + j] = (uint8_t)i;
+            }
+        }
+    }
+    table.present = true;
+    return true;
+}
+
+void JpegCoeffDecoder::installDefaultHuffman() {
+    buildHuffman(dcTables[0], JPEG_STD_DC_LUMA_COUNTS, JPEG_STD_DC_SYMBOLS);
+    buildHuffman(dcTables[1], JPEG_STD_DC_CHROMA_COUNTS, JPEG_STD_DC_SYMBOLS);
+    buildHuffman(acTables[0], JPEG_STD_AC_LUMA_COUNTS, JPEG_STD_AC_LUMA_SYMBOLS);
+    buildHuffman(acTables[1], JPEG_STD_AC_CHROMA_COUNTS, JPEG_STD_AC_CHROMA_SYMBOLS);
+}
+
+void JpegCoeffDecoder::fillBits() {
+    while (bitCount <= 24) {
+        uint32_t byte = 0;
+        if (!markerHit && pos < end) {
+            byte = *pos++;
+            if (byte == 0xFF) {
+                uint8_t next = pos < end ? *pos : 0;
+                if (next == 0x00) {
+                    pos++; // Stuffed zero
+                } else {
+                    // Marker ends the entropy segment; feed zeros from here
+                    markerHit = true;
+                    pos--;
+                    byte = 0;
+                }
+            }
+        }
+        bitBuffer |= byte << (24 - bitCount);
+        bitCount += 8;
+    }
+}
+
+int JpegCoeffDecoder::decodeSymbol(const JpegHuffmanTable& table) {
+    if (bitCount < 16) {
+        fillBits();
+    }
+
+    int index = table.fast[bitBuffer >> (32 - JPEG_HUFF_FAST_BITS)];
+    if (index < 255) {
+        int s = table.size[index];
+        bitBuffer <<= s;
+        bitCount -= s;
+        return table.symbols[index];
+    }
+
+    // Longer codes: find the length whose range holds the next 16 bits
+    uint32_t top = bitBuffer >> 16;
+    int len = JPEG_HUFF_FAST_BITS + 1;
+    while (top >= table.maxcode[len]) {
+        len++;
+    }
+    if (len > 16) {
+        error = true;
+        return -1;
+    }
+    int32_t symbolIndex = (int32_t)(bitBuffer >> (32 - len)) + table.delta[len];
+    if (symbolIndex < 0 || symbolIndex > 255 || table.size[symbolIndex] != len) {
+        error = true;
+        return -1;
+    }
+    bitBuffer <<= len;
+    bitCount -= len;
+    return table.symbols[symbolIndex];
+}
+
+int JpegCoeffDecoder::receiveExtend(int bits) {
+    if (bitCount < bits) {
+        fillBits();
+    }
+    int32_t value = (int32_t)(bitBuffer >> (32 - bits));
+    bitBuffer <<= bits;
+    bitCount -= bits;
+    // Values with a leading 0 bit are negative (JPEG F.2.2.1 EXTEND)
+    if (value < (1 << (bits - 1))) {
+        value -= (1 << bits) - 1;
+    }
+    return value;
+}
+
+void JpegCoeffDecoder::skipBits(int bits) {
+    if (bitCount < bits) {
+        fillBits();
+    }
+    bitBuffer <<= bits;
+    bitCount -= bits;
+}
+
+bool JpegCoeffDecoder::decodeBlock(JpegComponent& component, int16_t* out, bool withAC) {
+    int t = decodeSymbol(dcTables[component.dcTable]);
+    if (t < 0 || t > 11) {
+        error = true;
+        return false;
+    }
+    if (t > 0) {
+        component.dcPredictor += receiveExtend(t);
+    }
+    out[0] = (int16_t)component.dcPredictor;
+
+    const JpegHuffmanTable& ac = acTables[component.acTable];
+    if (withAC) {
+        memset(out + 1, 0, 63 * sizeof(int16_t));
+    }
+
+    int k = 1;
+    while (k < 64) {
+        int rs = decodeSymbol(ac);
+        if (rs < 0) {
+            return false;
+        }
+        int run = rs >> 4;
+        int size = rs & 0x0F;
+        if (size == 0) {
+            if (run != 15) {
+                break; // End of block
+            }
+            k += 16; // ZRL
+            continue;
+        }
+        k += run;
+        if (k > 63) {
+            error = true;
+            return false;
+        }
+        if (withAC) {
+            out[k] = (int16_t)receiveExtend(size);
+        } else {
+            skipBits(size);
+        }
+        k++;
+    }
+    return true;
+}
+
+void JpegCoeffDecoder::processRestart() {
+    // Drop padding bits and step over the RSTn marker
+    bitBuffer = 0;
+    bitCount = 0;
+    markerHit = false;
+    while (pos + 1 < end && !(pos[0] == 0xFF && pos[1] >= JPEG_RST0 && pos[1] <= JPEG_RST7)) {
+        pos++;
+    }
+    if (pos + 1 < end) {
+        pos += 2;
+    }
+
+    for (int i = 0; i < info.components; i++) {
+        components[i].dcPredictor = 0;
+    }
+    restartsLeft = info.restartInterval;
+}
+
+bool JpegCoeffDecoder::decodeMCU(bool withAC) {
+    if (error || pos == nullptr || mcuIndex >= getMCUCount()) {
+        return false;
+    }
+
+    if (info.restartInterval) {
+        if (restartsLeft == 0) {
+            processRestart();
+        }
+        restartsLeft--;
+    }
+
+    for (uint8_t b = 0; b < blockCount; b++) {
+        if (!decodeBlock(components[blockComponent[b]], coeff[b], withAC)) {
+            return false;
+        }
+    }
+    mcuIndex++;
+    return true;
+}
+
+const uint16_t* JpegCoeffDecoder::getQuantTable(uint8_t component) const {
+    if (component >= info.components) {
+        return quant[0];
+    }
+    return quant[components[component].quantTable];
+}
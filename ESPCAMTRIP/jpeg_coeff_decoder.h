@@ -0,0 +1,151 @@
+#ifndef JPEG_COEFF_DECODER_H
+#define JPEG_COEFF_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * JPEG Coefficient Decoder
+ *
+ * Entropy-decodes baseline (SOF0/SOF1) Huffman JPEG data into quantized
+ * DCT coefficients, one MCU at a time, without dequantization or IDCT.
+ * This is the cheap part of a JPEG decode and is enough for frame
+ * analysis: DC values give an 1/8-scale image, AC values give texture.
+ *
+ * - Per-MCU calls let callers sample MCUs; AC data of skipped blocks is
+ *   only length-decoded (Huffman symbol + bit skip, nothing stored)
+ * - Restart intervals (DRI/RSTn) are honoured
+ * - Standard (Annex K) Huffman tables are installed when the stream has
+ *   no DHT, as with some sensor MJPEG output
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); no heap allocation.
+ * Progressive and arithmetic-coded JPEGs are rejected by begin().
+ */
+
+#define JPEG_MAX_COMPONENTS 3
+#define JPEG_MAX_MCU_BLOCKS 10       // Baseline limit on blocks per MCU
+#define JPEG_HUFF_FAST_BITS 9        // Codes up to this length decode with one lookup
+
+// Annex K.3 standard Huffman tables: code counts per length (1-16) and symbols
+extern const uint8_t JPEG_STD_DC_LUMA_COUNTS[16];
+extern const uint8_t JPEG_STD_DC_CHROMA_COUNTS[16];
+extern const uint8_t JPEG_STD_DC_SYMBOLS[12];
+extern const uint8_t JPEG_STD_AC_LUMA_COUNTS[16];
+extern const uint8_t JPEG_STD_AC_LUMA_SYMBOLS[162];
+extern const uint8_t JPEG_STD_AC_CHROMA_COUNTS[16];
+extern const uint8_t JPEG_STD_AC_CHROMA_SYMBOLS[162];
+
+struct JpegHuffmanTable {
+    uint8_t fast[1 << JPEG_HUFF_FAST_BITS];  // Symbol index for short codes, 255 = slow path
+    uint16_t code[256];
+    uint8_t symbols[256];
+    uint8_t size[257];
+    uint32_t maxcode[18];
+    int32_t delta[17];
+    bool present;
+};
+
+struct JpegComponent {
+    uint8_t id;
+    uint8_t h;                   // Horizontal sampling factor
+    uint8_t v;                   // Vertical sampling factor
+    uint8_t quantTable;
+    uint8_t dcTable;
+    uint8_t acTable;
+    int32_t dcPredictor;
+};
+
+struct JpegInfo {
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;          // In the frame (1 = grayscale, 3 = YCbCr)
+    uint8_t hMax;
+    uint8_t vMax;
+    uint16_t mcusX;              // MCUs per row of the first scan
+    uint16_t mcusY;
+    uint16_t restartInterval;    // MCUs, 0 = none
+};
+
+class JpegCoeffDecoder {
+private:
+    // Stream
+    const uint8_t* data;
+    const uint8_t* end;
+    const uint8_t* pos;          // Next entropy-coded byte
+    uint32_t bitBuffer;          // MSB-aligned
+    int bitCount;
+    bool markerHit;
+    bool error;
+
+    // Tables
+    uint16_t quant[4][64];       // Zigzag order, as stored in DQT
+    JpegHuffmanTable dcTables[4];
+    JpegHuffmanTable acTables[4];
+    JpegComponent components[JPEG_MAX_COMPONENTS];
+
+    // Current scan
+    JpegInfo info;
+    uint8_t blockCount;
+    uint8_t blockComponent[JPEG_MAX_MCU_BLOCKS];
+    uint32_t mcuIndex;
+    uint16_t restartsLeft;
+    int16_t coeff[JPEG_MAX_MCU_BLOCKS][64];
+
+    bool parseDQT(const uint8_t* p, size_t length);
+    bool parseDHT(const uint8_t* p, size_t length);
+    bool parseSOF(const uint8_t* p, size_t length);
+    bool parseSOS(const uint8_t* p, size_t length);
+    bool buildHuffman(JpegHuffmanTable& table, const uint8_t* counts, const uint8_t* symbols);
+    void installDefaultHuffman();
+
+    void fillBits();
+    int decodeSymbol(const JpegHuffmanTable& table);
+    int receiveExtend(int bits);
+    void skipBits(int bits);
+    bool decodeBlock(JpegComponent& component, int16_t* out, bool withAC);
+    void processRestart();
+
+public:
+    JpegCoeffDecoder();
+
+    /**
+     * Parse headers up to the first scan
+     *
+     * @return false for truncated, progressive or unsupported streams
+     */
+    bool begin(const uint8_t* jpeg, size_t length);
+
+    /**
+     * Decode the next MCU in raster order
+     *
+     * @param withAC Store AC coefficients; when false only DC is kept
+     *               (AC of the blocks is still consumed from the stream)
+     * @return false at the end of the scan or on corrupt data
+     */
+    bool decodeMCU(bool withAC);
+
+    const JpegInfo& getInfo() const { return info; }
+    uint32_t getMCUIndex() const { return mcuIndex; }   // MCUs decoded so far
+    uint32_t getMCUCount() const { return (uint32_t)info.mcusX * info.mcusY; }
+    bool hasError() const { return error; }
+
+    /**
+     * Blocks of the last decoded MCU, component-major as in the scan
+     * (e.g. Y0 Y1 Cb Cr for 4:2:2). Coefficients are quantized values in
+     * zigzag order; getQuantTable() gives the matching step sizes.
+     */
+    uint8_t getBlockCount() const { return blockCount; }
+    uint8_t getBlockComponent(uint8_t block) const { return blockComponent[block]; }
+    const int16_t* getBlock(uint8_t block) const { return coeff[block]; }
+    int16_t getDC(uint8_t block) const { return coeff[block][0]; }
+    const uint16_t* getQuantTable(uint8_t component) const;
+
+    /**
+     * Frame component (index as in getBlockComponent()), with sampling factors
+     */
+    const JpegComponent& getComponent(uint8_t component) const {
+        return components[component < info.components ? component : 0];
+    }
+};
+
+#endif // JPEG_COEFF_DECODER_H
@@ -0,0 +1,205 @@
+#include "jpeg_encoder.h"
+#include "jpeg_entropy_writer.h"
+#include "jpeg_requantizer.h"
+#include <math.h>
+
+// AAN output scale per frequency: cos(k pi / 16) * sqrt(2), 1 for k = 0
+static const float AAN_SCALE[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+// Level-shifted sample of a component at a pixel; edges replicated past the image
+static inline float sample(const uint8_t* pixels, uint16_t width, uint16_t height,
+                           uint8_t channels, uint8_t component, int x, int y) {
+    if (x >= width) x = width - 1;
+    if (y >= height) y = height - 1;
+    const uint8_t* p = pixels + ((size_t)y * width + x) * channels;
+    if (channels == 1) {
+        return p[0] - 128.0f;
+    }
+    // JFIF YCbCr; Cb and Cr are centred on 0 here
+    switch (component) {
+    case 0:  return 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] - 128.0f;
+    case 1:  return -0.168736f * p[0] - 0.331264f * p[1] + 0.5f * p[2];
+    default: return 0.5f * p[0] - 0.418688f * p[1] - 0.081312f * p[2];
+    }
+}
+
+// One 8x8 block from (x0, y0); step 2 averages 2x2 pixels (4:2:0 chroma)
+static void loadBlock(const uint8_t* pixels, uint16_t width, uint16_t height, uint8_t channels,
+                      uint8_t component, int x0, int y0, int step, float* block) {
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int px = x0 + x * step;
+            int py = y0 + y * step;
+            float v = sample(pixels, width, height, channels, component, px, py);
+            if (step == 2) {
+                v += sample(pixels, width, height, channels, component, px + 1, py);
+                v += sample(pixels, width, height, channels, component, px, py + 1);
+                v += sample(pixels, width, height, channels, component, px + 1, py + 1);
+                v *= 0.25f;
+            }
+            block[y * 8 + x] = v;
+        }
+    }
+}
+
+// One 8-point AAN forward DCT pass (libjpeg jfdctflt.c), outputs scaled by AAN_SCALE
+static inline void fdct8(float* d, int stride) {
+    float tmp0 = d[0] + d[7 * stride];
+    float tmp7 = d[0] - d[7 * stride];
+    float tmp1 = d[stride] + d[6 * stride];
+    float tmp6 = d[stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = 0.541196100f * tmp10 + z5;
+    float z4 = 1.306562965f * tmp12 + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+// Forward DCT and quantization of a block into zigzag order
+static void transformBlock(float* block, const float* divisor, int16_t* zigzag) {
+    for (int row = 0; row < 8; row++) {
+        fdct8(block + row * 8, 1);
+    }
+    for (int column = 0; column < 8; column++) {
+        fdct8(block + column, 8);
+    }
+    for (int z = 0; z < 64; z++) {
+        long v = lroundf(block[JPEG_ZIGZAG_NATURAL[z]] * divisor[z]);
+        // Baseline AC magnitudes stop at 10 bits (reachable only near quality 1)
+        zigzag[z] = (int16_t)(v < -1023 ? -1023 : (v > 1023 ? 1023 : v));
+    }
+}
+
+bool JpegEncoder::encode(const uint8_t* pixels, uint16_t width, uint16_t height, uint8_t channels,
+                         uint8_t quality, uint8_t* out, size_t outSize, size_t& outLength) {
+    outLength = 0;
+    if (!pixels || width == 0 || height == 0 || (channels != 1 && channels != 3)) {
+        return false;
+    }
+
+    // Quantization tables (0 = luma, 1 = chroma) and the reciprocal divisor
+    // per zigzag position, with the AAN scale and the DCT's factor 8 folded in
+    uint8_t tables = channels == 3 ? 2 : 1;
+    uint16_t quant[2][64];
+    float divisor[2][64];
+    for (uint8_t t = 0; t < tables; t++) {
+        JpegRequantizer::scaledQuantTable(t != 0, quality, quant[t]);
+        for (int z = 0; z < 64; z++) {
+            uint8_t n = JPEG_ZIGZAG_NATURAL[z];
+            divisor[t][z] = 1.0f / (quant[t][z] * AAN_SCALE[n >> 3] * AAN_SCALE[n & 7] * 8.0f);
+        }
+    }
+
+    JpegWriter w = { out, outSize, 0, false, 0, 0 };
+    w.byte(0xFF);
+    w.byte(0xD8);
+
+    // DQT: table t for luma / chroma, 8-bit (scaled tables are clamped to 255)
+    w.byte(0xFF);
+    w.byte(0xDB);
+    w.u16(2 + tables * 65);
+    for (uint8_t t = 0; t < tables; t++) {
+        w.byte(t);
+        for (int z = 0; z < 64; z++) {
+            w.byte((uint8_t)quant[t][z]);
+        }
+    }
+
+    // SOF0: luma 2x2 over chroma for colour (4:2:0)
+    w.byte(0xFF);
+    w.byte(0xC0);
+    w.u16(8 + 3 * channels);
+    w.byte(8);
+    w.u16(height);
+    w.u16(width);
+    w.byte(channels);
+    for (uint8_t c = 0; c < channels; c++) {
+        w.byte(c + 1);
+        w.byte(c == 0 && channels == 3 ? 0x22 : 0x11);
+        w.byte(c ? 1 : 0);
+    }
+
+    JpegEntropyWriter::writeHuffmanTables(w, tables);
+
+    // SOS: all components interleaved
+    w.byte(0xFF);
+    w.byte(0xDA);
+    w.u16(6 + 2 * channels);
+    w.byte(channels);
+    for (uint8_t c = 0; c < channels; c++) {
+        uint8_t t = c ? 1 : 0;
+        w.byte(c + 1);
+        w.byte((t << 4) | t);
+    }
+    w.byte(0);                   // Ss
+    w.byte(63);                  // Se
+    w.byte(0);                   // Ah/Al
+
+    int mcuSize = channels == 3 ? 16 : 8;
+    int predictor[3] = {};
+    float samples[64];
+    int16_t block[64];
+    for (int my = 0; my < height; my += mcuSize) {
+        for (int mx = 0; mx < width; mx += mcuSize) {
+            if (channels == 1) {
+                loadBlock(pixels, width, height, 1, 0, mx, my, 1, samples);
+                transformBlock(samples, divisor[0], block);
+                JpegEntropyWriter::encodeBlock(w, block, predictor[0], 0);
+                continue;
+            }
+
+            // Four luma blocks row-major, then Cb and Cr over the 16x16 MCU
+            for (int b = 0; b < 4; b++) {
+                loadBlock(pixels, width, height, 3, 0, mx + (b & 1) * 8, my + (b >> 1) * 8, 1,
+                          samples);
+                transformBlock(samples, divisor[0], block);
+                JpegEntropyWriter::encodeBlock(w, block, predictor[0], 0);
+            }
+            for (uint8_t c = 1; c < 3; c++) {
+                loadBlock(pixels, width, height, 3, c, mx, my, 2, samples);
+                transformBlock(samples, divisor[1], block);
+                JpegEntropyWriter::encodeBlock(w, block, predictor[c], 1);
+            }
+        }
+        if (w.overflow) {
+            return false;
+        }
+    }
+
+    w.flushBits();
+    w.byte(0xFF);
+    w.byte(0xD9);
+    if (w.overflow) {
+        return false;
+    }
+    outLength = w.pos;
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * JPEG Encoder
+ *
+ * Baseline encoder for small images such as the EXIF thumbnail:
+ * grayscale, or RGB as YCbCr 4:2:0, with IJG-scaled Annex K quantization
+ * tables (JpegRequantizer::scaledQuantTable()) and the standard Huffman
+ * tables. Blocks are read straight from the pixel buffer and coded into
+ * the output buffer, so there are no line buffers: no heap and about
+ * 1.5 KB of stack. Float AAN forward DCT, as libjpeg's JDCT_FLOAT.
+ *
+ * Output is SOI, DQT, SOF0, DHT, SOS and EOI only (no JFIF/EXIF APPn), as
+ * an EXIF IFD1 thumbnail must be.
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies).
+ */
+
+class JpegEncoder {
+public:
+    /**
+     * Encode an image
+     *
+     * @param pixels Row-major, 1 (gray) or 3 (R, G, B) bytes per pixel
+     * @param quality IJG quality (1-100, 50 = Annex K)
+     * @param outLength Bytes written to out
+     * @return false for bad arguments or a short buffer
+     */
+    static bool encode(const uint8_t* pixels, uint16_t width, uint16_t height, uint8_t channels,
+                       uint8_t quality, uint8_t* out, size_t outSize, size_t& outLength);
+};
+
+#endif // JPEG_ENCODER_H
@@ -0,0 +1,112 @@
+#include "jpeg_entropy_writer.h"
+#include "jpeg_coeff_decoder.h"
+
+const uint8_t JPEG_ZIGZAG_NATURAL[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Huffman code and length per symbol, for writing
+struct HuffmanEncodeTable {
+    uint16_t code[256];
+    uint8_t size[256];
+};
+
+// Standard tables: 0 = luma, 1 = chroma. Built on first use; identical
+// values if two tasks race to build them
+static HuffmanEncodeTable dcEncode[2];
+static HuffmanEncodeTable acEncode[2];
+static volatile bool encodeTablesBuilt = false;
+
+static void buildEncodeTable(HuffmanEncodeTable& table, const uint8_t* counts, const uint8_t* symbols) {
+    // Canonical code assignment (JPEG Annex C)
+    memset(&table, 0, sizeof(table));
+    uint16_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < counts[len - 1]; i++) {
+            table.code[symbols[k]] = code++;
+            table.size[symbols[k]] = (uint8_t)len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+static void buildEncodeTables() {
+    if (encodeTablesBuilt) {
+        return;
+    }
+    buildEncodeTable(dcEncode[0], JPEG_STD_DC_LUMA_COUNTS, JPEG_STD_DC_SYMBOLS);
+    buildEncodeTable(dcEncode[1], JPEG_STD_DC_CHROMA_COUNTS, JPEG_STD_DC_SYMBOLS);
+    buildEncodeTable(acEncode[0], JPEG_STD_AC_LUMA_COUNTS, JPEG_STD_AC_LUMA_SYMBOLS);
+    buildEncodeTable(acEncode[1], JPEG_STD_AC_CHROMA_COUNTS, JPEG_STD_AC_CHROMA_SYMBOLS);
+    encodeTablesBuilt = true;
+}
+
+static inline int magnitudeBits(int v) {
+    if (v < 0) {
+        v = -v;
+    }
+    int n = 0;
+    while (v) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+void JpegEntropyWriter::writeHuffmanTables(JpegWriter& w, uint8_t tableSets) {
+    buildEncodeTables();
+    for (uint8_t t = 0; t < tableSets; t++) {
+        const uint8_t* dcCounts = t ? JPEG_STD_DC_CHROMA_COUNTS : JPEG_STD_DC_LUMA_COUNTS;
+        const uint8_t* acCounts = t ? JPEG_STD_AC_CHROMA_COUNTS : JPEG_STD_AC_LUMA_COUNTS;
+        const uint8_t* acSymbols = t ? JPEG_STD_AC_CHROMA_SYMBOLS : JPEG_STD_AC_LUMA_SYMBOLS;
+        w.byte(0xFF);
+        w.byte(0xC4);
+        w.u16(2 + 17 + 12 + 17 + 162);
+        w.byte(0x00 | t);
+        w.bytes(dcCounts, 16);
+        w.bytes(JPEG_STD_DC_SYMBOLS, 12);
+        w.byte(0x10 | t);
+        w.bytes(acCounts, 16);
+        w.bytes(acSymbols, 162);
+    }
+}
+
+void JpegEntropyWriter::encodeBlock(JpegWriter& w, const int16_t* block, int& predictor,
+                                    uint8_t table) {
+    const HuffmanEncodeTable& dc = dcEncode[table];
+    const HuffmanEncodeTable& ac = acEncode[table];
+
+    int diff = block[0] - predictor;
+    predictor = block[0];
+    int n = magnitudeBits(diff);
+    w.bits(dc.code[n], dc.size[n]);
+    if (n) {
+        w.bits(diff < 0 ? diff - 1 : diff, n);
+    }
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = block[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            w.bits(ac.code[0xF0], ac.size[0xF0]); // ZRL: 16 zeros
+            run -= 16;
+        }
+        n = magnitudeBits(v);
+        int symbol = (run << 4) | n;
+        w.bits(ac.code[symbol], ac.size[symbol]);
+        w.bits(v < 0 ? v - 1 : v, n);
+        run = 0;
+    }
+    if (run > 0) {
+        w.bits(ac.code[0x00], ac.size[0x00]); // EOB
+    }
+}
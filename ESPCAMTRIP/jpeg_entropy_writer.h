@@ -0,0 +1,90 @@
+#ifndef JPEG_ENTROPY_WRITER_H
+#define JPEG_ENTROPY_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * JPEG Entropy Writer
+ *
+ * Baseline JPEG output shared by JpegRequantizer and JpegEncoder: bytes
+ * and entropy-coded bits (with 0xFF stuffing) into a caller buffer, the
+ * standard (Annex K) Huffman tables and Huffman coding of one block.
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); no heap allocation.
+ */
+
+// Zigzag position -> natural (row-major) index
+extern const uint8_t JPEG_ZIGZAG_NATURAL[64];
+
+// Byte output with entropy-coded segment bit packing and 0xFF stuffing
+struct JpegWriter {
+    uint8_t* out;
+    size_t size;
+    size_t pos;
+    bool overflow;
+    uint32_t bitBuffer;          // Pending bits, LSB-aligned
+    int bitCount;
+
+    void byte(uint8_t b) {
+        if (pos < size) {
+            out[pos++] = b;
+        } else {
+            overflow = true;
+        }
+    }
+
+    void u16(uint16_t v) {
+        byte(v >> 8);
+        byte(v & 0xFF);
+    }
+
+    void bytes(const uint8_t* p, size_t n) {
+        if (pos + n > size) {
+            overflow = true;
+            return;
+        }
+        memcpy(out + pos, p, n);
+        pos += n;
+    }
+
+    void bits(uint32_t value, int count) {
+        bitBuffer = (bitBuffer << count) | (value & ((1u << count) - 1));
+        bitCount += count;
+        while (bitCount >= 8) {
+            uint8_t b = (uint8_t)(bitBuffer >> (bitCount - 8));
+            byte(b);
+            if (b == 0xFF) {
+                byte(0x00);
+            }
+            bitCount -= 8;
+        }
+    }
+
+    void flushBits() {
+        // Pad the last byte with ones
+        if (bitCount > 0) {
+            bits(0x7F, 8 - bitCount);
+        }
+    }
+};
+
+class JpegEntropyWriter {
+public:
+    /**
+     * DHT segment with the standard tables: 0 = luma, 1 = chroma (tableSets 2).
+     * Also builds the encode tables, so call it before encodeBlock()
+     */
+    static void writeHuffmanTables(JpegWriter& w, uint8_t tableSets);
+
+    /**
+     * Huffman code one block of quantized coefficients (zigzag order)
+     *
+     * @param predictor DC predictor of the block's component, updated
+     * @param table 0 = luma, 1 = chroma standard tables
+     */
+    static void encodeBlock(JpegWriter& w, const int16_t* block, int& predictor, uint8_t table);
+};
+
+#endif // JPEG_ENTROPY_WRITER_H
@@ -0,0 +1,186 @@
+#include "jpeg_requantizer.h"
+#include "jpeg_entropy_writer.h"
+#include <string.h>
+
+// Annex K.1 / K.2 quantization tables (natural order)
+static const uint8_t STD_LUMA_QUANT[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+static const uint8_t STD_CHROMA_QUANT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static inline int16_t requantizeCoefficient(int16_t value, uint16_t from, uint16_t to) {
+    if (value == 0 || from == to) {
+        return value;
+    }
+    int32_t scaled = (int32_t)value * from;
+    int32_t half = to / 2;
+    return (int16_t)(scaled >= 0 ? (scaled + half) / to : -((-scaled + half) / to));
+}
+
+void JpegRequantizer::scaledQuantTable(bool chroma, uint8_t quality, uint16_t* zigzagOut) {
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    const uint8_t* base = chroma ? STD_CHROMA_QUANT : STD_LUMA_QUANT;
+    for (int z = 0; z < 64; z++) {
+        int q = (base[JPEG_ZIGZAG_NATURAL[z]] * scale + 50) / 100;
+        zigzagOut[z] = (uint16_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+    }
+}
+
+bool JpegRequantizer::requantize(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                                 uint8_t quality, uint8_t* out, size_t outSize, size_t& outLength) {
+    outLength = 0;
+    if (!decoder.begin(jpeg, length)) {
+        return false;
+    }
+    const JpegInfo& ji = decoder.getInfo();
+
+    // The first scan must carry every component; note their order in it
+    uint8_t scanOrder[JPEG_MAX_COMPONENTS];
+    uint8_t scanCount = 0;
+    for (uint8_t b = 0; b < decoder.getBlockCount(); b++) {
+        uint8_t c = decoder.getBlockComponent(b);
+        if (scanCount == 0 || scanOrder[scanCount - 1] != c) {
+            scanOrder[scanCount++] = c;
+        }
+    }
+    if (scanCount != ji.components) {
+        return false;
+    }
+
+    // Target table per component: scaled Annex K, never finer than the source
+    uint16_t sourceQuant[JPEG_MAX_COMPONENTS][64];
+    uint16_t targetQuant[JPEG_MAX_COMPONENTS][64];
+    bool wideQuant = false;
+    for (uint8_t c = 0; c < ji.components; c++) {
+        memcpy(sourceQuant[c], decoder.getQuantTable(c), sizeof(sourceQuant[c]));
+        scaledQuantTable(c != 0, quality, targetQuant[c]);
+        for (int z = 0; z < 64; z++) {
+            if (targetQuant[c][z] < sourceQuant[c][z]) {
+                targetQuant[c][z] = sourceQuant[c][z];
+            }
+            wideQuant = wideQuant || targetQuant[c][z] > 255;
+        }
+    }
+
+    JpegWriter w = { out, outSize, 0, false, 0, 0 };
+    w.byte(0xFF);
+    w.byte(0xD8);
+
+    // Copy APPn and COM segments up to the scan (EXIF, JFIF)
+    const uint8_t* p = jpeg + 2;
+    const uint8_t* end = jpeg + length;
+    while (p + 4 <= end && p[0] == 0xFF) {
+        uint8_t marker = p[1];
+        if (marker == 0xFF) {
+            p++;
+            continue;
+        }
+        if (marker == 0xDA) {
+            break; // SOS
+        }
+        uint16_t segmentLength = (uint16_t)((p[2] << 8) | p[3]);
+        if (p + 2 + segmentLength > end) {
+            return false;
+        }
+        if ((marker >= 0xE0 && marker <= 0xEF) || marker == 0xFE) {
+            w.bytes(p, 2 + segmentLength);
+        }
+        p += 2 + segmentLength;
+    }
+
+    // DQT: table c for component c
+    w.byte(0xFF);
+    w.byte(0xDB);
+    w.u16(2 + ji.components * (wideQuant ? 129 : 65));
+    for (uint8_t c = 0; c < ji.components; c++) {
+        w.byte((wideQuant ? 0x10 : 0x00) | c);
+        for (int z = 0; z < 64; z++) {
+            if (wideQuant) {
+                w.u16(targetQuant[c][z]);
+            } else {
+                w.byte((uint8_t)targetQuant[c][z]);
+            }
+        }
+    }
+
+    // SOF0: geometry and sampling as the source
+    w.byte(0xFF);
+    w.byte(0xC0);
+    w.u16(8 + 3 * ji.components);
+    w.byte(8);
+    w.u16(ji.height);
+    w.u16(ji.width);
+    w.byte(ji.components);
+    for (uint8_t c = 0; c < ji.components; c++) {
+        const JpegComponent& comp = decoder.getComponent(c);
+        w.byte(comp.id);
+        w.byte((comp.h << 4) | comp.v);
+        w.byte(c);
+    }
+
+    // DHT: standard tables, 0 = luma, 1 = chroma
+    JpegEntropyWriter::writeHuffmanTables(w, ji.components > 1 ? 2 : 1);
+
+    // SOS: components in the source scan order
+    w.byte(0xFF);
+    w.byte(0xDA);
+    w.u16(6 + 2 * scanCount);
+    w.byte(scanCount);
+    for (uint8_t i = 0; i < scanCount; i++) {
+        uint8_t t = scanOrder[i] ? 1 : 0;
+        w.byte(decoder.getComponent(scanOrder[i]).id);
+        w.byte((t << 4) | t);
+    }
+    w.byte(0);                   // Ss
+    w.byte(63);                  // Se
+    w.byte(0);                   // Ah/Al
+
+    int predictor[JPEG_MAX_COMPONENTS] = {};
+    int16_t block[64];
+    uint32_t mcus = decoder.getMCUCount();
+    for (uint32_t m = 0; m < mcus; m++) {
+        if (!decoder.decodeMCU(true)) {
+            return false;
+        }
+        for (uint8_t b = 0; b < decoder.getBlockCount(); b++) {
+            uint8_t c = decoder.getBlockComponent(b);
+            const int16_t* source = decoder.getBlock(b);
+            for (int z = 0; z < 64; z++) {
+                block[z] = requantizeCoefficient(source[z], sourceQuant[c][z], targetQuant[c][z]);
+            }
+            JpegEntropyWriter::encodeBlock(w, block, predictor[c], c ? 1 : 0);
+        }
+        if (w.overflow) {
+            return false;
+        }
+    }
+
+    w.flushBits();
+    w.byte(0xFF);
+    w.byte(0xD9);
+    if (w.overflow || decoder.hasError()) {
+        return false;
+    }
+    outLength = w.pos;
+    return true;
+}
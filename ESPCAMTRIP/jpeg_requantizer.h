@@ -0,0 +1,49 @@
+#ifndef JPEG_REQUANTIZER_H
+#define JPEG_REQUANTIZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "jpeg_coeff_decoder.h"
+
+/**
+ * JPEG Requantizer
+ *
+ * Makes a smaller JPEG of the same size from a captured one without a
+ * pixel-domain round trip: the quantized DCT coefficients are decoded
+ * (JpegCoeffDecoder), divided down to a coarser quantization table and
+ * Huffman coded again. No IDCT, colour conversion or forward DCT is run,
+ * so the cost is two entropy passes and the result is the JPEG a decoder
+ * would give for the coarser table, not a re-encode of decoded pixels.
+ *
+ * - Target tables are the IJG (Annex K) tables scaled to a 1-100 quality,
+ *   never finer than the source table per coefficient
+ * - APPn and COM segments (EXIF with GPS) are copied; standard Huffman
+ *   tables are written; restart markers are not
+ * - Baseline input with all components in the first scan (camera output,
+ *   grayscale); other layouts are rejected
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); the caller provides
+ * the decoder and output buffer.
+ */
+
+class JpegRequantizer {
+public:
+    /**
+     * Requantize a JPEG
+     *
+     * @param quality IJG quality of the target tables (1-100, 50 = Annex K)
+     * @param outLength Bytes written to out
+     * @return false for unsupported or corrupt JPEGs or a short buffer
+     */
+    static bool requantize(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                           uint8_t quality, uint8_t* out, size_t outSize, size_t& outLength);
+
+    /**
+     * IJG quality scaling of an Annex K table, in zigzag order
+     *
+     * @param chroma Chrominance (K.2) instead of luminance (K.1) table
+     */
+    static void scaledQuantTable(bool chroma, uint8_t quality, uint16_t* zigzagOut);
+};
+
+#endif // JPEG_REQUANTIZER_H
@@ -0,0 +1,414 @@
+#include "mission_log.h"
+#include "config.h"
+#include "storage_manager.h"
+#include <vector>
+
+// Static member definitions
+File MissionLog::file;
+bool MissionLog::isOpen = false;
+SemaphoreHandle_t MissionLog::mutex = NULL;
+MissionLogRecord MissionLog::buffer[MISSION_LOG_BUFFER_RECORDS];
+uint8_t MissionLog::buffered = 0;
+size_t MissionLog::partialBytes = 0;
+unsigned long MissionLog::lastFlush = 0;
+MissionLogStats MissionLog::stats = {};
+
+uint16_t MissionLog::crc16(const uint8_t* data, size_t length) {
+    // CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+bool MissionLog::readHeader(File& f, MissionLogHeader& header) {
+    return f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+           memcmp(header.magic, MISSION_LOG_MAGIC, 4) == 0 &&
+           header.version == MISSION_LOG_VERSION &&
+           header.recordSize == sizeof(MissionLogRecord);
+}
+
+bool MissionLog::hasCurrentLayout(const String& path) {
+    File f = StorageManager::openFile(path, "r");
+    if (!f) {
+        return false;
+    }
+    MissionLogHeader header;
+    bool current = f.size() == 0 || readHeader(f, header);
+    StorageManager::closeFile(f);
+    return current;
+}
+
+bool MissionLog::open(const String& directory) {
+    if (mutex == NULL) {
+        mutex = xSemaphoreCreateMutex();
+        if (mutex == NULL) {
+            return false;
+        }
+    }
+    if (isOpen) {
+        close();
+    }
+
+    String path = directory + "/" + MISSION_LOG_FILE;
+    if (StorageManager::exists(path) && !hasCurrentLayout(path)) {
+        Serial.println("Mission log has an older record layout, not appending: " + path);
+        return false;
+    }
+    File f = StorageManager::openFile(path, "a");
+    if (!f) {
+        Serial.println("Failed to open mission log: " + path);
+        return false;
+    }
+
+    // New file: header first; an existing log is continued
+    if (f.size() == 0) {
+        MissionLogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MISSION_LOG_MAGIC, 4);
+        header.version = MISSION_LOG_VERSION;
+        header.recordSize = sizeof(MissionLogRecord);
+        time_t now = time(nullptr);
+        header.createdUnix = now > 1600000000 ? (uint32_t)now : 0;
+        header.createdMs = millis();
+        String name = directory.substring(directory.lastIndexOf('/') + 1);
+        strncpy(header.directory, name.c_str(), sizeof(header.directory));
+        if (f.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+            StorageManager::closeFile(f);
+            Serial.println("Failed to write mission log header: " + path);
+            return false;
+        }
+        f.flush();
+    } else {
+        // Torn last record (power loss or a write that never finished):
+        // zero-pad it so new records start on a record boundary. The
+        // padded record fails its CRC and is skipped by readers
+        size_t tail = (f.size() - sizeof(MissionLogHeader)) % sizeof(MissionLogRecord);
+        if (tail > 0) {
+            uint8_t zeros[sizeof(MissionLogRecord)] = {};
+            size_t pad = sizeof(MissionLogRecord) - tail;
+            if (f.write(zeros, pad) != pad) {
+                StorageManager::closeFile(f);
+                Serial.println("Failed to pad torn mission log record: " + path);
+                return false;
+            }
+            f.flush();
+            Serial.printf("Mission log: padded a torn record (%u bytes)\n", (unsigned)tail);
+        }
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    file = f;
+    isOpen = true;
+    buffered = 0;
+    partialBytes = 0;
+    lastFlush = millis();
+    xSemaphoreGive(mutex);
+    return true;
+}
+
+bool MissionLog::append(MissionLogRecord& record) {
+    if (!isOpen || mutex == NULL) {
+        stats.recordsDropped++;
+        return false;
+    }
+
+    record.crc = crc16((const uint8_t*)&record, offsetof(MissionLogRecord, crc));
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = true;
+    if (buffered >= MISSION_LOG_BUFFER_RECORDS) {
+        ok = flushLocked(); // Only if a previous flush failed
+    }
+    if (buffered < MISSION_LOG_BUFFER_RECORDS) {
+        buffer[buffered++] = record;
+        stats.recordsLogged++;
+    } else {
+        stats.recordsDropped++;
+        ok = false;
+    }
+
+    uint8_t flushRecords = min(Config::missionLog.FLUSH_RECORDS, (uint8_t)MISSION_LOG_BUFFER_RECORDS);
+    if (buffered >= flushRecords ||
+        millis() - lastFlush >= Config::missionLog.FLUSH_INTERVAL_MS) {
+        ok = flushLocked() && ok;
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+bool MissionLog::flushLocked() {
+    lastFlush = millis();
+    if (buffered == 0) {
+        return true;
+    }
+
+    // Continue where a short write stopped: bytes already in the file are
+    // never written twice, so later records stay aligned
+    uint32_t start = micros();
+    size_t bytes = buffered * sizeof(MissionLogRecord) - partialBytes;
+    size_t written = file.write((const uint8_t*)buffer + partialBytes, bytes);
+    file.flush();
+    uint32_t elapsed = micros() - start;
+
+    stats.flushes++;
+    stats.bytesWritten += written;
+    if (elapsed > stats.maxFlushTime) {
+        stats.maxFlushTime = elapsed;
+    }
+    if (written != bytes) {
+        // Drop the whole records that made it; the rest is retried on the next append
+        size_t done = partialBytes + written;
+        uint8_t complete = done / sizeof(MissionLogRecord);
+        memmove(buffer, buffer + complete, (buffered - complete) * sizeof(MissionLogRecord));
+        buffered -= complete;
+        partialBytes = done % sizeof(MissionLogRecord);
+        return false;
+    }
+    buffered = 0;
+    partialBytes = 0;
+    return true;
+}
+
+bool MissionLog::flush() {
+    if (!isOpen || mutex == NULL) {
+        return false;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = flushLocked();
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+void MissionLog::close() {
+    if (!isOpen) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (!flushLocked()) {
+        stats.recordsDropped += buffered;
+        Serial.printf("Mission log: %u records lost on close\n", buffered);
+        buffered = 0;
+        partialBytes = 0;
+    }
+    StorageManager::closeFile(file);
+    isOpen = false;
+    xSemaphoreGive(mutex);
+}
+
+bool MissionLog::readHashes(const String& directory, std::vector<MissionLogHash>& hashes) {
+    hashes.clear();
+    File f = StorageManager::openFile(directory + "/" + MISSION_LOG_FILE, "r");
+    if (!f) {
+        return false;
+    }
+    MissionLogHeader header;
+    if (!readHeader(f, header)) {
+        StorageManager::closeFile(f);
+        return false;
+    }
+
+    hashes.reserve((f.size() - sizeof(header)) / sizeof(MissionLogRecord));
+    MissionLogRecord record;
+    while (f.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+        if (record.crc != crc16((const uint8_t*)&record, offsetof(MissionLogRecord, crc)) ||
+            PhotoHash::isEmpty(record.sha256)) {
+            continue;
+        }
+        MissionLogHash entry;
+        memcpy(entry.filename, record.filename, sizeof(entry.filename));
+        entry.filename[sizeof(entry.filename) - 1] = '\0';
+        memcpy(entry.sha256, record.sha256, sizeof(entry.sha256));
+        hashes.push_back(entry);
+    }
+    StorageManager::closeFile(f);
+    return true;
+}
+
+bool MissionLog::readFrames(const String& directory, std::vector<MissionLogFrame>& frames) {
+    frames.clear();
+    File f = StorageManager::openFile(directory + "/" + MISSION_LOG_FILE, "r");
+    if (!f) {
+        return false;
+    }
+    MissionLogHeader header;
+    if (!readHeader(f, header)) {
+        StorageManager::closeFile(f);
+        return false;
+    }
+
+    frames.reserve((f.size() - sizeof(header)) / sizeof(MissionLogRecord));
+    MissionLogRecord record;
+    while (f.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+        if (record.crc != crc16((const uint8_t*)&record, offsetof(MissionLogRecord, crc))) {
+            continue;
+        }
+        MissionLogFrame frame;
+        frame.jpegBytes = record.fileSize > record.exifSize ? record.fileSize - record.exifSize : 0;
+        frame.jpegQuality = record.jpegQuality;
+        frame.frameSize = record.frameSize;
+        frames.push_back(frame);
+    }
+    StorageManager::closeFile(f);
+    return true;
+}
+
+void MissionLog::printStatistics() {
+    Serial.println("\n--- Mission Log ---");
+    Serial.printf("Records: %u logged, %u dropped, %u KB written\n", stats.recordsLogged,
+                  stats.recordsDropped, (unsigned)(stats.bytesWritten / 1024));
+    Serial.printf("Flushes: %u, max %u us\n", stats.flushes, stats.maxFlushTime);
+    Serial.println("-------------------\n");
+}
+
+bool MissionLog::runSelfTest() {
+    Serial.println("\n=== Mission Log Self-Test ===");
+    if (isOpen) {
+        Serial.println("FAIL: Mission log in use (capture running)");
+        return false;
+    }
+
+    const String directory = "/mission_log_test";
+    const String path = directory + "/" + MISSION_LOG_FILE;
+    const uint32_t count = MISSION_LOG_BUFFER_RECORDS + 5; // Forces a full-buffer flush
+    MissionLogStats savedStats = stats;
+    int passed = 0;
+    int total = 0;
+
+    StorageManager::remove(path);
+    StorageManager::mkdir(directory);
+
+    // Two sessions: the second must continue the file without a new header
+    bool written = open(directory);
+    for (uint32_t i = 0; written && i < count; i++) {
+        MissionLogRecord r;
+        memset(&r, 0, sizeof(r));
+        r.photoNumber = i;
+        r.latitude = -33.865143 + i * 1e-6;
+        r.longitude = 151.209900;
+        r.sharpness = -1;
+        snprintf(r.filename, sizeof(r.filename), "photo_%04u.jpg", (unsigned)i);
+        PhotoHash::compute((const uint8_t*)r.filename, strlen(r.filename), r.sha256);
+        written = append(r);
+    }
+    close();
+    if (written && open(directory)) {
+        MissionLogRecord r;
+        memset(&r, 0, sizeof(r));
+        r.photoNumber = count;
+        written = append(r);
+        close();
+    } else {
+        written = false;
+    }
+    total++;
+    if (written) {
+        passed++;
+        Serial.printf("PASS: %u records appended over two sessions\n", (unsigned)(count + 1));
+    } else {
+        Serial.println("FAIL: Could not write the test log");
+    }
+
+    std::vector<uint8_t> data;
+    bool read = StorageManager::readFileAtomic(path, data);
+    size_t expected = sizeof(MissionLogHeader) + (count + 1) * sizeof(MissionLogRecord);
+    total++;
+    if (read && data.size() == expected) {
+        passed++;
+        Serial.printf("PASS: File is %u bytes (one header)\n", (unsigned)data.size());
+    } else {
+        Serial.printf("FAIL: File is %u bytes, expected %u\n", (unsigned)data.size(), (unsigned)expected);
+    }
+
+    total++;
+    const MissionLogHeader* header = (const MissionLogHeader*)data.data();
+    if (data.size() >= sizeof(MissionLogHeader) && memcmp(header->magic, MISSION_LOG_MAGIC, 4) == 0 &&
+        header->version == MISSION_LOG_VERSION && header->recordSize == sizeof(MissionLogRecord)) {
+        passed++;
+        Serial.println("PASS: Header magic, version and record size");
+    } else {
+        Serial.println("FAIL: Bad header");
+    }
+
+    uint32_t good = 0;
+    for (size_t offset = sizeof(MissionLogHeader); offset + sizeof(MissionLogRecord) <= data.size();
+         offset += sizeof(MissionLogRecord)) {
+        const MissionLogRecord* r = (const MissionLogRecord*)(data.data() + offset);
+        uint32_t index = (offset - sizeof(MissionLogHeader)) / sizeof(MissionLogRecord);
+        if (r->crc == crc16((const uint8_t*)r, offsetof(MissionLogRecord, crc)) &&
+            r->photoNumber == index) {
+            good++;
+        }
+    }
+    total++;
+    if (good == count + 1) {
+        passed++;
+        Serial.println("PASS: All records in order with valid CRC");
+    } else {
+        Serial.printf("FAIL: %u/%u records valid\n", good, (unsigned)(count + 1));
+    }
+
+    // Only the first session's records carry a hash
+    std::vector<MissionLogHash> hashes;
+    uint32_t hashesOk = 0;
+    if (readHashes(directory, hashes)) {
+        for (const MissionLogHash& h : hashes) {
+            uint8_t expected[PHOTO_HASH_SIZE];
+            PhotoHash::compute((const uint8_t*)h.filename, strlen(h.filename), expected);
+            if (memcmp(expected, h.sha256, PHOTO_HASH_SIZE) == 0) {
+                hashesOk++;
+            }
+        }
+    }
+    total++;
+    if (hashes.size() == count && hashesOk == count) {
+        passed++;
+        Serial.printf("PASS: %u photo hashes read back\n", (unsigned)count);
+    } else {
+        Serial.printf("FAIL: %u/%u photo hashes read back (%u entries)\n",
+                      hashesOk, (unsigned)count, (unsigned)hashes.size());
+    }
+
+    // Torn record at the end (power loss): padded, next session stays aligned
+    File torn = StorageManager::openFile(path, "a");
+    bool tornWritten = torn && torn.write(data.data() + sizeof(MissionLogHeader), 50) == 50;
+    if (torn) {
+        StorageManager::closeFile(torn);
+    }
+    bool aligned = false;
+    if (tornWritten && open(directory)) {
+        MissionLogRecord r;
+        memset(&r, 0, sizeof(r));
+        r.photoNumber = count + 2;
+        append(r);
+        close();
+        size_t offset = sizeof(MissionLogHeader) + (count + 2) * sizeof(MissionLogRecord);
+        aligned = StorageManager::readFileAtomic(path, data) &&
+                  data.size() == offset + sizeof(MissionLogRecord);
+        if (aligned) {
+            const MissionLogRecord* last = (const MissionLogRecord*)(data.data() + offset);
+            aligned = last->crc == crc16((const uint8_t*)last, offsetof(MissionLogRecord, crc)) &&
+                      last->photoNumber == count + 2;
+        }
+    }
+    total++;
+    if (aligned) {
+        passed++;
+        Serial.println("PASS: Torn record padded, next session's record aligned and valid");
+    } else {
+        Serial.printf("FAIL: Record after a torn one not aligned (file %u bytes)\n",
+                      (unsigned)data.size());
+    }
+
+    StorageManager::remove(path);
+    StorageManager::rmdir(directory);
+    stats = savedStats;
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
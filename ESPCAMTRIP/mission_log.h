@@ -0,0 +1,176 @@
+#ifndef MISSION_LOG_H
+#define MISSION_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "photo_hash.h"
+
+/**
+ * Mission Log
+ *
+ * Append-only binary metadata log, one file per capture directory
+ * (<directory>/mission.bin), replacing the per-photo JSON sidecars:
+ * one fixed-size record per photo instead of one extra file.
+ *
+ * Layout (little-endian, packed):
+ *   MissionLogHeader   32 bytes, once
+ *   MissionLogRecord  168 bytes per photo, CRC-16/CCITT over the record
+ *
+ * Version 2 added the photo's SHA-256, computed while it was written
+ * (PhotoHash); UploadManager reads it back with readHashes() for the
+ * x-amz-content-sha256 header instead of hashing the file again.
+ * Version 3 added the exposure's UTC time to the microsecond; unixTime
+ * is only the fix's whole second.
+ *
+ * Records are buffered in RAM and appended through a file handle held
+ * open for the whole run, flushed every FLUSH_RECORDS records or
+ * FLUSH_INTERVAL_MS. A short write is resumed at the byte where it
+ * stopped, so records stay aligned. A torn last record after power loss
+ * fails its CRC and is skipped by tools/mission_log_convert.py
+ * (JSON/CSV/GeoJSON); open() pads it to a whole record before appending.
+ */
+
+#define MISSION_LOG_FILE "mission.bin"
+#define MISSION_LOG_MAGIC "ECML"
+#define MISSION_LOG_VERSION 3
+#define MISSION_LOG_BUFFER_RECORDS 16
+
+// MissionLogRecord.flags
+#define MISSION_LOG_GPS_VALID  0x01
+#define MISSION_LOG_GEOTAGGED  0x02
+#define MISSION_LOG_BLURRED    0x04
+#define MISSION_LOG_INTERPOLATED 0x08  // Position interpolated to the exposure time
+#define MISSION_LOG_EXTRAPOLATED 0x10  // Position projected from the last fix
+
+struct __attribute__((packed)) MissionLogHeader {
+    char magic[4];               // "ECML"
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t createdUnix;        // 0 if time not set
+    uint32_t createdMs;          // millis() at open
+    char directory[16];          // Capture directory name (no path)
+};
+
+struct __attribute__((packed)) MissionLogRecord {
+    uint32_t photoNumber;
+    uint32_t captureTimeMs;      // millis() at exposure (driver frame timestamp)
+    uint32_t unixTime;           // GPS time of the fix
+    double latitude;             // Degrees (WGS84)
+    double longitude;
+    float altitude;              // m MSL
+    float accuracy;              // m horizontal
+    float speed;                 // m/s
+    float course;                // degrees
+    float hdop;
+    float vdop;
+    float ageOfDiff;             // s
+    uint32_t fileSize;           // Bytes written for the photo
+    uint16_t exifOffset;         // GPS EXIF APP1 position in the file (0 = none)
+    uint16_t exifSize;
+    int16_t sharpness;           // Per mille, -1 = not scored
+    uint16_t gpsParseErrors;     // GPS receiver counters at capture (saturating)
+    uint16_t gpsChecksumErrors;
+    uint8_t gpsMessageRate;      // Messages per second
+    uint8_t fixQuality;
+    uint8_t satellites;
+    uint8_t baseStationId;
+    uint8_t flags;               // MISSION_LOG_*
+    uint8_t frameSize;           // framesize_t
+    uint8_t jpegQuality;
+    int32_t fixOffsetUs;         // Exposure minus the fix the position came from
+    uint8_t reserved[1];
+    uint8_t sha256[PHOTO_HASH_SIZE]; // Photo file SHA-256, all zero = not hashed
+    char filename[44];           // Photo file name (no path), NUL padded
+    int64_t exposureUtcUs;       // Exposure time, UTC unix us from the GPS clock (0 = unknown)
+    uint16_t crc;                // CRC-16/CCITT of all bytes above
+};
+
+static_assert(sizeof(MissionLogHeader) == 32, "MissionLogHeader layout changed");
+static_assert(sizeof(MissionLogRecord) == 168, "MissionLogRecord layout changed");
+
+struct MissionLogHash {
+    char filename[44];
+    uint8_t sha256[PHOTO_HASH_SIZE];
+};
+
+struct MissionLogFrame {
+    uint32_t jpegBytes;          // fileSize minus the EXIF segment
+    uint8_t jpegQuality;         // Sensor quality the frame was encoded at
+    uint8_t frameSize;           // framesize_t
+};
+
+struct MissionLogStats {
+    uint32_t recordsLogged;
+    uint32_t recordsDropped;     // Log not open or write failed
+    uint32_t flushes;
+    uint32_t maxFlushTime;       // us
+    uint64_t bytesWritten;
+
+    void reset() {
+        recordsLogged = 0;
+        recordsDropped = 0;
+        flushes = 0;
+        maxFlushTime = 0;
+        bytesWritten = 0;
+    }
+};
+
+class MissionLog {
+private:
+    static File file;
+    static bool isOpen;
+    static SemaphoreHandle_t mutex;
+    static MissionLogRecord buffer[MISSION_LOG_BUFFER_RECORDS];
+    static uint8_t buffered;
+    static size_t partialBytes;          // Bytes of buffer[0] already in the file
+    static unsigned long lastFlush;
+    static MissionLogStats stats;
+
+    static bool flushLocked();
+    static bool readHeader(File& f, MissionLogHeader& header);
+    static bool hasCurrentLayout(const String& path);
+
+public:
+    /**
+     * Open (or continue) <directory>/mission.bin for appending
+     */
+    static bool open(const String& directory);
+
+    /**
+     * Buffer one record (CRC filled in here); may flush
+     */
+    static bool append(MissionLogRecord& record);
+
+    static bool flush();
+    static void close();
+
+    static uint16_t crc16(const uint8_t* data, size_t length);
+
+    /**
+     * Photo digests recorded in <directory>/mission.bin (records with a
+     * valid CRC and a hash); false if there is no current-version log
+     */
+    static bool readHashes(const String& directory, std::vector<MissionLogHash>& hashes);
+
+    /**
+     * JPEG size and quality of each record with a valid CRC, in capture
+     * order (quality controller replay); false if there is no log
+     */
+    static bool readFrames(const String& directory, std::vector<MissionLogFrame>& frames);
+
+    /**
+     * Statistics
+     */
+    static MissionLogStats getStatistics() { return stats; }
+    static void printStatistics();
+
+    /**
+     * Write, read back and verify a log on the SD card (not while capturing)
+     */
+    static bool runSelfTest();
+};
+
+#endif // MISSION_LOG_H
@@ -0,0 +1,271 @@
+#include "mission_manifest.h"
+#include "config.h"
+#include "storage_manager.h"
+#include "camera_mode_manager.h"
+#include <esp_camera.h>
+#include <math.h>
+
+#define MANIFEST_METERS_PER_DEG_LAT 111320.0
+#define MANIFEST_DEG_TO_RAD 0.017453292519943295
+
+// Static member definitions
+File MissionManifest::file;
+bool MissionManifest::isOpen = false;
+SemaphoreHandle_t MissionManifest::mutex = NULL;
+char MissionManifest::buffer[MISSION_MANIFEST_BUFFER_SIZE];
+size_t MissionManifest::buffered = 0;
+bool MissionManifest::lineOpen = false;
+unsigned long MissionManifest::lastFlush = 0;
+uint32_t MissionManifest::features = 0;
+bool MissionManifest::groundSet = false;
+float MissionManifest::groundAltitude = 0.0f;
+MissionManifestStats MissionManifest::stats = {};
+
+bool MissionManifest::open(const String& directory) {
+    if (!Config::missionLog.MANIFEST) {
+        return false;
+    }
+    if (mutex == NULL) {
+        mutex = xSemaphoreCreateMutex();
+        if (mutex == NULL) {
+            return false;
+        }
+    }
+    if (isOpen) {
+        close();
+    }
+
+    // An existing manifest is continued over its trailer; one left open by
+    // a reset may end in a partial line and is not appended to
+    String path = directory + "/" + MISSION_MANIFEST_FILE;
+    const size_t trailerLength = strlen(MISSION_MANIFEST_TRAILER);
+    uint32_t existingFeatures = 0;
+    File f;
+    if (StorageManager::exists(path)) {
+        char tail[6] = {0};
+        File r = StorageManager::openFile(path, "r");
+        size_t size = r ? r.size() : 0;
+        bool finalized = size >= 5 && r.seek(size - 5) && r.read((uint8_t*)tail, 5) == 5 &&
+                         strcmp(tail + 5 - trailerLength, MISSION_MANIFEST_TRAILER) == 0;
+        StorageManager::closeFile(r);
+        if (!finalized) {
+            Serial.println("Manifest not finalized, not appending: " + path);
+            return false;
+        }
+        f = StorageManager::openFile(path, "r+");
+        if (!f || !f.seek(size - trailerLength)) {
+            StorageManager::closeFile(f);
+            Serial.println("Failed to reopen manifest: " + path);
+            return false;
+        }
+        existingFeatures = strncmp(tail, "[\n", 2) == 0 ? 0 : 1;
+    } else {
+        f = StorageManager::openFile(path, "w");
+        if (!f) {
+            Serial.println("Failed to create manifest: " + path);
+            return false;
+        }
+        time_t now = time(nullptr);
+        String name = directory.substring(directory.lastIndexOf('/') + 1);
+        char header[256];
+        int length = snprintf(header, sizeof(header),
+                              "{\"type\":\"FeatureCollection\",\"properties\":{\"directory\":\"%s\","
+                              "\"created_unix\":%lu,\"lens_along_track_fov_deg\":%.1f},"
+                              "\"features\":[\n",
+                              name.c_str(), now > 1600000000 ? (unsigned long)now : 0UL,
+                              Config::cameraMode.LENS_ALONG_TRACK_FOV_DEG);
+        if (f.write((const uint8_t*)header, length) != (size_t)length) {
+            StorageManager::closeFile(f);
+            Serial.println("Failed to write manifest header: " + path);
+            return false;
+        }
+        f.flush();
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    file = f;
+    isOpen = true;
+    buffered = 0;
+    lineOpen = false;
+    lastFlush = millis();
+    features = existingFeatures;
+    groundSet = false;
+    xSemaphoreGive(mutex);
+    return true;
+}
+
+int MissionManifest::formatFeature(const CaptureSlot& slot, char* line, size_t size) {
+    const char* name = strrchr(slot.filename, '/');
+    name = name ? name + 1 : slot.filename;
+    const char* separator = features > 0 ? "," : "";
+
+    const GPSPosition& gps = slot.gps;
+    if (!slot.geotagged || !gps.valid) {
+        return snprintf(line, size,
+                        "%s{\"type\":\"Feature\",\"geometry\":null,\"properties\":{"
+                        "\"photo\":\"%s\",\"photo_number\":%u,\"capture_time_ms\":%lu}}\n",
+                        separator, name, slot.sequence, slot.captureTime);
+    }
+
+    // Height above the takeoff point, or above the first photo of the run
+    float ground;
+    if (!CameraModeManager::getTakeoffAltitude(ground)) {
+        if (!groundSet) {
+            groundAltitude = gps.altitude;
+            groundSet = true;
+        }
+        ground = groundAltitude;
+    }
+    float agl = max(gps.altitude - ground, Config::cameraMode.MIN_TRIGGER_AGL_M);
+
+    // Footprint extents: image height along track, width across
+    float aspect = 4.0f / 3.0f;
+    if (slot.frameSize < FRAMESIZE_INVALID && resolution[slot.frameSize].height > 0) {
+        aspect = (float)resolution[slot.frameSize].width / resolution[slot.frameSize].height;
+    }
+    float along = 2.0f * agl * tanf(Config::cameraMode.LENS_ALONG_TRACK_FOV_DEG * 0.5f *
+                                    (float)MANIFEST_DEG_TO_RAD);
+    float across = along * aspect;
+
+    bool headingValid = gps.speed >= MISSION_MANIFEST_MIN_HEADING_SPEED;
+    float heading = headingValid ? gps.course : 0.0f;
+    float sinH = sinf(heading * (float)MANIFEST_DEG_TO_RAD);
+    float cosH = cosf(heading * (float)MANIFEST_DEG_TO_RAD);
+    double metersPerDegLon = MANIFEST_METERS_PER_DEG_LAT * cos(gps.latitude * MANIFEST_DEG_TO_RAD);
+
+    // Corners front-left, back-left, back-right, front-right: counterclockwise
+    // exterior ring (RFC 7946); ENU offsets converted to degrees
+    static const int8_t SIGNS[4][2] = {{1, -1}, {-1, -1}, {-1, 1}, {1, 1}};
+    double lon[4], lat[4];
+    double west = 180.0, east = -180.0, south = 90.0, north = -90.0;
+    for (int i = 0; i < 4; i++) {
+        float f = SIGNS[i][0] * along * 0.5f;
+        float r = SIGNS[i][1] * across * 0.5f;
+        lat[i] = gps.latitude + (f * cosH - r * sinH) / MANIFEST_METERS_PER_DEG_LAT;
+        lon[i] = gps.longitude + (f * sinH + r * cosH) / metersPerDegLon;
+        west = min(west, lon[i]);
+        east = max(east, lon[i]);
+        south = min(south, lat[i]);
+        north = max(north, lat[i]);
+    }
+
+    const char* position = slot.positionSource == GPS_POSITION_INTERPOLATED ? "interpolated" :
+                           slot.positionSource == GPS_POSITION_EXTRAPOLATED ? "extrapolated" : "latest";
+    char headingText[12];
+    if (headingValid) {
+        snprintf(headingText, sizeof(headingText), "%.1f", heading);
+    } else {
+        strcpy(headingText, "null");
+    }
+
+    return snprintf(line, size,
+                    "%s{\"type\":\"Feature\",\"bbox\":[%.7f,%.7f,%.7f,%.7f],"
+                    "\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.7f,%.7f,%.2f]},"
+                    "\"properties\":{\"photo\":\"%s\",\"photo_number\":%u,\"capture_time_ms\":%lu,"
+                    "\"unix_time\":%u,\"fix_quality\":%u,\"satellites\":%u,\"hdop\":%.2f,"
+                    "\"accuracy_m\":%.3f,\"position\":\"%s\",\"agl_m\":%.1f,\"heading_deg\":%s,"
+                    "\"footprint_m\":[%.1f,%.1f],\"footprint\":[[[%.7f,%.7f],[%.7f,%.7f],"
+                    "[%.7f,%.7f],[%.7f,%.7f],[%.7f,%.7f]]]}}\n",
+                    separator, west, south, east, north,
+                    gps.longitude, gps.latitude, gps.altitude,
+                    name, slot.sequence, slot.captureTime,
+                    gps.timestamp, gps.fixQuality, gps.satellites, gps.hdop,
+                    gps.accuracy, position, agl, headingText,
+                    across, along, lon[0], lat[0], lon[1], lat[1],
+                    lon[2], lat[2], lon[3], lat[3], lon[0], lat[0]);
+}
+
+bool MissionManifest::append(const CaptureSlot& slot) {
+    if (!isOpen || mutex == NULL) {
+        if (Config::missionLog.MANIFEST) {
+            stats.featuresDropped++;
+        }
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = true;
+    if (MISSION_MANIFEST_BUFFER_SIZE - buffered < MISSION_MANIFEST_LINE_SIZE) {
+        ok = flushLocked();
+    }
+    // Formatted straight into the buffer (no line on the writer task stack)
+    int length = -1;
+    if (MISSION_MANIFEST_BUFFER_SIZE - buffered >= MISSION_MANIFEST_LINE_SIZE) {
+        length = formatFeature(slot, buffer + buffered, MISSION_MANIFEST_LINE_SIZE);
+    }
+    if (length > 0 && length < MISSION_MANIFEST_LINE_SIZE) {
+        buffered += length;
+        features++;
+        stats.featuresWritten++;
+    } else {
+        stats.featuresDropped++;
+        ok = false;
+    }
+
+    if (millis() - lastFlush >= Config::missionLog.FLUSH_INTERVAL_MS) {
+        ok = flushLocked() && ok;
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+bool MissionManifest::flushLocked() {
+    lastFlush = millis();
+    if (buffered == 0) {
+        return true;
+    }
+
+    uint32_t start = micros();
+    size_t written = file.write((const uint8_t*)buffer, buffered);
+    file.flush();
+    uint32_t elapsed = micros() - start;
+
+    stats.flushes++;
+    stats.bytesWritten += written;
+    if (elapsed > stats.maxFlushTime) {
+        stats.maxFlushTime = elapsed;
+    }
+    if (written > 0) {
+        lineOpen = buffer[written - 1] != '\n';
+    }
+    if (written != buffered) {
+        // Keep only what did not make it; the next flush continues there
+        memmove(buffer, buffer + written, buffered - written);
+        buffered -= written;
+        return false;
+    }
+    buffered = 0;
+    return true;
+}
+
+void MissionManifest::close() {
+    if (!isOpen) {
+        return;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (!flushLocked()) {
+        Serial.printf("Manifest: %u bytes lost on close\n", (unsigned)buffered);
+        buffered = 0;
+    }
+    // Constant-time finalize: close the features array. After a partial
+    // line it stays open for UploadManager::repairManifest() to cut
+    size_t length = strlen(MISSION_MANIFEST_TRAILER);
+    if (lineOpen) {
+        Serial.println("Manifest: ends in a partial line, left for repair at upload");
+    } else if (file.write((const uint8_t*)MISSION_MANIFEST_TRAILER, length) == length) {
+        stats.bytesWritten += length;
+    } else {
+        Serial.println("Manifest: failed to write trailer");
+    }
+    StorageManager::closeFile(file);
+    isOpen = false;
+    xSemaphoreGive(mutex);
+}
+
+void MissionManifest::printStatistics() {
+    Serial.println("\n--- Mission Manifest ---");
+    Serial.printf("Features: %u written, %u dropped, %u KB written\n", stats.featuresWritten,
+                  stats.featuresDropped, (unsigned)(stats.bytesWritten / 1024));
+    Serial.printf("Flushes: %u, max %u us\n", stats.flushes, stats.maxFlushTime);
+    Serial.println("------------------------\n");
+}
@@ -0,0 +1,100 @@
+#ifndef MISSION_MANIFEST_H
+#define MISSION_MANIFEST_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "capture_pipeline.h"
+
+/**
+ * Mission Manifest
+ *
+ * GeoJSON FeatureCollection per capture directory (<directory>/manifest.geojson)
+ * built while capturing, so a flight map needs no pass over the photos.
+ * UploadManager sends it before any photo.
+ *
+ * One Feature per photo: Point geometry at the exposure position, the
+ * estimated ground footprint (polygon and bbox) and name, time, fix
+ * quality and accuracy as properties. Photos without GPS get a null
+ * geometry.
+ *
+ * The file is append-only: the header with the open "features" array is
+ * written at open, each feature is one line (",{...}\n" after the first)
+ * and close() appends the "]}" trailer, so finalizing costs the same for
+ * any mission length. A file cut short by power loss ends at the last
+ * newline once its partial line is dropped; UploadManager::repairManifest()
+ * does that and closes the array before upload. A short write is resumed
+ * at the byte where it stopped, so lines are never split by a retry.
+ *
+ * Footprint: nadir camera with the image top along the course,
+ * along-track extent 2 * AGL * tan(LENS_ALONG_TRACK_FOV_DEG / 2) and
+ * across-track scaled by the frame aspect ratio. AGL is relative to the
+ * distance trigger's takeoff altitude, else to the first photo of the run,
+ * and floored at MIN_TRIGGER_AGL_M.
+ */
+
+#define MISSION_MANIFEST_FILE "manifest.geojson"
+#define MISSION_MANIFEST_TRAILER "]}\n"
+#define MISSION_MANIFEST_BUFFER_SIZE 4096
+#define MISSION_MANIFEST_LINE_SIZE 768
+#define MISSION_MANIFEST_MIN_HEADING_SPEED 1.0f  // m/s; slower fixes are drawn north-up
+
+struct MissionManifestStats {
+    uint32_t featuresWritten;
+    uint32_t featuresDropped;    // Manifest not open or write failed
+    uint32_t flushes;
+    uint32_t maxFlushTime;       // us
+    uint64_t bytesWritten;
+
+    void reset() {
+        featuresWritten = 0;
+        featuresDropped = 0;
+        flushes = 0;
+        maxFlushTime = 0;
+        bytesWritten = 0;
+    }
+};
+
+class MissionManifest {
+private:
+    static File file;
+    static bool isOpen;
+    static SemaphoreHandle_t mutex;
+    static char buffer[MISSION_MANIFEST_BUFFER_SIZE];
+    static size_t buffered;
+    static bool lineOpen;                // File ends in a partly written line
+    static unsigned long lastFlush;
+    static uint32_t features;
+    static bool groundSet;
+    static float groundAltitude;
+    static MissionManifestStats stats;
+
+    static bool flushLocked();
+    static int formatFeature(const CaptureSlot& slot, char* line, size_t size);
+
+public:
+    /**
+     * Open <directory>/manifest.geojson; a finalized manifest is reopened
+     * in place of its trailer
+     */
+    static bool open(const String& directory);
+
+    /**
+     * Buffer the feature for one written photo; may flush
+     */
+    static bool append(const CaptureSlot& slot);
+
+    /**
+     * Flush and close the features array
+     */
+    static void close();
+
+    /**
+     * Statistics
+     */
+    static MissionManifestStats getStatistics() { return stats; }
+    static void printStatistics();
+};
+
+#endif // MISSION_MANIFEST_H
@@ -0,0 +1,356 @@
+#include "mission_tag_scanner.h"
+#include "scaled_luma.h"
+#include "apriltag_manager.h"
+#include "mavlink_manager.h"
+#include "camera_mode_manager.h"
+#include "capture_pipeline.h"
+#include "camera_hal.h"
+#include "psram_manager.h"
+#include "system_state.h"
+#include "config.h"
+#include <esp_timer.h>
+
+// Scaled luma of the largest mission frame (UXGA) at 1/4; 1/8 fits as well
+static const size_t GRAY_BUFFER_SIZE = (1600 / 4) * (1200 / 4);
+
+// Decoder state is ~14KB: keep it off the task stack
+static JpegCoeffDecoder scanDecoder;
+
+static portMUX_TYPE budgetMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Static member definitions
+bool MissionTagScanner::initialized = false;
+uint8_t* MissionTagScanner::jpegBuffer = nullptr;
+size_t MissionTagScanner::jpegLength = 0;
+int64_t MissionTagScanner::jpegExposureUs = 0;
+uint8_t* MissionTagScanner::grayBuffer = nullptr;
+size_t MissionTagScanner::grayBufferSize = 0;
+TaskHandle_t MissionTagScanner::scanTaskHandle = NULL;
+volatile bool MissionTagScanner::busy = false;
+uint8_t MissionTagScanner::frameCounter = 0;
+int64_t MissionTagScanner::budgetDebtUs = 0;
+int64_t MissionTagScanner::budgetUpdatedUs = 0;
+MissionTagStats MissionTagScanner::stats = {};
+
+bool MissionTagScanner::allocateBuffers() {
+    if (!jpegBuffer) {
+        jpegBuffer = (uint8_t*)PSRAM_MALLOC(Config::pipeline.SLOT_SIZE);
+    }
+    if (!grayBuffer) {
+        grayBuffer = (uint8_t*)PSRAM_MALLOC(GRAY_BUFFER_SIZE);
+        grayBufferSize = grayBuffer ? GRAY_BUFFER_SIZE : 0;
+    }
+    return jpegBuffer && grayBuffer;
+}
+
+bool MissionTagScanner::init() {
+    if (initialized) {
+        return true;
+    }
+
+    if (!Config::missionTags.enabled) {
+        Serial.println("Mission tag scanning disabled");
+        return false;
+    }
+
+    if (!AprilTagManager::isInitialized()) {
+        Serial.println("Mission tag scanning requires the AprilTag detector (apriltag.enabled)");
+        return false;
+    }
+
+    if (Config::missionTags.SCALE != 4 && Config::missionTags.SCALE != 8) {
+        Serial.printf("Mission tag scale 1/%u not supported, using 1/4\n",
+                      Config::missionTags.SCALE);
+        Config::missionTags.SCALE = 4;
+    }
+
+    if (!allocateBuffers()) {
+        Serial.println("Not enough PSRAM for mission tag scanning");
+        return false;
+    }
+
+    stats.reset();
+    budgetDebtUs = 0;
+    budgetUpdatedUs = esp_timer_get_time();
+
+    xTaskCreatePinnedToCore(
+        scanTask,
+        "TagScan",
+        Config::missionTags.STACK_SIZE,
+        NULL,
+        Config::missionTags.PRIORITY,
+        &scanTaskHandle,
+        Config::missionTags.CORE
+    );
+    if (scanTaskHandle == NULL) {
+        Serial.println("Failed to create mission tag scan task");
+        return false;
+    }
+
+    initialized = true;
+    Serial.printf("Mission tag scanning: every %u frames at 1/%u, CPU budget %u%%\n",
+                  Config::missionTags.EVERY_N_FRAMES, Config::missionTags.SCALE,
+                  Config::missionTags.CPU_BUDGET_PCT);
+    return true;
+}
+
+bool MissionTagScanner::budgetAvailable(int64_t nowUs) {
+    int64_t allowanceUs = (int64_t)Config::missionTags.BUDGET_WINDOW_MS * 10 *
+                          Config::missionTags.CPU_BUDGET_PCT;
+
+    portENTER_CRITICAL(&budgetMux);
+    // Drain at the budgeted share of elapsed time
+    budgetDebtUs -= (nowUs - budgetUpdatedUs) * Config::missionTags.CPU_BUDGET_PCT / 100;
+    if (budgetDebtUs < 0) {
+        budgetDebtUs = 0;
+    }
+    budgetUpdatedUs = nowUs;
+    bool available = budgetDebtUs < allowanceUs;
+    portEXIT_CRITICAL(&budgetMux);
+    return available;
+}
+
+void MissionTagScanner::chargeBudget(uint32_t busyUs) {
+    portENTER_CRITICAL(&budgetMux);
+    budgetDebtUs += busyUs;
+    portEXIT_CRITICAL(&budgetMux);
+}
+
+void MissionTagScanner::offer(const uint8_t* jpeg, size_t length, int64_t exposureUs) {
+    if (!initialized || !CameraModeManager::isMissionMode()) {
+        return;
+    }
+
+    stats.framesOffered++;
+    uint8_t everyN = Config::missionTags.EVERY_N_FRAMES ? Config::missionTags.EVERY_N_FRAMES : 1;
+    if (++frameCounter < everyN) {
+        return;
+    }
+    frameCounter = 0;
+
+    if (busy) {
+        stats.skippedBusy++;
+        return;
+    }
+    if (CapturePipeline::getOccupancy() > CapturePipeline::getCapacity() / 2) {
+        // Writer falling behind: leave it the core
+        stats.skippedBackPressure++;
+        return;
+    }
+    if (!budgetAvailable(esp_timer_get_time())) {
+        stats.skippedBudget++;
+        return;
+    }
+    if (length > Config::pipeline.SLOT_SIZE) {
+        stats.skippedOversize++;
+        return;
+    }
+
+    // The slot is reused once the writer returns: scan a copy
+    uint32_t start = micros();
+    memcpy(jpegBuffer, jpeg, length);
+    jpegLength = length;
+    jpegExposureUs = exposureUs;
+    chargeBudget(micros() - start);
+
+    busy = true;
+    xTaskNotifyGive(scanTaskHandle);
+}
+
+void MissionTagScanner::scanTask(void* parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (busy) {
+            scanFrame();
+            busy = false;
+        }
+    }
+}
+
+void MissionTagScanner::scanFrame() {
+    // Mode changed while the frame waited: the detector belongs to LANDING now
+    if (!CameraModeManager::isMissionMode()) {
+        return;
+    }
+
+    uint32_t start = micros();
+    uint16_t width, height;
+    bool decoded = ScaledLuma::decode(scanDecoder, jpegBuffer, jpegLength,
+                                      Config::missionTags.SCALE,
+                                      grayBuffer, grayBufferSize, width, height);
+    uint32_t decodeTime = micros() - start;
+    if (!decoded) {
+        stats.decodeFailures++;
+        chargeBudget(decodeTime);
+        return;
+    }
+
+    uint32_t detectStart = micros();
+    int tags = AprilTagManager::processFrameData(grayBuffer, width, height);
+    uint32_t detectTime = micros() - detectStart;
+    chargeBudget(micros() - start);
+
+    stats.framesScanned++;
+    stats.lastDecodeTime = decodeTime;
+    stats.totalDecodeTime += decodeTime;
+    if (decodeTime > stats.maxDecodeTime) {
+        stats.maxDecodeTime = decodeTime;
+    }
+    stats.lastDetectTime = detectTime;
+    stats.totalDetectTime += detectTime;
+    if (detectTime > stats.maxDetectTime) {
+        stats.maxDetectTime = detectTime;
+    }
+
+    uint32_t latency = (uint32_t)((esp_timer_get_time() - jpegExposureUs) / 1000);
+    stats.lastLatency = latency;
+    if (latency > stats.maxLatency) {
+        stats.maxLatency = latency;
+    }
+
+    if (tags <= 0) {
+        return;
+    }
+    stats.framesWithTags++;
+
+    AprilTagDetection detection = AprilTagManager::getLastDetection();
+    if (latency > Config::missionTags.MAX_LATENCY_MS) {
+        // The aircraft has moved on: a stale bearing is worse than none
+        stats.staleDetections++;
+        Serial.printf("MISSION: AprilTag ID=%d found %u ms after exposure, not sent\n",
+                      detection.id, latency);
+        return;
+    }
+
+    Serial.printf("MISSION: AprilTag ID=%d at (%.1f,%.1f), %u ms after exposure\n",
+                  detection.id, detection.center_x, detection.center_y, latency);
+    if (MAVLinkManager::isInitialized() && MAVLinkManager::isEnabled() &&
+        MAVLinkManager::sendLandingTarget(detection)) {
+        stats.targetsSent++;
+    }
+}
+
+bool MissionTagScanner::waitIdle(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (busy) {
+        if (millis() - start > timeoutMs) {
+            Serial.println("Mission tag scan still running");
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+void MissionTagScanner::printStatistics() {
+    uint32_t scanned = stats.framesScanned;
+    Serial.println("\n--- Mission Tag Scan ---");
+    Serial.printf("Frames offered: %u, scanned: %u, with tags: %u, targets sent: %u, stale: %u\n",
+                  stats.framesOffered, scanned, stats.framesWithTags,
+                  stats.targetsSent, stats.staleDetections);
+    Serial.printf("Skipped: busy %u, budget %u, back-pressure %u, oversize %u; decode failures %u\n",
+                  stats.skippedBusy, stats.skippedBudget, stats.skippedBackPressure,
+                  stats.skippedOversize, stats.decodeFailures);
+    Serial.printf("Decode last/avg/max: %u/%u/%u us\n", stats.lastDecodeTime,
+                  scanned ? (uint32_t)(stats.totalDecodeTime / scanned) : 0, stats.maxDecodeTime);
+    Serial.printf("Detect last/avg/max: %u/%u/%u us\n", stats.lastDetectTime,
+                  scanned ? (uint32_t)(stats.totalDetectTime / scanned) : 0, stats.maxDetectTime);
+    Serial.printf("Exposure to result last/max: %u/%u ms\n", stats.lastLatency, stats.maxLatency);
+    Serial.println("------------------------\n");
+}
+
+bool MissionTagScanner::runDecodeBenchmark(uint8_t frames) {
+    Serial.println("\n=== Mission Tag Decode Benchmark ===");
+
+    if (SystemState::isCapturing()) {
+        Serial.println("FAIL: Stop capture first (the benchmark takes camera frames)");
+        return false;
+    }
+    if (!allocateBuffers()) {
+        Serial.println("FAIL: Not enough PSRAM for scan buffers");
+        return false;
+    }
+    waitIdle(2000);
+
+    const uint8_t scales[2] = {4, 8};
+    uint32_t decodeTotal[2] = {0, 0};
+    uint32_t decodeMax[2] = {0, 0};
+    uint32_t detectTotal[2] = {0, 0};
+    uint32_t detectMax[2] = {0, 0};
+    uint16_t decoded[2] = {0, 0};
+    uint16_t outWidth[2] = {0, 0};
+    uint16_t outHeight[2] = {0, 0};
+    uint16_t grabbed = 0;
+    size_t jpegBytes = 0;
+    bool detect = AprilTagManager::isInitialized() && AprilTagManager::isEnabled();
+
+    for (uint8_t i = 0; i < frames; i++) {
+        camera_fb_t* fb = CameraHAL::fbGet();
+        if (!fb) {
+            continue;
+        }
+        if (fb->format != PIXFORMAT_JPEG) {
+            CameraHAL::fbReturn(fb);
+            Serial.println("FAIL: Camera source is not producing JPEG frames");
+            return false;
+        }
+        grabbed++;
+        jpegBytes += fb->len;
+
+        for (uint8_t s = 0; s < 2; s++) {
+            uint32_t start = micros();
+            bool ok = ScaledLuma::decode(scanDecoder, fb->buf, fb->len, scales[s],
+                                         grayBuffer, grayBufferSize, outWidth[s], outHeight[s]);
+            uint32_t elapsed = micros() - start;
+            if (!ok) {
+                continue;
+            }
+            decoded[s]++;
+            decodeTotal[s] += elapsed;
+            decodeMax[s] = max(decodeMax[s], elapsed);
+
+            if (detect) {
+                start = micros();
+                AprilTagManager::processFrameData(grayBuffer, outWidth[s], outHeight[s]);
+                elapsed = micros() - start;
+                detectTotal[s] += elapsed;
+                detectMax[s] = max(detectMax[s], elapsed);
+            }
+        }
+        CameraHAL::fbReturn(fb);
+    }
+
+    if (grabbed == 0) {
+        Serial.println("FAIL: No frames from camera source");
+        return false;
+    }
+
+    Serial.printf("%u frames from %s, avg %u KB\n", grabbed, CameraHAL::getSourceName(),
+                  (unsigned)(jpegBytes / grabbed / 1024));
+    uint32_t scanIntervalMs = Config::cameraMode.MISSION_CAPTURE_INTERVAL *
+                              max((uint8_t)1, Config::missionTags.EVERY_N_FRAMES);
+    for (uint8_t s = 0; s < 2; s++) {
+        if (decoded[s] == 0) {
+            Serial.printf("1/%u: no frame decoded\n", scales[s]);
+            continue;
+        }
+        uint32_t decodeAvg = decodeTotal[s] / decoded[s];
+        uint32_t detectAvg = detectTotal[s] / decoded[s];
+        Serial.printf("1/%u (%ux%u): decode avg/max %u/%u us, detect avg/max %u/%u us\n",
+                      scales[s], outWidth[s], outHeight[s], decodeAvg, decodeMax[s],
+                      detectAvg, detectMax[s]);
+        Serial.printf("  CPU at one scan per %u ms: %.1f%% (budget %u%%)\n", scanIntervalMs,
+                      (decodeAvg + detectAvg) / (scanIntervalMs * 10.0f),
+                      Config::missionTags.CPU_BUDGET_PCT);
+    }
+    if (!detect) {
+        Serial.println("Detection not timed: AprilTag detector not initialized");
+    }
+
+    bool passed = decoded[0] == grabbed && decoded[1] == grabbed;
+    Serial.printf("%s: %u/%u frames decoded at both scales\n", passed ? "PASS" : "FAIL",
+                  min(decoded[0], decoded[1]), grabbed);
+    Serial.printf("Overall Result: %s\n", passed ? "PASS" : "FAIL");
+    Serial.println("====================================\n");
+    return passed;
+}
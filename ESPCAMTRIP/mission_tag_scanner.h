@@ -0,0 +1,126 @@
+#ifndef MISSION_TAG_SCANNER_H
+#define MISSION_TAG_SCANNER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * Mission Tag Scanner
+ *
+ * Looks for AprilTags in mission (mapping) frames, so a landing pad seen
+ * during the survey is reported to the flight controller before LANDING
+ * mode starts. Every Nth saved JPEG is decoded luma-only at 1/4 or 1/8
+ * scale (ScaledLuma) and run through AprilTagManager; detections are sent
+ * as MAVLink LANDING_TARGET.
+ *
+ * Mapping cadence comes first:
+ * - The SD writer only copies the JPEG into a scanner buffer after the
+ *   photo is saved; decode and detection run in a lower-priority task
+ * - A frame is skipped (and counted) when the previous scan is still
+ *   running, the capture ring is over half full, or the scanner has used
+ *   its CPU budget: a leaky bucket of scan time that drains at
+ *   CPU_BUDGET_PCT of wall time and holds at most that share of
+ *   BUDGET_WINDOW_MS
+ *
+ * All buffers are allocated at init. The detector is shared with LANDING
+ * mode, so the scanner only runs in MISSION mode and the mode switch waits
+ * for it (waitIdle()).
+ */
+
+struct MissionTagStats {
+    uint32_t framesOffered;      // Mission frames seen by offer()
+    uint32_t framesScanned;
+    uint32_t framesWithTags;
+    uint32_t targetsSent;        // LANDING_TARGET messages sent
+    uint32_t staleDetections;    // Over MAX_LATENCY_MS after exposure, not sent
+    uint32_t skippedBusy;        // Previous scan still running
+    uint32_t skippedBudget;      // CPU budget used up
+    uint32_t skippedBackPressure;// Capture ring over half full
+    uint32_t skippedOversize;    // JPEG larger than the scan buffer
+    uint32_t decodeFailures;
+    uint32_t lastDecodeTime;     // us
+    uint32_t maxDecodeTime;
+    uint64_t totalDecodeTime;
+    uint32_t lastDetectTime;     // us
+    uint32_t maxDetectTime;
+    uint64_t totalDetectTime;
+    uint32_t lastLatency;        // ms from exposure to detection result
+    uint32_t maxLatency;
+
+    void reset() {
+        framesOffered = 0;
+        framesScanned = 0;
+        framesWithTags = 0;
+        targetsSent = 0;
+        staleDetections = 0;
+        skippedBusy = 0;
+        skippedBudget = 0;
+        skippedBackPressure = 0;
+        skippedOversize = 0;
+        decodeFailures = 0;
+        lastDecodeTime = 0;
+        maxDecodeTime = 0;
+        totalDecodeTime = 0;
+        lastDetectTime = 0;
+        maxDetectTime = 0;
+        totalDetectTime = 0;
+        lastLatency = 0;
+        maxLatency = 0;
+    }
+};
+
+class MissionTagScanner {
+private:
+    static bool initialized;
+    static uint8_t* jpegBuffer;          // PSRAM copy of the frame being scanned
+    static size_t jpegLength;
+    static int64_t jpegExposureUs;
+    static uint8_t* grayBuffer;          // PSRAM, scaled luma
+    static size_t grayBufferSize;
+    static TaskHandle_t scanTaskHandle;
+    static volatile bool busy;           // Frame handed to the task, not yet scanned
+    static uint8_t frameCounter;
+    static int64_t budgetDebtUs;         // Leaky bucket of scan time
+    static int64_t budgetUpdatedUs;
+    static MissionTagStats stats;
+
+    static bool allocateBuffers();
+    static void scanTask(void* parameter);
+    static void scanFrame();
+    static bool budgetAvailable(int64_t nowUs);
+    static void chargeBudget(uint32_t busyUs);
+
+public:
+    static bool init();
+    static bool isInitialized() { return initialized; }
+
+    /**
+     * Offer a saved mission frame (SD writer, after the photo is written).
+     * Copies and hands it to the scan task, or counts why it was skipped.
+     *
+     * @param exposureUs Frame timestamp (esp_timer us), for detection latency
+     */
+    static void offer(const uint8_t* jpeg, size_t length, int64_t exposureUs);
+
+    /**
+     * Wait for a running scan to finish (before leaving MISSION mode)
+     */
+    static bool waitIdle(uint32_t timeoutMs);
+
+    /**
+     * Statistics
+     */
+    static MissionTagStats getStatistics() { return stats; }
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+
+    /**
+     * Decode benchmark: grabs frames from the camera source (sensor or
+     * replay) and times the 1/4 and 1/8 luma decode and tag detection on
+     * each, with the CPU share this costs at the mission capture rate
+     */
+    static bool runDecodeBenchmark(uint8_t frames);
+};
+
+#endif // MISSION_TAG_SCANNER_H
@@ -0,0 +1,78 @@
+#ifndef PHOTO_HASH_H
+#define PHOTO_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include <mbedtls/sha256.h>
+#endif
+
+/**
+ * Photo Hash (incremental SHA-256)
+ *
+ * SHA-256 of a photo computed from the bytes as they are written to SD,
+ * so the digest is known without reading the file back. It goes into the
+ * directory's mission log and is sent as x-amz-content-sha256 on upload;
+ * S3 rejects the PUT if the data read from SD no longer matches.
+ *
+ * - On target the mbedtls SHA-256 API is used, which ESP-IDF routes to the
+ *   SHA accelerator (CONFIG_MBEDTLS_HARDWARE_SHA)
+ * - Elsewhere a small software implementation (FIPS 180-4) is built, so
+ *   host tools and checks produce the same digests
+ *
+ * Portable C++ (no Arduino dependencies); no heap allocation.
+ */
+
+#define PHOTO_HASH_SIZE 32
+#define PHOTO_HASH_HEX_SIZE (PHOTO_HASH_SIZE * 2 + 1)
+
+class PhotoHash {
+private:
+#ifdef ESP_PLATFORM
+    mbedtls_sha256_context ctx;
+#else
+    uint32_t state[8];
+    uint64_t totalLength;
+    uint8_t block[64];
+    size_t blockLength;
+
+    void processBlock(const uint8_t* data);
+#endif
+
+public:
+    PhotoHash();
+    ~PhotoHash();
+    PhotoHash(const PhotoHash&) = delete;
+    PhotoHash& operator=(const PhotoHash&) = delete;
+
+    /**
+     * Start a new digest (also done by the constructor)
+     */
+    void begin();
+    void update(const uint8_t* data, size_t length);
+
+    /**
+     * Final digest; begin() again before reusing the object
+     */
+    void finish(uint8_t digest[PHOTO_HASH_SIZE]);
+
+    /**
+     * One-shot digest of a buffer
+     */
+    static void compute(const uint8_t* data, size_t length, uint8_t digest[PHOTO_HASH_SIZE]);
+
+    /**
+     * Lowercase hex, NUL terminated (PHOTO_HASH_HEX_SIZE bytes)
+     */
+    static void toHex(const uint8_t digest[PHOTO_HASH_SIZE], char* hex);
+
+    /**
+     * All-zero digest marks "not hashed" in the mission log
+     */
+    static bool isEmpty(const uint8_t digest[PHOTO_HASH_SIZE]);
+
+    static const char* getBackendName();
+};
+
+#endif // PHOTO_HASH_H
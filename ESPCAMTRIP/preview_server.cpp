@@ -0,0 +1,255 @@
+#include "preview_server.h"
+#include "config.h"
+#include <esp_timer.h>
+
+static const char STREAM_BOUNDARY[] = "frame";
+
+// Static member definitions
+bool PreviewServer::initialized = false;
+WiFiServer PreviewServer::server;
+PreviewClient PreviewServer::clients[PREVIEW_MAX_CLIENTS];
+uint8_t PreviewServer::clientCount = 0;
+TaskHandle_t PreviewServer::serverTaskHandle = NULL;
+PreviewStats PreviewServer::stats = {};
+
+bool PreviewServer::init() {
+    if (initialized) {
+        return true;
+    }
+
+    if (!Config::preview.enabled) {
+        Serial.println("Live preview disabled");
+        return false;
+    }
+
+    if (!CapturePipeline::isInitialized()) {
+        Serial.println("Live preview requires the capture pipeline");
+        return false;
+    }
+
+    if (Config::preview.MAX_CLIENTS > PREVIEW_MAX_CLIENTS) {
+        Config::preview.MAX_CLIENTS = PREVIEW_MAX_CLIENTS;
+    }
+    if (Config::preview.MAX_FPS <= 0.0f) {
+        Config::preview.MAX_FPS = 1.0f;
+    }
+
+    for (uint8_t i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+        clients[i].active = false;
+        clients[i].slot = nullptr;
+    }
+    stats.reset();
+
+    server.begin(Config::preview.PORT);
+
+    xTaskCreatePinnedToCore(
+        serverTask,
+        "Preview",
+        Config::preview.STACK_SIZE,
+        NULL,
+        Config::preview.PRIORITY,
+        &serverTaskHandle,
+        Config::preview.CORE
+    );
+    if (serverTaskHandle == NULL) {
+        Serial.println("Failed to create preview task");
+        server.end();
+        return false;
+    }
+
+    initialized = true;
+    Serial.printf("Live preview: http://%s:%u/stream (max %u clients, %.1f fps each)\n",
+                  WiFi.localIP().toString().c_str(), Config::preview.PORT,
+                  Config::preview.MAX_CLIENTS, Config::preview.MAX_FPS);
+    return true;
+}
+
+void PreviewServer::serverTask(void* parameter) {
+    while (true) {
+        acceptClients();
+
+        bool sending = false;
+        int64_t now = esp_timer_get_time();
+        for (uint8_t i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            if (clients[i].active && serviceClient(clients[i], now)) {
+                sending = true;
+            }
+        }
+
+        // Yield a tick between chunks; poll slowly when there is nothing to send
+        vTaskDelay(sending ? 1 : pdMS_TO_TICKS(10));
+    }
+}
+
+bool PreviewServer::readRequestLine(WiFiClient& client, char* line, size_t size) {
+    size_t length = 0;
+    unsigned long start = millis();
+    while (millis() - start < 500) {
+        if (!client.available()) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+        char c = client.read();
+        if (c == '\n') {
+            line[length] = '\0';
+            // Headers are not used: discard what has arrived
+            while (client.available()) {
+                client.read();
+            }
+            return true;
+        }
+        if (c != '\r' && length < size - 1) {
+            line[length++] = c;
+        }
+    }
+    return false;
+}
+
+void PreviewServer::acceptClients() {
+    WiFiClient incoming = server.accept();
+    if (!incoming) {
+        return;
+    }
+
+    char line[64];
+    bool isStream = readRequestLine(incoming, line, sizeof(line)) &&
+                    (strncmp(line, "GET /stream ", 12) == 0 || strncmp(line, "GET / ", 6) == 0);
+    if (!isStream) {
+        incoming.print("HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
+        incoming.stop();
+        stats.clientsRejected++;
+        return;
+    }
+
+    PreviewClient* c = nullptr;
+    if (clientCount < Config::preview.MAX_CLIENTS) {
+        for (uint8_t i = 0; i < PREVIEW_MAX_CLIENTS; i++) {
+            if (!clients[i].active) {
+                c = &clients[i];
+                break;
+            }
+        }
+    }
+    if (!c) {
+        incoming.print("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+        incoming.stop();
+        stats.clientsRejected++;
+        return;
+    }
+
+    char header[160];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: multipart/x-mixed-replace; boundary=%s\r\n"
+                          "Cache-Control: no-cache\r\n"
+                          "Access-Control-Allow-Origin: *\r\n\r\n", STREAM_BOUNDARY);
+    incoming.write((const uint8_t*)header, length);
+
+    c->client = incoming;
+    c->active = true;
+    c->slot = nullptr;
+    c->offset = 0;
+    c->lastSequence = 0;
+    c->nextFrameUs = 0;
+    c->lastProgress = millis();
+    clientCount++;
+    stats.clientsServed++;
+
+    // Keep the newest written frame from now on
+    CapturePipeline::setPreviewActive(true);
+    Serial.printf("Preview client connected (%u active)\n", clientCount);
+}
+
+bool PreviewServer::serviceClient(PreviewClient& c, int64_t nowUs) {
+    if (!c.client.connected()) {
+        closeClient(c);
+        return false;
+    }
+
+    if (!c.slot) {
+        // Rate limit, then only a frame newer than the last one sent
+        if (nowUs < c.nextFrameUs) {
+            return false;
+        }
+        c.slot = CapturePipeline::acquirePreview(c.lastSequence);
+        if (!c.slot) {
+            return false;
+        }
+        c.nextFrameUs = nowUs + (int64_t)(1000000.0f / Config::preview.MAX_FPS);
+        c.frameStartUs = nowUs;
+        c.offset = 0;
+
+        uint32_t age = (uint32_t)((nowUs - c.slot->exposureUs) / 1000);
+        stats.lastFrameAge = age;
+        if (age > stats.maxFrameAge) {
+            stats.maxFrameAge = age;
+        }
+
+        char header[160];
+        int length = snprintf(header, sizeof(header),
+                              "--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                              "X-Frame-Sequence: %u\r\nX-Frame-Age-Ms: %u\r\n\r\n",
+                              STREAM_BOUNDARY, (unsigned)c.slot->length,
+                              c.slot->sequence, age);
+        if (c.client.write((const uint8_t*)header, length) != (size_t)length) {
+            closeClient(c);
+            return false;
+        }
+        c.lastProgress = millis();
+    }
+
+    size_t chunk = min((size_t)Config::preview.CHUNK_SIZE, c.slot->length - c.offset);
+    size_t written = c.client.write(c.slot->data + c.offset, chunk);
+    if (written > 0) {
+        c.offset += written;
+        c.lastProgress = millis();
+        stats.bytesSent += written;
+    } else if (millis() - c.lastProgress > Config::preview.SEND_TIMEOUT_MS) {
+        stats.clientsDropped++;
+        closeClient(c);
+        return false;
+    }
+
+    if (c.offset == c.slot->length) {
+        c.client.write((const uint8_t*)"\r\n", 2);
+        CapturePipeline::releasePreview(c.slot);
+        c.slot = nullptr;
+
+        uint32_t sendTime = (uint32_t)((esp_timer_get_time() - c.frameStartUs) / 1000);
+        stats.framesSent++;
+        stats.lastSendTime = sendTime;
+        stats.totalSendTime += sendTime;
+        if (sendTime > stats.maxSendTime) {
+            stats.maxSendTime = sendTime;
+        }
+    }
+    return true;
+}
+
+void PreviewServer::closeClient(PreviewClient& c) {
+    if (c.slot) {
+        CapturePipeline::releasePreview(c.slot);
+        c.slot = nullptr;
+    }
+    c.client.stop();
+    c.active = false;
+    clientCount--;
+
+    if (clientCount == 0) {
+        CapturePipeline::setPreviewActive(false);
+    }
+    Serial.printf("Preview client disconnected (%u active)\n", clientCount);
+}
+
+void PreviewServer::printStatistics() {
+    Serial.println("\n--- Live Preview ---");
+    Serial.printf("Clients: %u active, %u served, %u rejected, %u dropped\n",
+                  clientCount, stats.clientsServed, stats.clientsRejected, stats.clientsDropped);
+    Serial.printf("Frames sent: %u (%.1f MB)\n", stats.framesSent,
+                  stats.bytesSent / 1024.0 / 1024.0);
+    Serial.printf("Frame age last/max: %u/%u ms\n", stats.lastFrameAge, stats.maxFrameAge);
+    Serial.printf("Send time last/avg/max: %u/%u/%u ms\n", stats.lastSendTime,
+                  stats.framesSent ? (uint32_t)(stats.totalSendTime / stats.framesSent) : 0,
+                  stats.maxSendTime);
+    Serial.println("--------------------\n");
+}
@@ -0,0 +1,103 @@
+#ifndef PREVIEW_SERVER_H
+#define PREVIEW_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "capture_pipeline.h"
+
+/**
+ * Live Preview Server (MJPEG over HTTP)
+ *
+ * Field setup view of the mission camera: http://<ip>:<PORT>/stream is a
+ * multipart/x-mixed-replace stream of the newest saved mission frame.
+ *
+ * Frames are sent straight from the capture ring (CapturePipeline
+ * preview references): no copy, and the camera frame buffer is never
+ * held. Capture is not disturbed:
+ * - One task at priority below CameraTask serves all clients round-robin,
+ *   CHUNK_SIZE bytes per turn, so a slow client only slows itself
+ * - Each client gets at most MAX_FPS frames/s; frames written in between
+ *   are skipped, never queued
+ * - The ring takes the preview frame back whenever capture needs a slot
+ *
+ * Each part carries X-Frame-Sequence (photo number) and X-Frame-Age-Ms
+ * (exposure to start of send) headers; tools/mjpeg_probe.py measures fps
+ * and latency from them. Needs the capture pipeline; LANDING mode frames
+ * are not saved and so not previewed.
+ */
+
+#define PREVIEW_MAX_CLIENTS 4
+
+struct PreviewStats {
+    uint32_t clientsServed;
+    uint32_t clientsRejected;    // Over MAX_CLIENTS or not a stream request
+    uint32_t clientsDropped;     // Send timeout
+    uint32_t framesSent;
+    uint64_t bytesSent;
+    uint32_t lastFrameAge;       // ms from exposure to start of send
+    uint32_t maxFrameAge;
+    uint32_t lastSendTime;       // ms per frame
+    uint32_t maxSendTime;
+    uint64_t totalSendTime;
+
+    void reset() {
+        clientsServed = 0;
+        clientsRejected = 0;
+        clientsDropped = 0;
+        framesSent = 0;
+        bytesSent = 0;
+        lastFrameAge = 0;
+        maxFrameAge = 0;
+        lastSendTime = 0;
+        maxSendTime = 0;
+        totalSendTime = 0;
+    }
+};
+
+struct PreviewClient {
+    WiFiClient client;
+    bool active;
+    const CaptureSlot* slot;     // Frame being sent (preview reference), nullptr = between frames
+    size_t offset;               // Bytes of the frame sent
+    uint32_t lastSequence;       // Preview sequence of the last frame taken
+    int64_t nextFrameUs;         // Rate limit: earliest start of the next frame
+    int64_t frameStartUs;
+    unsigned long lastProgress;  // millis() of the last successful write
+};
+
+class PreviewServer {
+private:
+    static bool initialized;
+    static WiFiServer server;
+    static PreviewClient clients[PREVIEW_MAX_CLIENTS];
+    static uint8_t clientCount;
+    static TaskHandle_t serverTaskHandle;
+    static PreviewStats stats;
+
+    static void serverTask(void* parameter);
+    static void acceptClients();
+    static bool readRequestLine(WiFiClient& client, char* line, size_t size);
+    static bool serviceClient(PreviewClient& c, int64_t nowUs);
+    static void closeClient(PreviewClient& c);
+
+public:
+    /**
+     * Start listening on Config::preview.PORT
+     * Call after WiFi and the capture pipeline are initialized
+     */
+    static bool init();
+    static bool isInitialized() { return initialized; }
+
+    static uint8_t getClientCount() { return clientCount; }
+
+    /**
+     * Statistics
+     */
+    static PreviewStats getStatistics() { return stats; }
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+};
+
+#endif // PREVIEW_SERVER_H
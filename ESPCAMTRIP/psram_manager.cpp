@@ -1,6 +1,7 @@
 #include "psram_manager.h"
 #include "esp_heap_caps.h"
 #include "esp_psram.h"
+#include "alloc_counter.h"
 
 // Static member definitions
 bool PSRAMManager::psram_available = false;
@@ -71,9 +72,10 @@ void* PSRAMManager::allocate(size_t size, bool force_psram) {
 
     if (force_psram || size >= 1024) {
         // Use PSRAM for large allocations or when forced
+        // Not a malloc call, so counted here; no logging, this runs per buffer
         ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
         if (ptr) {
-            Serial.printf("PSRAM allocated: %u bytes\n", size);
+            AllocCounter::record(size);
         }
     }
 
@@ -88,6 +90,14 @@ void* PSRAMManager::allocate(size_t size, bool force_psram) {
     return ptr;
 }
 
+void* PSRAMManager::allocateZeroed(size_t num, size_t size, bool force_psram) {
+    void* ptr = allocate(num * size, force_psram);
+    if (ptr) {
+        memset(ptr, 0, num * size);
+    }
+    return ptr;
+}
+
 void* PSRAMManager::reallocate(void* ptr, size_t size) {
     if (!psram_available) {
         return realloc(ptr, size);
@@ -46,6 +46,7 @@ public:
      * Automatically uses PSRAM for large allocations
      */
     static void* allocate(size_t size, bool force_psram = false);
+    static void* allocateZeroed(size_t num, size_t size, bool force_psram = false);
     static void* reallocate(void* ptr, size_t size);
     static void deallocate(void* ptr);
 
@@ -76,7 +77,7 @@ public:
 
 // Memory allocation macros for PSRAM
 #define PSRAM_MALLOC(size) PSRAMManager::allocate(size, true)
-#define PSRAM_CALLOC(num, size) PSRAMManager::allocate((num) * (size), true)
+#define PSRAM_CALLOC(num, size) PSRAMManager::allocateZeroed(num, size, true)
 #define PSRAM_FREE(ptr) PSRAMManager::deallocate(ptr)
 
 // Camera buffer allocation
@@ -0,0 +1,365 @@
+#include "quality_controller.h"
+
+// EWMA weights for frame size and SD write rate
+#define QC_SIZE_ALPHA 0.3f
+#define QC_WRITE_ALPHA 0.2f
+
+// Frames averaged before the first decision after an adjustment
+#define QC_MIN_SAMPLES 3
+
+// Frames still in the driver at the old quality when it changes
+#define QC_SETTLE_FRAMES 2
+
+// Largest quality change per adjustment (towards smaller / larger frames)
+#define QC_MAX_STEP_UP 4
+#define QC_MAX_STEP_DOWN 2
+
+QualityController::QualityController() :
+    quality(10), minQuality(10), maxQuality(30),
+    targetBytes(200 * 1024), hysteresis(0.1f), writeBudgetMs(0),
+    sizeAverage(0.0f), samples(0), writeRate(0.0f), settleFrames(0) {
+    stats.reset();
+}
+
+void QualityController::configure(uint8_t initialQuality, uint8_t minQ, uint8_t maxQ,
+                                  uint32_t targetBytesPerFrame, float hysteresisFraction,
+                                  uint32_t writeBudget) {
+    minQuality = minQ;
+    maxQuality = maxQ < minQ ? minQ : maxQ;
+    quality = constrain(initialQuality, minQuality, maxQuality);
+    targetBytes = targetBytesPerFrame;
+    hysteresis = constrain(hysteresisFraction, 0.0f, 0.5f);
+    writeBudgetMs = writeBudget;
+}
+
+void QualityController::reset() {
+    samples = 0;
+    settleFrames = 0;
+    writeRate = 0.0f;
+}
+
+void QualityController::recordWrite(size_t bytes, uint32_t writeUs) {
+    if (bytes == 0 || writeUs == 0) {
+        return;
+    }
+
+    float rate = bytes * 1000.0f / writeUs;
+    float current = writeRate;
+    writeRate = current > 0.0f ? current + QC_WRITE_ALPHA * (rate - current) : rate;
+}
+
+uint32_t QualityController::getEffectiveTarget() const {
+    float rate = writeRate;
+    if (writeBudgetMs == 0 || rate <= 0.0f) {
+        return targetBytes;
+    }
+
+    // Largest frame the card can take within the write budget
+    float limit = rate * writeBudgetMs;
+    return limit < targetBytes ? (uint32_t)limit : targetBytes;
+}
+
+bool QualityController::update(size_t frameBytes) {
+    stats.frames++;
+
+    uint32_t target = getEffectiveTarget();
+    float upper = target * (1.0f + hysteresis);
+    float lower = target * (1.0f - hysteresis);
+    if (target < targetBytes) {
+        stats.budgetLimited++;
+    }
+    if (frameBytes > upper) {
+        stats.overTarget++;
+    }
+
+    // Frames encoded before the last change say nothing about the new quality
+    if (settleFrames > 0) {
+        settleFrames--;
+        return false;
+    }
+
+    if (samples == 0) {
+        sizeAverage = frameBytes;
+    } else {
+        sizeAverage += QC_SIZE_ALPHA * ((float)frameBytes - sizeAverage);
+    }
+    if (samples < 255) {
+        samples++;
+    }
+
+    if (samples < QC_MIN_SAMPLES || (sizeAverage <= upper && sizeAverage >= lower)) {
+        return false;
+    }
+
+    // Size scales roughly with 1/quality: step towards the quality that hits the target
+    int step = (int)lroundf(quality * sizeAverage / target) - quality;
+    if (step == 0) {
+        step = sizeAverage > upper ? 1 : -1;
+    }
+    step = constrain(step, -QC_MAX_STEP_DOWN, QC_MAX_STEP_UP);
+
+    int next = constrain(quality + step, (int)minQuality, (int)maxQuality);
+    if (next == quality) {
+        return false; // Pinned at a bound
+    }
+
+    if (next > quality) {
+        stats.qualityRaised++;
+    } else {
+        stats.qualityLowered++;
+    }
+    stats.adjustments++;
+
+    quality = next;
+    samples = 0;
+    settleFrames = QC_SETTLE_FRAMES;
+    return true;
+}
+
+// Replay helpers for runSimulation()
+struct SceneSegment {
+    const char* label;
+    uint16_t frames;
+    uint32_t bytesAtQ10;        // Scene detail: frame size at quality 10
+    uint32_t sdBytesPerMs;      // Card throughput while writing
+};
+
+static uint32_t simNoiseState = 12345;
+
+static float simNoise() {
+    // Deterministic +/-8% scene variation
+    simNoiseState = simNoiseState * 1103515245 + 12345;
+    return 1.0f + ((int)((simNoiseState >> 16) % 1601) - 800) / 10000.0f;
+}
+
+bool QualityController::runSimulation() {
+    Serial.println("\n=== JPEG Quality Controller Simulation ===");
+
+    const uint8_t minQ = 6;
+    const uint8_t maxQ = 30;
+    const uint32_t target = 200 * 1024;
+    const float band = 0.10f;
+    const uint32_t budgetMs = 120;            // 60% of a 200 ms interval
+    const uint32_t writeOverheadUs = 6000;    // Open/close and FAT update per file
+
+    QualityController controller;
+    controller.configure(10, minQ, maxQ, target, band, budgetMs);
+
+    const SceneSegment segments[] = {
+        { "Low detail",  60, 150 * 1024, 2000 },
+        { "High detail", 80, 480 * 1024, 2000 },
+        { "Slow card",   80, 300 * 1024, 1200 },
+        { "Clutter",     60, 900 * 1024, 2000 },
+    };
+    const int segmentCount = sizeof(segments) / sizeof(segments[0]);
+
+    int passed = 0;
+    int total = 0;
+    bool inBounds = true;
+    uint8_t driverQuality[QC_SETTLE_FRAMES];  // Quality of frames already queued in the driver
+    for (int i = 0; i < QC_SETTLE_FRAMES; i++) {
+        driverQuality[i] = controller.getQuality();
+    }
+    simNoiseState = 12345;
+    uint32_t frame = 0;
+
+    for (int s = 0; s < segmentCount; s++) {
+        const SceneSegment& seg = segments[s];
+        const uint16_t tail = seg.frames / 2;   // Steady-state window
+        float tailBytes = 0.0f;
+        float tailWriteMs = 0.0f;
+        uint32_t tailAdjustments = 0;
+        uint32_t effectiveTarget = 0;
+
+        Serial.printf("-- %s: %u KB at q10, SD %u KB/s --\n", seg.label,
+                      seg.bytesAtQ10 / 1024, seg.sdBytesPerMs * 1000 / 1024);
+
+        for (uint16_t i = 0; i < seg.frames; i++, frame++) {
+            // The frame coming out now was encoded at the oldest queued quality
+            uint8_t q = driverQuality[0];
+            for (int k = 0; k < QC_SETTLE_FRAMES - 1; k++) {
+                driverQuality[k] = driverQuality[k + 1];
+            }
+
+            size_t bytes = (size_t)(seg.bytesAtQ10 * 10.0f / q * simNoise());
+            uint32_t writeUs = writeOverheadUs + (uint32_t)((uint64_t)bytes * 1000 / seg.sdBytesPerMs);
+            controller.recordWrite(bytes, writeUs);
+            bool changed = controller.update(bytes);
+            driverQuality[QC_SETTLE_FRAMES - 1] = controller.getQuality();
+
+            if (controller.getQuality() < minQ || controller.getQuality() > maxQ) {
+                inBounds = false;
+            }
+            if (i >= seg.frames - tail) {
+                tailBytes += bytes;
+                tailWriteMs += writeUs / 1000.0f;
+                if (changed) {
+                    tailAdjustments++;
+                }
+            }
+            if (i % 10 == 0) {
+                Serial.printf("  frame %3u: q=%2u size=%4u KB avg=%4.0f KB target=%4u KB\n",
+                              frame, q, (unsigned)(bytes / 1024),
+                              controller.getAverageSize() / 1024.0f,
+                              controller.getEffectiveTarget() / 1024);
+            }
+            effectiveTarget = controller.getEffectiveTarget();
+        }
+
+        float meanBytes = tailBytes / tail;
+        float meanWriteMs = tailWriteMs / tail;
+        float error = (meanBytes - effectiveTarget) / effectiveTarget;
+        uint8_t q = controller.getQuality();
+        bool pinned = (q == maxQ && error > 0.0f) || (q == minQ && error < 0.0f);
+        bool converged = fabsf(error) <= band + 0.05f || pinned;
+        bool stable = tailAdjustments <= 2;
+        bool writeOk = meanWriteMs <= budgetMs * 1.15f || pinned;
+
+        total++;
+        if (converged && stable && writeOk) {
+            passed++;
+            Serial.printf("PASS: %s - q=%u, mean %.0f KB vs target %u KB (%+.0f%%%s), "
+                          "write %.0f ms, %u late adjustments\n",
+                          seg.label, q, meanBytes / 1024.0f, effectiveTarget / 1024,
+                          error * 100.0f, pinned ? ", at bound" : "", meanWriteMs, tailAdjustments);
+        } else {
+            Serial.printf("FAIL: %s - q=%u, mean %.0f KB vs target %u KB (%+.0f%%), "
+                          "write %.0f ms, %u late adjustments\n",
+                          seg.label, q, meanBytes / 1024.0f, effectiveTarget / 1024,
+                          error * 100.0f, meanWriteMs, tailAdjustments);
+        }
+    }
+
+    total++;
+    if (inBounds) {
+        passed++;
+        Serial.printf("PASS: Quality stayed within %u-%u\n", minQ, maxQ);
+    } else {
+        Serial.printf("FAIL: Quality left %u-%u\n", minQ, maxQ);
+    }
+
+    QualityControllerStats st = controller.getStatistics();
+    Serial.printf("Adjustments: %u (%u up, %u down), budget-limited frames: %u\n",
+                  st.adjustments, st.qualityRaised, st.qualityLowered, st.budgetLimited);
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
+
+bool QualityController::runReplay(const QualityController& configured,
+                                  const QualityReplayFrame* frames, size_t count) {
+    Serial.println("\n=== JPEG Quality Controller Replay ===");
+
+    QualityController controller = configured;
+    controller.reset();
+    controller.resetStatistics();
+    controller.writeBudgetMs = 0;             // Write times are not in the recording
+
+    const uint32_t target = controller.targetBytes;
+    const float upper = target * (1.0f + controller.hysteresis);
+    const size_t warmup = count / 4;          // Settling from the initial quality
+
+    uint8_t driverQuality[QC_SETTLE_FRAMES];  // Quality of frames already queued in the driver
+    for (int i = 0; i < QC_SETTLE_FRAMES; i++) {
+        driverQuality[i] = controller.getQuality();
+    }
+
+    bool inBounds = true;
+    uint32_t replayed = 0;
+    uint32_t skipped = 0;
+    uint32_t steadyFrames = 0;
+    uint32_t steadyAdjustments = 0;
+    uint32_t recordedOver = 0;
+    uint32_t replayedOver = 0;
+    float recordedBytes = 0.0f;
+    float replayedBytes = 0.0f;
+
+    for (size_t i = 0; i < count; i++) {
+        // The size model is undefined at quality 0
+        if (frames[i].quality == 0 || frames[i].bytes == 0) {
+            skipped++;
+            continue;
+        }
+
+        uint8_t q = driverQuality[0];
+        for (int k = 0; k < QC_SETTLE_FRAMES - 1; k++) {
+            driverQuality[k] = driverQuality[k + 1];
+        }
+
+        // Same scene at the controller's quality
+        float detail = (float)frames[i].bytes * frames[i].quality;
+        size_t bytes = (size_t)(detail / (q > 0 ? q : 1));
+        bool changed = controller.update(bytes);
+        driverQuality[QC_SETTLE_FRAMES - 1] = controller.getQuality();
+
+        if (controller.getQuality() < controller.minQuality ||
+            controller.getQuality() > controller.maxQuality) {
+            inBounds = false;
+        }
+        if (i >= warmup) {
+            steadyFrames++;
+            recordedBytes += frames[i].bytes;
+            replayedBytes += bytes;
+            recordedOver += frames[i].bytes > upper ? 1 : 0;
+            replayedOver += bytes > upper ? 1 : 0;
+            if (changed) {
+                steadyAdjustments++;
+            }
+        }
+        replayed++;
+    }
+
+    Serial.printf("%u frames replayed, %u skipped (no size or quality 0), target %u KB\n",
+                  replayed, skipped, target / 1024);
+
+    int passed = 0;
+    int total = 1;
+    if (steadyFrames < 20) {
+        Serial.printf("FAIL: Only %u frames after warm-up, need 20\n", steadyFrames);
+        Serial.printf("Results: %d/%d tests passed\n", passed, total);
+        Serial.println("Overall Result: FAIL");
+        return false;
+    }
+
+    float recordedMean = recordedBytes / steadyFrames;
+    float replayedMean = replayedBytes / steadyFrames;
+    float error = (replayedMean - target) / target;
+    uint8_t q = controller.getQuality();
+    bool pinned = (q == controller.maxQuality && error > 0.0f) ||
+                  (q == controller.minQuality && error < 0.0f);
+
+    Serial.printf("Recorded: mean %.0f KB, %u%% of frames over target\n",
+                  recordedMean / 1024.0f, recordedOver * 100 / steadyFrames);
+    Serial.printf("Replayed: mean %.0f KB, %u%% of frames over target, final q=%u\n",
+                  replayedMean / 1024.0f, replayedOver * 100 / steadyFrames, q);
+
+    if (fabsf(error) <= controller.hysteresis + 0.05f || pinned) {
+        passed++;
+        Serial.printf("PASS: Converged - mean %+.0f%% from target%s\n", error * 100.0f,
+                      pinned ? " (at quality bound)" : "");
+    } else {
+        Serial.printf("FAIL: Mean %+.0f%% from target\n", error * 100.0f);
+    }
+
+    // At most one change per 20 frames once settled
+    total++;
+    if (steadyAdjustments <= steadyFrames / 20 + 2) {
+        passed++;
+        Serial.printf("PASS: Stable - %u adjustments in %u frames\n", steadyAdjustments, steadyFrames);
+    } else {
+        Serial.printf("FAIL: Hunting - %u adjustments in %u frames\n", steadyAdjustments, steadyFrames);
+    }
+
+    total++;
+    if (inBounds) {
+        passed++;
+        Serial.printf("PASS: Quality stayed within %u-%u\n", controller.minQuality, controller.maxQuality);
+    } else {
+        Serial.printf("FAIL: Quality left %u-%u\n", controller.minQuality, controller.maxQuality);
+    }
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
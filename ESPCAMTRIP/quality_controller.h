@@ -0,0 +1,122 @@
+#ifndef QUALITY_CONTROLLER_H
+#define QUALITY_CONTROLLER_H
+
+#include <Arduino.h>
+
+/**
+ * JPEG Quality Rate Controller
+ *
+ * Holds mission frames near a byte budget by steering the sensor JPEG
+ * quality (0-63, lower number = better quality, larger frames).
+ *
+ * - Frame size is smoothed with an EWMA; quality only moves when the
+ *   average leaves a hysteresis band around the target
+ * - JPEG size is roughly inversely proportional to the quality number, so
+ *   the step is proportional to the size error (capped per adjustment)
+ * - Measured SD write throughput caps the target so a frame can be written
+ *   within a share of the capture interval
+ * - Frames already queued in the driver at the old quality are ignored
+ *   after each adjustment
+ *
+ * Like DistanceTrigger, the class has no global state, so synthetic
+ * (runSimulation()) or recorded (runReplay()) frame-size sequences can be
+ * replayed through it.
+ * recordWrite() may be called from the SD writer task; update() runs on the
+ * camera task.
+ */
+
+struct QualityControllerStats {
+    uint32_t frames;             // Frame sizes seen
+    uint32_t adjustments;        // Quality changes issued
+    uint32_t qualityRaised;      // Quality number increased (smaller frames)
+    uint32_t qualityLowered;     // Quality number decreased (larger frames)
+    uint32_t budgetLimited;      // Updates where the write budget was below the byte target
+    uint32_t overTarget;         // Frames above the band's upper edge
+
+    void reset() {
+        frames = 0;
+        adjustments = 0;
+        qualityRaised = 0;
+        qualityLowered = 0;
+        budgetLimited = 0;
+        overTarget = 0;
+    }
+};
+
+// One recorded frame for runReplay(): JPEG size at the quality it was encoded with
+struct QualityReplayFrame {
+    uint32_t bytes;
+    uint8_t quality;
+};
+
+class QualityController {
+private:
+    // Bounds and target
+    uint8_t quality;
+    uint8_t minQuality;          // Best quality allowed (lowest number)
+    uint8_t maxQuality;          // Worst quality allowed (highest number)
+    uint32_t targetBytes;        // Per frame
+    float hysteresis;            // Band half-width as a fraction of the target
+    uint32_t writeBudgetMs;      // 0 = no write-time cap
+
+    // Measurements
+    float sizeAverage;           // Bytes, EWMA
+    uint8_t samples;             // Frames in the average since the last adjustment
+    volatile float writeRate;    // Bytes per ms, EWMA (0 = no sample yet)
+    uint8_t settleFrames;        // Frames to ignore after an adjustment
+
+    QualityControllerStats stats;
+
+public:
+    QualityController();
+
+    /**
+     * Set bounds and target; the current quality is clamped to the bounds
+     */
+    void configure(uint8_t initialQuality, uint8_t minQ, uint8_t maxQ,
+                   uint32_t targetBytesPerFrame, float hysteresisFraction,
+                   uint32_t writeBudget);
+
+    /**
+     * Forget averages (quality is kept)
+     */
+    void reset();
+
+    /**
+     * Record a completed SD write of the given size
+     */
+    void recordWrite(size_t bytes, uint32_t writeUs);
+
+    /**
+     * Feed the size of a captured frame
+     *
+     * @return true when the quality changed (apply getQuality() to the sensor)
+     */
+    bool update(size_t frameBytes);
+
+    uint8_t getQuality() const { return quality; }
+    uint32_t getTargetBytes() const { return targetBytes; }
+    uint32_t getEffectiveTarget() const;
+    float getAverageSize() const { return samples > 0 ? sizeAverage : 0.0f; }
+    float getWriteRate() const { return writeRate; }
+    QualityControllerStats getStatistics() const { return stats; }
+    void resetStatistics() { stats.reset(); }
+
+    /**
+     * Replay synthetic scene sequences (size vs quality model, driver lag,
+     * SD slowdown) and check convergence, bounds and stability
+     */
+    static bool runSimulation();
+
+    /**
+     * Replay a recorded frame-size sequence (e.g. fileSize and jpegQuality
+     * from mission.bin) through a copy of a configured controller and check
+     * the replayed sizes settle on the target without hunting. Each frame's
+     * scene detail is taken as size x quality, the same model update()
+     * steps with; write times are not recorded, so the write budget is unused.
+     */
+    static bool runReplay(const QualityController& configured,
+                          const QualityReplayFrame* frames, size_t count);
+};
+
+#endif // QUALITY_CONTROLLER_H
@@ -0,0 +1,145 @@
+#include "scaled_luma.h"
+
+// Zigzag position -> index into the 5x5 grid of row/column frequencies
+// {0,1,3,5,7} (row * 5 + column); 255 = averages out over a quadrant
+static const uint8_t QUADRANT_INDEX[64] = {
+      0,   1,   5, 255,   6, 255,   2, 255, 255,  10, 255,  11, 255,   7, 255,   3,
+    255, 255, 255, 255,  15, 255,  16, 255,  12, 255,   8, 255,   4, 255, 255, 255,
+    255, 255, 255,  20,  21, 255,  17, 255,  13, 255,   9, 255, 255, 255, 255, 255,
+    255,  22, 255,  18, 255,  14, 255, 255, 255, 255,  23, 255,  19, 255, 255,  24
+};
+
+// Mean of the DCT basis over the first four samples: C(0) for frequency 0,
+// sum(cos((2x+1)f*pi/16), x=0..3)/4 for f = 1,3,5,7 (negated for the second half)
+static const float QUADRANT_WEIGHT[5] = {
+    0.70710678f, 0.64072886f, -0.22499406f, 0.15033622f, -0.12744889f
+};
+
+static inline uint8_t clampLevel(float v) {
+    // Level shift and round
+    v += 128.5f;
+    return v <= 0.0f ? 0 : (v >= 255.0f ? 255 : (uint8_t)v);
+}
+
+// Block mean from its quantized DC: DC * q / 8, level shifted (libjpeg DESCALE)
+static inline uint8_t dcLevel(int16_t dc, uint16_t q) {
+    int v = (((int32_t)dc * q + 4) >> 3) + 128;
+    return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+// Quadrant means of one block: out[0..3] = top-left, top-right, bottom-left, bottom-right
+static void quadrantMeans(const int16_t* block, const uint16_t* quant, uint8_t out[4]) {
+    float f[25] = {};
+    for (uint8_t z = 0; z < 64; z++) {
+        if (block[z] != 0 && QUADRANT_INDEX[z] != 255) {
+            f[QUADRANT_INDEX[z]] = (float)block[z] * quant[z];
+        }
+    }
+
+    // Rows: split each row's horizontal sum into even (left = right) and odd
+    // (left = -right) parts, then the same vertically
+    float topLeft = 0.0f, bottomLeft = 0.0f, topRight = 0.0f, bottomRight = 0.0f;
+    for (uint8_t row = 0; row < 5; row++) {
+        const float* r = f + row * 5;
+        float even = QUADRANT_WEIGHT[0] * r[0];
+        float odd = QUADRANT_WEIGHT[1] * r[1] + QUADRANT_WEIGHT[2] * r[2] +
+                    QUADRANT_WEIGHT[3] * r[3] + QUADRANT_WEIGHT[4] * r[4];
+        float left = even + odd;
+        float right = even - odd;
+        if (row == 0) {
+            left *= QUADRANT_WEIGHT[0];
+            right *= QUADRANT_WEIGHT[0];
+            topLeft += left;
+            bottomLeft += left;
+            topRight += right;
+            bottomRight += right;
+        } else {
+            left *= QUADRANT_WEIGHT[row];
+            right *= QUADRANT_WEIGHT[row];
+            topLeft += left;
+            bottomLeft -= left;
+            topRight += right;
+            bottomRight -= right;
+        }
+    }
+
+    out[0] = clampLevel(topLeft * 0.25f);
+    out[1] = clampLevel(topRight * 0.25f);
+    out[2] = clampLevel(bottomLeft * 0.25f);
+    out[3] = clampLevel(bottomRight * 0.25f);
+}
+
+bool ScaledLuma::decode(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                        uint8_t scale, uint8_t* out, size_t outSize,
+                        uint16_t& width, uint16_t& height) {
+    width = 0;
+    height = 0;
+    if ((scale != 4 && scale != 8) || !decoder.begin(jpeg, length)) {
+        return false;
+    }
+
+    const JpegInfo& ji = decoder.getInfo();
+    bool interleaved = decoder.getBlockCount() > 1;
+    if (!interleaved && decoder.getBlockComponent(0) != 0) {
+        return false; // First scan is not luma
+    }
+
+    // Luma must be at full resolution (4:4:4, 4:2:2, 4:2:0 or grayscale)
+    uint8_t h = interleaved ? decoder.getComponent(0).h : 1;
+    uint8_t v = interleaved ? decoder.getComponent(0).v : 1;
+    if (interleaved && (h != ji.hMax || v != ji.vMax)) {
+        return false;
+    }
+
+    width = (ji.width + scale - 1) / scale;
+    height = (ji.height + scale - 1) / scale;
+    if (!out || outSize < (size_t)width * height) {
+        return false;
+    }
+
+    const uint16_t* quant = decoder.getQuantTable(0);
+    const uint8_t blockPixels = 8 / scale;
+    const bool withAC = scale == 4;
+    uint8_t quadrant[4];
+
+    for (uint16_t my = 0; my < ji.mcusY; my++) {
+        for (uint16_t mx = 0; mx < ji.mcusX; mx++) {
+            if (!decoder.decodeMCU(withAC)) {
+                return false;
+            }
+
+            // Luma blocks are stored row-major within the MCU
+            uint8_t k = 0;
+            for (uint8_t b = 0; b < decoder.getBlockCount(); b++) {
+                if (decoder.getBlockComponent(b) != 0) {
+                    continue;
+                }
+                uint32_t ox = ((uint32_t)mx * h + k % h) * blockPixels;
+                uint32_t oy = ((uint32_t)my * v + k / h) * blockPixels;
+                k++;
+                if (ox >= width || oy >= height) {
+                    continue; // Padding blocks outside the image
+                }
+
+                uint8_t* px = out + oy * width + ox;
+                if (!withAC) {
+                    *px = dcLevel(decoder.getDC(b), quant[0]);
+                    continue;
+                }
+
+                quadrantMeans(decoder.getBlock(b), quant, quadrant);
+                px[0] = quadrant[0];
+                if (ox + 1 < width) {
+                    px[1] = quadrant[1];
+                }
+                if (oy + 1 < height) {
+                    px[width] = quadrant[2];
+                    if (ox + 1 < width) {
+                        px[width + 1] = quadrant[3];
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
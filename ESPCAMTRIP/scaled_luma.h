@@ -0,0 +1,41 @@
+#ifndef SCALED_LUMA_H
+#define SCALED_LUMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "jpeg_coeff_decoder.h"
+
+/**
+ * Scaled Luma Decode
+ *
+ * Grayscale image at 1/4 or 1/8 scale (400x300 or 200x150 for UXGA)
+ * straight from the JPEG coefficients, for analysis that does not need
+ * full resolution (AprilTag search on mission frames). Chroma blocks are
+ * entropy-skipped and no full IDCT is run.
+ *
+ * - 1/8: the luma DC of each block (block mean), as DCThumbnail
+ * - 1/4: the mean of each 4x4 quadrant of a block. Even AC frequencies
+ *   average out over a quadrant, so only the 25 coefficients with row
+ *   and column frequency in {0,1,3,5,7} are needed; the result is the
+ *   exact box-filtered image, not an approximation
+ *
+ * Portable C++ (no Arduino or ESP-IDF dependencies); the caller provides
+ * the decoder and output buffer.
+ */
+
+class ScaledLuma {
+public:
+    /**
+     * Decode the luma of a JPEG at 1/scale
+     *
+     * @param scale 4 or 8
+     * @param width, height Output size, set once the headers are parsed
+     *                      (also when the buffer is too small)
+     * @return false for unsupported or corrupt JPEGs or a short buffer
+     */
+    static bool decode(JpegCoeffDecoder& decoder, const uint8_t* jpeg, size_t length,
+                       uint8_t scale, uint8_t* out, size_t outSize,
+                       uint16_t& width, uint16_t& height);
+};
+
+#endif // SCALED_LUMA_H
@@ -0,0 +1,221 @@
+#include "sensor_profile_manager.h"
+
+#define COUNT_FIELD(field, setter, type, statusField) + 1
+static const int SENSOR_SETTINGS_COUNT = 0 SENSOR_SETTINGS_FIELDS(COUNT_FIELD);
+#undef COUNT_FIELD
+
+// Profiles (field order matches SensorSettings)
+static const SensorSettings PROFILES[SENSOR_PROFILE_COUNT] = {
+    // MISSION: previous applyCameraSettings() defaults
+    { 0, 0, 0, 0, 1, 1, 0, 1, 0, 0, 300, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0 },
+    // LANDING: previous reconfigureCamera() landing settings (same values as mission)
+    { 0, 0, 0, 0, 1, 1, 0, 1, 0, 0, 300, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0 },
+    // LOW_LIGHT: AEC DSP, brighter exposure target, 32x gain ceiling, black pixel correction
+    { 0, 0, 0, 0, 1, 1, 0, 1, 1, 1, 300, 1, 0, 4, 1, 1, 1, 1, 0, 0, 1, 0 },
+};
+
+// Static member definitions
+SensorSettings SensorProfileManager::shadow = {};
+bool SensorProfileManager::shadowValid = false;
+SensorProfileId SensorProfileManager::activeProfile = SENSOR_PROFILE_MISSION;
+SensorProfileStats SensorProfileManager::stats = {};
+
+void SensorProfileManager::syncFromSensor(sensor_t* s) {
+    if (!s) {
+        shadowValid = false;
+        return;
+    }
+
+#define SYNC_FIELD(field, setter, type, statusField) shadow.field = s->status.statusField;
+    SENSOR_SETTINGS_FIELDS(SYNC_FIELD)
+#undef SYNC_FIELD
+
+    shadowValid = true;
+}
+
+int SensorProfileManager::apply(sensor_t* s, SensorProfileId id) {
+    if (id >= SENSOR_PROFILE_COUNT) {
+        return -1;
+    }
+
+    int writes = apply(s, PROFILES[id]);
+    if (writes >= 0) {
+        activeProfile = id;
+    }
+    return writes;
+}
+
+int SensorProfileManager::apply(sensor_t* s, const SensorSettings& target) {
+    if (!s) {
+        return -1;
+    }
+
+    int writes = 0;
+    int skipped = 0;
+    bool failed = false;
+
+    // Write a setting only if the shadow is unknown or differs
+#define APPLY_FIELD(field, setter, type, statusField) \
+    if (!shadowValid || target.field != shadow.field) { \
+        writes++; \
+        if (s->setter(s, (type)target.field) == 0) { \
+            shadow.field = target.field; \
+        } else { \
+            stats.writeFailures++; \
+            failed = true; \
+        } \
+    } else { \
+        skipped++; \
+    }
+    SENSOR_SETTINGS_FIELDS(APPLY_FIELD)
+#undef APPLY_FIELD
+
+    // A failed write leaves that field unknown - rewrite everything next time
+    shadowValid = !failed;
+
+    stats.applyCount++;
+    stats.registerWrites += writes;
+    stats.writesSkipped += skipped;
+    return writes;
+}
+
+const SensorSettings& SensorProfileManager::getProfile(SensorProfileId id) {
+    if (id >= SENSOR_PROFILE_COUNT) {
+        return PROFILES[SENSOR_PROFILE_MISSION];
+    }
+    return PROFILES[id];
+}
+
+const char* SensorProfileManager::getProfileName(SensorProfileId id) {
+    switch (id) {
+        case SENSOR_PROFILE_MISSION:
+            return "MISSION";
+        case SENSOR_PROFILE_LANDING:
+            return "LANDING";
+        case SENSOR_PROFILE_LOW_LIGHT:
+            return "LOW_LIGHT";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void SensorProfileManager::recordApplyTime(uint32_t us) {
+    stats.lastApplyTime = us;
+    if (us > stats.maxApplyTime) {
+        stats.maxApplyTime = us;
+    }
+}
+
+void SensorProfileManager::printStatistics() {
+    Serial.println("\n--- Sensor Profile ---");
+    Serial.printf("Active profile: %s (shadow %s)\n",
+                  getProfileName(activeProfile), shadowValid ? "valid" : "invalid");
+    Serial.printf("Applies: %u, writes: %u, skipped: %u, failures: %u\n",
+                  stats.applyCount, stats.registerWrites,
+                  stats.writesSkipped, stats.writeFailures);
+    Serial.printf("Apply time last/max: %u/%u us\n", stats.lastApplyTime, stats.maxApplyTime);
+    Serial.println("----------------------\n");
+}
+
+// Mock sensor for the self-test: each setter updates status and counts the write
+static uint32_t mockWrites = 0;
+
+#define MOCK_SETTER(field, setter, type, statusField) \
+    static int mock_##setter(sensor_t* s, type value) { \
+        s->status.statusField = value; \
+        mockWrites++; \
+        return 0; \
+    }
+SENSOR_SETTINGS_FIELDS(MOCK_SETTER)
+#undef MOCK_SETTER
+
+static int countDifferences(const SensorSettings& a, const SensorSettings& b) {
+    int n = 0;
+#define DIFF_FIELD(field, setter, type, statusField) if (a.field != b.field) n++;
+    SENSOR_SETTINGS_FIELDS(DIFF_FIELD)
+#undef DIFF_FIELD
+    return n;
+}
+
+bool SensorProfileManager::runSelfTest() {
+    Serial.println("\n=== Sensor Profile Self-Test ===");
+
+    static sensor_t mock;
+    memset(&mock, 0, sizeof(mock));
+#define MOCK_BIND(field, setter, type, statusField) mock.setter = mock_##setter;
+    SENSOR_SETTINGS_FIELDS(MOCK_BIND)
+#undef MOCK_BIND
+
+    // Preserve state for the real sensor
+    SensorSettings savedShadow = shadow;
+    bool savedValid = shadowValid;
+    SensorProfileId savedProfile = activeProfile;
+    SensorProfileStats savedStats = stats;
+
+    int passed = 0;
+    int total = 0;
+
+    // Unknown shadow: every setting is written once
+    invalidate();
+    mockWrites = 0;
+    apply(&mock, SENSOR_PROFILE_MISSION);
+    total++;
+    if (mockWrites == (uint32_t)SENSOR_SETTINGS_COUNT) {
+        passed++;
+        Serial.printf("PASS: Cold apply wrote all %d settings\n", SENSOR_SETTINGS_COUNT);
+    } else {
+        Serial.printf("FAIL: Cold apply wrote %u of %d settings\n", mockWrites, SENSOR_SETTINGS_COUNT);
+    }
+
+    // Same profile again: nothing to write
+    mockWrites = 0;
+    apply(&mock, SENSOR_PROFILE_MISSION);
+    total++;
+    if (mockWrites == 0) {
+        passed++;
+        Serial.println("PASS: Re-apply wrote nothing");
+    } else {
+        Serial.printf("FAIL: Re-apply wrote %u settings\n", mockWrites);
+    }
+
+    // Profile changes write exactly the differing settings
+    const SensorProfileId sequence[] = { SENSOR_PROFILE_LANDING, SENSOR_PROFILE_LOW_LIGHT,
+                                         SENSOR_PROFILE_MISSION };
+    SensorProfileId previous = SENSOR_PROFILE_MISSION;
+    for (SensorProfileId id : sequence) {
+        int expected = countDifferences(PROFILES[previous], PROFILES[id]);
+        mockWrites = 0;
+        apply(&mock, id);
+        total++;
+        if (mockWrites == (uint32_t)expected) {
+            passed++;
+            Serial.printf("PASS: %s -> %s wrote %d settings\n",
+                          getProfileName(previous), getProfileName(id), expected);
+        } else {
+            Serial.printf("FAIL: %s -> %s wrote %u settings, expected %d\n",
+                          getProfileName(previous), getProfileName(id), mockWrites, expected);
+        }
+        previous = id;
+    }
+
+    // Shadow seeded from status matches what the mock holds
+    syncFromSensor(&mock);
+    mockWrites = 0;
+    apply(&mock, SENSOR_PROFILE_MISSION);
+    total++;
+    if (mockWrites == 0) {
+        passed++;
+        Serial.println("PASS: Shadow seeded from sensor status");
+    } else {
+        Serial.printf("FAIL: Seeded shadow still wrote %u settings\n", mockWrites);
+    }
+
+    shadow = savedShadow;
+    shadowValid = savedValid;
+    activeProfile = savedProfile;
+    stats = savedStats;
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
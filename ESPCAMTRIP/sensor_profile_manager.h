@@ -0,0 +1,144 @@
+#ifndef SENSOR_PROFILE_MANAGER_H
+#define SENSOR_PROFILE_MANAGER_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+
+/**
+ * Sensor Profile Manager (shadow register cache)
+ *
+ * Keeps a shadow copy of the image sensor settings and applies named
+ * profiles by writing only the settings that differ from the shadow.
+ * Every sensor_t setter is an SCCB transaction, so unchanged settings
+ * are skipped entirely.
+ *
+ * The shadow is seeded from sensor->status right after esp_camera_init()
+ * (the driver resets the sensor and fills status with its defaults) and
+ * must be invalidated when the driver is deinitialized.
+ */
+
+enum SensorProfileId {
+    SENSOR_PROFILE_MISSION,      // Colour mapping photos, auto exposure/white balance
+    SENSOR_PROFILE_LANDING,      // Grayscale AprilTag frames, baseline auto exposure/gain
+    SENSOR_PROFILE_LOW_LIGHT,    // Mission photos at dusk: higher gain ceiling, AEC DSP
+    SENSOR_PROFILE_COUNT
+};
+
+struct SensorSettings {
+    int8_t brightness;           // -2 to 2
+    int8_t contrast;             // -2 to 2
+    int8_t saturation;           // -2 to 2
+    uint8_t special_effect;      // 0 - No Effect
+    uint8_t whitebal;            // AWB enable
+    uint8_t awb_gain;            // AWB gain enable
+    uint8_t wb_mode;             // 0 to 4 (0 - Auto)
+    uint8_t exposure_ctrl;       // AEC enable
+    uint8_t aec2;                // AEC DSP enable
+    int8_t ae_level;             // -2 to 2
+    uint16_t aec_value;          // 0 to 1200
+    uint8_t gain_ctrl;           // AGC enable
+    uint8_t agc_gain;            // 0 to 30
+    uint8_t gainceiling;         // 0 to 6 (2x..128x)
+    uint8_t bpc;                 // Black pixel correction
+    uint8_t wpc;                 // White pixel correction
+    uint8_t raw_gma;             // Gamma
+    uint8_t lenc;                // Lens correction
+    uint8_t hmirror;
+    uint8_t vflip;
+    uint8_t dcw;                 // Downsize enable
+    uint8_t colorbar;
+};
+
+// Every cached setting: field, sensor_t setter, setter argument type, status field
+// (also used by sensor_t emulations such as the replay camera)
+#define SENSOR_SETTINGS_FIELDS(X) \
+    X(brightness,     set_brightness,     int,           brightness) \
+    X(contrast,       set_contrast,       int,           contrast) \
+    X(saturation,     set_saturation,     int,           saturation) \
+    X(special_effect, set_special_effect, int,           special_effect) \
+    X(whitebal,       set_whitebal,       int,           awb) \
+    X(awb_gain,       set_awb_gain,       int,           awb_gain) \
+    X(wb_mode,        set_wb_mode,        int,           wb_mode) \
+    X(exposure_ctrl,  set_exposure_ctrl,  int,           aec) \
+    X(aec2,           set_aec2,           int,           aec2) \
+    X(ae_level,       set_ae_level,       int,           ae_level) \
+    X(aec_value,      set_aec_value,      int,           aec_value) \
+    X(gain_ctrl,      set_gain_ctrl,      int,           agc) \
+    X(agc_gain,       set_agc_gain,       int,           agc_gain) \
+    X(gainceiling,    set_gainceiling,    gainceiling_t, gainceiling) \
+    X(bpc,            set_bpc,            int,           bpc) \
+    X(wpc,            set_wpc,            int,           wpc) \
+    X(raw_gma,        set_raw_gma,        int,           raw_gma) \
+    X(lenc,           set_lenc,           int,           lenc) \
+    X(hmirror,        set_hmirror,        int,           hmirror) \
+    X(vflip,          set_vflip,          int,           vflip) \
+    X(dcw,            set_dcw,            int,           dcw) \
+    X(colorbar,       set_colorbar,       int,           colorbar)
+
+struct SensorProfileStats {
+    uint32_t applyCount;
+    uint32_t registerWrites;     // Setter calls issued
+    uint32_t writesSkipped;      // Setter calls avoided by the shadow
+    uint32_t writeFailures;
+    uint32_t lastApplyTime;      // us
+    uint32_t maxApplyTime;       // us
+
+    void reset() {
+        applyCount = 0;
+        registerWrites = 0;
+        writesSkipped = 0;
+        writeFailures = 0;
+        lastApplyTime = 0;
+        maxApplyTime = 0;
+    }
+};
+
+class SensorProfileManager {
+private:
+    static SensorSettings shadow;
+    static bool shadowValid;
+    static SensorProfileId activeProfile;
+    static SensorProfileStats stats;
+
+public:
+    /**
+     * Seed the shadow from the driver's view of the sensor
+     * Call after esp_camera_init() and after any direct setter call
+     */
+    static void syncFromSensor(sensor_t* s);
+
+    /**
+     * Forget the shadow (driver deinitialized or sensor reset)
+     * The next apply writes every setting
+     */
+    static void invalidate() { shadowValid = false; }
+
+    /**
+     * Apply a profile, writing only settings that differ from the shadow
+     *
+     * @return Number of setter calls issued, or -1 if the sensor is missing
+     */
+    static int apply(sensor_t* s, SensorProfileId id);
+    static int apply(sensor_t* s, const SensorSettings& target);
+
+    static const SensorSettings& getProfile(SensorProfileId id);
+    static const char* getProfileName(SensorProfileId id);
+    static SensorProfileId getActiveProfile() { return activeProfile; }
+    static bool isShadowValid() { return shadowValid; }
+
+    /**
+     * Statistics
+     */
+    static SensorProfileStats getStatistics() { return stats; }
+    static void recordApplyTime(uint32_t us);
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+
+    /**
+     * Apply profiles to a mock sensor_t that counts setter calls
+     * Does not touch the camera; verifies the delta logic only
+     */
+    static bool runSelfTest();
+};
+
+#endif // SENSOR_PROFILE_MANAGER_H
@@ -0,0 +1,255 @@
+#include "sharpness_gate.h"
+#include "jpeg_coeff_decoder.h"
+#include "duplicate_filter.h"
+#include "config.h"
+#include "camera_hal.h"
+#include "system_state.h"
+
+// Horizontal/vertical DCT frequency (of 0-7) from which energy counts as detail
+#define SHARP_DETAIL_FREQ 2
+
+// Sum of dequantized |AC| below which a block is treated as flat
+#define SHARP_MIN_BLOCK_ENERGY 96
+
+// Textured blocks needed to judge a frame (absolute and share of sampled)
+#define SHARP_MIN_TEXTURED 16
+#define SHARP_MIN_TEXTURED_DIVISOR 20
+
+// Horizontal (u) and vertical (v) frequency of each zigzag position
+static const uint8_t ZIGZAG_U[64] = {
+    0, 1, 0, 0, 1, 2, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5,
+    4, 3, 2, 1, 0, 0, 1, 2, 3, 4, 5, 6, 7, 6, 5, 4,
+    3, 2, 1, 0, 1, 2, 3, 4, 5, 6, 7, 7, 6, 5, 4, 3,
+    2, 3, 4, 5, 6, 7, 7, 6, 5, 4, 5, 6, 7, 7, 6, 7
+};
+static const uint8_t ZIGZAG_V[64] = {
+    0, 0, 1, 2, 1, 0, 0, 1, 2, 3, 4, 3, 2, 1, 0, 0,
+    1, 2, 3, 4, 5, 6, 5, 4, 3, 2, 1, 0, 0, 1, 2, 3,
+    4, 5, 6, 7, 7, 6, 5, 4, 3, 2, 1, 2, 3, 4, 5, 6,
+    7, 7, 6, 5, 4, 3, 4, 5, 6, 7, 7, 6, 5, 6, 7, 7
+};
+
+// Decoder state is ~14 KB; keep it off the camera task stack
+static JpegCoeffDecoder decoder;
+
+SharpnessStats SharpnessGate::stats = {};
+
+bool SharpnessGate::score(const uint8_t* jpeg, size_t length, SharpnessResult& result,
+                          DCGrid* grid) {
+    memset(&result, 0, sizeof(result));
+    if (grid) {
+        grid->complete = false;
+    }
+    uint32_t start = micros();
+
+    if (!decoder.begin(jpeg, length)) {
+        result.decodeTime = micros() - start;
+        return false;
+    }
+
+    const JpegInfo& info = decoder.getInfo();
+    if (grid) {
+        grid->begin(info.mcusX, info.mcusY);
+    }
+    const uint16_t* quant = decoder.getQuantTable(0);
+    uint8_t stride = Config::sharpness.MCU_STRIDE ? Config::sharpness.MCU_STRIDE : 1;
+    uint32_t budget = Config::sharpness.DECODE_BUDGET_US;
+    uint64_t totalEnergy = 0;
+    uint64_t hEnergy = 0;
+    uint64_t vEnergy = 0;
+
+    result.complete = true;
+    for (uint16_t my = 0; my < info.mcusY; my++) {
+        if (budget > 0 && micros() - start > budget) {
+            result.complete = false;
+            break;
+        }
+
+        bool sampleRow = (my % stride) == 0;
+        for (uint16_t mx = 0; mx < info.mcusX; mx++) {
+            bool sample = sampleRow && (mx % stride) == 0;
+            if (!decoder.decodeMCU(sample)) {
+                result.complete = false;
+                break;
+            }
+            if (grid) {
+                grid->add(mx, my, decoder.getDC(0)); // First luma block of the MCU
+            }
+            if (!sample) {
+                continue;
+            }
+
+            for (uint8_t b = 0; b < decoder.getBlockCount(); b++) {
+                if (decoder.getBlockComponent(b) != 0) {
+                    continue; // Luma only
+                }
+                const int16_t* c = decoder.getBlock(b);
+                uint32_t total = 0;
+                uint32_t hDetail = 0;
+                uint32_t vDetail = 0;
+                for (int k = 1; k < 64; k++) {
+                    if (!c[k]) {
+                        continue;
+                    }
+                    uint32_t e = abs(c[k]) * quant[k];
+                    total += e;
+                    if (ZIGZAG_U[k] >= SHARP_DETAIL_FREQ) hDetail += e;
+                    if (ZIGZAG_V[k] >= SHARP_DETAIL_FREQ) vDetail += e;
+                }
+
+                result.sampledBlocks++;
+                if (total >= SHARP_MIN_BLOCK_ENERGY) {
+                    result.texturedBlocks++;
+                    totalEnergy += total;
+                    hEnergy += hDetail;
+                    vEnergy += vDetail;
+                }
+            }
+        }
+        if (decoder.hasError()) {
+            break;
+        }
+    }
+
+    result.decodeTime = micros() - start;
+    if (grid) {
+        grid->complete = result.complete;
+    }
+    uint32_t needed = result.sampledBlocks / SHARP_MIN_TEXTURED_DIVISOR;
+    if (needed < SHARP_MIN_TEXTURED) {
+        needed = SHARP_MIN_TEXTURED;
+    }
+    result.valid = result.texturedBlocks >= needed;
+    if (result.valid) {
+        // Motion blur is directional: the weaker axis decides
+        uint64_t detail = hEnergy < vEnergy ? hEnergy : vEnergy;
+        result.score = (uint16_t)(detail * 1000 / totalEnergy);
+    }
+    return true;
+}
+
+bool SharpnessGate::check(const uint8_t* jpeg, size_t length, SharpnessResult* result,
+                          DCGrid* grid) {
+    SharpnessResult local;
+    SharpnessResult& r = result ? *result : local;
+
+    if (!Config::sharpness.enabled) {
+        if (grid) {
+            score(jpeg, length, r, grid);
+        }
+        memset(&r, 0, sizeof(r));
+        return true;
+    }
+
+    bool parsed = score(jpeg, length, r, grid);
+    stats.scored++;
+    stats.lastDecodeTime = r.decodeTime;
+    stats.totalDecodeTime += r.decodeTime;
+    if (r.decodeTime > stats.maxDecodeTime) {
+        stats.maxDecodeTime = r.decodeTime;
+    }
+    if (parsed && !r.complete && !decoder.hasError()) {
+        stats.budgetHits++;
+    }
+
+    if (!parsed || !r.valid) {
+        stats.unscorable++;
+        stats.kept++;
+        return true;
+    }
+
+    stats.lastScore = r.score;
+    r.blurred = r.score < Config::sharpness.THRESHOLD;
+    if (r.blurred) {
+        stats.blurred++;
+        if (Config::sharpness.DROP_BLURRED) {
+            stats.dropped++;
+            return false;
+        }
+    }
+
+    stats.kept++;
+    return true;
+}
+
+float SharpnessGate::getKeepRate() {
+    return stats.scored > 0 ? (float)stats.kept / stats.scored : 1.0f;
+}
+
+void SharpnessGate::printStatistics() {
+    Serial.println("\n--- Sharpness Gate ---");
+    Serial.printf("Frames: %u scored, %u kept (%.1f%%), %u blurred, %u dropped, %u unjudged\n",
+                  stats.scored, stats.kept, getKeepRate() * 100.0f,
+                  stats.blurred, stats.dropped, stats.unscorable);
+    Serial.printf("Last score: %u (threshold %u)\n", stats.lastScore, Config::sharpness.THRESHOLD);
+    Serial.printf("Decode time last/avg/max: %u/%u/%u us, budget hits: %u\n",
+                  stats.lastDecodeTime,
+                  stats.scored ? (uint32_t)(stats.totalDecodeTime / stats.scored) : 0,
+                  stats.maxDecodeTime, stats.budgetHits);
+    Serial.println("----------------------\n");
+}
+
+bool SharpnessGate::runBenchmark(uint8_t frames) {
+    Serial.println("\n=== Sharpness Gate Benchmark ===");
+
+    if (SystemState::isCapturing()) {
+        Serial.println("FAIL: Stop capture first (the benchmark takes camera frames)");
+        return false;
+    }
+
+    uint32_t intervalUs = Config::cameraMode.MISSION_CAPTURE_INTERVAL * 1000;
+    uint32_t maxTime = 0;
+    uint64_t totalTime = 0;
+    uint64_t totalBytes = 0;
+    uint8_t scored = 0;
+
+    for (uint8_t i = 0; i < frames; i++) {
+        camera_fb_t* fb = CameraHAL::fbGet();
+        if (!fb) {
+            Serial.println("FAIL: Camera capture failed");
+            return false;
+        }
+        if (fb->format != PIXFORMAT_JPEG) {
+            CameraHAL::fbReturn(fb);
+            Serial.println("FAIL: Camera is not in a JPEG mode");
+            return false;
+        }
+
+        SharpnessResult r;
+        bool parsed = score(fb->buf, fb->len, r);
+        size_t length = fb->len;
+        CameraHAL::fbReturn(fb);
+
+        if (!parsed) {
+            Serial.printf("Frame %u: JPEG not decodable\n", i);
+            continue;
+        }
+        scored++;
+        totalTime += r.decodeTime;
+        totalBytes += length;
+        if (r.decodeTime > maxTime) {
+            maxTime = r.decodeTime;
+        }
+        Serial.printf("Frame %u: %u KB, score %u%s, %u/%u textured blocks, %u us%s\n",
+                      i, (unsigned)(length / 1024), r.score, r.valid ? "" : " (unjudged)",
+                      r.texturedBlocks, r.sampledBlocks, r.decodeTime,
+                      r.complete ? "" : " (partial)");
+    }
+
+    if (scored == 0) {
+        Serial.println("Overall Result: FAIL");
+        return false;
+    }
+
+    uint32_t avgTime = (uint32_t)(totalTime / scored);
+    Serial.printf("Average %u us, max %u us, %.1f MB/s entropy decode\n", avgTime, maxTime,
+                  totalTime ? (totalBytes / 1048576.0) / (totalTime / 1000000.0) : 0.0);
+
+    // Leave most of the interval for capture, EXIF and queueing
+    bool fits = maxTime <= intervalUs / 4;
+    Serial.printf("%s: Max decode is %.1f%% of the %u ms capture interval\n",
+                  fits ? "PASS" : "FAIL", maxTime * 100.0f / intervalUs,
+                  Config::cameraMode.MISSION_CAPTURE_INTERVAL);
+    Serial.printf("Overall Result: %s\n", fits ? "PASS" : "FAIL");
+    return fits;
+}
@@ -0,0 +1,105 @@
+#ifndef SHARPNESS_GATE_H
+#define SHARPNESS_GATE_H
+
+#include <Arduino.h>
+
+/**
+ * Sharpness Gate
+ *
+ * Scores mission frames for blur straight from the JPEG entropy data
+ * (JpegCoeffDecoder), before the frame is written to SD.
+ *
+ * AC energy is the sum of dequantized luma coefficient magnitudes over
+ * sampled blocks that carry texture at all. Per axis, the detail energy
+ * is the part at horizontal frequency u >= 2, and separately at vertical
+ * frequency v >= 2; the score is the weaker axis's share of the total, as
+ * motion blur removes detail along one direction only. Focus blur lowers
+ * both axes, so blurred frames score low regardless of exposure; flat
+ * blocks (sky, water) are ignored and frames with too few textured blocks
+ * are kept unjudged.
+ *
+ * Every MCU is Huffman-decoded (the stream is sequential) but only every
+ * MCU_STRIDE-th MCU in every MCU_STRIDE-th row has its AC values
+ * extracted. Decoding stops at DECODE_BUDGET_US and scores the part seen.
+ */
+
+struct DCGrid;
+
+struct SharpnessResult {
+    uint16_t score;              // Per mille, 0 when not valid
+    uint32_t sampledBlocks;
+    uint32_t texturedBlocks;
+    uint32_t decodeTime;         // us
+    bool valid;                  // Enough texture to judge
+    bool complete;               // Whole frame decoded within the budget
+    bool blurred;                // Valid and below the threshold
+};
+
+struct SharpnessStats {
+    uint32_t scored;             // Frames checked
+    uint32_t kept;               // Frames allowed through (incl. marked and unjudged)
+    uint32_t blurred;            // Frames below the threshold
+    uint32_t dropped;            // Blurred frames not written
+    uint32_t unscorable;         // Too little texture or undecodable
+    uint32_t budgetHits;         // Decodes cut short by the time budget
+    uint16_t lastScore;
+    uint32_t lastDecodeTime;     // us
+    uint32_t maxDecodeTime;      // us
+    uint64_t totalDecodeTime;    // us
+
+    void reset() {
+        scored = 0;
+        kept = 0;
+        blurred = 0;
+        dropped = 0;
+        unscorable = 0;
+        budgetHits = 0;
+        lastScore = 0;
+        lastDecodeTime = 0;
+        maxDecodeTime = 0;
+        totalDecodeTime = 0;
+    }
+};
+
+class SharpnessGate {
+private:
+    static SharpnessStats stats;
+
+public:
+    /**
+     * Score a JPEG frame (no statistics or threshold applied)
+     *
+     * @param grid Optional luma DC grid filled from every decoded MCU
+     *             (for DuplicateFilter)
+     * @return false if the JPEG could not be parsed
+     */
+    static bool score(const uint8_t* jpeg, size_t length, SharpnessResult& result,
+                      DCGrid* grid = nullptr);
+
+    /**
+     * Score a frame and apply the configured threshold
+     *
+     * With the gate disabled the frame is still decoded when a grid is
+     * requested, but never judged.
+     *
+     * @return true if the frame should be written (sharp, marked or unjudged)
+     */
+    static bool check(const uint8_t* jpeg, size_t length, SharpnessResult* result = nullptr,
+                      DCGrid* grid = nullptr);
+
+    /**
+     * Statistics
+     */
+    static SharpnessStats getStatistics() { return stats; }
+    static float getKeepRate();
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+
+    /**
+     * Score live camera frames and compare decode time with the mission
+     * capture interval (camera in a JPEG mode, not while capturing)
+     */
+    static bool runBenchmark(uint8_t frames = 10);
+};
+
+#endif // SHARPNESS_GATE_H
@@ -1,5 +1,8 @@
 #include "storage_manager.h"
 #include "config.h"
+#include "alloc_counter.h"
+#include "psram_manager.h"
+#include "system_state.h"
 #include <algorithm>
 
 // Static member definitions
@@ -122,11 +125,17 @@ bool StorageManager::verifyCard() {
 }
 
 File StorageManager::openFile(const String& path, const char* mode) {
+  return openFile(path.c_str(), mode);
+}
+
+File StorageManager::openFile(const char* path, const char* mode) {
   if (!initialized || !takeMutex(1000)) {
     return File();
   }
   
-  File file = SD_MMC.open(path.c_str(), mode);
+  // The VFS layer allocates a handle per open file (freed on close)
+  AllocCounter::Exempt exempt;
+  File file = SD_MMC.open(path, mode);
   giveMutex();
   
   return file;
@@ -134,12 +143,32 @@ File StorageManager::openFile(const String& path, const char* mode) {
 
 bool StorageManager::closeFile(File& file) {
   if (file) {
+    AllocCounter::Exempt exempt;
     file.close();
     return true;
   }
   return false;
 }
 
+size_t HashingPrint::write(const uint8_t* buffer, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    size_t chunk = min((size_t)HASHED_WRITE_CHUNK, size - total);
+    size_t written = out.write(buffer + total, chunk);
+    hash.update(buffer + total, written);
+    total += written;
+    if (written != chunk) {
+      break;
+    }
+  }
+  return total;
+}
+
+size_t StorageManager::writeHashed(File& file, const uint8_t* data, size_t size, PhotoHash& hash) {
+  HashingPrint out(file, hash);
+  return out.write(data, size);
+}
+
 bool StorageManager::exists(const String& path) {
   if (!initialized || !takeMutex(1000)) {
     return false;
@@ -512,4 +541,158 @@ bool StorageManager::readFileAtomic(const String& path, std::vector<uint8_t>& da
   }
   
   return true;
-}
\ No newline at end of file
+}
+
+bool StorageManager::runHashBenchmark(uint8_t iterations) {
+  Serial.println("\n=== Photo Hash Benchmark ===");
+  if (SystemState::isCapturing()) {
+    Serial.println("FAIL: Stop capture first (the benchmark writes to the card)");
+    return false;
+  }
+
+  const size_t size = 512 * 1024; // One capture slot
+  const String path = "/hash_bench.bin";
+  int passed = 0;
+  int total = 0;
+  uint8_t digest[PHOTO_HASH_SIZE];
+  char hex[PHOTO_HASH_HEX_SIZE];
+
+  // FIPS 180-2 test vectors
+  static const char* ABC_HEX = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+  static const char* EMPTY_HEX = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+  PhotoHash::compute((const uint8_t*)"abc", 3, digest);
+  PhotoHash::toHex(digest, hex);
+  total++;
+  if (strcmp(hex, ABC_HEX) == 0) {
+    passed++;
+    Serial.println("PASS: SHA-256(\"abc\")");
+  } else {
+    Serial.printf("FAIL: SHA-256(\"abc\") = %s\n", hex);
+  }
+  PhotoHash::compute(nullptr, 0, digest);
+  PhotoHash::toHex(digest, hex);
+  total++;
+  if (strcmp(hex, EMPTY_HEX) == 0) {
+    passed++;
+    Serial.println("PASS: SHA-256(\"\")");
+  } else {
+    Serial.printf("FAIL: SHA-256(\"\") = %s\n", hex);
+  }
+
+  uint8_t* data = (uint8_t*)PSRAM_MALLOC(size);
+  uint8_t* readBuffer = (uint8_t*)malloc(HASHED_WRITE_CHUNK);
+  if (!data || !readBuffer) {
+    Serial.println("FAIL: Not enough memory for the benchmark buffers");
+    if (data) PSRAM_FREE(data);
+    free(readBuffer);
+    return false;
+  }
+  for (size_t i = 0; i < size; i += 4) {
+    uint32_t r = esp_random();
+    memcpy(data + i, &r, 4);
+  }
+
+  // Incremental in odd-sized pieces must equal one shot
+  uint8_t oneShot[PHOTO_HASH_SIZE];
+  uint32_t start = micros();
+  PhotoHash::compute(data, size, oneShot);
+  uint32_t hashTime = micros() - start;
+  PhotoHash pieces;
+  for (size_t offset = 0; offset < size; offset += 1000) {
+    pieces.update(data + offset, min((size_t)1000, size - offset));
+  }
+  pieces.finish(digest);
+  total++;
+  if (memcmp(digest, oneShot, PHOTO_HASH_SIZE) == 0) {
+    passed++;
+    Serial.println("PASS: Incremental digest equals one-shot digest");
+  } else {
+    Serial.println("FAIL: Incremental digest differs from one-shot digest");
+  }
+
+  uint32_t plainTotal = 0;
+  uint32_t hashedTotal = 0;
+  uint32_t readBackTotal = 0;
+  uint8_t runs = 0;
+  uint8_t matches = 0;
+  for (uint8_t i = 0; i < iterations; i++) {
+    start = micros();
+    File file = openFile(path, "w");
+    size_t written = file ? file.write(data, size) : 0;
+    closeFile(file);
+    uint32_t plain = micros() - start;
+
+    PhotoHash hash;
+    start = micros();
+    file = openFile(path, "w");
+    size_t hashedWritten = file ? writeHashed(file, data, size, hash) : 0;
+    closeFile(file);
+    uint32_t hashed = micros() - start;
+    uint8_t streamed[PHOTO_HASH_SIZE];
+    hash.finish(streamed);
+
+    // What hashing without the streamed digest would cost: read the photo back
+    start = micros();
+    file = openFile(path, "r");
+    PhotoHash readHash;
+    size_t readTotal = 0;
+    while (file && readTotal < size) {
+      size_t n = file.read(readBuffer, HASHED_WRITE_CHUNK);
+      if (n == 0) {
+        break;
+      }
+      readHash.update(readBuffer, n);
+      readTotal += n;
+    }
+    closeFile(file);
+    readHash.finish(digest);
+    uint32_t readBack = micros() - start;
+
+    if (written != size || hashedWritten != size || readTotal != size) {
+      continue;
+    }
+    runs++;
+    plainTotal += plain;
+    hashedTotal += hashed;
+    readBackTotal += readBack;
+    if (memcmp(streamed, digest, PHOTO_HASH_SIZE) == 0 &&
+        memcmp(streamed, oneShot, PHOTO_HASH_SIZE) == 0) {
+      matches++;
+    }
+  }
+  remove(path);
+  free(readBuffer);
+  PSRAM_FREE(data);
+
+  total++;
+  if (runs == iterations && runs > 0) {
+    passed++;
+    Serial.printf("PASS: %u x %u KB written and read back\n", runs, (unsigned)(size / 1024));
+  } else {
+    Serial.printf("FAIL: Only %u/%u write/read runs completed\n", runs, iterations);
+  }
+  total++;
+  if (runs > 0 && matches == runs) {
+    passed++;
+    Serial.println("PASS: Digest computed during write matches the file on the card");
+  } else {
+    Serial.printf("FAIL: Digest matched the card in %u/%u runs\n", matches, runs);
+  }
+
+  Serial.printf("Backend: %s\n", PhotoHash::getBackendName());
+  Serial.printf("Hash only: %u us per %u KB (%.1f MB/s)\n", hashTime, (unsigned)(size / 1024),
+                hashTime ? size / (float)hashTime : 0.0f);
+  if (runs > 0) {
+    uint32_t plainAvg = plainTotal / runs;
+    uint32_t hashedAvg = hashedTotal / runs;
+    uint32_t readBackAvg = readBackTotal / runs;
+    Serial.printf("Write plain/hashed: %u/%u us (+%.1f%%)\n", plainAvg, hashedAvg,
+                  plainAvg ? 100.0f * ((float)hashedAvg - plainAvg) / plainAvg : 0.0f);
+    Serial.printf("Read back and hash (avoided): %u us per photo\n", readBackAvg);
+  }
+
+  Serial.printf("\nResults: %d/%d tests passed\n", passed, total);
+  Serial.printf("Overall Result: %s\n", passed == total ? "PASS" : "FAIL");
+  Serial.println("============================\n");
+  return passed == total;
+}
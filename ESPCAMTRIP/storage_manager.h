@@ -7,6 +7,26 @@
 #include <vector>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include "photo_hash.h"
+
+/**
+ * Print wrapper that hashes the bytes the wrapped output accepted, so a
+ * photo's SHA-256 is computed while it is written (no read back). Data is
+ * passed on in HASHED_WRITE_CHUNK pieces and only written bytes are hashed:
+ * after a short write the digest still matches the file contents.
+ */
+#define HASHED_WRITE_CHUNK 32768
+
+class HashingPrint : public Print {
+public:
+  HashingPrint(Print& out, PhotoHash& hash) : out(out), hash(hash) {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+
+private:
+  Print& out;
+  PhotoHash& hash;
+};
 
 class StorageManager {
 public:
@@ -17,7 +37,9 @@ public:
   // File operations (WARNING: openFile/closeFile has race condition)
   // Mutex is released before file handle returned - use atomic operations when possible
   static File openFile(const String& path, const char* mode);
+  static File openFile(const char* path, const char* mode);
   static bool closeFile(File& file);
+  static size_t writeHashed(File& file, const uint8_t* data, size_t size, PhotoHash& hash);
   
   // Thread-safe atomic file operations (recommended)
   static bool writeFileAtomic(const String& path, const uint8_t* data, size_t size);
@@ -40,6 +62,9 @@ public:
   // Utility functions
   static time_t extractTimestampFromDirectory(const String& directory);
   static bool writeLogEntry(const String& filename, const String& entry);
+
+  // Plain vs hashed write vs write + read back to hash, on the card (not while capturing)
+  static bool runHashBenchmark(uint8_t iterations);
   
 private:
   static SemaphoreHandle_t sdMutex;
@@ -0,0 +1,362 @@
+#include "thumbnail_manager.h"
+#include "config.h"
+#include "storage_manager.h"
+#include "psram_manager.h"
+#include "camera_hal.h"
+#include "img_converters.h"
+#include "jpeg_encoder.h"
+#include "exif_gps_static.h"
+#include "capture_pipeline.h"
+#include "system_state.h"
+
+#define THUMBNAIL_EXIF_BUFFER_SIZE (32 * 1024)  // 200x150 at quality 70 is ~6-10 KB
+
+// Decoder state is ~14 KB; used from the SD writer task only
+static JpegCoeffDecoder decoder;
+
+uint8_t* ThumbnailManager::buffer = nullptr;
+size_t ThumbnailManager::bufferSize = 0;
+ThumbnailStats ThumbnailManager::stats = {};
+uint8_t* ThumbnailManager::exifBuffer = nullptr;
+const uint8_t* ThumbnailManager::extractedJpeg = nullptr;
+size_t ThumbnailManager::extractedLength = 0;
+DCThumbnailInfo ThumbnailManager::extractedInfo = {};
+uint32_t ThumbnailManager::extractedTime = 0;
+
+bool ThumbnailManager::isEnabled() {
+    return Config::thumbnail.enabled;
+}
+
+bool ThumbnailManager::isEXIFEnabled() {
+    return Config::thumbnail.EXIF;
+}
+
+bool ThumbnailManager::ensureBuffer(size_t size) {
+    if (buffer && bufferSize >= size) {
+        return true;
+    }
+    if (buffer) {
+        PSRAM_FREE(buffer);
+        bufferSize = 0;
+    }
+    buffer = (uint8_t*)PSRAM_MALLOC(size);
+    if (!buffer) {
+        Serial.printf("Thumbnail: failed to allocate %u bytes\n", (unsigned)size);
+        return false;
+    }
+    bufferSize = size;
+    return true;
+}
+
+bool ThumbnailManager::ensureEXIFBuffer() {
+    if (!exifBuffer) {
+        exifBuffer = (uint8_t*)PSRAM_MALLOC(THUMBNAIL_EXIF_BUFFER_SIZE);
+        if (!exifBuffer) {
+            Serial.println("Thumbnail: failed to allocate EXIF thumbnail buffer");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThumbnailManager::extract(const uint8_t* jpeg, size_t length, bool rgb,
+                               DCThumbnailInfo& info) {
+    if (DCThumbnail::extract(decoder, jpeg, length, rgb, buffer, bufferSize, info)) {
+        return true;
+    }
+    // Grow on the first frame of a larger size; otherwise not parseable or corrupt
+    if (info.width == 0 || info.size() <= bufferSize || !ensureBuffer(info.size())) {
+        return false;
+    }
+    return DCThumbnail::extract(decoder, jpeg, length, rgb, buffer, bufferSize, info);
+}
+
+bool ThumbnailManager::makePath(const char* jpegPath, char* out, size_t outSize) {
+    const char* dot = strrchr(jpegPath, '.');
+    size_t baseLength = dot ? (size_t)(dot - jpegPath) : strlen(jpegPath);
+    const char* suffix = Config::thumbnail.RGB ? "_thumb.ppm" : "_thumb.pgm";
+    if (baseLength + strlen(suffix) + 1 > outSize) {
+        return false;
+    }
+    memcpy(out, jpegPath, baseLength);
+    strcpy(out + baseLength, suffix);
+    return true;
+}
+
+size_t ThumbnailManager::makeEXIFThumbnail(const uint8_t* jpeg, size_t length,
+                                           const uint8_t** thumbnail) {
+    extractedJpeg = nullptr;
+
+    // Writer behind: the time goes to the frames queued after this one
+    if (CapturePipeline::getOccupancy() > 1) {
+        stats.exifSkipped++;
+        return 0;
+    }
+    if (!ensureEXIFBuffer()) {
+        stats.exifFailed++;
+        return 0;
+    }
+
+    uint32_t start = micros();
+    DCThumbnailInfo info;
+    if (!extract(jpeg, length, Config::thumbnail.RGB, info)) {
+        stats.exifFailed++;
+        return 0;
+    }
+    extractedTime = micros() - start;
+    extractedJpeg = jpeg;
+    extractedLength = length;
+    extractedInfo = info;
+    if (extractedTime > Config::thumbnail.EXIF_BUDGET_MS * 1000UL) {
+        stats.exifSkipped++;
+        return 0;
+    }
+
+    // Encoded in place: no encoder state or line buffers on the heap
+    size_t thumbnailLength;
+    bool encoded = JpegEncoder::encode(buffer, info.width, info.height, info.channels,
+                                       Config::thumbnail.EXIF_QUALITY, exifBuffer,
+                                       min((size_t)THUMBNAIL_EXIF_BUFFER_SIZE,
+                                           StaticEXIFGPS::getMaxThumbnailSize()),
+                                       thumbnailLength);
+    uint32_t elapsed = micros() - start;
+
+    if (!encoded) {
+        stats.exifFailed++;
+        return 0;
+    }
+    stats.exifEmbedded++;
+    stats.exifBytes += thumbnailLength;
+    if (elapsed > stats.maxEXIFTime) {
+        stats.maxEXIFTime = elapsed;
+    }
+    *thumbnail = exifBuffer;
+    return thumbnailLength;
+}
+
+bool ThumbnailManager::writeThumbnail(const char* jpegPath, const uint8_t* jpeg, size_t length) {
+    uint32_t start = micros();
+    DCThumbnailInfo info;
+    uint32_t decodeTime;
+    if (extractedJpeg == jpeg && extractedLength == length) {
+        // Already extracted for the EXIF thumbnail
+        info = extractedInfo;
+        decodeTime = extractedTime;
+        extractedJpeg = nullptr;
+    } else if (extract(jpeg, length, Config::thumbnail.RGB, info)) {
+        decodeTime = micros() - start;
+    } else {
+        stats.failed++;
+        return false;
+    }
+    stats.lastDecodeTime = decodeTime;
+    stats.totalDecodeTime += decodeTime;
+    if (decodeTime > stats.maxDecodeTime) {
+        stats.maxDecodeTime = decodeTime;
+    }
+
+    char path[128];
+    if (!makePath(jpegPath, path, sizeof(path))) {
+        stats.failed++;
+        return false;
+    }
+
+    File file = StorageManager::openFile(path, "w");
+    if (!file) {
+        Serial.printf("Failed to create thumbnail: %s\n", path);
+        stats.failed++;
+        return false;
+    }
+
+    // Netpbm: P5 = 8-bit gray, P6 = 8-bit RGB
+    char header[24];
+    int headerLength = snprintf(header, sizeof(header), "P%c\n%u %u\n255\n",
+                                info.channels == 3 ? '6' : '5', info.width, info.height);
+    size_t written = file.write((const uint8_t*)header, headerLength);
+    written += file.write(buffer, info.size());
+    StorageManager::closeFile(file);
+
+    if (written != headerLength + info.size()) {
+        Serial.printf("Short write for %s\n", path);
+        stats.failed++;
+        return false;
+    }
+    stats.written++;
+    stats.bytesWritten += written;
+    return true;
+}
+
+void ThumbnailManager::printStatistics() {
+    Serial.println("\n--- Thumbnails ---");
+    Serial.printf("Written: %u (%u KB), failed: %u\n", stats.written,
+                  (unsigned)(stats.bytesWritten / 1024), stats.failed);
+    Serial.printf("Extract time last/avg/max: %u/%u/%u us\n", stats.lastDecodeTime,
+                  stats.written ? (uint32_t)(stats.totalDecodeTime / stats.written) : 0,
+                  stats.maxDecodeTime);
+    if (Config::thumbnail.EXIF) {
+        Serial.printf("EXIF: %u embedded (avg %u bytes), %u skipped, %u failed, max %u us\n",
+                      stats.exifEmbedded,
+                      stats.exifEmbedded ? (unsigned)(stats.exifBytes / stats.exifEmbedded) : 0,
+                      stats.exifSkipped, stats.exifFailed, stats.maxEXIFTime);
+    }
+    Serial.println("------------------\n");
+}
+
+// RGB565 channel difference (in 565 steps) between our pixel and a reference pixel
+static int rgb565Difference(const uint8_t* rgb, uint16_t ref) {
+    int dr = abs((rgb[0] >> 3) - ((ref >> 11) & 0x1F));
+    int dg = abs((rgb[1] >> 2) - ((ref >> 5) & 0x3F));
+    int db = abs((rgb[2] >> 3) - (ref & 0x1F));
+    return max(dr, max(dg, db));
+}
+
+static void swapRedBlue(uint8_t* rgb, size_t pixels) {
+    for (size_t p = 0; p < pixels; p++, rgb += 3) {
+        uint8_t r = rgb[0];
+        rgb[0] = rgb[2];
+        rgb[2] = r;
+    }
+}
+
+// Mean RGB565 difference of a decoded JPEG from the thumbnail it was
+// encoded from; -1 if it does not decode. decoded holds pixels * 2 bytes
+static float decodeError(const uint8_t* jpeg, size_t length, const uint8_t* rgb,
+                         uint8_t* decoded, size_t pixels) {
+    if (!jpg2rgb565(jpeg, length, decoded, JPG_SCALE_NONE)) {
+        return -1;
+    }
+    uint32_t errorBE = 0;
+    uint32_t errorLE = 0;
+    for (size_t p = 0; p < pixels; p++) {
+        uint16_t be = (decoded[p * 2] << 8) | decoded[p * 2 + 1];
+        uint16_t le = (decoded[p * 2 + 1] << 8) | decoded[p * 2];
+        errorBE += rgb565Difference(rgb + p * 3, be);
+        errorLE += rgb565Difference(rgb + p * 3, le);
+    }
+    return (float)min(errorBE, errorLE) / pixels;
+}
+
+bool ThumbnailManager::runSelfTest(uint8_t frames) {
+    Serial.println("\n=== Thumbnail Self-Test ===");
+    if (SystemState::isCapturing()) {
+        Serial.println("FAIL: Stop capture first (the writer's thumbnail buffer is shared)");
+        return false;
+    }
+    extractedJpeg = nullptr; // The shared buffer is overwritten below
+
+    uint32_t intervalUs = Config::cameraMode.MISSION_CAPTURE_INTERVAL * 1000;
+    uint32_t maxTime = 0;
+    int passed = 0;
+    int total = 0;
+
+    for (uint8_t i = 0; i < frames; i++) {
+        camera_fb_t* fb = CameraHAL::fbGet();
+        if (!fb) {
+            Serial.println("FAIL: Camera capture failed");
+            return false;
+        }
+        if (fb->format != PIXFORMAT_JPEG) {
+            CameraHAL::fbReturn(fb);
+            Serial.println("FAIL: Camera is not in a JPEG mode");
+            return false;
+        }
+
+        uint32_t start = micros();
+        DCThumbnailInfo info;
+        bool ok = extract(fb->buf, fb->len, true, info);
+        uint32_t elapsed = micros() - start;
+        if (elapsed > maxTime) {
+            maxTime = elapsed;
+        }
+
+        total++;
+        if (!ok || info.channels != 3) {
+            CameraHAL::fbReturn(fb);
+            Serial.printf("FAIL: Frame %u: no RGB thumbnail\n", i);
+            continue;
+        }
+
+        // Reference: esp32-camera decoder at 1/8 scale
+        size_t pixels = (size_t)info.width * info.height;
+        uint8_t* ref = (uint8_t*)PSRAM_MALLOC(pixels * 2);
+        bool decoded = ref && jpg2rgb565(fb->buf, fb->len, ref, JPG_SCALE_8X);
+        CameraHAL::fbReturn(fb);
+        if (!decoded) {
+            PSRAM_FREE(ref);
+            Serial.printf("FAIL: Frame %u: reference decode failed\n", i);
+            continue;
+        }
+
+        // Count pixels off by more than one 565 step; RGB565 byte order
+        // differs between esp32-camera releases, so take the better one
+        uint32_t mismatchBE = 0;
+        uint32_t mismatchLE = 0;
+        for (size_t p = 0; p < pixels; p++) {
+            uint16_t be = (ref[p * 2] << 8) | ref[p * 2 + 1];
+            uint16_t le = (ref[p * 2 + 1] << 8) | ref[p * 2];
+            if (rgb565Difference(buffer + p * 3, be) > 1) mismatchBE++;
+            if (rgb565Difference(buffer + p * 3, le) > 1) mismatchLE++;
+        }
+
+        uint32_t mismatched = min(mismatchBE, mismatchLE);
+        bool match = mismatched * 100 <= pixels;
+        if (match) {
+            passed++;
+        }
+        Serial.printf("%s: Frame %u: %ux%u, %u/%u pixels differ, %u us\n",
+                      match ? "PASS" : "FAIL", i, info.width, info.height,
+                      mismatched, (unsigned)pixels, elapsed);
+
+        // EXIF thumbnail: JpegEncoder output read back by the esp32-camera
+        // decoder must be as close to the thumbnail as esp32-camera's own
+        // encoder at the same quality (content sets the absolute error)
+        total++;
+        size_t thumbLength = 0;
+        start = micros();
+        bool encoded = ensureEXIFBuffer() &&
+                       JpegEncoder::encode(buffer, info.width, info.height, 3,
+                                           Config::thumbnail.EXIF_QUALITY, exifBuffer,
+                                           THUMBNAIL_EXIF_BUFFER_SIZE, thumbLength);
+        uint32_t encodeTime = micros() - start;
+        float meanError = encoded ? decodeError(exifBuffer, thumbLength, buffer, ref, pixels) : -1;
+
+        // esp32-camera's RGB888 is BGR in memory; swapped back afterwards
+        uint8_t* refJpeg = nullptr;
+        size_t refLength = 0;
+        swapRedBlue(buffer, pixels);
+        bool refEncoded = fmt2jpg(buffer, info.size(), info.width, info.height, PIXFORMAT_RGB888,
+                                  Config::thumbnail.EXIF_QUALITY, &refJpeg, &refLength);
+        swapRedBlue(buffer, pixels);
+        float refError = refEncoded ? decodeError(refJpeg, refLength, buffer, ref, pixels) : -1;
+        free(refJpeg);
+        PSRAM_FREE(ref);
+
+        if (meanError < 0 || refError < 0) {
+            Serial.printf("FAIL: Frame %u: EXIF thumbnail %s failed\n", i,
+                          meanError < 0 ? "encode/decode" : "reference encode/decode");
+            continue;
+        }
+        bool readable = meanError <= refError * 1.2f + 0.25f;
+        if (readable) {
+            passed++;
+        }
+        Serial.printf("%s: Frame %u: EXIF thumbnail %u bytes, mean error %.2f steps "
+                      "(esp32-camera %u bytes, %.2f), %u us\n",
+                      readable ? "PASS" : "FAIL", i, (unsigned)thumbLength, meanError,
+                      (unsigned)refLength, refError, encodeTime);
+    }
+
+    // The writer must keep up with capture
+    total++;
+    bool fits = maxTime <= intervalUs;
+    if (fits) {
+        passed++;
+    }
+    Serial.printf("%s: Max extract is %.1f%% of the %u ms capture interval\n",
+                  fits ? "PASS" : "FAIL", maxTime * 100.0f / intervalUs,
+                  Config::cameraMode.MISSION_CAPTURE_INTERVAL);
+
+    Serial.printf("Results: %d/%d tests passed\n", passed, total);
+    Serial.printf("Overall Result: %s\n", (passed == total) ? "PASS" : "FAIL");
+    return passed == total;
+}
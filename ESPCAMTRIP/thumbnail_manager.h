@@ -0,0 +1,106 @@
+#ifndef THUMBNAIL_MANAGER_H
+#define THUMBNAIL_MANAGER_H
+
+#include <Arduino.h>
+#include "dc_thumbnail.h"
+
+/**
+ * Thumbnail Manager
+ *
+ * Writes a 1/8-scale DC thumbnail (DCThumbnail) next to each photo the
+ * SD writer saves, for field review and preview-first upload:
+ *   photo_0001.jpg -> photo_0001_thumb.pgm (gray) or _thumb.ppm (RGB)
+ *
+ * Netpbm binary files are used so any viewer or script reads them without
+ * a decoder. Runs in the writer path only; capture never waits on it.
+ *
+ * With thumbnail.EXIF the same DC thumbnail is also JPEG encoded
+ * (JpegEncoder: no heap, unlike esp32-camera's fmt2jpg whose encoder
+ * allocates per call) for the photo's EXIF IFD1, so galleries and
+ * triage scripts show it without decoding the full frame. It is skipped
+ * when frames are queued behind the one being written or the extract
+ * overruns EXIF_BUDGET_MS; writeThumbnail() reuses that extract.
+ */
+
+struct ThumbnailStats {
+    uint32_t written;
+    uint32_t failed;             // Undecodable JPEG, no buffer or SD error
+    uint32_t lastDecodeTime;     // us
+    uint32_t maxDecodeTime;      // us
+    uint64_t totalDecodeTime;    // us
+    uint64_t bytesWritten;
+    uint32_t exifEmbedded;       // EXIF thumbnails made
+    uint32_t exifSkipped;        // Writer behind or extract over budget
+    uint32_t exifFailed;         // Undecodable JPEG, encoder error or too large
+    uint32_t maxEXIFTime;        // us, extract + encode
+    uint64_t exifBytes;
+
+    void reset() {
+        written = 0;
+        failed = 0;
+        lastDecodeTime = 0;
+        maxDecodeTime = 0;
+        totalDecodeTime = 0;
+        bytesWritten = 0;
+        exifEmbedded = 0;
+        exifSkipped = 0;
+        exifFailed = 0;
+        maxEXIFTime = 0;
+        exifBytes = 0;
+    }
+};
+
+class ThumbnailManager {
+private:
+    static uint8_t* buffer;      // PSRAM, grown to the largest thumbnail seen
+    static size_t bufferSize;
+    static ThumbnailStats stats;
+    static uint8_t* exifBuffer;  // PSRAM, EXIF thumbnail JPEG
+    static const uint8_t* extractedJpeg; // Frame whose extract is in buffer (for writeThumbnail)
+    static size_t extractedLength;
+    static DCThumbnailInfo extractedInfo;
+    static uint32_t extractedTime;
+
+    static bool ensureBuffer(size_t size);
+    static bool ensureEXIFBuffer();
+    static bool extract(const uint8_t* jpeg, size_t length, bool rgb, DCThumbnailInfo& info);
+
+public:
+    static bool isEnabled();
+    static bool isEXIFEnabled();
+
+    /**
+     * JPEG thumbnail of a frame for its EXIF IFD1 (StaticEXIFGPS::attachThumbnail())
+     *
+     * @param thumbnail Set to the JPEG, valid until the next call
+     * @return Thumbnail size, 0 if skipped or failed
+     */
+    static size_t makeEXIFThumbnail(const uint8_t* jpeg, size_t length, const uint8_t** thumbnail);
+
+    /**
+     * Thumbnail path for a photo path ("<base>_thumb.pgm" / ".ppm")
+     */
+    static bool makePath(const char* jpegPath, char* out, size_t outSize);
+
+    /**
+     * Extract and write the thumbnail of a JPEG already saved at jpegPath
+     */
+    static bool writeThumbnail(const char* jpegPath, const uint8_t* jpeg, size_t length);
+
+    /**
+     * Statistics
+     */
+    static ThumbnailStats getStatistics() { return stats; }
+    static void resetStatistics() { stats.reset(); }
+    static void printStatistics();
+
+    /**
+     * Compare thumbnails of live frames with the esp32-camera JPEG decoder
+     * at 1/8 scale, decode each one's EXIF thumbnail JPEG back with it and
+     * time extraction against the capture interval (camera in a JPEG mode;
+     * refused while capturing, the writer's buffers are shared)
+     */
+    static bool runSelfTest(uint8_t frames = 5);
+};
+
+#endif // THUMBNAIL_MANAGER_H
@@ -2,6 +2,14 @@
 #include "config.h"
 #include "storage_manager.h"
 #include "wifi_manager.h"
+#include "mission_log.h"
+#include "mission_manifest.h"
+#include "duplicate_filter.h"
+#include "jpeg_requantizer.h"
+#include "photo_hash.h"
+#include "psram_manager.h"
+#include "camera_hal.h"
+#include "img_converters.h"
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 #include <mbedtls/md.h>
@@ -11,6 +19,29 @@
 std::vector<String> UploadManager::uploadedDirectories;
 uint32_t UploadManager::totalUploaded = 0;
 uint32_t UploadManager::totalFailed = 0;
+uint32_t UploadManager::previewsUploaded = 0;
+uint32_t UploadManager::previewFailures = 0;
+uint64_t UploadManager::previewBytes = 0;
+uint64_t UploadManager::previewSourceBytes = 0;
+uint32_t UploadManager::hashesFromLog = 0;
+uint32_t UploadManager::hashesComputed = 0;
+
+// Digest of a photo in the mission log hashes; files are listed in about
+// the order they were logged, so the search starts after the last match
+static const uint8_t* findHash(const std::vector<MissionLogHash>& hashes, const String& name,
+                               size_t& cursor) {
+  for (size_t n = 0; n < hashes.size(); n++) {
+    size_t i = (cursor + n) % hashes.size();
+    if (name == hashes[i].filename) {
+      cursor = i + 1;
+      return hashes[i].sha256;
+    }
+  }
+  return nullptr;
+}
+
+// Decoder state is ~14 KB; used from the upload task only
+static JpegCoeffDecoder previewDecoder;
 
 void UploadManager::loadTracking() {
   Serial.println("Loading upload tracking...");
@@ -106,15 +137,43 @@ void UploadManager::uploadPendingDirectories() {
   }
   
   Serial.printf("Found %d directories to upload\n", pendingDirs.size());
+
+  // Manifests first: the back end can lay out every flight from them
+  // before any preview or photo arrives
+  std::vector<bool> manifestDone(pendingDirs.size(), false);
+  for (size_t i = 0; i < pendingDirs.size(); i++) {
+    manifestDone[i] = uploadManifest(pendingDirs[i]);
+  }
+
+  // Previews of everything pending first: a weak link shows the whole
+  // survey early, full-size photos follow
+  if (Config::upload.PREVIEW_FIRST) {
+    for (const String& dir : pendingDirs) {
+      if (StorageManager::exists(dir + "/" + PREVIEW_MARKER_FILE)) {
+        continue;
+      }
+      Serial.println("\nUploading previews: " + dir);
+      if (uploadPreviews(dir)) {
+        File marker = StorageManager::openFile(dir + "/" + PREVIEW_MARKER_FILE, "w");
+        if (marker) {
+          StorageManager::closeFile(marker);
+        }
+      }
+    }
+  }
   
   // Upload each directory
   int successCount = 0;
-  for (const String& dir : pendingDirs) {
+  for (size_t i = 0; i < pendingDirs.size(); i++) {
+    const String& dir = pendingDirs[i];
     Serial.println("\nUploading: " + dir);
     
     bool success = false;
     for (size_t retry = 0; retry < Config::s3.MAX_UPLOAD_RETRIES; retry++) {
-      if (uploadDirectory(dir)) {
+      if (!manifestDone[i]) {
+        manifestDone[i] = uploadManifest(dir);
+      }
+      if (manifestDone[i] && uploadDirectory(dir)) {
         markDirectoryAsUploaded(dir);
         successCount++;
         success = true;
@@ -145,12 +204,18 @@ void UploadManager::uploadPendingDirectories() {
 
 bool UploadManager::uploadDirectory(const String& directoryPath) {
   std::vector<String> files = StorageManager::listDirectory(directoryPath);
+  std::vector<MissionLogHash> hashes;
+  MissionLog::readHashes(directoryPath, hashes);
+  size_t hashCursor = 0;
   
   int uploadCount = 0;
   int successCount = 0;
   
   for (const String& filename : files) {
-    if (filename.endsWith(".jpg")) {
+    // Photos, the directory's mission log (per-photo metadata) and the
+    // duplicate filter's decisions (frames that were not written)
+    if (filename.endsWith(".jpg") || filename.endsWith(MISSION_LOG_FILE) ||
+        filename.endsWith(DEDUP_LOG_FILE)) {
       uploadCount++;
       
       File file = StorageManager::openFile(filename, "r");
@@ -161,7 +226,8 @@ bool UploadManager::uploadDirectory(const String& directoryPath) {
       
       Serial.printf("  Uploading %s...", filename.c_str());
       
-      if (uploadFile(file, directoryPath)) {
+      const uint8_t* sha256 = findHash(hashes, extractFileName(filename), hashCursor);
+      if (uploadFile(file, directoryPath, sha256)) {
         successCount++;
         Serial.println(" ✓");
       } else {
@@ -175,7 +241,7 @@ bool UploadManager::uploadDirectory(const String& directoryPath) {
   return (successCount == uploadCount && uploadCount > 0);
 }
 
-bool UploadManager::uploadFile(File& file, const String& directoryPath) {
+bool UploadManager::uploadFile(File& file, const String& directoryPath, const uint8_t* sha256) {
   if (!file) return false;
   
   // Generate S3 key
@@ -183,20 +249,139 @@ bool UploadManager::uploadFile(File& file, const String& directoryPath) {
   String fileName = extractFileName(file.name());
   String s3Key = dirName + "/" + fileName;
   
+  const char* contentType = fileName.endsWith(".jpg") ? "image/jpeg" : "application/octet-stream";
+  if (file.size() > UPLOAD_BUFFER_LIMIT) {
+    return uploadStream(file, s3Key, contentType, sha256);
+  }
+
+  size_t fileSize;
+  uint8_t* buffer = readFile(file, fileSize);
+  if (!buffer) {
+    return false;
+  }
+  
+  bool success = uploadBuffer(buffer, fileSize, s3Key, contentType, sha256);
+  free(buffer);
+  return success;
+}
+
+uint8_t* UploadManager::readFile(File& file, size_t& size) {
+  // Read file into memory (for small files)
+  // Larger files go through uploadStream()
+  size = file.size();
+  if (size > UPLOAD_BUFFER_LIMIT) {
+    Serial.println("File too large for simple upload");
+    return nullptr;
+  }
+  
+  uint8_t* buffer = (uint8_t*)malloc(size);
+  if (!buffer) {
+    Serial.println("Failed to allocate upload buffer");
+    return nullptr;
+  }
+  
+  file.seek(0);
+  if (file.read(buffer, size) != size) {
+    Serial.println("Failed to read file for upload");
+    free(buffer);
+    return nullptr;
+  }
+  return buffer;
+}
+
+bool UploadManager::uploadBuffer(const uint8_t* data, size_t size, const String& s3Key,
+                                 const char* contentType, const uint8_t* sha256) {
+  // Payload hash: the capture-time digest if there is one. S3 checks it
+  // against the body, so a photo corrupted on SD since capture is rejected.
+  uint8_t computed[PHOTO_HASH_SIZE];
+  if (sha256) {
+    hashesFromLog++;
+  } else {
+    PhotoHash::compute(data, size, computed);
+    sha256 = computed;
+    hashesComputed++;
+  }
+
+  WiFiClientSecure client;
+  HTTPClient http;
+  beginPut(http, client, s3Key, contentType, size, sha256);
+
+  bool success = false;
+  int httpCode = http.PUT((uint8_t*)data, size);
+  
+  if (httpCode == 200 || httpCode == 201) {
+    success = true;
+  } else {
+    Serial.printf("HTTP error: %d", httpCode);
+  }
+  
+  http.end();
+  
+  return success;
+}
+
+bool UploadManager::uploadStream(File& file, const String& s3Key, const char* contentType,
+                                 const uint8_t* sha256) {
+  size_t size = file.size();
+  uint8_t chunk[1024];
+
+  uint8_t computed[PHOTO_HASH_SIZE];
+  if (sha256) {
+    hashesFromLog++;
+  } else {
+    PhotoHash hash;
+    size_t hashed = 0;
+    file.seek(0);
+    while (hashed < size) {
+      size_t n = file.read(chunk, min(sizeof(chunk), size - hashed));
+      if (n == 0) {
+        Serial.println("Failed to read file for upload");
+        return false;
+      }
+      hash.update(chunk, n);
+      hashed += n;
+    }
+    hash.finish(computed);
+    sha256 = computed;
+    hashesComputed++;
+  }
+  file.seek(0);
+
+  WiFiClientSecure client;
+  HTTPClient http;
+  beginPut(http, client, s3Key, contentType, size, sha256);
+
+  bool success = false;
+  int httpCode = http.sendRequest("PUT", &file, size);
+
+  if (httpCode == 200 || httpCode == 201) {
+    success = true;
+  } else {
+    Serial.printf("HTTP error: %d", httpCode);
+  }
+
+  http.end();
+
+  return success;
+}
+
+void UploadManager::beginPut(HTTPClient& http, WiFiClientSecure& client, const String& s3Key,
+                             const char* contentType, size_t size, const uint8_t* sha256) {
+  char payloadHash[PHOTO_HASH_HEX_SIZE];
+  PhotoHash::toHex(sha256, payloadHash);
+
   // Generate URL
   String url = generateS3Url(s3Key);
   
   // Prepare HTTP client
-  WiFiClientSecure client;
   client.setInsecure(); // For development - use proper certs in production
   
-  HTTPClient http;
   http.begin(client, url);
   http.setTimeout(30000); // 30 second timeout
   
   // Set headers
-  http.addHeader("Content-Type", "image/jpeg");
-  http.addHeader("Content-Length", String(file.size()));
+  http.addHeader("Content-Type", contentType);
+  http.addHeader("Content-Length", String(size));
   
   // Generate timestamp
   time_t now;
@@ -204,45 +389,220 @@ bool UploadManager::uploadFile(File& file, const String& directoryPath) {
   char timestamp[20];
   strftime(timestamp, sizeof(timestamp), "%Y%m%dT%H%M%SZ", gmtime(&now));
   http.addHeader("x-amz-date", timestamp);
+  http.addHeader("x-amz-content-sha256", payloadHash);
   
   // Add authorization (simplified - implement proper AWS Signature V4)
-  String authHeader = generateAWSSignature("PUT", "/" + s3Key, "", "", timestamp);
+  String authHeader = generateAWSSignature("PUT", "/" + s3Key, "", payloadHash, timestamp);
   http.addHeader("Authorization", authHeader);
-  
-  // Read file into memory (for small files)
-  // For larger files, implement streaming upload
-  size_t fileSize = file.size();
-  if (fileSize > 1024 * 1024) { // 1MB limit for this implementation
-    Serial.println("File too large for simple upload");
+}
+
+bool UploadManager::uploadManifest(const String& directoryPath) {
+  String path = directoryPath + "/" + MISSION_MANIFEST_FILE;
+  if (!StorageManager::exists(path)) {
+    return true;
+  }
+  File file = StorageManager::openFile(path, "r");
+  if (!file) {
+    Serial.println("Failed to open: " + path);
     return false;
   }
-  
-  uint8_t* buffer = (uint8_t*)malloc(fileSize);
-  if (!buffer) {
-    Serial.println("Failed to allocate upload buffer");
+
+  // Room for the trailer if a reset left the manifest open
+  size_t size = file.size();
+  size_t trailerLength = strlen(MISSION_MANIFEST_TRAILER);
+  uint8_t* buffer = (uint8_t*)PSRAM_MALLOC(size + trailerLength);
+  bool read = buffer && file.read(buffer, size) == size;
+  StorageManager::closeFile(file);
+  if (!read) {
+    Serial.println("Failed to read manifest: " + path);
+    if (buffer) PSRAM_FREE(buffer);
     return false;
   }
+
+  size = repairManifest(buffer, size);
+  bool success = false;
+  Serial.printf("  Uploading %s...", path.c_str());
+  if (size > 0) {
+    success = uploadBuffer(buffer, size, extractDirectoryName(directoryPath) + "/" +
+                           MISSION_MANIFEST_FILE, "application/geo+json");
+  }
+  Serial.println(success ? " ✓" : " ✗");
+  PSRAM_FREE(buffer);
+  return success;
+}
+
+size_t UploadManager::repairManifest(uint8_t* data, size_t size) {
+  const char* trailer = MISSION_MANIFEST_TRAILER;
+  size_t trailerLength = strlen(trailer);
+  if (size >= trailerLength && memcmp(data + size - trailerLength, trailer, trailerLength) == 0) {
+    return size;
+  }
+
+  // Not finalized: drop the partial last line and close the array
+  // (data has room for the trailer)
+  while (size > 0 && data[size - 1] != '\n') {
+    size--;
+  }
+  if (size == 0) {
+    return 0;
+  }
+  memcpy(data + size, trailer, trailerLength);
+  Serial.print(" (repaired)");
+  return size + trailerLength;
+}
+
+bool UploadManager::uploadPreviews(const String& directoryPath) {
+  std::vector<String> files = StorageManager::listDirectory(directoryPath);
   
-  file.seek(0);
-  size_t bytesRead = file.read(buffer, fileSize);
+  int uploadCount = 0;
+  int successCount = 0;
   
-  bool success = false;
-  if (bytesRead == fileSize) {
-    int httpCode = http.PUT(buffer, fileSize);
+  for (const String& filename : files) {
+    if (!filename.endsWith(".jpg")) {
+      continue;
+    }
+    uploadCount++;
     
-    if (httpCode == 200 || httpCode == 201) {
-      success = true;
+    File file = StorageManager::openFile(filename, "r");
+    if (!file) {
+      Serial.println("Failed to open: " + filename);
+      continue;
+    }
+    
+    Serial.printf("  Preview %s...", filename.c_str());
+    if (uploadPreview(file, directoryPath)) {
+      successCount++;
+      Serial.println(" ✓");
     } else {
-      Serial.printf("HTTP error: %d", httpCode);
+      Serial.println(" ✗");
     }
+    
+    StorageManager::closeFile(file);
   }
   
-  free(buffer);
-  http.end();
+  return successCount == uploadCount;
+}
+
+bool UploadManager::uploadPreview(File& file, const String& directoryPath) {
+  if (!file) return false;
+  
+  String s3Key = extractDirectoryName(directoryPath) + "/preview/" + extractFileName(file.name());
+  
+  size_t fileSize;
+  uint8_t* source = readFile(file, fileSize);
+  if (!source) {
+    return false;
+  }
+  
+  // A preview that would not be smaller than the photo fails to fit
+  uint8_t* preview = (uint8_t*)PSRAM_MALLOC(fileSize);
+  size_t previewSize = 0;
+  bool requantized = preview &&
+      JpegRequantizer::requantize(previewDecoder, source, fileSize, Config::upload.PREVIEW_QUALITY,
+                                  preview, fileSize, previewSize);
+  free(source);
+  
+  if (!requantized) {
+    // Unsupported layout or no memory: the full-size upload covers this photo
+    PSRAM_FREE(preview);
+    previewFailures++;
+    Serial.print(" (no preview)");
+    return true;
+  }
   
+  bool success = uploadBuffer(preview, previewSize, s3Key, "image/jpeg");
+  PSRAM_FREE(preview);
+  if (success) {
+    previewsUploaded++;
+    previewBytes += previewSize;
+    previewSourceBytes += fileSize;
+  }
   return success;
 }
 
+bool UploadManager::runPreviewBenchmark(uint8_t frames) {
+  Serial.println("\n=== Preview Requantization Benchmark ===");
+  
+  const uint8_t qualities[] = { 20, 30, 50, 75 };
+  const uint8_t qualityCount = sizeof(qualities) / sizeof(qualities[0]);
+  uint32_t totalTime[qualityCount] = {};
+  uint32_t maxTime[qualityCount] = {};
+  uint64_t totalOut[qualityCount] = {};
+  uint64_t totalIn = 0;
+  int passed = 0;
+  int total = 0;
+  uint8_t grabbed = 0;
+  
+  for (uint8_t i = 0; i < frames; i++) {
+    camera_fb_t* fb = CameraHAL::fbGet();
+    if (!fb) {
+      Serial.println("FAIL: Camera capture failed");
+      return false;
+    }
+    if (fb->format != PIXFORMAT_JPEG) {
+      CameraHAL::fbReturn(fb);
+      Serial.println("FAIL: Camera is not in a JPEG mode");
+      return false;
+    }
+    
+    // Own copy: the requantizer reads the frame several times
+    size_t length = fb->len;
+    uint8_t* source = (uint8_t*)PSRAM_MALLOC(length);
+    uint8_t* preview = (uint8_t*)PSRAM_MALLOC(length);
+    if (!source || !preview) {
+      CameraHAL::fbReturn(fb);
+      PSRAM_FREE(source);
+      PSRAM_FREE(preview);
+      Serial.println("FAIL: Not enough PSRAM for benchmark buffers");
+      return false;
+    }
+    memcpy(source, fb->buf, length);
+    CameraHAL::fbReturn(fb);
+    grabbed++;
+    totalIn += length;
+    
+    for (uint8_t q = 0; q < qualityCount; q++) {
+      uint32_t start = micros();
+      size_t previewSize = 0;
+      bool ok = JpegRequantizer::requantize(previewDecoder, source, length, qualities[q],
+                                            preview, length, previewSize);
+      uint32_t elapsed = micros() - start;
+      totalTime[q] += elapsed;
+      maxTime[q] = max(maxTime[q], elapsed);
+      totalOut[q] += previewSize;
+      
+      // Validity: the esp32-camera decoder must read the preview
+      total++;
+      const JpegInfo& info = previewDecoder.getInfo();
+      size_t refSize = (size_t)((info.width + 7) / 8) * ((info.height + 7) / 8) * 2;
+      uint8_t* ref = ok ? (uint8_t*)PSRAM_MALLOC(refSize) : nullptr;
+      bool decoded = ref && jpg2rgb565(preview, previewSize, ref, JPG_SCALE_8X);
+      PSRAM_FREE(ref);
+      if (ok && decoded && previewSize <= length) {
+        passed++;
+      } else {
+        Serial.printf("FAIL: Frame %u quality %u: %s\n", i, qualities[q],
+                      !ok ? "requantize failed" : (!decoded ? "not decodable" : "larger than source"));
+      }
+    }
+    PSRAM_FREE(source);
+    PSRAM_FREE(preview);
+  }
+  
+  Serial.printf("%u frames, avg %u KB\n", grabbed, (unsigned)(totalIn / grabbed / 1024));
+  for (uint8_t q = 0; q < qualityCount; q++) {
+    uint32_t avgTime = totalTime[q] / grabbed;
+    Serial.printf("Quality %2u: %5.1f%% of source, avg/max %u/%u ms, %.2f MB/s\n",
+                  qualities[q], totalOut[q] * 100.0f / totalIn, avgTime / 1000, maxTime[q] / 1000,
+                  avgTime ? (totalIn / grabbed) / (float)avgTime : 0.0f);
+  }
+  
+  Serial.printf("Results: %d/%d tests passed\n", passed, total);
+  Serial.printf("Overall Result: %s\n", passed == total ? "PASS" : "FAIL");
+  Serial.println("========================================\n");
+  return passed == total;
+}
+
 uint32_t UploadManager::getUploadedCount() {
   return uploadedDirectories.size();
 }
@@ -266,6 +626,12 @@ void UploadManager::printStatistics() {
   Serial.printf("Total failed: %u uploads\n", totalFailed);
   Serial.printf("Currently tracked: %u directories\n", uploadedDirectories.size());
   Serial.printf("Pending uploads: %u directories\n", getPendingCount());
+  if (previewsUploaded > 0) {
+    Serial.printf("Previews: %u uploaded (%.1f%% of source size), %u not requantizable\n",
+                  previewsUploaded, previewBytes * 100.0f / previewSourceBytes, previewFailures);
+  }
+  Serial.printf("Payload hashes: %u from capture, %u computed at upload\n",
+                hashesFromLog, hashesComputed);
   Serial.println("========================\n");
 }
 
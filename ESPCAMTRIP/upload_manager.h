@@ -7,6 +7,12 @@
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 
+// Written in a capture directory once all its previews are uploaded
+#define PREVIEW_MARKER_FILE "previews.done"
+
+// Largest file read into RAM for upload; larger ones are streamed from SD
+#define UPLOAD_BUFFER_LIMIT (1024 * 1024)
+
 class UploadManager {
 public:
   // Upload tracking
@@ -19,7 +25,19 @@ public:
   // Upload operations
   static void uploadPendingDirectories();
   static bool uploadDirectory(const String& directoryPath);
-  static bool uploadFile(File& file, const String& directoryPath);
+  // sha256: digest recorded at capture (mission log), hashed here if nullptr
+  static bool uploadFile(File& file, const String& directoryPath,
+                         const uint8_t* sha256 = nullptr);
+
+  // Mission manifest (GeoJSON) of each pending directory, before previews
+  // and photos; true if the directory has none
+  static bool uploadManifest(const String& directoryPath);
+
+  // Preview tier: requantized copies under <directory>/preview/ in S3,
+  // uploaded for every pending directory before any full-size photo
+  static bool uploadPreviews(const String& directoryPath);
+  static bool uploadPreview(File& file, const String& directoryPath);
+  static bool runPreviewBenchmark(uint8_t frames);
   
   // Statistics
   static uint32_t getUploadedCount();
@@ -30,6 +48,12 @@ private:
   static std::vector<String> uploadedDirectories;
   static uint32_t totalUploaded;
   static uint32_t totalFailed;
+  static uint32_t previewsUploaded;
+  static uint32_t previewFailures;       // Not requantizable (photo still uploads in full)
+  static uint64_t previewBytes;
+  static uint64_t previewSourceBytes;
+  static uint32_t hashesFromLog;         // x-amz-content-sha256 from the capture-time digest
+  static uint32_t hashesComputed;        // Hashed at upload (previews, logs, unlogged photos)
   
   // AWS S3 functions
   static String generateS3Url(const String& key);
@@ -37,6 +61,16 @@ private:
                                    const String& queryString, const String& payload, 
                                    const String& timestamp);
   static bool performS3Upload(const String& url, File& file, const String& contentType);
+  static bool uploadBuffer(const uint8_t* data, size_t size, const String& s3Key,
+                           const char* contentType, const uint8_t* sha256 = nullptr);
+  // Files over the readFile() limit (long mission logs): sent from the SD
+  // card in chunks, hashed in a first pass if there is no capture digest
+  static bool uploadStream(File& file, const String& s3Key, const char* contentType,
+                           const uint8_t* sha256 = nullptr);
+  static void beginPut(HTTPClient& http, WiFiClientSecure& client, const String& s3Key,
+                       const char* contentType, size_t size, const uint8_t* sha256);
+  static uint8_t* readFile(File& file, size_t& size);
+  static size_t repairManifest(uint8_t* data, size_t size);
   
   // Utility functions
   static String extractDirectoryName(const String& path);
@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""Convert an ESPCAMTRIP mission log (mission.bin) to JSON, CSV or GeoJSON.
+
+The layout matches ESPCAMTRIP/mission_log.h: a 32-byte header followed by
+little-endian records (128 bytes in version 1, 160 in version 2, which adds
+the photo's SHA-256, 168 in version 3, which adds the exposure's UTC time in
+microseconds), each ending in a CRC-16/CCITT. Records that fail their
+CRC (e.g. the last one after a power loss) are skipped.
+
+--verify hashes the photos next to the log and compares them with the
+digests recorded at capture (version 2 logs).
+
+Usage:
+    mission_log_convert.py mission.bin [--format json|csv|geojson] [-o out] [--verify]
+"""
+
+import argparse
+import csv
+import hashlib
+import json
+import os
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHII16s")
+RECORDS = {
+    1: struct.Struct("<IIIdd7fIHHhHHBBBBBBBix44sH"),
+    2: struct.Struct("<IIIdd7fIHHhHHBBBBBBBix32s44sH"),
+    3: struct.Struct("<IIIdd7fIHHhHHBBBBBBBix32s44sqH"),
+}
+MAGIC = b"ECML"
+
+GPS_VALID = 0x01
+GEOTAGGED = 0x02
+BLURRED = 0x04
+INTERPOLATED = 0x08
+EXTRAPOLATED = 0x10
+
+FIX_QUALITY = {
+    0: "None", 1: "GPS", 2: "DGPS", 3: "PPS", 4: "RTK Fixed",
+    5: "RTK Float", 6: "Estimated", 7: "Manual", 8: "Simulation",
+}
+
+FIELDS = [
+    "photo_number", "capture_time", "unix_timestamp", "latitude", "longitude",
+    "altitude_msl", "horizontal_accuracy", "speed_ms", "course_degrees", "hdop",
+    "vdop", "age_of_diff", "file_size", "exif_offset", "exif_size", "sharpness",
+    "parse_errors", "checksum_errors", "message_rate_hz", "fix_quality",
+    "satellites_used", "base_station_id", "flags", "frame_size", "jpeg_quality",
+    "fix_offset_us", "sha256", "photo_filename", "exposure_utc_us",
+]
+V2_FIELDS = [f for f in FIELDS if f != "exposure_utc_us"]
+V1_FIELDS = [f for f in V2_FIELDS if f != "sha256"]
+VERSION_FIELDS = {1: V1_FIELDS, 2: V2_FIELDS, 3: FIELDS}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def read_log(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if len(data) < HEADER.size:
+        raise ValueError("file too short for a mission log header")
+    magic, version, record_size, created_unix, created_ms, directory = HEADER.unpack_from(data)
+    record_struct = RECORDS.get(version)
+    if magic != MAGIC or record_struct is None or record_size != record_struct.size:
+        raise ValueError("not a supported mission log (magic %r, version %d, record %d)"
+                         % (magic, version, record_size))
+    fields = VERSION_FIELDS[version]
+    header = {
+        "directory": directory.rstrip(b"\0").decode("ascii", "replace"),
+        "created_unix": created_unix,
+        "created_ms": created_ms,
+        "version": version,
+    }
+
+    records = []
+    skipped = 0
+    size = record_struct.size
+    for offset in range(HEADER.size, len(data) - size + 1, size):
+        raw = data[offset:offset + size]
+        values = record_struct.unpack(raw)
+        if values[-1] != crc16(raw[:-2]):
+            skipped += 1
+            continue
+        record = dict(zip(fields, values[:-1]))
+        record["photo_filename"] = record["photo_filename"].rstrip(b"\0").decode("ascii", "replace")
+        digest = record.get("sha256", b"")
+        record["sha256"] = digest.hex() if digest.strip(b"\0") else ""
+        record.setdefault("exposure_utc_us", 0)  # 0 = unknown, as in the log
+        records.append(record)
+    if (len(data) - HEADER.size) % size:
+        skipped += 1  # Partial record at the end
+
+    return header, records, skipped
+
+
+def to_sidecar(record):
+    """Per-photo object in the structure of the former JSON sidecars."""
+    flags = record["flags"]
+    photo = {
+        "photo_filename": record["photo_filename"],
+        "photo_number": record["photo_number"],
+        "capture_time": record["capture_time"],
+        "file_size": record["file_size"],
+        "sha256": record["sha256"],
+        "camera": {
+            "frame_size": record["frame_size"],
+            "jpeg_quality": record["jpeg_quality"],
+            "pixel_format": "JPEG",
+        },
+    }
+    if record["sharpness"] >= 0:
+        photo["camera"]["sharpness"] = record["sharpness"]
+        photo["camera"]["blurred"] = bool(flags & BLURRED)
+    if record["exif_size"]:
+        photo["exif"] = {"offset": record["exif_offset"], "size": record["exif_size"]}
+    if flags & GEOTAGGED:
+        photo["unix_timestamp"] = record["unix_timestamp"]
+        photo["exposure_utc_us"] = record["exposure_utc_us"]
+        photo["gps"] = {
+            "latitude": record["latitude"],
+            "longitude": record["longitude"],
+            "altitude_msl": record["altitude_msl"],
+            "horizontal_accuracy": record["horizontal_accuracy"],
+            "speed_ms": record["speed_ms"],
+            "course_degrees": record["course_degrees"],
+            "fix_quality": record["fix_quality"],
+            "fix_quality_text": FIX_QUALITY.get(record["fix_quality"], "Unknown"),
+            "satellites_used": record["satellites_used"],
+            "hdop": record["hdop"],
+            "vdop": record["vdop"],
+            "age_of_diff": record["age_of_diff"],
+            "base_station_id": record["base_station_id"],
+            "valid": bool(flags & GPS_VALID),
+            "position": ("interpolated" if flags & INTERPOLATED else
+                         "extrapolated" if flags & EXTRAPOLATED else "latest"),
+            "fix_offset_us": record["fix_offset_us"],
+        }
+        photo["gps_stats"] = {
+            "parse_errors": record["parse_errors"],
+            "checksum_errors": record["checksum_errors"],
+            "message_rate_hz": record["message_rate_hz"],
+        }
+    return photo
+
+
+def write_json(out, header, records):
+    json.dump({"mission": header, "photos": [to_sidecar(r) for r in records]}, out, indent=2)
+    out.write("\n")
+
+
+def write_csv(out, header, records):
+    writer = csv.DictWriter(out, fieldnames=FIELDS)
+    writer.writeheader()
+    writer.writerows(records)
+
+
+def write_geojson(out, header, records):
+    features = []
+    for record in records:
+        if not record["flags"] & GEOTAGGED:
+            continue
+        features.append({
+            "type": "Feature",
+            "geometry": {
+                "type": "Point",
+                "coordinates": [record["longitude"], record["latitude"], record["altitude_msl"]],
+            },
+            "properties": {k: v for k, v in record.items()
+                           if k not in ("latitude", "longitude", "altitude_msl")},
+        })
+    json.dump({"type": "FeatureCollection", "properties": header, "features": features},
+              out, indent=2)
+    out.write("\n")
+
+
+WRITERS = {"json": write_json, "csv": write_csv, "geojson": write_geojson}
+
+
+def verify_photos(log_path, records):
+    """Compare photos next to the log with their capture-time SHA-256."""
+    directory = os.path.dirname(os.path.abspath(log_path))
+    checked = mismatched = missing = 0
+    for record in records:
+        if not record["sha256"]:
+            continue
+        path = os.path.join(directory, record["photo_filename"])
+        if not os.path.exists(path):
+            missing += 1
+            continue
+        with open(path, "rb") as f:
+            digest = hashlib.sha256(f.read()).hexdigest()
+        checked += 1
+        if digest != record["sha256"]:
+            mismatched += 1
+            print("MISMATCH %s" % record["photo_filename"], file=sys.stderr)
+    print("Verified %d photos: %d mismatched, %d missing" % (checked, mismatched, missing),
+          file=sys.stderr)
+    return mismatched == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="mission.bin from a capture directory")
+    parser.add_argument("--format", choices=sorted(WRITERS), default="json")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    parser.add_argument("--verify", action="store_true",
+                        help="check the photos next to the log against their SHA-256")
+    args = parser.parse_args()
+
+    try:
+        header, records, skipped = read_log(args.log)
+    except (OSError, ValueError) as e:
+        sys.exit("%s: %s" % (args.log, e))
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    try:
+        WRITERS[args.format](out, header, records)
+    finally:
+        if args.output:
+            out.close()
+
+    print("%d records, %d skipped (bad CRC or truncated)" % (len(records), skipped),
+          file=sys.stderr)
+    if args.verify and not verify_photos(args.log, records):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
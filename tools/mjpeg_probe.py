@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Measure an ESPCAMTRIP live preview stream (MJPEG): fps, frame age, send time.
+
+Reads the multipart stream from ESPCAMTRIP/preview_server.cpp for a while and
+reports, per frame and in total:
+  - delivered frames per second
+  - frame age: X-Frame-Age-Ms (exposure to start of send, device clock)
+  - transfer time from the part header to the last JPEG byte (client clock)
+  - gaps in X-Frame-Sequence (frames captured but not previewed)
+
+Run it against a camera or the replay source (replay.enabled) to check a
+preview setting before flight, e.g. two probes at once for MAX_CLIENTS=2.
+
+Usage:
+    mjpeg_probe.py http://192.168.4.1:81/stream [--seconds 30] [--save DIR]
+"""
+
+import argparse
+import os
+import socket
+import sys
+import time
+from urllib.parse import urlparse
+
+
+def read_line(sock_file):
+    line = sock_file.readline()
+    if not line:
+        raise EOFError("stream closed")
+    return line.decode("latin-1").rstrip("\r\n")
+
+
+def read_headers(sock_file):
+    headers = {}
+    while True:
+        line = read_line(sock_file)
+        if not line:
+            return headers
+        name, _, value = line.partition(":")
+        headers[name.strip().lower()] = value.strip()
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("url")
+    parser.add_argument("--seconds", type=float, default=30.0)
+    parser.add_argument("--save", help="write received frames to this directory")
+    parser.add_argument("--quiet", action="store_true", help="only print the summary")
+    args = parser.parse_args()
+
+    url = urlparse(args.url)
+    sock = socket.create_connection((url.hostname, url.port or 80), timeout=10)
+    sock.sendall(("GET %s HTTP/1.1\r\nHost: %s\r\n\r\n" %
+                  (url.path or "/stream", url.hostname)).encode())
+    stream = sock.makefile("rb")
+
+    status = read_line(stream)
+    if " 200 " not in status + " ":
+        sys.exit("Server refused the stream: %s" % status)
+    headers = read_headers(stream)
+    content_type = headers.get("content-type", "")
+    if "boundary=" not in content_type:
+        sys.exit("Not a multipart stream: %s" % content_type)
+    boundary = "--" + content_type.split("boundary=")[1].strip()
+
+    if args.save:
+        os.makedirs(args.save, exist_ok=True)
+
+    ages, send_times, intervals = [], [], []
+    total_bytes = 0
+    skipped = 0
+    last_sequence = None
+    last_arrival = None
+    start = time.monotonic()
+
+    while time.monotonic() - start < args.seconds:
+        line = read_line(stream)
+        if not line:
+            continue
+        if line != boundary:
+            sys.exit("Unexpected data in stream: %r" % line[:40])
+
+        part_start = time.monotonic()
+        part = read_headers(stream)
+        length = int(part["content-length"])
+        jpeg = stream.read(length)
+        if len(jpeg) != length:
+            raise EOFError("stream closed mid-frame")
+        arrival = time.monotonic()
+
+        sequence = int(part.get("x-frame-sequence", -1))
+        age = int(part.get("x-frame-age-ms", 0))
+        send_ms = (arrival - part_start) * 1000.0
+        if last_sequence is not None and sequence > last_sequence + 1:
+            skipped += sequence - last_sequence - 1
+        if last_arrival is not None:
+            intervals.append(arrival - last_arrival)
+        last_sequence = sequence
+        last_arrival = arrival
+
+        ages.append(age)
+        send_times.append(send_ms)
+        total_bytes += length
+        if args.save:
+            with open(os.path.join(args.save, "frame_%05d.jpg" % sequence), "wb") as f:
+                f.write(jpeg)
+        if not args.quiet:
+            print("frame %5d  %7d bytes  age %5d ms  send %7.1f ms" %
+                  (sequence, length, age, send_ms))
+
+    elapsed = time.monotonic() - start
+    sock.close()
+
+    if not ages:
+        sys.exit("No frames received in %.0f s" % elapsed)
+
+    print("\nFrames: %d in %.1f s (%.2f fps), %.1f KB/s" %
+          (len(ages), elapsed, len(ages) / elapsed, total_bytes / 1024.0 / elapsed))
+    print("Frame age (exposure to send) avg/p95/max: %.0f/%d/%d ms" %
+          (sum(ages) / len(ages), percentile(ages, 0.95), max(ages)))
+    print("Send time avg/p95/max: %.0f/%.0f/%.0f ms" %
+          (sum(send_times) / len(send_times), percentile(send_times, 0.95), max(send_times)))
+    if intervals:
+        print("Frame interval avg/max: %.0f/%.0f ms" %
+              (1000.0 * sum(intervals) / len(intervals), 1000.0 * max(intervals)))
+    print("Captured frames not previewed: %d" % skipped)
+    print("End-to-end latency (age + send) avg: %.0f ms" %
+          (sum(ages) / len(ages) + sum(send_times) / len(send_times)))
+
+
+if __name__ == "__main__":
+    main()
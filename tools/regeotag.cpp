@@ -0,0 +1,531 @@
+/*
+ * regeotag: rewrite the GPS positions of ESPCAMTRIP photos in place from a
+ * post-processed (PPK) trajectory.
+ *
+ * Every photo carries the same fixed-size EXIF APP1 segment right after
+ * SOI (ESPCAMTRIP/exif_gps_layout.h), so re-geotagging needs no JPEG
+ * parsing and no file rewrite: the start of each file is memory-mapped,
+ * checked against the template and the GPS rationals are patched in the
+ * mapped page. Photos from other cameras are left alone. Files are
+ * spread over one thread per core.
+ *
+ * Trajectory (detected per line):
+ *   - RTKLIB .pos with latitude/longitude in degrees, time as
+ *     "yyyy/mm/dd hh:mm:ss.sss" or "week tow"; GPST times are converted to
+ *     UTC with --leap-seconds. Q 1/2 (fix/float) is written as "RTK",
+ *     sqrt(sdn^2 + sde^2) as the horizontal error
+ *   - CSV unix_time,latitude,longitude,altitude[,accuracy]
+ * Positions are interpolated linearly between the epochs around the photo
+ * time; photos outside the trajectory or in a gap over --max-gap keep
+ * their position. DOP, speed and track are kept.
+ *
+ * Photo time: the EXIF GPS date and time, or --times with the CSV from
+ * mission_log_convert.py: exposure_utc_us per photo_filename (version 3
+ * logs). Current firmware stamps GPSTimeStamp with the exposure's UTC time
+ * to the millisecond from the GPS clock (camera clock before the receiver
+ * had a date). Older firmware stamped the whole second of the fix the
+ * camera used, and version 2 logs only have that second (unix_timestamp)
+ * plus fix_offset_us: both drop the fix's fraction of a second, so the
+ * time is exact with 1 Hz fixes and otherwise early by up to 1 s minus
+ * one fix interval (0.8 s at 5 Hz). --offset is added to all of them.
+ *
+ * Heights are written as given; EXIF altitude is above sea level, so
+ * convert ellipsoidal heights first. Patched photos no longer match the
+ * SHA-256 in mission.bin: re-geotag after upload, or copies.
+ *
+ * Build (Linux):
+ *   g++ -O2 -std=c++17 -pthread -I ESPCAMTRIP -o regeotag \
+ *       tools/regeotag.cpp ESPCAMTRIP/exif_gps_layout.cpp
+ *
+ * Usage:
+ *   regeotag -t flight.pos [--times photos.csv] [--offset SEC]
+ *            [--leap-seconds N] [--max-gap SEC] [--jobs N] [--dry-run]
+ *            [-v] PHOTO_OR_DIRECTORY...
+ */
+
+#include "exif_gps_layout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The EXIF layout is little-endian TIFF");
+
+#define GPS_EPOCH_UNIX 315964800.0         // 1980-01-06 00:00:00 UTC
+#define GPS_LEAP_SECONDS 18                // GPST - UTC since 2017-01-01
+#define METERS_PER_DEG_LAT 111320.0
+#define DEG_TO_RAD 0.017453292519943295
+
+// RTKLIB solution quality
+#define POS_QUALITY_UNKNOWN 0              // CSV: keep the photo's method
+#define POS_QUALITY_FIX 1
+#define POS_QUALITY_FLOAT 2
+
+struct TrajectoryEpoch {
+    double time;                           // Unix time, UTC
+    double latitude;
+    double longitude;
+    double height;
+    double accuracy;                       // m horizontal, NAN = unknown
+    int quality;                           // POS_QUALITY_*, or RTKLIB Q
+};
+
+struct Options {
+    std::string trajectory;
+    std::string times;
+    double offset = 0.0;
+    int leapSeconds = GPS_LEAP_SECONDS;
+    double maxGap = 1.0;
+    unsigned jobs = 0;
+    bool dryRun = false;
+    bool verbose = false;
+    std::vector<std::string> paths;
+};
+
+enum PhotoResult {
+    PHOTO_PATCHED = 0,
+    PHOTO_NOT_OURS,                        // No ESPCAMTRIP EXIF header
+    PHOTO_NO_TIME,                         // No GPS date or --times entry
+    PHOTO_NO_POSITION,                     // Outside the trajectory or in a gap
+    PHOTO_ERROR,                           // open/mmap failed
+    PHOTO_RESULTS
+};
+
+static const char* const RESULT_NAMES[PHOTO_RESULTS] = {
+    "patched", "not ESPCAMTRIP", "no time", "outside trajectory or gap", "errors"
+};
+
+static std::vector<TrajectoryEpoch> trajectory;
+static std::map<std::string, double> photoTimes;
+static std::mutex outputMutex;
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static double daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return (double)era * 146097 + dayOfEra - 719468;
+}
+
+// One trajectory line; false for comments, headers and unparsable lines
+static bool parseEpoch(const char* line, bool gpst, int leapSeconds, TrajectoryEpoch& epoch) {
+    epoch.accuracy = NAN;
+    epoch.quality = POS_QUALITY_UNKNOWN;
+
+    if (strchr(line, ',')) {
+        return sscanf(line, "%lf,%lf,%lf,%lf,%lf", &epoch.time, &epoch.latitude, &epoch.longitude,
+                      &epoch.height, &epoch.accuracy) >= 4;
+    }
+
+    // RTKLIB: time, lat, lon, height, Q, ns, sdn, sde, ...
+    int fields, quality = POS_QUALITY_UNKNOWN, satellites;
+    double sdn = NAN, sde = NAN;
+    if (strchr(line, '/')) {
+        int year, month, day, hour, minute;
+        double second;
+        fields = sscanf(line, "%d/%d/%d %d:%d:%lf %lf %lf %lf %d %d %lf %lf", &year, &month, &day,
+                        &hour, &minute, &second, &epoch.latitude, &epoch.longitude, &epoch.height,
+                        &quality, &satellites, &sdn, &sde);
+        if (fields < 9) {
+            return false;
+        }
+        epoch.time = daysFromCivil(year, month, day) * 86400.0 + hour * 3600 + minute * 60 + second;
+        fields -= 5;
+    } else {
+        int week;
+        double tow;
+        fields = sscanf(line, "%d %lf %lf %lf %lf %d %d %lf %lf", &week, &tow, &epoch.latitude,
+                        &epoch.longitude, &epoch.height, &quality, &satellites, &sdn, &sde);
+        if (fields < 5) {
+            return false;
+        }
+        epoch.time = GPS_EPOCH_UNIX + week * 604800.0 + tow;
+        gpst = true;                       // Week/TOW is always GPST
+        fields -= 1;
+    }
+    if (gpst) {
+        epoch.time -= leapSeconds;
+    }
+    epoch.quality = quality;
+    if (fields >= 8) {
+        epoch.accuracy = sqrt(sdn * sdn + sde * sde);
+    }
+    return true;
+}
+
+static bool loadTrajectory(const Options& options) {
+    FILE* file = fopen(options.trajectory.c_str(), "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open trajectory %s: %s\n", options.trajectory.c_str(), strerror(errno));
+        return false;
+    }
+
+    char line[512];
+    bool gpst = false;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '%') {
+            // RTKLIB column header names the time system and angle format
+            if (strstr(line, "latitude(")) {
+                if (strstr(line, "latitude(d'")) {
+                    fprintf(stderr, "%s: latitude/longitude must be in degrees, not d m s\n",
+                            options.trajectory.c_str());
+                    fclose(file);
+                    return false;
+                }
+                gpst = strstr(line, "GPST") != nullptr;
+            }
+            continue;
+        }
+        TrajectoryEpoch epoch;
+        if (parseEpoch(line, gpst, options.leapSeconds, epoch)) {
+            trajectory.push_back(epoch);
+        }
+    }
+    fclose(file);
+
+    std::stable_sort(trajectory.begin(), trajectory.end(),
+                     [](const TrajectoryEpoch& a, const TrajectoryEpoch& b) { return a.time < b.time; });
+    if (trajectory.size() < 2) {
+        fprintf(stderr, "%s: fewer than 2 epochs\n", options.trajectory.c_str());
+        return false;
+    }
+    return true;
+}
+
+// --times: photo_filename -> exposure_utc_us, or unix_timestamp + fix_offset_us
+// for version 2 logs, from mission_log_convert.py
+static bool loadPhotoTimes(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line)) {
+        fprintf(stderr, "Cannot read photo times %s\n", path.c_str());
+        return false;
+    }
+
+    auto split = [](const std::string& text) {
+        std::vector<std::string> fields;
+        size_t start = 0, comma;
+        while ((comma = text.find(',', start)) != std::string::npos) {
+            fields.push_back(text.substr(start, comma - start));
+            start = comma + 1;
+        }
+        fields.push_back(text.substr(start, text.find_last_not_of("\r\n") + 1 - start));
+        return fields;
+    };
+
+    std::vector<std::string> header = split(line);
+    auto column = [&](const char* name) {
+        auto it = std::find(header.begin(), header.end(), name);
+        return it == header.end() ? -1 : (int)(it - header.begin());
+    };
+    int nameColumn = column("photo_filename");
+    int timeColumn = column("unix_timestamp");
+    int offsetColumn = column("fix_offset_us");
+    int exposureColumn = column("exposure_utc_us");
+    if (nameColumn < 0 || timeColumn < 0) {
+        fprintf(stderr, "%s: needs photo_filename and unix_timestamp columns\n", path.c_str());
+        return false;
+    }
+
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields = split(line);
+        int last = std::max(std::max(nameColumn, timeColumn), std::max(offsetColumn, exposureColumn));
+        if ((int)fields.size() <= last) {
+            continue;
+        }
+        long long exposureUs = exposureColumn >= 0 ? atoll(fields[exposureColumn].c_str()) : 0;
+        if (exposureUs > 0) {
+            photoTimes[baseName(fields[nameColumn])] = exposureUs / 1e6;
+            continue;
+        }
+        double time = atof(fields[timeColumn].c_str());
+        if (time <= 0) {
+            continue;                      // Not geotagged: no fix time
+        }
+        if (offsetColumn >= 0) {
+            time += atof(fields[offsetColumn].c_str()) / 1e6;
+        }
+        photoTimes[baseName(fields[nameColumn])] = time;
+    }
+    return true;
+}
+
+static bool interpolate(double time, TrajectoryEpoch& out, double maxGap) {
+    auto after = std::lower_bound(trajectory.begin(), trajectory.end(), time,
+                                  [](const TrajectoryEpoch& e, double t) { return e.time < t; });
+    if (after == trajectory.end()) {
+        return false;
+    }
+    if (after->time == time) {
+        out = *after;
+        return true;
+    }
+    if (after == trajectory.begin()) {
+        return false;
+    }
+    const TrajectoryEpoch& a = *(after - 1);
+    const TrajectoryEpoch& b = *after;
+    if (b.time - a.time > maxGap) {
+        return false;
+    }
+
+    double f = (time - a.time) / (b.time - a.time);
+    double dlon = b.longitude - a.longitude;
+    if (dlon > 180.0) dlon -= 360.0;       // Shortest way across the antimeridian
+    if (dlon < -180.0) dlon += 360.0;
+    out.time = time;
+    out.latitude = a.latitude + (b.latitude - a.latitude) * f;
+    out.longitude = a.longitude + dlon * f;
+    if (out.longitude > 180.0) out.longitude -= 360.0;
+    if (out.longitude < -180.0) out.longitude += 360.0;
+    out.height = a.height + (b.height - a.height) * f;
+    out.accuracy = a.accuracy + (b.accuracy - a.accuracy) * f;
+    out.quality = std::max(a.quality, b.quality);  // The worse solution
+    return true;
+}
+
+static PhotoResult ioError(const std::string& path, const char* operation) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    fprintf(stderr, "%s: %s: %s\n", path.c_str(), operation, strerror(errno));
+    return PHOTO_ERROR;
+}
+
+static PhotoResult processPhoto(const std::string& path, const Options& options, double& shift) {
+    int fd = open(path.c_str(), options.dryRun ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
+        return ioError(path, "open");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        PhotoResult result = ioError(path, "stat");
+        close(fd);
+        return result;
+    }
+
+    // Only the header is mapped: one page, whatever the photo size
+    size_t length = EXIFGPSLayout::getThumbnailOffset();
+    if ((size_t)st.st_size < length) {
+        close(fd);
+        return PHOTO_NOT_OURS;
+    }
+    void* map = mmap(nullptr, length, options.dryRun ? PROT_READ : PROT_READ | PROT_WRITE,
+                     options.dryRun ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        PhotoResult result = ioError(path, "mmap");
+        close(fd);
+        return result;
+    }
+    close(fd);                             // The mapping keeps the file open
+
+    PhotoResult result = PHOTO_PATCHED;
+    StaticEXIFHeader* header = EXIFGPSLayout::findHeader((uint8_t*)map, length);
+    double time = 0.0;
+    TrajectoryEpoch epoch;
+    if (!header) {
+        result = PHOTO_NOT_OURS;
+    } else if (!options.times.empty()) {
+        auto it = photoTimes.find(baseName(path));
+        if (it == photoTimes.end()) {
+            result = PHOTO_NO_TIME;
+        } else {
+            time = it->second;
+        }
+    } else if (!EXIFGPSLayout::getTime(header->patch, time)) {
+        result = PHOTO_NO_TIME;
+    }
+    if (result == PHOTO_PATCHED && !interpolate(time + options.offset, epoch, options.maxGap)) {
+        result = PHOTO_NO_POSITION;
+    }
+
+    if (result == PHOTO_PATCHED) {
+        EXIFGPSFix fix;
+        EXIFGPSLayout::getFix(header->patch, fix);
+        double north = (epoch.latitude - fix.latitude) * METERS_PER_DEG_LAT;
+        double east = (epoch.longitude - fix.longitude) * METERS_PER_DEG_LAT *
+                      cos(epoch.latitude * DEG_TO_RAD);
+        shift = fix.valid ? sqrt(north * north + east * east) : NAN;
+
+        fix.latitude = epoch.latitude;
+        fix.longitude = epoch.longitude;
+        fix.altitude = (float)epoch.height;
+        fix.valid = true;
+        if (!isnan(epoch.accuracy)) {
+            fix.accuracy = (float)epoch.accuracy;
+        }
+        if (epoch.quality != POS_QUALITY_UNKNOWN) {
+            fix.rtk = epoch.quality == POS_QUALITY_FIX || epoch.quality == POS_QUALITY_FLOAT;
+        }
+        if (!options.dryRun) {
+            EXIFGPSLayout::setFix(header->patch, fix);
+        }
+
+        if (options.verbose) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            printf("%s %.3f %.9f %.9f %.3f Q%d shift %.3f m\n", path.c_str(), time + options.offset,
+                   epoch.latitude, epoch.longitude, epoch.height, epoch.quality, shift);
+        }
+    } else if (options.verbose) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        printf("%s: %s\n", path.c_str(), RESULT_NAMES[result]);
+    }
+
+    munmap(map, length);
+    return result;
+}
+
+static bool isJPEGName(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".jpg" || ext == ".jpeg";
+}
+
+static std::vector<std::string> collectPhotos(const std::vector<std::string>& paths) {
+    std::vector<std::string> photos;
+    for (const std::string& path : paths) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error)) {
+            photos.push_back(path);
+            continue;
+        }
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error)) {
+            if (entry.is_regular_file() && isJPEGName(entry.path())) {
+                photos.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(photos.begin(), photos.end());
+    return photos;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: regeotag -t TRAJECTORY [options] PHOTO_OR_DIRECTORY...\n"
+            "  -t, --trajectory FILE  RTKLIB .pos (degrees) or CSV unix_time,lat,lon,alt[,accuracy]\n"
+            "  --times FILE           Photo times from mission_log_convert.py --format csv\n"
+            "  --offset SEC           Added to every photo time (default 0)\n"
+            "  --leap-seconds N       GPST - UTC for GPST trajectories (default %d)\n"
+            "  --max-gap SEC          Longest trajectory gap to interpolate over (default 1)\n"
+            "  -j, --jobs N           Worker threads (default: one per core)\n"
+            "  -n, --dry-run          Report without writing\n"
+            "  -v, --verbose          One line per photo\n",
+            GPS_LEAP_SECONDS);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "-t" || arg == "--trajectory") && hasValue) {
+            options.trajectory = argv[++i];
+        } else if (arg == "--times" && hasValue) {
+            options.times = argv[++i];
+        } else if (arg == "--offset" && hasValue) {
+            options.offset = atof(argv[++i]);
+        } else if (arg == "--leap-seconds" && hasValue) {
+            options.leapSeconds = atoi(argv[++i]);
+        } else if (arg == "--max-gap" && hasValue) {
+            options.maxGap = atof(argv[++i]);
+        } else if ((arg == "-j" || arg == "--jobs") && hasValue) {
+            options.jobs = (unsigned)atoi(argv[++i]);
+        } else if (arg == "-n" || arg == "--dry-run") {
+            options.dryRun = true;
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            options.paths.push_back(arg);
+        } else {
+            return false;
+        }
+    }
+    return !options.trajectory.empty() && !options.paths.empty();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    if (!loadTrajectory(options) || (!options.times.empty() && !loadPhotoTimes(options.times))) {
+        return 2;
+    }
+
+    std::vector<std::string> photos = collectPhotos(options.paths);
+    unsigned jobs = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::max(1u, std::min(jobs, (unsigned)photos.size()));
+    printf("Trajectory: %zu epochs, %.3f .. %.3f; %zu photos, %u threads%s\n", trajectory.size(),
+           trajectory.front().time, trajectory.back().time, photos.size(), jobs,
+           options.dryRun ? " (dry run)" : "");
+    fflush(stdout);
+
+    // Workers take the next photo until none are left
+    std::atomic<size_t> next(0);
+    std::atomic<uint32_t> counts[PHOTO_RESULTS] = {};
+    std::mutex shiftMutex;
+    double shiftSum = 0.0, shiftMax = 0.0;
+    uint32_t shifts = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < jobs; t++) {
+        workers.emplace_back([&]() {
+            double sum = 0.0, max = 0.0;
+            uint32_t count = 0;
+            for (size_t i = next++; i < photos.size(); i = next++) {
+                double shift = NAN;
+                PhotoResult result = processPhoto(photos[i], options, shift);
+                counts[result]++;
+                if (result == PHOTO_PATCHED && !isnan(shift)) {
+                    sum += shift;
+                    max = std::max(max, shift);
+                    count++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(shiftMutex);
+            shiftSum += sum;
+            shiftMax = std::max(shiftMax, max);
+            shifts += count;
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s %u of %zu photos in %.3f s: %.0f photos/s\n", options.dryRun ? "Would patch" : "Patched",
+           counts[PHOTO_PATCHED].load(), photos.size(), elapsed,
+           elapsed > 0 ? photos.size() / elapsed : 0.0);
+    if (shifts > 0) {
+        printf("Position shift: mean %.3f m, max %.3f m (%u photos with a previous fix)\n",
+               shiftSum / shifts, shiftMax, shifts);
+    }
+    for (int r = PHOTO_NOT_OURS; r < PHOTO_RESULTS; r++) {
+        if (counts[r] > 0) {
+            printf("Skipped (%s): %u\n", RESULT_NAMES[r], counts[r].load());
+        }
+    }
+    return counts[PHOTO_ERROR] > 0 ? 1 : 0;
+}